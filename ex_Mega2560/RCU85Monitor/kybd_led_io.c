@@ -20,6 +20,7 @@
 
 #include "kybd_led_io.h"
 #include <avrlib/gpio_api.h>
+#include <avrlib/busseq.h>
 #include <avrlib/libtime.h>
 
 /* Physical Description of the RCU-85 Keyboard/LED controller
@@ -126,21 +127,40 @@ static uint8_t disp_setup = 0;
 #define DISP_TIM_HOLD_US    1
 #define DISP_TIM_POST_US    1
 
-// Write a byte to the display
-static int disp_write(uint8_t byt, uint8_t mode) {
+#define DISP_M_WRT          (1<<DDATA_WRT_BIT)
+#define DISP_M_MOD          (1<<DDATA_MOD_BIT)
+
+// Write bytes to the display (bus sequencer, busseq.h): per byte, set
+// up the data/ctrl byte and the data-type ('1' = control-byte), pulse /WR
+#define DISP_STEPS_WRITE(modestep) \
+    BS_OUT(DDATA_PORT),                                             \
+    modestep,                                                       \
+    BS_WAIT(TM_US_CYCLES(DISP_TIM_PRE_US)),                         \
+    BS_PULSE(DDATA_WRT_PORT, DISP_M_WRT, TM_US_CYCLES(DISP_TIM_HOLD_US)), \
+    BS_WAIT(TM_US_CYCLES(DISP_TIM_POST_US))
+
+// one control byte
+static const bs_step_t disp_prog_ctrl[] BS_PROGMEM = {
+    DISP_STEPS_WRITE(BS_SET(DDATA_MOD_PRT, DISP_M_MOD)),
+    BS_END()
+};
+
+// one control byte, then the 8 data bytes (digits)
+static const bs_step_t disp_prog_frame[] BS_PROGMEM = {
+    DISP_STEPS_WRITE(BS_SET(DDATA_MOD_PRT, DISP_M_MOD)),   /* 0 .. 4 */
+    BS_REP(8),                                              /* 5      */
+    DISP_STEPS_WRITE(BS_CLR(DDATA_MOD_PRT, DISP_M_MOD)),   /* 6 .. 10 */
+    BS_DJNZ(6),
+    BS_END()
+};
+
+static int disp_run(const bs_step_t * prog, uint8_t * buf) {
     int rc = KD_ERR_DISP;
     if (disp_setup) {
-        /* setup data/ctrl byte on data-port */
-        pm_out(hndl_ddata, byt);
-        /* set data-type, '1' = control-byte */
-        pm_out(hndl_dmod, mode);
-        tm_delay_us(DISP_TIM_PRE_US);
-        /* pulse the /WR line */
-        pm_out(hndl_dwrt, DISP_WRITE);
-        tm_delay_us(DISP_TIM_HOLD_US);
-        pm_out(hndl_dwrt, DISP_WR_IDLE);
-        tm_delay_us(DISP_TIM_POST_US);
-        rc = KD_SUCCESS;
+        bs_ctx_t bc = { buf, 1, 0, 0, NULL };
+        if (bs_run(prog, &bc) > 0) {
+            rc = KD_SUCCESS;
+        }
     }
     return rc;
 }
@@ -152,10 +172,13 @@ static int disp_init(void) {
     hndl_dmod  = pm_register_pin(DDATA_MOD_PRT, DDATA_MOD_BIT, PINMODE_OUTPUT_LO);
     hndl_ddata = pm_register_prt(DDATA_PORT, 0, PINMODE_OUTPUT_LO);
     if ((hndl_dwrt > 0) && (hndl_dmod > 0) && (hndl_ddata > 0)) {
+        pm_static(hndl_dwrt);
+        pm_static(hndl_dmod);
+        pm_static(hndl_ddata);
         uint8_t disp = DISP_CTRL_INIT;
         disp_setup = 1; // setup completed.
         // setup the ICM7218A for HEX output
-        rc = disp_write(disp, DISP_MODE_CTRL);
+        rc = disp_run(disp_prog_ctrl, &disp);
     }
     return rc;
 }
@@ -167,27 +190,22 @@ uint8_t disp_isInitializaed(void) {
 // call to refresh the LED 7-Segment Display
 int disp_update(kybd_t * disp) {
     int rc = KD_ERR_DISP;
+    PROF_BEGIN(KD_PROF_DISP);
     if (disp && disp_setup) {
-    do {
-        uint8_t dd = DISP_CTRL_START_UPDATE;
-        if ((rc = disp_write(dd, DISP_MODE_CTRL)) != KD_SUCCESS) break;
-        dd = (disp->ds.dat.addr_hi >> 4) & 0x0f;    // A[15..12]
-        if ((rc = disp_write(dd, DISP_MODE_DATA)) != KD_SUCCESS) break;
-        dd = disp->ds.dat.addr_hi & 0x0f;           // A[11..8]
-        if ((rc = disp_write(dd, DISP_MODE_DATA)) != KD_SUCCESS) break;
-        dd = (disp->ds.dat.addr_lo >> 4) & 0x0f;    // A[7..4]
-        if ((rc = disp_write(dd, DISP_MODE_DATA)) != KD_SUCCESS) break;
-        dd = disp->ds.dat.addr_lo & 0x0f;           // A[3..0]
-        if ((rc = disp_write(dd, DISP_MODE_DATA)) != KD_SUCCESS) break;
-        dd = (disp->ds.dat.data >> 4) & 0x0f;       // D[7..4]
-        if ((rc = disp_write(dd, DISP_MODE_DATA)) != KD_SUCCESS) break;
-        dd = disp->ds.dat.data & 0x0f;              // D[3..0]
-        if ((rc = disp_write(dd, DISP_MODE_DATA)) != KD_SUCCESS) break;
+        uint8_t dd[9];
+        dd[0] = DISP_CTRL_START_UPDATE;
+        dd[1] = (disp->ds.dat.addr_hi >> 4) & 0x0f;    // A[15..12]
+        dd[2] = disp->ds.dat.addr_hi & 0x0f;           // A[11..8]
+        dd[3] = (disp->ds.dat.addr_lo >> 4) & 0x0f;    // A[7..4]
+        dd[4] = disp->ds.dat.addr_lo & 0x0f;           // A[3..0]
+        dd[5] = (disp->ds.dat.data >> 4) & 0x0f;       // D[7..4]
+        dd[6] = disp->ds.dat.data & 0x0f;              // D[3..0]
         // 2 zeros (unused displays)
-        if ((rc = disp_write(0, DISP_MODE_DATA)) != KD_SUCCESS) break;
-        rc = disp_write(0, DISP_MODE_DATA);
-    } while (0);
+        dd[7] = 0;
+        dd[8] = 0;
+        rc = disp_run(disp_prog_frame, dd);
     }
+    PROF_END(KD_PROF_DISP);
     return rc;
 }
 
@@ -239,6 +257,8 @@ static int kybd_init(void) {
     hndl_kybd_clk = pm_register_pin(KYBDCRTL_CK_PRT, KYBDCRTL_CK_PIN, KYBDCRTL_CK_MOD);
     hndl_kybd_din = pm_register_pin(KYBDDATA_PRT, KYBDDATA_PIN, KYBDDATA_MOD);
     if ((hndl_kybd_ld > PM_SUCCESS) && (hndl_kybd_clk > PM_SUCCESS) && (hndl_kybd_din > PM_SUCCESS)) {
+        pm_static(hndl_kybd_ld);
+        pm_static(hndl_kybd_clk);
         kybd_setup = 1; // setup completed.
         rc = KD_SUCCESS;
     }
@@ -249,69 +269,37 @@ uint8_t kybd_isInitializaed(void) {
     return kybd_setup;
 }
 
-static int kybd_clk(void) {
-    int rc = KD_ERR_KYBD;
-    if (kybd_setup) {
-        int grc = PM_ERROR;
-        do {
-            if ((grc = pm_tog(hndl_kybd_clk)) != PM_SUCCESS) break;
-            tm_delay_us(KYBD_CLK_PD_US);
-            if ((grc = pm_tog(hndl_kybd_clk)) != PM_SUCCESS) break;
-            tm_delay_us(KYBD_CLK_PD_US);
-        } while (0);
-        rc = (grc == PM_SUCCESS) ? KD_SUCCESS : KD_ERR_KYBD;
-    }
-    return rc;
-}
+#define KYBD_M_LD   (1<<KYBDCRTL_LD_PIN)
+#define KYBD_M_CK   (1<<KYBDCRTL_CK_PIN)
+#define KYBD_M_DIN  (1<<KYBDDATA_PIN)
 
-static int kybd_load(void) {
-    int rc = KD_ERR_KYBD;
-    if (kybd_setup) {
-        int grc = PM_ERROR;
-        do {
-            if ((grc = pm_tog(hndl_kybd_ld)) != PM_SUCCESS) break;
-            tm_delay_us(KYBD_LOAD_DLY_US);
-            if ((grc = pm_tog(hndl_kybd_ld)) != PM_SUCCESS) break;
-            tm_delay_us(KYBD_LOAD_DLY_US);
-        } while (0);
-        rc = (grc == PM_SUCCESS) ? KD_SUCCESS : KD_ERR_KYBD;
-    }
-    return rc;
-}
+// one key-scan (bus sequencer, busseq.h): pulse /LOAD, then per shifter
+// sample DIN and clock 8 times. Bit-0 comes first: shift in at b7, the
+// 8th sample lands the first bit in b0.
+static const bs_step_t kybd_prog_scan[] BS_PROGMEM = {
+    BS_PULSE(KYBDCRTL_LD_PRT, KYBD_M_LD, TM_US_CYCLES(KYBD_LOAD_DLY_US)),   /* 0 */
+    BS_WAIT(TM_US_CYCLES(KYBD_LOAD_DLY_US)),
+    BS_REP(8),                                                              /* 2: shifter */
+    BS_SHIN(KYBDDATA_PRT, KYBD_M_DIN),                                      /* 3: bit */
+    BS_PULSE(KYBDCRTL_CK_PRT, KYBD_M_CK, TM_US_CYCLES(KYBD_CLK_PD_US)),
+    BS_WAIT(TM_US_CYCLES(KYBD_CLK_PD_US)),
+    BS_DJNZ(3),
+    BS_PUT(),
+    BS_LOOP(2),
+    BS_END()
+};
 
 // call to invoke one key-scan. Blocks until done.
 int kybd_scan(kybd_t * kdata) {
     int rc = KD_ERR_KYBD;
-    if (kybd_setup) {
-        if ((rc = kybd_load()) == KD_SUCCESS) {
-            uint8_t grc,d,p,b;
-            for (p = 0 ; p < KYBD_SHIFTER_COUNT ; ++p) {
-                d = 0;
-                // shift 7 times, save on the last (8th) iteration
-                for (b = 0 ; b < 8 ; ++b) {
-                    grc = pm_in(hndl_kybd_din);
-                    if (grc >= 0) {
-                        if (grc) {
-                            d |= 0x80; // DIN ~ '1'
-                        }
-                        // 8-th run does not shift the data, it is saved instead.
-                        if (b < 7) {
-                            d = d >> 1;
-                        } else {
-                            kdata->ds.byt[p] = d;
-                        }
-                        kybd_clk(); // 1 .. 7
-                    } else {
-                        rc = KD_ERR_KYBD;
-                        break;
-                    }
-                } // for (b)
-                if (rc == KD_ERR_KYBD) {
-                    break; // fail out of outer loop
-                }
-            } // for(p)
-        } // load ok
+    PROF_BEGIN(KD_PROF_KYBD);
+    if (kybd_setup && kdata) {
+        bs_ctx_t bc = { kdata->ds.byt, KYBD_SHIFTER_COUNT, 0, 0, NULL };
+        if (bs_run(kybd_prog_scan, &bc) == KYBD_SHIFTER_COUNT) {
+            rc = KD_SUCCESS;
+        }
     } // keyboard configured ok
+    PROF_END(KD_PROF_KYBD);
     return rc;
 }
 
@@ -22,6 +22,7 @@
 #define _KYBD_LED_IO_H_
 
 #include <avrlib/avrlib.h>
+#include <avrlib/libprof.h>
 
 /* Some functions return a success/fail code -------------------------*/
 #define KD_SUCCESS  0
@@ -29,6 +30,10 @@
 #define KD_ERR_KYBD (-2)
 #define KD_ERR_DISP (-3)
 
+/* profiling probes (libprof.h) */
+#define KD_PROF_DISP    (PROF_USER+1)   /* disp_update() */
+#define KD_PROF_KYBD    (PROF_USER+2)   /* kybd_scan()   */
+
 /* To accomodate 4 byte int bit-mask, extra byte will be used in 
  * future update. 
  */
@@ -12,6 +12,11 @@
  *  write   (w)         write 1..8 bytes to given address
  *  addr    (a)         set start address
  *  bwrt    (b)         send a "bulk" write, for loading programs
+ *  prof                dump and reset the profiling probes
+ *  trace               dump the event trace
+ *  mem                 RAM usage, stack high-water mark
+ *  buscal              calibrate, save the bus cycle timing
+ *  xmem                bus transfers through XMEM or the GPIO bus cycle
  * 
  **********************************************************************/
 
@@ -20,6 +25,9 @@
 #include "kybd_led_io.h"
 #include <avrlib/stringutils.h>
 #include <avrlib/cmdparser.h>
+#include <avrlib/libprof.h>
+#include <avrlib/libtrace.h>
+#include <avrlib/libmem.h>
 #ifdef TDD_PRINTF 
  #include <stdio.h>
 #endif
@@ -50,9 +58,27 @@ System help menu ----------------------------------------------------\r\n\
                                released using run (go)\r\n\
   run       (go) [reset]       Release the RCU85, when being manually held.\r\n\
                                If optional 'reset' is added then CPU is reset.\r\n\
-  NOTE: halt,run not required as a write will perform a halt,release. If \r\n\
-   the CPU is to be held during multiple read,write ops then call 'halt'\r\n\
-   first, perform reads,writes then manually release the CPU using 'run'.\r\n\
+  prof                         Dump and reset the profiling probes (build\r\n\
+                               with PROF=1). Times are CPU cycles, or ns\r\n\
+                               in the host build.\r\n\
+  trace     [clear]            Dump and empty the event trace (build with\r\n\
+                               TRACE=1): time (us), event, argument in hex.\r\n\
+                               See tools/tracedec.\r\n\
+  mem       [reset]            RAM usage in bytes: statics, heap, stack now\r\n\
+                               and deepest, free now and never used.\r\n\
+                               'reset' restarts the deepest figures.\r\n\
+  buscal    [addr | save | default]\r\n\
+                               Bus cycle timing in CPU cycles. 'addr' (hex)\r\n\
+                               calibrates it on 32 bytes of RAM from addr,\r\n\
+                               'save' stores it in EEPROM for the next\r\n\
+                               start, 'default' goes back to the defaults.\r\n\
+  xmem      [on | off]         Bus transfers through the XMEM interface\r\n\
+                               (build with XMEM=1) or the bit-banged bus\r\n\
+                               cycle (default). No argument: the setting.\r\n\
+  NOTE: halt,run not required as read,write hold the CPU and release it\r\n\
+   when no read,write has come for a moment (RCM_IDLE_MS), so a run of\r\n\
+   reads,writes holds it once. To keep it held use 'halt', release it\r\n\
+   with 'run'. 'run' also releases it at once after reads,writes.\r\n\
   NOTE: Hexadecimal values DO NOT need a preceeding '0x'. Just type the\r\n\
    value using 0-9,a-f,A-F characters.\r\n\
   NOTE: Bulk write (bwrt) data is 2 character ASCII-HEX, no leading '0x'.\r\n\
@@ -190,19 +216,13 @@ static int cmd_read(int vc, const char * verbs[]) {
     int rc = CMD_SUCCESS;
     int rcount = 0;
     uint16_t addr;
-    uint8_t  is_held = rcmem_isHeld();
     g_memptr = 0;
     if (vc == 2) {
         addr = sutil_strtohex(verbs[0]);
         g_memptr = sutil_strtohex(verbs[1]);
-        if (is_held) {
-            pSendString("READ: pre-hold on\r\n");
-        }
-        // If not already HALTed, do a localized HALT..RUN around the Write operation
-        if (is_held || rcmem_hold() == RCM_SUCCESS ) {
-            if ( !rcmem_isHeld() ) {
-                pSendString("READ ERROR: hold request failed\r\n");
-            } else if ( (rcount = rcmem_read(addr, g_membuf, g_memptr, (uint8_t)memtype)) != g_memptr) {
+        // Held for the read, released once the commands go idle (or at 'run')
+        if (rcmem_begin() == RCM_SUCCESS ) {
+            if ( (rcount = rcmem_read(addr, g_membuf, g_memptr, (uint8_t)memtype)) != g_memptr) {
                 if (rcount >= 0) {
                     char numbuf[16];
                     int  numptr;
@@ -216,11 +236,10 @@ static int cmd_read(int vc, const char * verbs[]) {
                 } else {
                     pSendString("READ ERROR (Operation Error)\r\n");
                 }
-            } else if (is_held || rcmem_release(NO_CPU_RESET) == RCM_SUCCESS) {
-                prmem(addr, g_membuf, g_memptr);
             } else {
-                pSendString("RCU85 release operation failed.\r\n");
+                prmem(addr, g_membuf, g_memptr);
             }
+            rcmem_commit();
         } else {
             pSendString("RCU85 hold operation failed.\r\n");
         }
@@ -235,7 +254,6 @@ static int cmd_write(int vc, const char * verbs[]) {
     int rc = CMD_SUCCESS;
     uint16_t addr;
     uint8_t  vcp = 0;
-    uint8_t  is_held = rcmem_isHeld();
     g_memptr = 0;
     if (vc >= 2) {
         addr = sutil_strtohex(verbs[vcp++]);
@@ -244,15 +262,14 @@ static int cmd_write(int vc, const char * verbs[]) {
             vcp ++;
         }
         g_memptr = vc - 1;
-        // If not already HALTed, do a localized HALT..RUN around the Write operation
-        if (is_held || rcmem_hold() == RCM_SUCCESS ) {
+        // Held for the write, released once the commands go idle (or at 'run')
+        if (rcmem_begin() == RCM_SUCCESS ) {
             if (rcmem_write(addr, g_membuf, g_memptr, (uint8_t)memtype) != g_memptr) {
                 pSendString("WRITE ERROR\r\n");
-            } else if (is_held || rcmem_release(NO_CPU_RESET) == RCM_SUCCESS) {
-                pSendString("Write OK\r\n");
             } else {
-                pSendString("RCU85 release operation failed.\r\n");
+                pSendString("Write OK\r\n");
             }
+            rcmem_commit();
         } else {
             pSendString("RCU85 hold operation failed.\r\n");
         }
@@ -375,12 +392,16 @@ static int cmd_hwrt(int vc, const char * verbs[]) {
     uint8_t  reccrc  = 0;   /* record crc (decoded from line)       */
     uint8_t  crc     = 0;   /* data crc (calculated)                */
     uint16_t addr    = 0;   /* starting address for 'databuffer'    */
+    uint8_t  pending = 0;   /* a whole line is left in the buffer   */
     hwrt_state_t hstate = HS_WAIT_COLON;
 
     /* Main loop - once entered, keep pulling data from stdin ------*/
     while (hstate < HS_REC_END) {
-        cnt = preadInputStream(linebuffer+linend, 80-linend, READ_TMOUT);
-        if (cnt > 0) {
+        /* parse what is left before waiting, the last records of a
+         * paste may all have come in with one read */
+        cnt = (pending) ? 0 : preadInputStream(linebuffer+linend, 80-linend, READ_TMOUT);
+        if (cnt > 0 || pending) {
+            pending = 0;
             bufend = linend + cnt;
             linebuffer[bufend] = '\0';
             /* check all chars to see that they are valid */
@@ -486,11 +507,13 @@ static int cmd_hwrt(int vc, const char * verbs[]) {
                         brk = 1; // do a buffer shift at this point...
                     } else {
                         pSendString(" CRC-ERR\r\n");
+                        brk = 1; // stop here, idx would not advance
                     }
                     break;
                 case HS_REC_END:
                 case HS_REC_ABORT:
                 default:
+                    brk = 1;
                     break;
                 } /* switch */
                 if (brk) {
@@ -505,10 +528,18 @@ static int cmd_hwrt(int vc, const char * verbs[]) {
                     }
                     /* move remaining line to the front */
                     linend = sutil_memcpy(linebuffer, linebuffer+idx, bufend-idx);
+                    linebuffer[linend] = '\0';
+                    pending = (hstate == HS_WAIT_COLON &&
+                        (sutil_strchar(linebuffer, '\r') >= 0 || sutil_strchar(linebuffer, '\n') >= 0));
                     /* break out to the outer loop, to read stdin */
                     break;
                 }
             } /* while (parsing line buffer) */
+            if (!brk) {
+                /* all of it parsed (eg. the colon came last), the next
+                 * read starts a fresh buffer, not after stale data */
+                linend = 0;
+            }
         } else if (cnt < 0) {
             rc = CMD_ERROR_SYNTAX;
             hstate = HS_REC_ABORT;
@@ -550,9 +581,175 @@ static int cmd_run(int vc, const char * verbs[]) {
     }
     return rc;
 }
-    
+
+// Send 'val' (unsigned) right aligned in a field of 'width' characters,
+// a field too narrow for it (or < 0) gets no padding
+static void prfield(uint32_t val, int width) {
+    char numbuf[12];
+    int  numptr = sutil_asciiunsigned(numbuf, val);
+    numbuf[numptr] = '\0';
+    while (width-- > numptr) {
+        pSendString(" ");
+    }
+    pSendString(numbuf);
+}
+
+static int cmd_prof(int vc, const char * verbs[]) {
+#ifdef PROF_ENABLE
+    prof_stat_t st;
+    const char * name;
+    int pad;
+    uint8_t id;
+    pSendString("id probe      count        min        max        avg\r\n");
+    for ( id = 0 ; id < PROF_MAX_PROBES ; ++id ) {
+        if (prof_get(id, &st) != PROF_SUCCESS || (st.count == 0 && !st.name)) {
+            continue;
+        }
+        prfield(id, 2);
+        pSendString(" ");
+        name = st.name ? st.name : "-";
+        pSendString(name);
+        // at least one space, a long name pushes the columns right
+        pad = 15 - (int)sutil_strlen(name);
+        pSendString(" ");
+        prfield(st.count, pad);
+        prfield(st.min, 11);
+        prfield(st.max, 11);
+        prfield(st.count ? st.total / st.count : 0, 11);
+        pSendString("\r\n");
+    }
+    prof_reset();
+#else
+    pSendString("Profiling is off, build with PROF=1\r\n");
+#endif
+    return CMD_SUCCESS;
+}
+
+static int cmd_trace(int vc, const char * verbs[]) {
+    int rc = CMD_SUCCESS;
+#ifdef TRACE_ENABLE
+    trace_evt_t evt;
+    uint16_t n;
+    if (vc) {
+        if (sutil_strcmp(verbs[0], "clear") == 0) {
+            trace_clear();
+        } else {
+            rc = CMD_ERROR_SYNTAX;
+        }
+    } else {
+        // only what is there now, the ring keeps filling while we send
+        n = trace_count();
+        pSendString("time     evt  arg\r\n");
+        while (n-- && trace_get(&evt)) {
+            pSendHexLong(evt.time);
+            pSendString(" ");
+            pSendHexShort(evt.id);
+            pSendString(" ");
+            pSendHexShort(evt.arg);
+            pSendString("\r\n");
+        }
+        pSendString("lost ");
+        pSendInt(trace_lost());
+        pSendString("\r\n");
+    }
+#else
+    pSendString("Tracing is off, build with TRACE=1\r\n");
+#endif
+    return rc;
+}
+
+// [[COMMAND]] 'mem' - nargs: 0..1
+static int cmd_mem(int vc, const char * verbs[]) {
+    int rc = CMD_SUCCESS;
+    mem_info_t mi;
+    if (vc) {
+        if (sutil_strcmp(verbs[0], "reset") == 0) {
+            mem_reset();
+        } else {
+            rc = CMD_ERROR_SYNTAX;
+        }
+    } else {
+        mem_get(&mi);
+        pSendString("data  ");
+        prfield(mi.data, 6);
+        pSendString("   bss  ");
+        prfield(mi.bss, 6);
+        pSendString("   heap ");
+        prfield(mi.heap, 6);
+        pSendString("\r\nstack ");
+        prfield(mi.stack, 6);
+        pSendString("   max  ");
+        prfield(mi.stack_max, 6);
+        pSendString("\r\nfree  ");
+        prfield(mi.free, 6);
+        pSendString("   min  ");
+        prfield(mi.free_min, 6);
+        pSendString("\r\n");
+    }
+    return rc;
+}
+
+// [[COMMAND]] 'buscal' - nargs: 0..1
+// Read, calibrate or save the bus cycle timing
+static int cmd_buscal(int vc, const char * verbs[]) {
+    int rc = CMD_SUCCESS;
+    rcm_timing_t tm;
+    if (vc) {
+        if (sutil_strcmp(verbs[0], "save") == 0) {
+            rcmem_timing_save();
+        } else if (sutil_strcmp(verbs[0], "default") == 0) {
+            rcmem_set_timing(NULL);
+        } else if (sutil_ishexstring(verbs[0])) {
+            uint16_t addr = sutil_strtohex(verbs[0]);
+            if (rcmem_begin() == RCM_SUCCESS) {
+                if (rcmem_calibrate(addr, RCM_CAL_LEN, NULL) != RCM_SUCCESS) {
+                    pSendString("BUSCAL ERROR: fails at the present timing\r\n");
+                }
+                rcmem_commit();
+            } else {
+                pSendString("RCU85 hold operation failed.\r\n");
+            }
+        } else {
+            rc = CMD_ERROR_SYNTAX;
+        }
+    }
+    if (rc == CMD_SUCCESS) {
+        rcmem_get_timing(&tm);
+        pSendString("Bus timing (cycles): setup ");
+        prfield(tm.setup, 0);
+        pSendString(" strobe ");
+        prfield(tm.strobe, 0);
+        pSendString(" hold ");
+        prfield(tm.hold, 0);
+        pSendString((rcmem_isXmem()) ? " (XMEM in use)\r\n" : "\r\n");
+    }
+    return rc;
+}
+
+// [[COMMAND]] 'xmem' - nargs: 0..1
+// Bus transfers through XMEM or the bit-banged bus cycle
+static int cmd_xmem(int vc, const char * verbs[]) {
+    int rc = CMD_SUCCESS;
+    if (vc) {
+        if (sutil_strcmp(verbs[0], "on") == 0) {
+            if (rcmem_xmem(1) != RCM_SUCCESS) {
+                pSendString("XMEM ERROR: not built in (make XMEM=1)\r\n");
+            }
+        } else if (sutil_strcmp(verbs[0], "off") == 0) {
+            rcmem_xmem(0);
+        } else {
+            rc = CMD_ERROR_SYNTAX;
+        }
+    }
+    if (rc == CMD_SUCCESS) {
+        pSendString("Bus transfers: ");
+        pSendString((rcmem_isXmem()) ? "XMEM\r\n" : "GPIO bus cycle\r\n");
+    }
+    return rc;
+}
+
 /* Register all commands */
-cmdobj pCommandList[11] = {
+cmdobj pCommandList[16] = {
 	{ "help", "h", 0, 0, cmd_help },
     { "mode", "m", 0, 1, cmd_mode },
     { "iom",  "im",0, 1, cmd_iom  },
@@ -563,5 +760,10 @@ cmdobj pCommandList[11] = {
     { "hwrt", NULL,0, 0, cmd_hwrt },
     { "halt","hold",0, 0, cmd_halt },
     { "run", "go", 0, 1, cmd_run  },
+    { "prof", NULL,0, 0, cmd_prof },
+    { "trace",NULL,0, 1, cmd_trace},
+    { "mem",  NULL,0, 1, cmd_mem  },
+    { "buscal",NULL,0,1, cmd_buscal},
+    { "xmem", NULL,0, 1, cmd_xmem },
 	{ NULL, NULL,  0, 0, NULL     }
 };
@@ -0,0 +1,353 @@
+/*********************************************************************
+ * rcu85host.c
+ *
+ * Version 1.0
+ * ---
+ * RCU85 Monitor - Linux host backend (EMULATE_LIB builds only)
+ * See rcu85host.h
+ *
+ **********************************************************************/
+
+#ifdef EMULATE_LIB
+
+#define _GNU_SOURCE
+#include "rcu85host.h"
+#include <avrlib/gpio_api.h>
+#include <avrlib/gpio_emu_dev.h>
+#include <avrlib/libtime.h>
+#include <avrlib/libtrace.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <errno.h>
+#include <fcntl.h>
+#include <signal.h>
+#include <termios.h>
+#include <time.h>
+#include <unistd.h>
+
+#define RH_IMAGE_DEFAULT    "rcu85mon.img"
+#define RH_BUF_LEN          256
+
+/* serialdriver.c, UART_ENABLE_EMU_1 */
+extern int uart_emu1_get_tx(char * strn, int maxread);
+extern int uart_emu1_put_rx(const char * strn, int len);
+extern void uart_emu1_set_isr(void (*isr)(void));
+
+// RCU-85 wiring (see rcu85mem.c, kybd_led_io.c)
+static emu_bus8085_t rh_bus = {
+    PM_PORT_A,                  /* AD0..7   */
+    PM_PORT_C,                  /* A8..15   */
+    { PM_PORT_G, PM_PIN_2 },    /* ALE      */
+    { PM_PORT_G, PM_PIN_1 },    /* /RD      */
+    { PM_PORT_G, PM_PIN_0 },    /* /WR      */
+    { PM_PORT_L, PM_PIN_0 },    /* IO/M     */
+    { PM_PORT_L, PM_PIN_1 },    /* HOLD     */
+    { PM_PORT_L, PM_PIN_2 },    /* HLDA     */
+    { PM_PORT_L, PM_PIN_3 },    /* /RESET   */
+    { PM_PORT_K, PM_PIN_7 },    /* EXTSEL   */
+    5                           /* HLDA latency */
+};
+
+static emu_74165_t rh_kbd = {
+    PM_PORT_K, PM_PIN_4,        /* /LOAD    */
+    PM_PORT_K, PM_PIN_5,        /* CLOCK    */
+    PM_PORT_K, PM_PIN_6,        /* SER.OUT  */
+    3                           /* 24 bits  */
+};
+
+static emu_icm7218_t rh_disp = {
+    PM_PORT_F,                  /* ID0..7   */
+    PM_PORT_K, PM_PIN_0,        /* /WRITE   */
+    PM_PORT_K, PM_PIN_1         /* MODE     */
+};
+
+static int      rh_master = -1;
+static int      rh_slave  = -1;
+static const char * rh_link = NULL;
+static volatile sig_atomic_t rh_stop = 0;
+static volatile sig_atomic_t rh_report = 0;
+static uint8_t  rh_running = 0;
+
+/* bytes read from the pty, not yet taken by the Rx buffer */
+static char     rh_rxbuf[RH_BUF_LEN];
+static int      rh_rxlen = 0;
+/* bytes taken from the Tx buffer, not yet accepted by the pty */
+static char     rh_txbuf[RH_BUF_LEN];
+static int      rh_txlen = 0;
+
+static uint64_t rh_rxcount = 0;
+static uint64_t rh_txcount = 0;
+static uint64_t rh_overflow = 0;
+
+/* line pacing: one byte per rh_byte_us on the libtime clock, 0 = off */
+static uint32_t rh_byte_us = 0;
+static uint32_t rh_rx_line = 0;     /* tm_micros() the Rx line frees up */
+static uint32_t rh_tx_line = 0;
+static double   rh_t0 = 0.0;
+static uint64_t rh_emu0 = 0;
+static char     rh_led[EMU_7218_DIGITS+1] = "";
+#ifdef TRACE_ENABLE
+static FILE *   rh_trace = NULL;    /* RCU85_TRACE */
+#endif
+
+static double s_wall(void) {
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return (double)ts.tv_sec + (double)ts.tv_nsec / 1e9;
+}
+
+static void s_signal(int sig) {
+    (void)sig;
+    rh_stop = 1;
+}
+
+static void s_signal_report(int sig) {
+    (void)sig;
+    rh_report = 1;
+}
+
+static void s_stats(void) {
+    fprintf(stderr, "STATS rx=%llu tx=%llu overflow=%llu rd=%lu wr=%lu host_s=%.3f target_s=%.3f\n",
+        (unsigned long long)rh_rxcount, (unsigned long long)rh_txcount,
+        (unsigned long long)rh_overflow,
+        (unsigned long)rh_bus.rd_cycles, (unsigned long)rh_bus.wr_cycles,
+        s_wall() - rh_t0, (double)(tm_emu_ns() - rh_emu0) / 1e9);
+    fflush(stderr);
+}
+
+static void s_atexit(void) {
+    rcu85host_exit();
+}
+
+/* bytes the line can carry now, at most 'max'. 'line' is the time the
+ * last byte started, the caller restarts it when the line runs dry so
+ * that an idle line does not bank time. */
+static int s_line_budget(uint32_t * line, int max) {
+    int n = 0;
+    uint32_t now = tm_micros();
+    while (n < max && (int32_t)(now - *line) >= (int32_t)rh_byte_us) {
+        *line += rh_byte_us;
+        n++;
+    }
+    return n;
+}
+
+#ifdef TRACE_ENABLE
+/* event trace ring --> RCU85_TRACE file, binary records */
+static void s_trace_drain(void) {
+    trace_evt_t evt;
+    uint8_t rec[TRACE_REC_LEN];
+    while (trace_get(&evt)) {
+        trace_encode(&evt, rec);
+        fwrite(rec, 1, TRACE_REC_LEN, rh_trace);
+    }
+}
+#endif
+
+/* Emulated UART ISR - pty <--> minor-1 Rx/Tx buffers.
+ * Unpaced, the pty takes the place of the line: the monitor is throttled
+ * by the client and there is no Rx overflow. Paced (RCU85_BAUD), bytes
+ * move at the line rate and Rx bytes the buffer cannot take are lost,
+ * as they would be on the board.
+ */
+static void s_uart_isr(void) {
+    char txt[EMU_7218_DIGITS+1];
+    int n, max;
+    if (rh_stop) {
+        exit(0);
+    }
+    if (rh_report) {
+        rh_report = 0;
+        s_stats();
+    }
+    /* Rx: pty --> Rx buffer */
+    if (rh_rxlen == 0) {
+        n = (int)read(rh_master, rh_rxbuf, sizeof(rh_rxbuf));
+        if (n > 0) {
+            rh_rxlen = n;
+            rh_rxcount += n;
+        } else {
+            rh_rx_line = tm_micros() - rh_byte_us;  /* idle */
+        }
+    }
+    if (rh_rxlen > 0 && rh_byte_us) {
+        max = s_line_budget(&rh_rx_line, rh_rxlen);
+        if (max > 0) {
+            n = uart_emu1_put_rx(rh_rxbuf, max);
+            if (n < max) {
+                rh_overflow += max - (n > 0 ? n : 0);
+                TRACE(TRACE_UART_OVF, 1);
+            }
+            rh_rxlen -= max;
+            memmove(rh_rxbuf, rh_rxbuf + max, rh_rxlen);
+        }
+    } else if (rh_rxlen > 0) {
+        n = uart_emu1_put_rx(rh_rxbuf, rh_rxlen);
+        if (n > 0) {
+            rh_rxlen -= n;
+            memmove(rh_rxbuf, rh_rxbuf + n, rh_rxlen);
+        }
+    }
+    /* Tx: Tx buffer --> pty */
+    max = (int)sizeof(rh_txbuf) - rh_txlen;
+    if (rh_byte_us) {
+        max = s_line_budget(&rh_tx_line, max);
+    }
+    n = uart_emu1_get_tx(rh_txbuf + rh_txlen, max);
+    if (n > 0) {
+        rh_txlen += n;
+    }
+    if (rh_byte_us && n < max) {
+        rh_tx_line = tm_micros() - rh_byte_us;      /* ran dry, idle */
+    }
+    if (rh_txlen > 0) {
+        n = (int)write(rh_master, rh_txbuf, rh_txlen);
+        if (n > 0) {
+            rh_txcount += n;
+            rh_txlen -= n;
+            memmove(rh_txbuf, rh_txbuf + n, rh_txlen);
+        }
+    }
+#ifdef TRACE_ENABLE
+    if (rh_trace) {
+        s_trace_drain();
+    }
+#endif
+    /* show the LED display on the console when it changes */
+    if (rh_disp.updates && strcmp(emu_icm7218_text(&rh_disp, txt), rh_led) != 0) {
+        strcpy(rh_led, txt);
+        printf("LED [%s]\n", rh_led);
+        fflush(stdout);
+    }
+}
+
+static int s_pty_open(void) {
+    int rc = RH_ERROR;
+    struct termios tio;
+    const char * name;
+    rh_master = posix_openpt(O_RDWR | O_NOCTTY);
+    if (rh_master < 0) {
+        return rc;
+    }
+    if (grantpt(rh_master) == 0 && unlockpt(rh_master) == 0 && (name = ptsname(rh_master)) != NULL) {
+        /* hold the slave open: the master then never reads EIO while
+         * no client is connected */
+        rh_slave = open(name, O_RDWR | O_NOCTTY);
+        if (rh_slave >= 0 && tcgetattr(rh_slave, &tio) == 0) {
+            cfmakeraw(&tio);
+            cfsetspeed(&tio, B19200);
+            tcsetattr(rh_slave, TCSANOW, &tio);
+            fcntl(rh_master, F_SETFL, fcntl(rh_master, F_GETFL) | O_NONBLOCK);
+            printf("rcu85mon: serial port on %s\n", name);
+            rh_link = getenv("RCU85_PTY_LINK");
+            if (rh_link) {
+                unlink(rh_link);
+                if (symlink(name, rh_link) != 0) {
+                    printf("rcu85mon: cannot link %s (%s)\n", rh_link, strerror(errno));
+                    rh_link = NULL;
+                }
+            }
+            fflush(stdout);
+            rc = RH_SUCCESS;
+        }
+    }
+    if (rc != RH_SUCCESS) {
+        if (rh_slave >= 0) {
+            close(rh_slave);
+            rh_slave = -1;
+        }
+        close(rh_master);
+        rh_master = -1;
+    }
+    return rc;
+}
+
+int rcu85host_init(void) {
+    int rc = RH_ERROR;
+    const char * image;
+    const char * baud;
+#ifdef TRACE_ENABLE
+    const char * trace;
+#endif
+    if (rh_running) {
+        return rc;
+    }
+    if ( !pm_isInitialized() )
+        pm_init();
+    image = getenv("RCU85_IMAGE");
+    if (!image) {
+        image = RH_IMAGE_DEFAULT;
+    }
+    /* /WRITE and /LOAD idle high before the MCU drives them */
+    emu_pin_drive(PM_PORT_K, 0x11, 0x11);
+    if (emu_bus8085_attach(&rh_bus, image) != PM_SUCCESS) {
+        printf("rcu85mon: cannot attach image %s\n", image);
+        return rc;
+    }
+    if (emu_74165_attach(&rh_kbd) != PM_SUCCESS || emu_icm7218_attach(&rh_disp) != PM_SUCCESS) {
+        emu_bus8085_detach(&rh_bus);
+        return rc;
+    }
+    if (s_pty_open() != RH_SUCCESS) {
+        emu_icm7218_detach(&rh_disp);
+        emu_74165_detach(&rh_kbd);
+        emu_bus8085_detach(&rh_bus);
+        return rc;
+    }
+    /* 10 bit times per byte (8N1) */
+    baud = getenv("RCU85_BAUD");
+    if (baud && atol(baud) > 0) {
+        rh_byte_us = (uint32_t)(10000000L / atol(baud));
+        rh_rx_line = rh_tx_line = tm_micros();
+        printf("rcu85mon: line paced at %ld baud\n", atol(baud));
+    }
+#ifdef TRACE_ENABLE
+    trace = getenv("RCU85_TRACE");
+    if (trace) {
+        rh_trace = fopen(trace, "wb");
+        if (!rh_trace) {
+            printf("rcu85mon: cannot open trace file %s\n", trace);
+        }
+    }
+#endif
+    rh_running = 1;
+    rh_t0 = s_wall();
+    rh_emu0 = tm_emu_ns();
+    uart_emu1_set_isr(s_uart_isr);
+    signal(SIGINT, s_signal);
+    signal(SIGTERM, s_signal);
+    signal(SIGUSR1, s_signal_report);
+    atexit(s_atexit);
+    rc = RH_SUCCESS;
+    return rc;
+}
+
+void rcu85host_exit(void) {
+    if (!rh_running) {
+        return;
+    }
+    rh_running = 0;
+    uart_emu1_set_isr(NULL);
+    s_stats();
+    emu_icm7218_detach(&rh_disp);
+    emu_74165_detach(&rh_kbd);
+    emu_bus8085_detach(&rh_bus);
+#ifdef TRACE_ENABLE
+    if (rh_trace) {
+        s_trace_drain();
+        fclose(rh_trace);
+        rh_trace = NULL;
+    }
+#endif
+    if (rh_link) {
+        unlink(rh_link);
+        rh_link = NULL;
+    }
+    close(rh_slave);
+    close(rh_master);
+    rh_slave = -1;
+    rh_master = -1;
+}
+
+#endif /* EMULATE_LIB */
@@ -0,0 +1,69 @@
+/*********************************************************************
+ * rcu85host.h
+ *
+ * Version 1.0
+ * ---
+ * RCU85 Monitor - Linux host backend (EMULATE_LIB builds only)
+ *
+ * Runs the unmodified monitor firmware as a Linux process:
+ *  - serial port minor-1 (UART_ENABLE_EMU_1) is connected to a pty,
+ *    the slave name is printed at startup. Connect a terminal or a
+ *    test script to it as if it were the board's USB serial port.
+ *  - the RCU85 bus is the 8085 bus model, memory and I/O are backed
+ *    by an image file so they persist between runs.
+ *  - the keyboard and LED display are the 74LS165 and ICM7218A models.
+ *
+ * ENVIRONMENT
+ *
+ *  RCU85_IMAGE     target memory image file, default "rcu85mon.img"
+ *  RCU85_PTY_LINK  if set, a symlink to the pty slave is made here
+ *  RCU85_BAUD      if set, pace the serial line at this baud rate (8N1)
+ *                  on the libtime clock. Rx bytes arriving while the
+ *                  Rx buffer is full are dropped and counted.
+ *  RCU85_TRACE     if set, the event trace (libtrace.h) is streamed to
+ *                  this file as binary records, see ../tools/tracedec.
+ *                  The 'trace' command then finds the ring empty.
+ *
+ * On SIGINT / SIGTERM the image is written back and a statistics line
+ * is printed on stderr:
+ *
+ *  STATS rx=<bytes> tx=<bytes> overflow=<Rx bytes dropped>
+ *        rd=<bus reads> wr=<bus writes>
+ *        host_s=<wall time> target_s=<time spent in tm_delay_*()>
+ *
+ * SIGUSR1 prints the same line and keeps running (../tools/rcu85soak).
+ *
+ * Without RCU85_BAUD the pty takes the place of the serial line with
+ * no pacing, a client that does not read stalls the monitor's output.
+ *
+ **********************************************************************/
+
+#ifndef _RCU85HOST_H_
+#define _RCU85HOST_H_
+
+#include <avrlib/avrlib.h>
+
+#ifdef EMULATE_LIB
+
+#define RH_SUCCESS      0
+#define RH_ERROR        (-1)
+
+/* Start the host backend --------------------------------------------
+ * -
+ * Open the pty, attach the device models and hook the serial driver.
+ * Call before any other initialization in main(). This will initialize
+ * GPIO API, if not already done.
+ * Returns:     RH_ERROR, RH_SUCCESS
+ */
+int rcu85host_init(void);
+
+/* Stop the host backend ---------------------------------------------
+ * -
+ * Print the statistics line, detach the models (writes the image back)
+ * and close the pty. Also called on SIGINT / SIGTERM and at exit.
+ */
+void rcu85host_exit(void);
+
+#endif /* EMULATE_LIB */
+
+#endif /* _RCU85HOST_H_ */
@@ -11,8 +11,79 @@
 
 #include "rcu85mem.h"
 #include <avrlib/gpio_api.h>
+#include <avrlib/busseq.h>
 #include <avrlib/libtime.h>
 
+/* /RD, /WR strobe wait. The 8085A-2 memory cycle allows ~300 ns from
+ * the strobe to valid data (tRD, tDW). The bus cycle is a bus
+ * sequencer program (busseq.h): the strobe is a BS_WAIT() from the
+ * step that asserts it to the step that samples or clears it, and the
+ * dispatch of those steps (bs_measure()) is taken off. At 16 MHz
+ * the steps alone already exceed 500 ns, the wait is the floor the
+ * strobe keeps at any clock and timing slot setting. */
+#ifndef RCM_STROBE_CYCLES
+ #define RCM_STROBE_CYCLES  TM_NS_CYCLES(500)
+#endif
+
+/* XMEM - ATmega2560 external memory interface (RCM_XMEM, target only).
+ * The RCU85 bus is wired to the XMEM pins: AD0..7 PortA, A8..15 PortC,
+ * /WR PG0, /RD PG1, ALE PG2. While the CPU is held, transfers are
+ * plain loads and stores in the AVR data space. Internal SRAM hides
+ * the XMEM space below 0x2200, so A15 (PC7) is released from XMEM
+ * (XMM = 1) and driven as a pin: the target is seen 32K at a time in
+ * the window 0x8000 .. 0xFFFF.
+ * RCM_XMEM_WAIT (0..3) wait states, 3: /RD, /WR are 3 cycles (190 ns at
+ * 16 MHz) and the address is held one cycle more. That is the slowest
+ * XMEM gets, still below the ~300 ns of the 8085A-2 memory cycle: XMEM
+ * stays off until rcmem_xmem(1) ('xmem on'), for a board shown to take
+ * it.
+ * EXTSEL stays asserted for a whole transfer, not toggled per byte. */
+#if defined(RCM_XMEM) && !defined(EMULATE_LIB)
+ #define RCM_USE_XMEM
+ #include <avr/io.h>
+ #include <string.h>
+ #ifndef RCM_XMEM_WAIT
+  #define RCM_XMEM_WAIT     3
+ #endif
+ #define XMEM_WIN           0x8000
+#endif
+
+/* Timing calibration (rcmem_calibrate): a value is the lowest that
+ * passed, plus a quarter (at least RCM_CAL_MARGIN wait loop passes)
+ * where a lower one failed. The pattern test runs RCM_CAL_PASSES times
+ * per trial. The strobe search starts from RCM_CAL_STROBE at least,
+ * well above the sequencer's steps: the default strobe is within them
+ * and has nothing to cut. */
+#ifndef RCM_CAL_STROBE
+ #define RCM_CAL_STROBE     TM_US_CYCLES(4)
+#endif
+#ifndef RCM_CAL_MARGIN
+ #define RCM_CAL_MARGIN     1
+#endif
+#ifndef RCM_CAL_PASSES
+ #define RCM_CAL_PASSES     2
+#endif
+
+/* Saved timing: EEPROM on the target. The host build keeps the
+ * 'EEPROM' in RAM, erased (0xff) at start-up. */
+#define RCM_EE_MAGIC    0x85
+typedef struct rcm_ee_type {
+    uint8_t         magic;
+    rcm_timing_t    tim;
+    uint8_t         sum;        /* two's complement of the field bytes */
+} rcm_ee_t;
+#ifdef EMULATE_LIB
+ #include <string.h>
+ static rcm_ee_t ee_timing = { 0xff, { 0xffff, 0xffff, 0xffff }, 0xff };
+ #define EE_WRITE(src)  memcpy(&ee_timing, (src), sizeof(rcm_ee_t))
+ #define EE_READ(dst)   memcpy((dst), &ee_timing, sizeof(rcm_ee_t))
+#else
+ #include <avr/eeprom.h>
+ static rcm_ee_t ee_timing EEMEM;
+ #define EE_WRITE(src)  eeprom_update_block((src), &ee_timing, sizeof(rcm_ee_t))
+ #define EE_READ(dst)   eeprom_read_block((dst), &ee_timing, sizeof(rcm_ee_t))
+#endif
+
 #define ADDRHI_PORT      PM_PORT_C
 #define ADDRHI_MODE_STBY PINMODE_INPUT_TRI   /* resting-state should be tri-state/input */
 #define ADDRHI_MODE_ACT  PINMODE_OUTPUT_LO
@@ -76,9 +147,26 @@ static int hndl_reset = 0;
 
 static uint8_t  isInitializaed = 0;
 static uint8_t  isHeld = 0;
+static uint8_t  txDepth = 0;    /* open rcmem_begin() calls */
+static uint8_t  txHeld = 0;     /* the hold was taken by rcmem_begin() */
+static int      txTimer = 0;    /* idle release timer, 0 = not running */
+static uint8_t  useXmem = 0;    /* rcmem_xmem(), built with RCM_XMEM */
 
 /* --- Internal Operations -------------------------------------------*/
 
+#ifdef RCM_USE_XMEM
+/* the XMEM pins must be set up as in the hold state (PORTA = 0, no
+ * pullups on AD0..7), XMEM takes them over */
+static void xmem_enable(uint8_t on) {
+    if (on) {
+        XMCRB = (1<<XMM0);                          /* PC7 (A15) stays a pin  */
+        XMCRA = (1<<SRE) | ((RCM_XMEM_WAIT & 3) << SRW10) | ((RCM_XMEM_WAIT & 3) << SRW00);
+    } else {
+        XMCRA = 0;
+        XMCRB = 0;
+    }
+}
+#endif
 
 
 /* --- API -----------------------------------------------------------*/
@@ -102,8 +190,17 @@ int rcmem_init(void) {
         if ((hndl_addrhi > 0) && (hndl_addrdata > 0) && (hndl_extsel > 0) &&
           (hndl_wr > 0) && (hndl_rd > 0) && (hndl_ale > 0) && (hndl_iom > 0) &&
           (hndl_hold > 0) && (hndl_hold_ack > 0) && (hndl_reset > 0)) {
+            /* driven with pm_s_*() in bus_action() */
+            pm_static(hndl_addrhi);
+            pm_static(hndl_addrdata);
+            pm_static(hndl_extsel);
+            pm_static(hndl_wr);
+            pm_static(hndl_rd);
+            pm_static(hndl_ale);
+            pm_static(hndl_iom);
             isInitializaed = 1;
             isHeld = 0;
+            rcmem_timing_load();    /* calibrated timing, if saved */
             rc = RCM_SUCCESS;
         }
     }
@@ -114,9 +211,31 @@ uint8_t rcmem_isHeld(void) {
     return isHeld;
 }
 
+/* stop the idle release timer, if it runs */
+static void tx_idle_stop(void) {
+    if (txTimer > 0) {
+        tm_timer_stop(txTimer);
+    }
+    txTimer = 0;
+}
+
+/* no transaction for RCM_IDLE_MS: give the bus back */
+static void tx_idle(void * ctx) {
+    (void)ctx;
+    txTimer = 0;
+    if (txHeld && txDepth == 0) {
+        rcmem_release(NO_CPU_RESET);
+    }
+}
+
 int rcmem_hold(void) {
     int rc = RCM_ERROR;
-    if (!rcmem_isHeld()) {
+    if (txHeld) {
+        /* held for transactions, it stays held from now on */
+        tx_idle_stop();
+        txHeld = 0;
+        rc = RCM_SUCCESS;
+    } else if (!rcmem_isHeld()) {
         int grc;
         int t_max = 100;
         pm_out(hndl_hold, HOLD_REQ);
@@ -135,16 +254,20 @@ int rcmem_hold(void) {
             pm_chg_dir(hndl_iom, IOM_MODE_ACT);             /* low (mem) */
             pm_chg_dir(hndl_addrhi, ADDRHI_MODE_ACT);       /* 0x00 */
             pm_chg_dir(hndl_addrdata, ADDRDATA_MODE_ACT);   /* 0x00 */
+#ifdef RCM_USE_XMEM
+            xmem_enable(useXmem);
+#endif
             isHeld = 1;
             rc = RCM_SUCCESS;
         }
     }
+    TRACE(RCM_TRACE_HOLD, rc);
     return rc;
 }
 
 int rcmem_release(uint8_t doReset) {
     int rc = RCM_ERROR;
-    if (rcmem_isHeld()) {
+    if (rcmem_isHeld() && txDepth == 0) {
         int grc;
         int t_max = 100;
         if (doReset) {
@@ -153,6 +276,9 @@ int rcmem_release(uint8_t doReset) {
         }
         /* ensure all data, ctrl lines are input Hi-Z */
         pm_out(hndl_extsel, EXTSEL_INT); /* release the CE controller */
+#ifdef RCM_USE_XMEM
+        xmem_enable(0);
+#endif
         pm_chg_dir(hndl_wr, WR_MODE_STBY);
         pm_chg_dir(hndl_rd, RD_MODE_STBY);
         pm_chg_dir(hndl_ale, ALE_MODE_STBY);
@@ -175,6 +301,43 @@ int rcmem_release(uint8_t doReset) {
             isHeld = 0;
             rc = RCM_SUCCESS;
         }
+        tx_idle_stop();
+        txHeld = 0;
+    }
+    TRACE(RCM_TRACE_RELEASE, rc);
+    return rc;
+}
+
+int rcmem_begin(void) {
+    int rc = RCM_SUCCESS;
+    if (txDepth == 0xff) {
+        return RCM_ERROR;
+    }
+    if (txDepth == 0) {
+        tx_idle_stop();
+        if (!isHeld) {
+            rc = rcmem_hold();
+            txHeld = (rc == RCM_SUCCESS);
+        }
+    }
+    if (rc == RCM_SUCCESS) {
+        txDepth++;
+    }
+    return rc;
+}
+
+int rcmem_commit(void) {
+    int rc = RCM_SUCCESS;
+    if (txDepth == 0) {
+        return RCM_ERROR;
+    }
+    if (--txDepth == 0 && txHeld) {
+        /* the next transaction may come soon, release when idle */
+        if (RCM_IDLE_MS == 0 ||
+          (txTimer = tm_timer_start(RCM_IDLE_MS, TM_ONESHOT, tx_idle, NULL)) <= 0) {
+            txTimer = 0;
+            rc = rcmem_release(NO_CPU_RESET);
+        }
     }
     return rc;
 }
@@ -186,68 +349,364 @@ typedef enum bus_act_type {
     BUS_ACT_COUNT
 } bus_act_t;
 
+/* Bus Cycles --------------------------------------------------------
+ * AD [0..7] carry the address (ALE), then the data. For I/O,
+ * (A7 - A0) =copy=> (A15 - A8). Waits are the timing slots (RCM_T_*),
+ * data is on the bus for 'setup' before /WR, /RD and /WR are 'strobe'
+ * wide, 'hold' follows the strobe.
+ * -------------------------------------------------------------------*/
+#define M_EXTSEL    (1<<EXTSEL_PIN)
+#define M_WR        (1<<WR_PIN)
+#define M_RD        (1<<RD_PIN)
+#define M_ALE       (1<<ALE_PIN)
+
+static uint16_t s_tim[RCM_T_COUNT] = { 0, RCM_STROBE_CYCLES, 0 };
+
+/* Single cycle: one byte per pass, ctx.count passes. EXTSEL per byte. */
+static const bs_step_t bus_prog_wr[] BS_PROGMEM = {
+    BS_ALO(ADDRDATA_PORT),                  /* 0: addr_lo, PORT before DDR      */
+    BS_DIR(ADDRDATA_PORT, 0xff),            /*    AD [0..7] out                 */
+    BS_AHI(ADDRHI_PORT),                    /*    addr_hi                       */
+    BS_CLR(EXTSEL_PORT, M_EXTSEL),          /*    EXTSEL_EXT: CE controller     */
+    BS_PULSE(ALE_PORT, M_ALE, 0),           /*    ALE, address latched          */
+    BS_OUT(ADDRDATA_PORT),                  /*    data on the bus               */
+    BS_WAIT(BS_T(RCM_T_SETUP)),
+    BS_CLR(WR_PORT, M_WR),                  /*    assert /WR                    */
+    BS_WAIT(BS_T(RCM_T_STROBE)),
+    BS_SET(WR_PORT, M_WR),                  /*    clr /WR, data written         */
+    BS_WAIT(BS_T(RCM_T_HOLD)),
+    BS_SET(EXTSEL_PORT, M_EXTSEL),          /*    EXTSEL_INT                    */
+    BS_INC(),
+    BS_LOOP(0),
+    BS_END()
+};
+
+static const bs_step_t bus_prog_rd[] BS_PROGMEM = {
+    BS_ALO(ADDRDATA_PORT),                  /* 0: addr_lo, AD [0..7] out again  */
+    BS_DIR(ADDRDATA_PORT, 0xff),            /*    after the last read           */
+    BS_AHI(ADDRHI_PORT),
+    BS_CLR(EXTSEL_PORT, M_EXTSEL),
+    BS_PULSE(ALE_PORT, M_ALE, 0),
+    BS_DIR(ADDRDATA_PORT, 0x00),            /*    AD tri-state *before* /RD,    */
+    BS_WR(ADDRDATA_PORT, 0x00),             /*    no pullups                    */
+    BS_WAIT(BS_T(RCM_T_SETUP)),
+    BS_CLR(RD_PORT, M_RD),                  /*    assert /RD                    */
+    BS_WAIT(BS_T(RCM_T_STROBE)),
+    BS_IN(ADDRDATA_PORT),                   /*    read data off the bus         */
+    BS_SET(RD_PORT, M_RD),
+    BS_WAIT(BS_T(RCM_T_HOLD)),
+    BS_SET(EXTSEL_PORT, M_EXTSEL),
+    BS_INC(),
+    BS_LOOP(0),
+    BS_END()
+};
+
+/* Burst: the bytes of one 256-byte page, ctx.count passes. EXTSEL is
+ * held by the caller over all pages, A8..15 written once per page. A
+ * write run keeps AD [0..7] driven. A read run turns it around per
+ * byte: the multiplexed bus needs the address out for ALE. */
+static const bs_step_t bus_prog_wr_burst[] BS_PROGMEM = {
+    BS_AHI(ADDRHI_PORT),                    /* 0: addr_hi, once                 */
+    BS_DIR(ADDRDATA_PORT, 0xff),            /*    AD [0..7] out, for the run    */
+    BS_ALO(ADDRDATA_PORT),                  /* 2: addr_lo                       */
+    BS_PULSE(ALE_PORT, M_ALE, 0),
+    BS_OUT(ADDRDATA_PORT),
+    BS_WAIT(BS_T(RCM_T_SETUP)),
+    BS_CLR(WR_PORT, M_WR),
+    BS_WAIT(BS_T(RCM_T_STROBE)),
+    BS_SET(WR_PORT, M_WR),
+    BS_WAIT(BS_T(RCM_T_HOLD)),
+    BS_INC(),
+    BS_LOOP(2),
+    BS_END()
+};
+
+static const bs_step_t bus_prog_rd_burst[] BS_PROGMEM = {
+    BS_AHI(ADDRHI_PORT),                    /* 0: addr_hi, once                 */
+    BS_ALO(ADDRDATA_PORT),                  /* 1: addr_lo                       */
+    BS_DIR(ADDRDATA_PORT, 0xff),
+    BS_PULSE(ALE_PORT, M_ALE, 0),
+    BS_DIR(ADDRDATA_PORT, 0x00),
+    BS_WR(ADDRDATA_PORT, 0x00),
+    BS_WAIT(BS_T(RCM_T_SETUP)),
+    BS_CLR(RD_PORT, M_RD),
+    BS_WAIT(BS_T(RCM_T_STROBE)),
+    BS_IN(ADDRDATA_PORT),
+    BS_SET(RD_PORT, M_RD),
+    BS_WAIT(BS_T(RCM_T_HOLD)),
+    BS_INC(),
+    BS_LOOP(1),
+    BS_END()
+};
+
+/* memory blocks (len > 1) run as bursts, a page at a time. I/O
+ * addresses change A8..15 with every byte: single cycles. */
 static int bus_action(uint16_t addr, uint8_t * data, uint16_t len, uint8_t isIO, bus_act_t act) {
     int rc = RCM_ERROR;
-    uint16_t idx = 0;
+    PROF_BEGIN(RCM_PROF_BUS);
     if (isHeld && data && len) {
-        uint8_t addr_lo = (uint8_t)(addr & 0xff);
-        uint8_t addr_hi = (isIO) ? addr_lo : (uint8_t)(addr >> 8);
-        /* (1) set mem or I/O */
-        pm_out(hndl_iom, (isIO)?IOM_MODE_IO:IOM_MODE_MEM);
-        /* loop for every byte in or out */
-        for ( idx = 0 ; idx < len ; ++idx ) {
-            /* (2) set addr_lo, addr_hi (note: for I/O, (A7 - A0) =copy=> (A15 - A8) */
-            if (pm_dir(hndl_addrdata) == PINDIR_INPUT)
-                pm_chg_dir(hndl_addrdata, ADDRDATA_MODE_ACT);
-            pm_out(hndl_addrdata, addr_lo);
-            pm_out(hndl_addrhi, addr_hi);
-            /* (3) enable CE controller (EXT_SEL) */
-            pm_out(hndl_extsel, EXTSEL_EXT);
-            /* (4) set ALE */
-            pm_out(hndl_ale, ALE_MODE_ADDR);
-            /* (5) clr ALE */
-            pm_out(hndl_ale, ALE_MODE_DATA);
-            /* WRITE / READ */
-            if (act == BUS_ACT_WR) {
-                /* (7) [WR] : assert WR */
-                pm_out(hndl_wr, WR_MODE_ON);
-                /* (8) wait 1 us */
-                tm_delay_us(1);
-                /* set data on bus */
-                pm_out(hndl_addrdata, data[idx]);
-                /* wait 1 us */
-                tm_delay_us(1);
-                /* (9) clr WR */
-                pm_out(hndl_wr, WR_MODE_OFF);
-            } else { /* read */
-                /* change AD [0..7] to be Tri-state *before* asserting RD */
-                if (pm_dir(hndl_addrdata) == PINDIR_OUTPUT)
-                    pm_chg_dir(hndl_addrdata, ADDRDATA_MODE_STBY);
-                /* (7) [RD] : assert [RD] */
-                pm_out(hndl_rd, RD_MODE_ON);
-                /* (8) wait 1 us */
-                tm_delay_us(1);
-                /* read data off bus */
-                data[idx] = pm_in(hndl_addrdata);
-                /* (9) clr RD */
-                pm_out(hndl_rd, RD_MODE_OFF);
+        bs_ctx_t bc;
+        bc.buf = data;
+        bc.count = len;
+        bc.addr = addr;
+        bc.flags = (isIO) ? BS_F_IO : 0;
+        bc.tim = s_tim;
+        /* set mem or I/O */
+        pm_s_out(IOM_PORT, IOM_PIN, (isIO)?IOM_MODE_IO:IOM_MODE_MEM);
+        if (isIO || len == 1) {
+            rc = bs_run((act == BUS_ACT_WR) ? bus_prog_wr : bus_prog_rd, &bc);  // the byte count transacted.
+        } else {
+            const bs_step_t * prog = (act == BUS_ACT_WR) ? bus_prog_wr_burst : bus_prog_rd_burst;
+            uint16_t done = 0;
+            pm_s_out(EXTSEL_PORT, EXTSEL_PIN, EXTSEL_EXT);
+            while (done < len) {
+                uint16_t n = 0x100 - (bc.addr & 0xff);  /* to the end of the page */
+                if (n > len - done)
+                    n = len - done;
+                bc.buf = data + done;
+                bc.count = n;
+                if (bs_run(prog, &bc) != (int)n)
+                    break;
+                done += n;
             }
-            /* release the C controller */
-            pm_out(hndl_extsel, EXTSEL_INT);
-            /* increment and re-calculate addresses */
-            addr ++;
-            addr_lo = (uint8_t)(addr & 0xff);
-            addr_hi = (isIO) ? addr_lo : (uint8_t)(addr >> 8);
-        } // for ()
-        rc = (int)idx; // return the byte count transacted.
+            pm_s_out(EXTSEL_PORT, EXTSEL_PIN, EXTSEL_INT);
+            rc = (done == len) ? (int)done : RCM_ERROR;
+        }
     } // args good
+    PROF_END(RCM_PROF_BUS);
+    return rc;
+}
+
+#ifdef RCM_USE_XMEM
+/* XMEM transfer, memory: one memcpy() per 32K half. I/O: the 8085 puts
+ * the port # on both address bytes, one byte per access. */
+static int xmem_action(uint16_t addr, uint8_t * data, uint16_t len, uint8_t isIO, bus_act_t act) {
+    int rc = RCM_ERROR;
+    PROF_BEGIN(RCM_PROF_BUS);
+    if (isHeld && data && len) {
+        uint16_t done = 0;
+        pm_s_out(IOM_PORT, IOM_PIN, (isIO)?IOM_MODE_IO:IOM_MODE_MEM);
+        pm_s_out(EXTSEL_PORT, EXTSEL_PIN, EXTSEL_EXT);
+        while (done < len) {
+            uint16_t a = addr + done;
+            uint16_t n = 1;
+            uint8_t * win;
+            if (isIO) {
+                a = (uint16_t)(((a & 0xff) << 8) | (a & 0xff));
+            } else {
+                n = 0x8000 - (a & 0x7fff);          /* to the end of the half */
+                if (n > len - done)
+                    n = len - done;
+            }
+            pm_s_out(ADDRHI_PORT, PM_PIN_7, (a & 0x8000) ? 1 : 0);  /* A15 */
+            win = (uint8_t *)(XMEM_WIN | (a & 0x7fff));
+            if (act == BUS_ACT_WR)
+                memcpy(win, data + done, n);
+            else
+                memcpy(data + done, win, n);
+            done += n;
+        }
+        pm_s_out(EXTSEL_PORT, EXTSEL_PIN, EXTSEL_INT);
+        rc = (int)done;
+    }
+    PROF_END(RCM_PROF_BUS);
+    return rc;
+}
+#endif
+
+int rcmem_xmem(uint8_t enable) {
+    int rc = RCM_SUCCESS;
+#ifdef RCM_USE_XMEM
+    useXmem = (enable) ? 1 : 0;
+    if (isHeld) {
+        xmem_enable(useXmem);
+    }
+#else
+    if (enable) {
+        rc = RCM_ERROR;     /* not built in */
+    }
+#endif
     return rc;
 }
 
+uint8_t rcmem_isXmem(void) {
+    return useXmem;
+}
+
+void rcmem_set_timing(const rcm_timing_t * tim) {
+    s_tim[RCM_T_SETUP]  = (tim) ? tim->setup  : 0;
+    s_tim[RCM_T_STROBE] = (tim) ? tim->strobe : RCM_STROBE_CYCLES;
+    s_tim[RCM_T_HOLD]   = (tim) ? tim->hold   : 0;
+}
+
+void rcmem_get_timing(rcm_timing_t * tim) {
+    if (tim) {
+        tim->setup  = s_tim[RCM_T_SETUP];
+        tim->strobe = s_tim[RCM_T_STROBE];
+        tim->hold   = s_tim[RCM_T_HOLD];
+    }
+}
+
+/* Calibration -------------------------------------------------------*/
+
+/* 3 patterns: 0x55/0xaa, 0xaa/0x55, address based. Each byte changes
+ * from one pattern to the next, a lost write shows. */
+static uint8_t cal_pattern(uint8_t pat, uint16_t addr) {
+    if (pat == 2)
+        return (uint8_t)(addr ^ 0xa5);
+    return ((addr ^ pat) & 1) ? 0xaa : 0x55;
+}
+
+/* write, read back 'len' bytes of each pattern */
+static uint8_t cal_test(uint16_t addr, uint8_t * buf, uint16_t len) {
+    uint8_t pat, pass;
+    uint16_t i;
+    for ( pass = 0 ; pass < RCM_CAL_PASSES ; ++pass ) {
+        for ( pat = 0 ; pat < 3 ; ++pat ) {
+            for ( i = 0 ; i < len ; ++i ) {
+                buf[i] = cal_pattern(pat, addr + i);
+            }
+            if (bus_action(addr, buf, len, 0, BUS_ACT_WR) != (int)len)
+                return 0;
+            for ( i = 0 ; i < len ; ++i ) {
+                buf[i] = (uint8_t)~buf[i];
+            }
+            if (bus_action(addr, buf, len, 0, BUS_ACT_RD) != (int)len)
+                return 0;
+            for ( i = 0 ; i < len ; ++i ) {
+                if (buf[i] != cal_pattern(pat, addr + i))
+                    return 0;
+            }
+        }
+    }
+    return 1;
+}
+
+/* the search, held and arguments checked */
+static int cal_run(uint16_t addr, uint16_t len) {
+    /* strobe first, it is the most of a bus cycle */
+    static const uint8_t order[RCM_T_COUNT] = { RCM_T_STROBE, RCM_T_SETUP, RCM_T_HOLD };
+    uint8_t  save[RCM_CAL_LEN];
+    uint8_t  buf[RCM_CAL_LEN];
+    uint16_t start[RCM_T_COUNT];
+    uint16_t from[RCM_T_COUNT];
+    uint16_t fin[RCM_T_COUNT];
+    uint8_t  i, t;
+    int rc = RCM_ERROR;
+    for ( t = 0 ; t < RCM_T_COUNT ; ++t ) {
+        start[t] = s_tim[t];
+        from[t] = s_tim[t];
+    }
+    if (from[RCM_T_STROBE] < RCM_CAL_STROBE) {
+        from[RCM_T_STROBE] = RCM_CAL_STROBE;
+    }
+    /* the memory is put back as it was, read at the timing the search
+     * starts from. If that fails the test, what was read may not be
+     * right either. */
+    for ( t = 0 ; t < RCM_T_COUNT ; ++t ) {
+        s_tim[t] = from[t];
+    }
+    if (bus_action(addr, save, len, 0, BUS_ACT_RD) != (int)len || !cal_test(addr, buf, len)) {
+        for ( t = 0 ; t < RCM_T_COUNT ; ++t ) {
+            s_tim[t] = start[t];
+        }
+        return rc;
+    }
+    for ( i = 0 ; i < RCM_T_COUNT ; ++i ) {
+        uint16_t v, w;
+        t = order[i];
+        /* only the waits the sequencer makes (busseq.h): a loop pass
+         * less each trial, none below the first pass */
+        v = bs_wait_round(from[t]);
+        while (v) {
+            w = (v > bs_wait_round(bs_step_cycles() + 1)) ? v - BS_WAIT_STEP : 0;
+            s_tim[t] = w;
+            if (!cal_test(addr, buf, len))
+                break;
+            v = w;
+        }
+        if (v) {
+            /* v passed, a pass less failed: add the margin */
+            uint16_t m = (uint16_t)((v + 3) / 4);
+            if (m < RCM_CAL_MARGIN * BS_WAIT_STEP)
+                m = RCM_CAL_MARGIN * BS_WAIT_STEP;
+            v = bs_wait_round(v + m);
+            if (v > bs_wait_round(from[t]))
+                v = bs_wait_round(from[t]);
+        }
+        s_tim[t] = v;
+    }
+    if (cal_test(addr, buf, len)) {
+        rc = RCM_SUCCESS;
+    }
+    /* failed: the present timing stays */
+    for ( t = 0 ; t < RCM_T_COUNT ; ++t ) {
+        fin[t] = (rc == RCM_SUCCESS) ? s_tim[t] : start[t];
+        s_tim[t] = from[t];
+    }
+    bus_action(addr, save, len, 0, BUS_ACT_WR);
+    for ( t = 0 ; t < RCM_T_COUNT ; ++t ) {
+        s_tim[t] = fin[t];
+    }
+    return rc;
+}
+
+int rcmem_calibrate(uint16_t addr, uint16_t len, rcm_timing_t * result) {
+    int rc = RCM_ERROR;
+    if (!isHeld || len == 0 || len > RCM_CAL_LEN || (uint16_t)(addr + len - 1) < addr) {
+        return rc;
+    }
+#ifdef RCM_USE_XMEM
+    /* the bit-banged cycle drives the pins XMEM has while held */
+    xmem_enable(0);
+#endif
+    rc = cal_run(addr, len);
+#ifdef RCM_USE_XMEM
+    xmem_enable(useXmem);
+#endif
+    rcmem_get_timing(result);
+    return rc;
+}
+
+static uint8_t ee_sum(const rcm_ee_t * ee) {
+    uint8_t sum = ee->magic;
+    sum += (uint8_t)ee->tim.setup  + (uint8_t)(ee->tim.setup >> 8);
+    sum += (uint8_t)ee->tim.strobe + (uint8_t)(ee->tim.strobe >> 8);
+    sum += (uint8_t)ee->tim.hold   + (uint8_t)(ee->tim.hold >> 8);
+    return (uint8_t)(0 - sum);
+}
+
+int rcmem_timing_save(void) {
+    rcm_ee_t ee;
+    ee.magic = RCM_EE_MAGIC;
+    rcmem_get_timing(&ee.tim);
+    ee.sum = ee_sum(&ee);
+    EE_WRITE(&ee);
+    return RCM_SUCCESS;
+}
+
+int rcmem_timing_load(void) {
+    rcm_ee_t ee;
+    EE_READ(&ee);
+    if (ee.magic != RCM_EE_MAGIC || ee.sum != ee_sum(&ee)) {
+        return RCM_ERROR;
+    }
+    rcmem_set_timing(&ee.tim);
+    return RCM_SUCCESS;
+}
+
 int rcmem_write(uint16_t addr, uint8_t * data, uint16_t len, uint8_t isIO) {
+#ifdef RCM_USE_XMEM
+    if (useXmem)
+        return xmem_action(addr, data, len, isIO, BUS_ACT_WR);
+#endif
     return bus_action(addr, data, len, isIO, BUS_ACT_WR);
 }
 
 int rcmem_read(uint16_t addr, uint8_t * data, uint16_t len, uint8_t isIO) {
+#ifdef RCM_USE_XMEM
+    if (useXmem)
+        return xmem_action(addr, data, len, isIO, BUS_ACT_RD);
+#endif
     return bus_action(addr, data, len, isIO, BUS_ACT_RD);
 }
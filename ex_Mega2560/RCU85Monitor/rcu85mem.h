@@ -13,6 +13,8 @@
 #define _RCU85MEM_H_
 
 #include <avrlib/avrlib.h>
+#include <avrlib/libprof.h>
+#include <avrlib/libtrace.h>
 
 #define RCM_SUCCESS     0
 #define RCM_ERROR       (-1)
@@ -24,6 +26,13 @@
 #define NO_CPU_RESET    0
 #define RESET_CPU       1
 
+/* profiling probe, one bus read or write transfer (libprof.h) */
+#define RCM_PROF_BUS    (PROF_USER+0)
+
+/* trace events, arg = return code (libtrace.h) */
+#define RCM_TRACE_HOLD      (TRACE_USER+0)  /* rcmem_hold() */
+#define RCM_TRACE_RELEASE   (TRACE_USER+1)  /* rcmem_release() */
+
 /* Setup for Memory I/O operations -----------------------------------
  * -
  * Configure GPIO and needed memory. 
@@ -41,7 +50,7 @@ uint8_t rcmem_isHeld(void);
  * -
  * This must be called prior to reading or writing the RCU Memory.
  * Call rcmem_release() to return control to the RCU85 CPU and issue
- * an optional reset.
+ * an optional reset. See also rcmem_begin().
  * Returns:     RCM_ERROR, RCM_SUCCESS
  */
 int rcmem_hold(void);
@@ -56,6 +65,104 @@ int rcmem_hold(void);
  */
 int rcmem_release(uint8_t doReset);
 
+/* Transactions ----------------------------------------------------
+ * -
+ * rcmem_begin() holds the CPU, unless it is held already, and
+ * rcmem_commit() ends the transaction. They nest, the hold is counted.
+ * After the last commit the CPU stays held for RCM_IDLE_MS, so that a
+ * run of commands hands the bus over once. No rcmem_begin() in that
+ * time releases it (software timer, tm_timer_poll()). RCM_IDLE_MS 0
+ * releases at the last commit.
+ * A hold taken with rcmem_hold() is not released by a commit, and
+ * rcmem_hold() while held for transactions keeps it held.
+ * rcmem_release() fails while a transaction is open.
+ * Returns:     RCM_SUCCESS, RCM_ERROR (hold failed; commit without a
+ *              begin), RCM_TIMEOUT
+ */
+#ifndef RCM_IDLE_MS
+ #define RCM_IDLE_MS    250
+#endif
+int rcmem_begin(void);
+int rcmem_commit(void);
+
+/* Bus Transfers Through XMEM ----------------------------------------
+ * -
+ * Built with RCM_XMEM (AVR target), rcmem_read() and rcmem_write() use
+ * the ATmega2560 external memory interface while the CPU is held: a
+ * block is a memcpy(). Wait states: RCM_XMEM_WAIT (0..3, default 3).
+ * Even 3 wait states give ~190 ns strobes at 16 MHz, so XMEM is off at
+ * start-up and the bit-banged bus cycle is used: rcmem_xmem(1) turns
+ * it on for memories fast enough, rcmem_xmem(0) switches back. May be
+ * called while held.
+ * Arguments:
+ *  enable  [bool]          XMEM on, off (default)
+ * Returns:     RCM_SUCCESS, RCM_ERROR (XMEM not built in)
+ */
+int rcmem_xmem(uint8_t enable);
+uint8_t rcmem_isXmem(void);
+
+/* Bus Cycle Timing -------------------------------------------------
+ * -
+ * The bit-banged bus cycle (not XMEM) in CPU cycles: data set up to
+ * the /RD, /WR strobe, strobe width, hold after the strobe. Defaults
+ * (NULL): 0, RCM_STROBE_CYCLES (500 ns), 0. Each is a bus sequencer
+ * wait from step to step (busseq.h): the steps take bs_step_cycles(),
+ * a value up to that adds nothing, above it the wait goes in steps of
+ * BS_WAIT_STEP cycles.
+ * Blocks of memory (len > 1) run as bursts: EXTSEL stays asserted and
+ * A8..15 is written once per 256-byte page. Single bytes and I/O run
+ * one full cycle per byte.
+ */
+#define RCM_T_SETUP     0
+#define RCM_T_STROBE    1
+#define RCM_T_HOLD      2
+#define RCM_T_COUNT     3
+
+typedef struct rcm_timing_type {
+    uint16_t    setup;
+    uint16_t    strobe;
+    uint16_t    hold;
+} rcm_timing_t;
+
+void rcmem_set_timing(const rcm_timing_t * tim);
+void rcmem_get_timing(rcm_timing_t * tim);
+
+/* Calibrate the Bus Timing ------------------------------------------
+ * -
+ * Finds the fastest timing the board's memory takes. Patterns are
+ * written and read back in a scratch area of RAM while strobe, then
+ * setup, then hold are cut one wait loop pass (BS_WAIT_STEP cycles) at
+ * a time from the present timing, the strobe from RCM_CAL_STROBE (4 us)
+ * at least, until the test fails or no wait is left. A bus slower than
+ * the default timing is found as well. A value that failed one pass lower gets a margin of a quarter
+ * (at least RCM_CAL_MARGIN passes). Values are as bs_wait_round()
+ * gives them, the waits the target really makes. The result is
+ * checked once more, then set for later rcmem_*() calls.
+ * The CPU must be held. XMEM, if in use, is off for the calibration
+ * and back on after it. The scratch area is read first and written
+ * back after, at the timing the search starts from. If that timing
+ * fails the test the contents are lost.
+ * Arguments:
+ *  addr    [uint16]        scratch area, memory (RAM)
+ *  len     [uint16]        scratch bytes, 1 .. RCM_CAL_LEN
+ *  result  [rcm_timing_t*] the timing in use on return, may be NULL
+ * Returns:     RCM_SUCCESS, RCM_ERROR (not held, bad arguments, the
+ *              start timing fails: the present one is left as it is)
+ */
+#ifndef RCM_CAL_LEN
+ #define RCM_CAL_LEN    32
+#endif
+int rcmem_calibrate(uint16_t addr, uint16_t len, rcm_timing_t * result);
+
+/* Saved Bus Timing --------------------------------------------------
+ * -
+ * Save the present timing to EEPROM, load it back. rcmem_init() loads
+ * a saved timing, otherwise the defaults stay.
+ * Returns:     RCM_SUCCESS, RCM_ERROR (load: nothing saved)
+ */
+int rcmem_timing_save(void);
+int rcmem_timing_load(void);
+
 /* Write a block of data to the RCU85 memory -------------------------
  * -
  * The RCU85 CPU must be in a held state otherwise the call will fail.
@@ -17,6 +17,15 @@
  * P_OK_ON_SUCCESS      (just define it)
  * MAX_GPIO_RSVD        10 (!) ADJUST WHEN RCU85 MEMORY I/F IS ADDED
  * 
+ * Linux host build: see Makefile.host and rcu85host.h
+ * Profiling probes: build with PROF=1, see the 'prof' command
+ * Event trace: build with TRACE=1 (the host build has it unless
+ *  TRACE=0), see the 'trace' command. TRACE_LEN sets its RAM, 8 bytes
+ *  per event. TRACE_UART=n also streams it out of /dev/uart/n
+ *  (TRACE_DEV).
+ * RAM usage: see the 'mem' command, 'make ramuse' for the per module
+ *  .data/.bss footprint.
+ * 
  **********************************************************************/
 
 #include <avrlib/avrlib.h>
@@ -26,13 +35,43 @@
 #include <avrlib/driver.h>
 #include <avrlib/cmdparser.h>
 #include <avrlib/libtime.h>
+#include <avrlib/libtrace.h>
+#include <avrlib/libmem.h>
+#include <avrlib/busseq.h>
+#include <avrlib/chardev.h>
 #include "kybd_led_io.h"
 #include "rcu85cmds.h"
 #include "rcu85mem.h"
+#ifdef EMULATE_LIB
+#include "rcu85host.h"
+#else
+#include <avr/interrupt.h>
+#endif
 
 // (TODO) will need to be externally accessed...
 kybd_t mon_info; // data from the serial monitor
 
+#define PANEL_PERIOD_MS     20  /* keyboard scan + LED display refresh */
+
+#if defined(TRACE_ENABLE) && defined(TRACE_DEV)
+static int trace_fh = 0;    /* spare serial port for the event trace */
+#endif
+
+// Panel timer callback: scan the key switches, refresh the display
+static void panel_update(void * ctx) {
+    kybd_t * kbd_info = (kybd_t *)ctx;
+    if (kybd_scan(kbd_info) != KD_SUCCESS)
+        blink_error(5); /* Keyboard - Scan error */
+
+    if ( rcmd_readMonitorState() == MSTATE_KYBD) {
+        if (disp_update(kbd_info) != KD_SUCCESS)
+            blink_error(7); /* LED Display - update error */
+    } else {
+        if (disp_update(&mon_info) != KD_SUCCESS)
+            blink_error(7); /* LED Display - update error */
+    }
+}
+
 #if 0
 static uint8_t tcount[3] = {0,0,0};
 static void test_display(kybd_t * kbd_info) {
@@ -58,10 +97,35 @@ int main (void) {
 	int  fhnd;
     int rc;
 	
+    // RAM usage, stack high-water mark (see the 'mem' command)
+    mem_init();
+#ifdef EMULATE_LIB
+    // Linux host build: pty serial port, RCU85 bus and panel models
+    if (rcu85host_init() != RH_SUCCESS)
+        blink_error(1);
+#endif
+	// System tick
+	tm_init();
+#ifdef PROF_ENABLE
+	// Profiling probes, see the 'prof' command
+	prof_init();
+	prof_name(PROF_UART_RX, "uart-rx");
+	prof_name(PROF_UART_TX, "uart-tx");
+	prof_name(PROF_PARSER,  "parser");
+	prof_name(RCM_PROF_BUS, "bus");
+	prof_name(KD_PROF_DISP, "disp");
+	prof_name(KD_PROF_KYBD, "kybd");
+#endif
 	// Setup the System drivers and the driver stack
 	System_DriverStartup();
     System_driverInit();
 	blink_init();           /* also initializes gpiolib... */
+#ifndef EMULATE_LIB
+    // Interrupts on: system tick, profiling clock, serial port
+    sei();
+#endif
+    // Bus sequencer step time, taken off the bus and panel waits
+    bs_measure();
 	rc = kybdio_sysinit();       /* setup keyboard & LED display */
     if (rc != KD_SUCCESS) {
         if (rc == KD_ERR_KYBD) {
@@ -89,6 +153,11 @@ int main (void) {
 	if (fhnd != 0)
 		blink_error(2);
 
+#if defined(TRACE_ENABLE) && defined(TRACE_DEV)
+    // Event trace stream, not fatal if the port does not open
+    trace_fh = cd_open(TRACE_DEV, 0);
+#endif
+
 	tm_delay_ms(10);
 
 	/* Monitor Title message --> serial terminal (if attached) */
@@ -101,24 +170,23 @@ int main (void) {
         pSendString("Key switch panel setup - OK\r\n");
 #endif
 
+    /* Keyboard & LED display run from a periodic timer, the serial
+     * monitor is polled on every pass */
+    if (tm_timer_start(PANEL_PERIOD_MS, TM_PERIODIC, panel_update, &kbd_info) < 0)
+        blink_error(8);
+
     /* === MAIN LOOP =================================================*/
 
     while (1) {
-        tm_delay_ms(20);
         if ( pollParser() != 0 ) {
             blink_error(3);
         }
-
-        if ((rc = kybd_scan(&kbd_info)) != KD_SUCCESS)
-            blink_error(5); /* Keyboard - Scan error */
-
-        if ( rcmd_readMonitorState() == MSTATE_KYBD) {
-            if ((rc = disp_update(&kbd_info)) != KD_SUCCESS)
-                blink_error(7); /* LED Display - update error */
-        } else {
-            if ((rc = disp_update(&mon_info)) != KD_SUCCESS)
-                blink_error(7); /* LED Display - update error */
-        }
+        tm_timer_poll();
+#if defined(TRACE_ENABLE) && defined(TRACE_DEV)
+        if (trace_fh > 0)
+            trace_flush(trace_fh);
+#endif
+        tm_idle();
     }
     return(0);
 }
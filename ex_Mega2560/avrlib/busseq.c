@@ -0,0 +1,241 @@
+/**********************************************************************
+ * busseq.c
+ *
+ * BUS SEQUENCER - parallel bus cycles as step programs
+ * See busseq.h
+ *
+ *********************************************************************/
+
+#include "busseq.h"
+#include "libtime.h"
+
+#ifdef EMULATE_LIB
+ #define BS_RD_OP(s)     ((s)->op)
+ #define BS_RD_M(s)      ((s)->m)
+ #define BS_RD_REG(s)    ((s)->reg)
+ #define BS_RD_N(s)      ((s)->n)
+#else
+ #define BS_RD_OP(s)     pgm_read_byte(&((s)->op))
+ #define BS_RD_M(s)      pgm_read_byte(&((s)->m))
+ #define BS_RD_REG(s)    pgm_read_word(&((s)->reg))
+ #define BS_RD_N(s)      pgm_read_word(&((s)->n))
+#endif
+
+/* Wait Loop ---------------------------------------------------------
+ * A pass is sbiw, brne: 4 cycles, 3 for the last one. In a pulse the
+ * second pin write (st, 2 cycles) ends the wait, BS_WAIT_MIN for one
+ * pass. A delay call would not do here: tm_delay_cycles() with a
+ * runtime argument skips waits below its call overhead.
+ * ------------------------------------------------------------------*/
+#define BS_LOOP_MIN     (BS_WAIT_MIN - 2)   /* one pass, no write */
+
+static uint16_t s_step = 0;     /* bs_measure(), cycles per step */
+
+/* wait 'n', cycles: constant or timing slot */
+static uint16_t s_cycles(const bs_ctx_t * ctx, uint16_t n) {
+    if (n & BS_T_SLOT) {
+        return (ctx->tim) ? ctx->tim[n & (uint16_t)~BS_T_SLOT] : 0;
+    }
+    return n;
+}
+
+/* passes for at least 'cyc' cycles, 'min' cycles with one pass */
+static uint16_t s_passes(uint16_t cyc, uint16_t min) {
+    if (cyc <= min) {
+        return 1;
+    }
+    return (uint16_t)(((uint32_t)cyc - min + BS_WAIT_STEP - 1) / BS_WAIT_STEP + 1);
+}
+
+#ifdef EMULATE_LIB
+static void s_loop(uint16_t k) {
+    tm_delay_cycles(BS_LOOP_MIN + (uint32_t)(k - 1) * BS_WAIT_STEP);
+}
+
+static void s_pulse(uint16_t reg, uint8_t m, uint16_t k) {
+    PM_S_WR(reg, m);
+    tm_delay_cycles(BS_WAIT_MIN + (uint32_t)(k - 1) * BS_WAIT_STEP);
+    PM_S_WR(reg, m);
+}
+#else
+/* k > 0 */
+static inline void s_loop(uint16_t k) {
+    __asm__ __volatile__ (
+        "1: sbiw %0, 1"     "\n\t"
+        "brne 1b"
+        : "=w" (k)
+        : "0" (k)
+    );
+}
+
+/* the same loop between the two writes of m to PINx, k > 0 */
+static inline void s_pulse(uint16_t reg, uint8_t m, uint16_t k) {
+    __asm__ __volatile__ (
+        "st Z, %2"          "\n\t"
+        "1: sbiw %0, 1"     "\n\t"
+        "brne 1b"           "\n\t"
+        "st Z, %2"
+        : "=w" (k)
+        : "0" (k), "r" (m), "z" ((volatile uint8_t *)reg)
+        : "memory"
+    );
+}
+#endif
+
+uint16_t bs_wait_round(uint16_t n) {
+    uint32_t r;
+    if (n <= s_step) {
+        return 0;
+    }
+    r = s_step + BS_LOOP_MIN + (uint32_t)(s_passes(n - s_step, BS_LOOP_MIN) - 1) * BS_WAIT_STEP;
+    return (r > 0xffffUL) ? (uint16_t)(r - BS_WAIT_STEP) : (uint16_t)r;
+}
+
+int bs_run(const bs_step_t * prog, bs_ctx_t * ctx) {
+    const bs_step_t * st = prog;
+    uint8_t * buf;
+    uint16_t i = 0;
+    uint16_t cyc;
+    uint16_t c = 0;
+    uint8_t acc = 0;
+
+    if (!prog || !ctx) {
+        return BS_ERROR;
+    }
+    buf = ctx->buf;
+    for (;;) {
+        uint8_t  op  = BS_RD_OP(st);
+        uint16_t reg = BS_RD_REG(st);
+#ifdef EMULATE_LIB
+        tm_delay_cycles(BS_STEP_CYCLES);    /* the dispatch, as on the target */
+#endif
+        switch (op) {
+        case BS_OP_END:
+            return (int)i;
+        case BS_OP_WR:
+            PM_S_WR(reg, BS_RD_M(st));
+            break;
+        case BS_OP_SET:
+            PM_S_WR(reg, PM_S_RD(reg) | BS_RD_M(st));
+            break;
+        case BS_OP_CLR:
+            PM_S_WR(reg, PM_S_RD(reg) & (uint8_t)~BS_RD_M(st));
+            break;
+        case BS_OP_TOG:
+            PM_S_WR(reg, BS_RD_M(st));      /* PINx */
+            break;
+        case BS_OP_PULSE:
+            cyc = s_cycles(ctx, BS_RD_N(st));
+            if (cyc) {
+                s_pulse(reg, BS_RD_M(st), s_passes(cyc, BS_WAIT_MIN));
+            } else {
+                PM_S_WR(reg, BS_RD_M(st));
+                PM_S_WR(reg, BS_RD_M(st));
+            }
+            break;
+        case BS_OP_WAIT:
+            cyc = s_cycles(ctx, BS_RD_N(st));
+            if (cyc > s_step) {
+                s_loop(s_passes(cyc - s_step, BS_LOOP_MIN));
+            }
+            break;
+        case BS_OP_OUT:
+            if (!buf) return BS_ERROR;
+            PM_S_WR(reg, buf[i++]);
+            break;
+        case BS_OP_IN:
+            if (!buf) return BS_ERROR;
+            buf[i++] = PM_S_RD(reg);
+            break;
+        case BS_OP_SHIN:
+            acc = (uint8_t)((acc >> 1) | ((PM_S_RD(reg) & BS_RD_M(st)) ? 0x80 : 0));
+            break;
+        case BS_OP_PUT:
+            if (!buf) return BS_ERROR;
+            buf[i++] = acc;
+            break;
+        case BS_OP_ALO:
+            PM_S_WR(reg, (uint8_t)ctx->addr);
+            break;
+        case BS_OP_AHI:
+            PM_S_WR(reg, (ctx->flags & BS_F_IO) ? (uint8_t)ctx->addr : (uint8_t)(ctx->addr >> 8));
+            break;
+        case BS_OP_INC:
+            ctx->addr++;
+            break;
+        case BS_OP_REP:
+            c = BS_RD_N(st);
+            if (c == 0) {
+                /* zero passes: on after the DJNZ back to the next step */
+                uint16_t body = (uint16_t)(st - prog) + 1;
+                do {
+                    st++;
+                    op = BS_RD_OP(st);
+                    if (op == BS_OP_END) return BS_ERROR;
+                } while (op != BS_OP_DJNZ || BS_RD_N(st) != body);
+            }
+            break;
+        case BS_OP_DJNZ:
+            if (c > 1) {
+                c--;
+                st = prog + BS_RD_N(st);
+                continue;
+            }
+            c = 0;
+            break;
+        case BS_OP_LOOP:
+            if (ctx->count > 1) {
+                ctx->count--;
+                st = prog + BS_RD_N(st);
+                continue;
+            }
+            ctx->count = 0;
+            break;
+        default:
+            return BS_ERROR;
+        }
+        st++;
+    }
+}
+
+/* Step Time ---------------------------------------------------------*/
+
+/* a DJNZ loop, and the same with a wait from a slot, as a strobe */
+static const bs_step_t s_prog_djnz[] BS_PROGMEM = {
+    BS_REP(BS_MEASURE_N),
+    BS_DJNZ(1),
+    BS_END()
+};
+
+static const bs_step_t s_prog_wait[] BS_PROGMEM = {
+    BS_REP(BS_MEASURE_N),
+    BS_WAIT(BS_T(0)),
+    BS_DJNZ(1),
+    BS_END()
+};
+
+#ifdef EMULATE_LIB
+ #define S_NOW_US()     ((uint32_t)(tm_emu_ns() / 1000ULL))
+#else
+ #define S_NOW_US()     tm_micros()
+#endif
+
+uint16_t bs_measure(void) {
+    uint16_t zero = 0;
+    bs_ctx_t bc = { NULL, 1, 0, 0, &zero };
+    uint32_t t0, t1, t2, us;
+
+    s_step = 0;                         /* the WAIT runs no loop */
+    t0 = S_NOW_US();
+    bs_run(s_prog_djnz, &bc);
+    t1 = S_NOW_US();
+    bs_run(s_prog_wait, &bc);
+    t2 = S_NOW_US();
+    us = ((t2 - t1) > (t1 - t0)) ? (t2 - t1) - (t1 - t0) : 0;
+    s_step = (uint16_t)((us * TM_US_CYCLES(1) + BS_MEASURE_N / 2) / BS_MEASURE_N);
+    return s_step;
+}
+
+uint16_t bs_step_cycles(void) {
+    return s_step;
+}
@@ -0,0 +1,201 @@
+/**********************************************************************
+ * busseq.h
+ *
+ * BUS SEQUENCER - parallel bus cycles as step programs
+ * Bit-banged peripherals (a multiplexed address/data bus, a latch with
+ * a /WR strobe, a shift register chain) are a fixed order of port
+ * writes, strobes, waits and samples. Here that order is a table of
+ * steps, run by one loop with direct register access: no handles, no
+ * checks per pin, no call per step.
+ *
+ *  static const bs_step_t prog[] BS_PROGMEM = {
+ *      BS_ALO(PM_PORT_A),                  0: address out
+ *      BS_PULSE(PM_PORT_G, 0x04, 0),       1: ALE
+ *      BS_OUT(PM_PORT_A),                  2: data out, from buf
+ *      BS_PULSE(PM_PORT_G, 0x01, BS_T(0)), 3: /WR, timing slot 0
+ *      BS_INC(),                           4
+ *      BS_LOOP(0),                         5: ctx.count passes
+ *      BS_END()
+ *  };
+ *
+ * Ports are PM_PORT_*, bits are masks (more than one pin may be set).
+ * BS_PULSE(), BS_TOG() invert the pins by a write to PINx, a pulse
+ * goes to the opposite level and back.
+ *
+ * STEPS
+ *  BS_WR(port,v)       PORTx = v
+ *  BS_DIR(port,v)      DDRx = v, '1' = output
+ *  BS_SET(port,m)      PORTx |= m
+ *  BS_CLR(port,m)      PORTx &= ~m
+ *  BS_TOG(port,m)      invert pins m
+ *  BS_PULSE(port,m,n)  invert pins m, wait n, invert again
+ *  BS_WAIT(n)          wait n
+ *  BS_OUT(port)        PORTx = buf[i++]
+ *  BS_IN(port)         buf[i++] = PINx
+ *  BS_SHIN(port,m)     acc = (acc >> 1) | 0x80 if any of PINx & m
+ *  BS_PUT()            buf[i++] = acc
+ *  BS_ALO(port)        PORTx = address, low byte
+ *  BS_AHI(port)        PORTx = address, high byte (BS_F_IO: low byte)
+ *  BS_INC()            address + 1
+ *  BS_REP(n)           c = n, 16 bits. n = 0: zero passes, the steps up
+ *                      to the BS_DJNZ() back to the step after the REP
+ *                      are skipped
+ *  BS_DJNZ(s)          c - 1, go to step s while not 0 (c = 0: on)
+ *  BS_LOOP(s)          go to step s until ctx.count passes are done
+ *  BS_END()            end, bs_run() returns i
+ *
+ * Waits 'n' are CPU cycles (TM_NS_CYCLES(), TM_US_CYCLES()) or a slot
+ * of the context's timing table, BS_T(slot). Timing slots let one
+ * program run with timing measured or set at run time.
+ *
+ * WAITS
+ * A wait is a counted loop inside bs_run(), BS_WAIT_STEP cycles per
+ * pass, rounded up: a wait is never shorter than asked for.
+ *  BS_PULSE(port,m,n)  n > 0: the pins are inverted for BS_WAIT_MIN
+ *                      cycles plus BS_WAIT_STEP per further pass.
+ *                      n = 0: back to back writes.
+ *  BS_WAIT(n)          n is the time from the step before to the step
+ *                      after. The time of a step, as bs_measure() found
+ *                      it, is taken off n: below it a wait adds
+ *                      nothing, eg. a /RD strobe is never shorter than
+ *                      the two steps around it. Not measured, nothing
+ *                      is taken off.
+ *
+ * AVR Target: programs are kept in flash (BS_PROGMEM). SET, CLR on a
+ * runtime address are lds, ori (andi), sts and not atomic: a port a
+ * program writes must not be written by an interrupt routine. TOG,
+ * PULSE are atomic (PINx write).
+ * EMULATE_LIB: registers go through the emulated register file, so
+ * device models (gpio_emu_dev.h) see every step. Each step advances
+ * the emulated time by BS_STEP_CYCLES, waits by the cycles the target's
+ * loop takes.
+ *
+ * The pins must be registered with gpio_api and marked pm_static(),
+ * as for the pm_s_*() macros.
+ *
+ *********************************************************************/
+
+#ifndef _BUSSEQ_H_
+#define _BUSSEQ_H_
+
+#include "avrlib.h"
+#include "gpio_api.h"
+
+#define BS_SUCCESS  0
+#define BS_ERROR    (-1)
+
+#ifdef EMULATE_LIB
+ #define BS_PROGMEM
+#else
+ #include <avr/pgmspace.h>
+ #define BS_PROGMEM PROGMEM
+#endif
+
+/* One Step, 6 bytes -------------------------------------------------*/
+typedef struct bs_step_type {
+    uint8_t     op;
+    uint8_t     m;          /* value or pin mask */
+    uint16_t    reg;        /* register, data-space address */
+    uint16_t    n;          /* wait, count or step # */
+} bs_step_t;
+
+/* Run Context -------------------------------------------------------*/
+typedef struct bs_ctx_type {
+    uint8_t *           buf;    /* BS_OUT source, BS_IN, BS_PUT target */
+    uint16_t            count;  /* BS_LOOP passes, 0 counts as 1 */
+    uint16_t            addr;   /* BS_ALO, BS_AHI, BS_INC */
+    uint8_t             flags;  /* BS_F_* */
+    const uint16_t *    tim;    /* BS_T() timing slots, cycles (RAM) */
+} bs_ctx_t;
+
+#define BS_F_IO     0x01    /* BS_AHI puts out the low byte (8085 I/O cycle) */
+
+/* Wait Loop, cycles -------------------------------------------------*/
+#define BS_WAIT_MIN     5   /* shortest BS_PULSE() wait: one pass, the write */
+#define BS_WAIT_STEP    4   /* per further pass */
+/* Per step, EMULATE_LIB only: the emulated time a step takes. The
+ * target's own is measured, bs_measure(). */
+#ifndef BS_STEP_CYCLES
+ #define BS_STEP_CYCLES 24
+#endif
+
+/* Step Codes, use the macros below ----------------------------------*/
+#define BS_OP_END   0
+#define BS_OP_WR    1
+#define BS_OP_SET   2
+#define BS_OP_CLR   3
+#define BS_OP_TOG   4
+#define BS_OP_PULSE 5
+#define BS_OP_WAIT  6
+#define BS_OP_OUT   7
+#define BS_OP_IN    8
+#define BS_OP_SHIN  9
+#define BS_OP_PUT   10
+#define BS_OP_ALO   11
+#define BS_OP_AHI   12
+#define BS_OP_INC   13
+#define BS_OP_REP   14
+#define BS_OP_DJNZ  15
+#define BS_OP_LOOP  16
+
+#define BS_T_SLOT       0x8000
+#define BS_T(slot)      (BS_T_SLOT | (slot))
+
+#define BS_WR(port,v)       { BS_OP_WR,    (v), PM_S_ADDR_PRT(port), 0 }
+#define BS_DIR(port,v)      { BS_OP_WR,    (v), PM_S_ADDR_DDR(port), 0 }
+#define BS_SET(port,m)      { BS_OP_SET,   (m), PM_S_ADDR_PRT(port), 0 }
+#define BS_CLR(port,m)      { BS_OP_CLR,   (m), PM_S_ADDR_PRT(port), 0 }
+#define BS_TOG(port,m)      { BS_OP_TOG,   (m), PM_S_ADDR_PIN(port), 0 }
+#define BS_PULSE(port,m,n)  { BS_OP_PULSE, (m), PM_S_ADDR_PIN(port), (n) }
+#define BS_WAIT(n)          { BS_OP_WAIT,  0,   0, (n) }
+#define BS_OUT(port)        { BS_OP_OUT,   0,   PM_S_ADDR_PRT(port), 0 }
+#define BS_IN(port)         { BS_OP_IN,    0,   PM_S_ADDR_PIN(port), 0 }
+#define BS_SHIN(port,m)     { BS_OP_SHIN,  (m), PM_S_ADDR_PIN(port), 0 }
+#define BS_PUT()            { BS_OP_PUT,   0,   0, 0 }
+#define BS_ALO(port)        { BS_OP_ALO,   0,   PM_S_ADDR_PRT(port), 0 }
+#define BS_AHI(port)        { BS_OP_AHI,   0,   PM_S_ADDR_PRT(port), 0 }
+#define BS_INC()            { BS_OP_INC,   0,   0, 0 }
+#define BS_REP(n)           { BS_OP_REP,   0,   0, (n) }
+#define BS_DJNZ(s)          { BS_OP_DJNZ,  0,   0, (s) }
+#define BS_LOOP(s)          { BS_OP_LOOP,  0,   0, (s) }
+#define BS_END()            { BS_OP_END,   0,   0, 0 }
+
+/* Run a Program -----------------------------------------------------
+ * -
+ * Steps run in order from step 0 until BS_END(). The context is
+ * updated: 'addr' as moved by BS_INC(), 'count' is used up.
+ * -
+ * Arguments:
+ *  prog        step table (BS_PROGMEM)
+ *  ctx         buffer, count, address, timing
+ * Returns:     bytes moved through ctx->buf, BS_ERROR (bad step, a
+ *              buffer step without a buffer, BS_REP(0) without its
+ *              BS_DJNZ())
+ * ------------------------------------------------------------------*/
+int bs_run(const bs_step_t * prog, bs_ctx_t * ctx);
+
+/* Real Wait of BS_WAIT(n) -------------------------------------------
+ * -
+ * 'n' as the loop makes it: 0 up to bs_step_cycles(), above that
+ * rounded up to whole passes, BS_WAIT_STEP apart. Values that round the same
+ * wait the same, eg. for a timing search.
+ * ------------------------------------------------------------------*/
+uint16_t bs_wait_round(uint16_t n);
+
+/* Measure the Step Time ---------------------------------------------
+ * -
+ * Times BS_MEASURE_N passes of a BS_DJNZ() loop with and without a
+ * BS_WAIT() from a timing slot, the difference is what a BS_WAIT() step
+ * takes (tm_micros(), ~5 ms at 16 MHz; EMULATE_LIB: tm_emu_ns()).
+ * BS_WAIT() takes it off from then on. Call once at start-up, with
+ * the tick running and interrupts on; an interrupt during the run adds
+ * at most a fraction of a cycle.
+ * Returns:     cycles per step
+ * ------------------------------------------------------------------*/
+#ifndef BS_MEASURE_N
+ #define BS_MEASURE_N   1000
+#endif
+uint16_t bs_measure(void);
+uint16_t bs_step_cycles(void);
+
+#endif /* _BUSSEQ_H_ */
@@ -2,7 +2,7 @@
  * cmdparser.c
  * API and hooks for a simple command parser.
  * 
- * Version 1.0
+ * Version 1.1
  *
  ***************************************************************************/
 
@@ -10,6 +10,8 @@
 #include "libtime.h"
 #include "cmdparser.h"
 #include "chardev.h"
+#include "libprof.h"
+#include "libtrace.h"
 #ifdef TDD_PRINTF
  #include <stdio.h>
 #endif
@@ -30,6 +32,10 @@
 #define TEMP_BUF_LEN    64
 #endif
 
+#ifndef P_MAX_CMDSTATS
+#define P_MAX_CMDSTATS  16
+#endif
+
 static const char sInit[] = "AVRLIB Command Parser Version 1.0\r\n";
 static const char sErrVerbCount[] = "Error (invalid arg count)\r\n";
 static const char sErrFail[]      = "Error (command fail)\r\n";
@@ -53,6 +59,23 @@ int    cmdptr = 0;
 int    serdesc = DEV_FAIL;
 char   tempbuf[TEMP_BUF_LEN];
 
+/* Per command statistics, indexed as pCommandList. Times in us. */
+typedef struct cmdstat_type {
+    uint32_t count;
+    uint32_t exec_total;    /* CR --> command function returns */
+    uint32_t exec_max;
+    uint32_t done_total;    /* CR --> last output byte left the Tx buffer */
+    uint32_t done_max;
+    uint32_t bytes;         /* sent by the command, incl. the response */
+} cmdstat_t;
+
+static cmdstat_t cmdstats[P_MAX_CMDSTATS];
+static int       cs_pending = -1;   /* command waiting for the Tx drain */
+static uint32_t  cs_t_cr = 0;       /* tm_micros() of the terminating CR */
+static uint32_t  cs_bytes0 = 0;
+static uint32_t  cs_tx_bytes = 0;   /* bytes queued by pSendChars() */
+static int       cs_tx_room = 0;    /* Tx buffer free space when empty */
+
 // busy loop-spin until all characters pushed into the transmit buffer.
 int pSendChars(const char * text, int len) {
     int rc = CMD_FAIL;
@@ -68,6 +91,7 @@ int pSendChars(const char * text, int len) {
                 sent = cd_write(serdesc, text+sp, remlen);
             }
         }
+        cs_tx_bytes += sp;
         rc = (sent >=0) ? DEV_SUCCESS : DEV_FAIL;
     }
     return rc;
@@ -136,11 +160,10 @@ void pEcho(char * c, int len) {
     }
 }
 
-#define PRIS_TM_INCR  10    /* sleep in 10 ms increments */
 int preadInputStream(char * buf, int len, uint16_t tmout) {
     int rc = CMD_FAIL;
     int rptr = 0;
-    uint16_t loop_time = 0;
+    uint32_t deadline = tm_deadline_ms(tmout);
 #ifdef TDD_PRINTF
     printf("{preadInputStream} maxlen[%d] maxwait[%u]\n", len, tmout);
 #endif    
@@ -149,28 +172,144 @@ int preadInputStream(char * buf, int len, uint16_t tmout) {
             rc = cd_read(serdesc, buf+rptr, len-rptr);
             if (rc > 0) {
                 rptr += rc;
-                loop_time = 0; /* read something, reset timeout timer */
+                deadline = tm_deadline_ms(tmout); /* read something, reset timeout timer */
 #ifdef TDD_PRINTF
                 printf("    read chunk [%d], accumulated[%d], tmr reset\n", rc, rptr);
 #endif    
             } else if (rc == 0) {
-                tm_delay_ms(PRIS_TM_INCR);
-                loop_time += PRIS_TM_INCR;
+                tm_idle(); /* nothing yet, poll again */
             } else {
 #ifdef TDD_PRINTF
                 printf("    read error[%d]\n", rc);
 #endif    
                 break; /* some error */
             }
-        } while ((loop_time < tmout) && (rptr < len));
+        } while (!tm_expired(deadline) && (rptr < len));
         if (rc >= 0)
             rc = rptr; /* if all ok, return the actual read count */
     }
     return rc;
 }
 
+/* Command statistics ----------------------------------------------*/
+
+static uint8_t s_tx_empty(void) {
+    int room = 0;
+    return (cd_ioctl(serdesc, CMD_TX_PEEK, &room) != DEV_SUCCESS || room >= cs_tx_room);
+}
+
+// command function returned
+static void s_cmdstat_exec(int idx, uint32_t now) {
+    cmdstat_t * st = &cmdstats[idx];
+    uint32_t t = now - cs_t_cr;
+    st->count ++;
+    st->exec_total += t;
+    if (t > st->exec_max)
+        st->exec_max = t;
+}
+
+// output of the pending command has left the Tx buffer, or the next
+// command arrived first
+static void s_cmdstat_done(uint32_t now) {
+    cmdstat_t * st = &cmdstats[cs_pending];
+    uint32_t t = now - cs_t_cr;
+    st->done_total += t;
+    if (t > st->done_max)
+        st->done_max = t;
+    st->bytes += cs_tx_bytes - cs_bytes0;
+    cs_pending = -1;
+}
+
+// send 'val' (unsigned) right aligned in a field of 'width' characters,
+// a field too narrow for it (or < 0) gets no padding
+static void s_sendfield(uint32_t val, int width) {
+    int sp = sutil_asciiunsigned(tempbuf, val);
+    tempbuf[sp] = '\0';
+    while (width-- > sp)
+        pSendChars(" ", 1);
+    pSendString(tempbuf);
+}
+
+// [[BUILT-IN]] 'cmdstats' - nargs: 0,1
+static int cmd_cmdstats(int vc, const char * verbs[]) {
+    int rc = CMD_SUCCESS;
+    int i;
+    cmdstat_t * st;
+    if (vc == 1 && sutil_strcmp(verbs[0], "reset") == 0) {
+        for ( i = 0 ; i < P_MAX_CMDSTATS ; ++i ) {
+            st = &cmdstats[i];
+            st->count = st->exec_total = st->exec_max = 0;
+            st->done_total = st->done_max = st->bytes = 0;
+        }
+        cs_pending = -1;
+    } else if (vc) {
+        rc = CMD_ERROR_SYNTAX;
+    } else {
+        pSendString("Command statistics, times in us\r\n");
+        pSendString("command  count  exec avg  exec max  done avg  done max     bytes\r\n");
+        for ( i = 0 ; i < P_MAX_CMDSTATS && pCommandList[i].noun ; ++i ) {
+            st = &cmdstats[i];
+            if (st->count == 0)
+                continue;
+            // at least one space, a long noun pushes the columns right
+            pSendString(pCommandList[i].noun);
+            pSendString(" ");
+            s_sendfield(st->count, 13 - (int)sutil_strlen(pCommandList[i].noun));
+            s_sendfield(st->exec_total / st->count, 10);
+            s_sendfield(st->exec_max, 10);
+            s_sendfield(st->done_total / st->count, 10);
+            s_sendfield(st->done_max, 10);
+            s_sendfield(st->bytes, 10);
+            pSendString("\r\n");
+        }
+    }
+    return rc;
+}
+
+/* Parser's own commands, looked up after pCommandList */
+static cmdobj pBuiltinList[] = {
+    { "cmdstats", NULL, 0, 1, cmd_cmdstats },
+    { NULL, NULL,       0, 0, NULL         }
+};
+
+// check the verb count, call the command and send the response.
+// 'idx' is the pCommandList index, for statistics, or -1.
+// Returns: 1 if the command was called
+static int s_run_command(const cmdobj * cmd, int idx) {
+    int rc;
+    if (verbcount < cmd->verb_min || verbcount > cmd->verb_max ) {
+        // Syntax Error (mis-matching verb count)
+        pSendString(sErrVerbCount);
+        return 0;
+    }
+#ifdef TDD_PRINTF
+    printf("{pollParser} found command, calling...\n");
+#endif    
+    TRACE(TRACE_CMD_BEGIN, idx);
+    rc = cmd->cp(verbcount, (const char **)verbv);
+    TRACE(TRACE_CMD_END, rc);
+    if (idx >= P_MAX_CMDSTATS)
+        idx = -1;
+    if (idx >= 0)
+        s_cmdstat_exec(idx, tm_micros());
+    if (rc < 0) {
+        // invert error and use to lookup error code
+        rc = rc * -1;
+        rc = rc - 1;
+        pSendString(sCmdErrList[rc]);
+    }
+#ifdef P_OK_ON_SUCCESS
+    else {
+        pSendString(sSuccess);
+    }
+#endif
+    cs_pending = idx;
+    return 1;
+}
+
 int pollParser(void) {
     int rc = CMD_FAIL;
+    PROF_BEGIN(PROF_PARSER);
     if (serdesc > 0) {
 #ifdef TDD_PRINTF
         printf("{pollParser}\n");
@@ -179,11 +318,20 @@ int pollParser(void) {
         /* Build the command buffer with incoming data until 
          * crlf received.
          */
+        if (cs_pending >= 0 && s_tx_empty()) {
+            s_cmdstat_done(tm_micros());
+        }
         rc = cd_read(serdesc, cmdbuffer+cmdptr, (P_MAX_CMDLEN-cmdptr));
         if (rc > 0) {
             pEcho(cmdbuffer+cmdptr, rc);
             cmdptr += rc;
             if (cmdptr && (cmdbuffer[cmdptr-1] == '\r' || cmdbuffer[cmdptr-1] == '\n')) {
+                uint32_t now = tm_micros();
+                if (cs_pending >= 0) {
+                    s_cmdstat_done(now);
+                }
+                cs_t_cr = now;
+                cs_bytes0 = cs_tx_bytes;
                 pSendString("\r\n");
                 // pull out the noun, then any following verbs
                 int i;
@@ -214,32 +362,20 @@ int pollParser(void) {
                     if (sutil_strcmp(noun, pCommandList[i].noun) == 0 || 
                         sutil_strcmp(noun, pCommandList[i].nsc) == 0  ) {
                         // -- COMMAND MATCH
-                        if (verbcount < pCommandList[i].verb_min ||
-                            verbcount > pCommandList[i].verb_max ) {
-                            // Syntax Error (mis-matching verb count)
-                            pSendString(sErrVerbCount);
-                            break;
-                        }
-#ifdef TDD_PRINTF
-                        printf("{pollParser} found command, calling...\n");
-#endif    
-                        i = pCommandList[i].cp(verbcount, (const char **)verbv);
-                        if (i < 0) {
-                            // invert error and use to lookup error code
-                            i = i * -1;
-                            i = i - 1;
-                            pSendString(sCmdErrList[i]);
-                        }
-#ifdef P_OK_ON_SUCCESS
-                        else {
-                            pSendString(sSuccess);
-                        }
-#endif
-                        handled = 1;
+                        handled = s_run_command(&pCommandList[i], i);
                         break;
                     }
                     i ++;
                 }
+                if (!pCommandList[i].noun) {
+                    // not an application command, try the built-ins
+                    for ( i = 0 ; pBuiltinList[i].noun ; ++i ) {
+                        if (sutil_strcmp(noun, pBuiltinList[i].noun) == 0) {
+                            handled = s_run_command(&pBuiltinList[i], -1);
+                            break;
+                        }
+                    }
+                }
                 if (!handled) {
                     pSendString(sErrUnknown);
                 }
@@ -247,6 +383,13 @@ int pollParser(void) {
                 // buffer pointers and clean up the buffer.
                 cb = &(cmdbuffer[0]);
                 cmdptr = 0;
+            } else if (cmdptr >= P_MAX_CMDLEN) {
+                // full without a CR: drop the line, nothing more could
+                // be read into the buffer otherwise.
+                pSendString("\r\n");
+                pSendString(sErrCmdSyntax);
+                cb = &(cmdbuffer[0]);
+                cmdptr = 0;
             }
 #ifdef TDD_PRINTF
             printf("{pollParser} Exit\n");
@@ -256,6 +399,7 @@ int pollParser(void) {
             rc = CMD_POLL_FAIL;
         }
     }
+    PROF_END(PROF_PARSER);
     return rc;
 }
 
@@ -265,6 +409,9 @@ int startParser(const char * serialdev, int mode) {
         serdesc = cd_open(serialdev, mode);
         if (serdesc > 0) {
             cmdptr = 0; /* reset back to the cmd buffer start */
+            /* Tx buffer is empty now, see s_tx_empty() */
+            if (cd_ioctl(serdesc, CMD_TX_PEEK, &cs_tx_room) != DEV_SUCCESS)
+                cs_tx_room = 0;
             pSendString(sInit);
             rc = CMD_SUCCESS;
         }
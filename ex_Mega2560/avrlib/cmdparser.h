@@ -2,7 +2,7 @@
  * cmdparser.h
  * API and hooks for a simple command parser.
  * 
- * Version 1.0
+ * Version 1.1
  *
  * ESTABLISHMENT OF COMMAD SYNTAX
  * 
@@ -61,6 +61,19 @@
  *  P_OK_ON_SUCCESS     Parser returns a '\r\nOK\r\n' if function 
  *                      returns CMD_SUCCESS. This define just needs to 
  *                      be set, no value is required (switch)
+ *  P_MAX_CMDSTATS      number of pCommandList entries with statistics,
+ *                      default 16. Later entries are not counted.
+ * 
+ * BUILT-IN COMMANDS
+ * 
+ * Nouns not found in pCommandList are looked up in the parser's own
+ * list, so an application can override them:
+ * 
+ *  cmdstats [reset]    per command statistics: count, mean and max time
+ *                      from the terminating CR to the command function's
+ *                      return (exec) and to its last output byte leaving
+ *                      the Tx buffer (done), and the bytes it sent. Times
+ *                      are in microseconds (libtime tm_micros()).
  * 
  ***************************************************************************/
 
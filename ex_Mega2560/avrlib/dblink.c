@@ -5,7 +5,12 @@
 
 #include <avrlib/gpio_api.h>
 #include <avrlib/libtime.h>
-#include <avr/io.h>
+#ifdef EMULATE_LIB
+ #include <stdio.h>
+ #include <stdlib.h>
+#else
+ #include <avr/io.h>
+#endif
 #include "dblink.h"
 
 #define LED1_PORT   PM_PORT_B
@@ -35,6 +40,11 @@ void blink_once(int count) {
 
 // acts as an error trap
 void blink_error(int count) {
+#ifdef EMULATE_LIB
+    // host build: nobody is watching the LED, stop with the blink count
+    fprintf(stderr, "blink_error(%d) trap\n", count);
+    exit(count);
+#endif
     while (1) {
 		blink_once(count);
         tm_delay_ms(1000);
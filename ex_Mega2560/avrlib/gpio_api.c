@@ -24,74 +24,76 @@
  *                          to be used by the application. Reducing this
  *                          value to the total # of GPIO pins and ports
  *                          to be used by the application will save RAM
- *                          space from being wasted.
+ *                          space from being wasted. Handles given
+ *                          back with pm_release() are reused, size it
+ *                          to the most reservations held at once, see
+ *                          pm_rsvd_peak().
  *
  *********************************************************************/
 
 #include "gpio_api.h"
 
 #ifdef EMULATE_LIB
- #include <stdio.h>
- uint8_t MCUCR = 0;
- #define PUD 4
- uint8_t TEST_REGISTERS[TEST_REGR_COUNT];
- sfr8p_t TR_ADDR_BASE = (sfr8p_t)&(TEST_REGISTERS[0]);
- #define GP_ADDR_OFFSET  TR_ADDR_BASE
- #define PINA /* use for pin testing */
- #define PINB /* use for port testing */
+ #include "gpio_emu.h"
+ #define GP_REG(addr)    EMU_REG(addr)
+ #define GP_RD(r)        emu_reg_read(r)
+ #define GP_WR(r,v)      emu_reg_write((r),(v))
+ #define GP_ATOMIC
 #else
  #include <avr/io.h>
- #define GP_ADDR_OFFSET  0x20
+ #include <util/atomic.h>
+ #define GP_REG(addr)    ((sfr8p_t)(addr))
+ #define GP_RD(r)        (*(r))
+ #define GP_WR(r,v)      (*(r) = (v))
+ #define GP_ATOMIC       ATOMIC_BLOCK(ATOMIC_RESTORESTATE)
 #endif
 
 #ifndef MAX_GPIO_RSVD
 #define MAX_GPIO_RSVD 40
 #endif
+#if (MAX_GPIO_RSVD > 255)
+ #error "MAX_GPIO_RSVD: the handle has 8 bits for the slot"
+#endif
 
-/* GPIO REGISTER ADDRESSES - NOT DEFINED IN AVR HEADERS!!! -----------*/
-#define GP_A_PIN    (GP_ADDR_OFFSET+0x00)
-#define GP_A_DDR    (GP_ADDR_OFFSET+0x01)
-#define GP_A_PRT    (GP_ADDR_OFFSET+0x02)
-/* - */
-#define GP_B_PIN    (GP_ADDR_OFFSET+0x03)
-#define GP_B_DDR    (GP_ADDR_OFFSET+0x04)
-#define GP_B_PRT    (GP_ADDR_OFFSET+0x05)
-/* - */
-#define GP_C_PIN    (GP_ADDR_OFFSET+0x06)
-#define GP_C_DDR    (GP_ADDR_OFFSET+0x07)
-#define GP_C_PRT    (GP_ADDR_OFFSET+0x08)
-/* - */
-#define GP_D_PIN    (GP_ADDR_OFFSET+0x09)
-#define GP_D_DDR    (GP_ADDR_OFFSET+0x0A)
-#define GP_D_PRT    (GP_ADDR_OFFSET+0x0B)
-/* - */
-#define GP_E_PIN    (GP_ADDR_OFFSET+0x0C)
-#define GP_E_DDR    (GP_ADDR_OFFSET+0x0D)
-#define GP_E_PRT    (GP_ADDR_OFFSET+0x0E)
-/* - */
-#define GP_F_PIN    (GP_ADDR_OFFSET+0x0F)
-#define GP_F_DDR    (GP_ADDR_OFFSET+0x10)
-#define GP_F_PRT    (GP_ADDR_OFFSET+0x11)
-/* - */
-#define GP_G_PIN    (GP_ADDR_OFFSET+0x12)
-#define GP_G_DDR    (GP_ADDR_OFFSET+0x13)
-#define GP_G_PRT    (GP_ADDR_OFFSET+0x14)
-/* - */
-#define GP_H_PIN    (0x100)
-#define GP_H_DDR    (0x101)
-#define GP_H_PRT    (0x102)
-/* - */
-#define GP_J_PIN    (0x103)
-#define GP_J_DDR    (0x104)
-#define GP_J_PRT    (0x105)
+/* GPIO REGISTER ADDRESSES - NOT DEFINED IN AVR HEADERS!!! -----------
+ * Data-space address of each port's PINx register. DDRx and PORTx
+ * always follow at +1, +2.
+ * -------------------------------------------------------------------*/
+#define GP_A_PIN    0x20
+#define GP_B_PIN    0x23
+#define GP_C_PIN    0x26
+#define GP_D_PIN    0x29
+#define GP_E_PIN    0x2C
+#define GP_F_PIN    0x2F
+#define GP_G_PIN    0x32
+#define GP_H_PIN    0x100
+#define GP_J_PIN    0x103
+#define GP_K_PIN    0x106
+#define GP_L_PIN    0x109
 /* - */
-#define GP_K_PIN    (0x106)
-#define GP_K_DDR    (0x107)
-#define GP_K_PRT    (0x108)
-/* - */
-#define GP_L_PIN    (0x109)
-#define GP_L_DDR    (0x10A)
-#define GP_L_PRT    (0x10B)
+#define GP_OFS_DDR  1
+#define GP_OFS_PRT  2
+/* -------------------------------------------------------------------*/
+
+/* Port Description Table (ATmega640/1280/2560) ----------------------*/
+typedef struct s_portdesc_type {
+    uint16_t    pin_addr;   /* PINx data-space address  */
+    uint8_t     pin_mask;   /* existing pins ('1')      */
+} s_portdesc;
+
+static const s_portdesc port_desc[PORT_COUNT] = {
+    { GP_A_PIN, 0xff },
+    { GP_B_PIN, 0xff },
+    { GP_C_PIN, 0xff },
+    { GP_D_PIN, 0xff },
+    { GP_E_PIN, 0xff },
+    { GP_F_PIN, 0xff },
+    { GP_G_PIN, 0x3f },     /* 6 pins */
+    { GP_H_PIN, 0xff },
+    { GP_J_PIN, 0xff },
+    { GP_K_PIN, 0xff },
+    { GP_L_PIN, 0xff }
+};
 /* -------------------------------------------------------------------*/
 
 
@@ -107,6 +109,9 @@ typedef struct s_portstatus_type {
     s_pinstatus pin[8];             /* pin/bit 0 .. 7       */
     uint8_t     port_mask;  /* filter write outputs through a ddr mask (all output pins are '1') */
     uint8_t     pup_mask;   /* pullup_mask - all bit inputs w/ pullup on must have a '1' in corresponding bitfield */
+    uint8_t     sh_port;    /* PORTx as last written, the API never reads PORTx back ... */
+    uint8_t     sh_ddr;     /* DDRx, idem */
+    uint8_t     live_mask;  /* ... except for pins written with pm_s_*() (pm_static()), '1' = read back */
     sfr8p_t     rddr;
     sfr8p_t     rpin;
     sfr8p_t     rport;   
@@ -116,14 +121,26 @@ static s_portstatus port_stat[PORT_COUNT] = {0};    /* PORT A..L */
 
 #define PINIDX_PORT 0xff        /* when 'pinidx' is set to this value then the entire port is being used. */
 typedef struct s_handle_type {
-    s_portstatus *  p_port;
+    s_portstatus *  p_port;     /* NULL: slot is free */
     uint8_t         pinidx;
     uint8_t         port_state; /* (for ports only) last r/w port state */
+    uint8_t         gen;        /* bumped on release, stale handles no longer match */
+    uint8_t         next;       /* free list link, slot # + 1, 0: end */
 } s_handle;
 
-/* Internal Registration List ----------------------------------------*/
+/* Internal Registration List -----------------------------------------
+ * A handle is (gen << 8) | (slot + 1), the 1st handle is 1. Released
+ * slots go on a free list and are taken first. Slots at the top of the
+ * table are given back to it (s_used shrinks) so the table only ever
+ * spans the live reservations plus the holes below them.
+ * -------------------------------------------------------------------*/
+#define HNDL_GEN_MASK   0x7f    /* handles stay positive with a 16 bit int */
+#define HNDL_MAKE(idx)  ((int)(((uint16_t)reglist[idx].gen << 8) | ((idx) + 1)))
+
 static s_handle reglist[MAX_GPIO_RSVD] = {0};
-static uint16_t s_nxt_hndl = 1; /* 1st valid handle # is 1. handles are dec-by-1 before referecing the port_stat[] list internally. */
+static uint8_t  s_used = 0;     /* slots 0 .. s_used-1 are live or on the free list */
+static uint8_t  s_free = 0;     /* free list head, slot # + 1, 0: empty */
+static uint8_t  s_peak = 0;     /* most slots held at once */
 /* -------------------------------------------------------------------*/
 
 /* Initialization State ----------------------------------------------*/
@@ -136,219 +153,185 @@ uint8_t pm_isInitialized(void) {
 
 void pm_init(void) {
     // Setup global pin registration tables
-    uint8_t i;
+    uint8_t p, i;
 #ifdef EMULATE_LIB
-    for ( i = 0 ; i < TEST_REGR_COUNT ; ++i ) {
-        TEST_REGISTERS[i] = 0;
-    }
+    emu_reset();
 #endif
-#ifdef PINA
-    port_stat[PM_PORT_A].rpin = (sfr8p_t)GP_A_PIN;
-    port_stat[PM_PORT_A].rddr = (sfr8p_t)GP_A_DDR;
-    port_stat[PM_PORT_A].rport= (sfr8p_t)GP_A_PRT;
-    port_stat[PM_PORT_A].port_mask = 0;
-    port_stat[PM_PORT_A].pup_mask = 0;
-    for ( i = 0 ; i < PM_TOTALPINS ; ++i ) {
-        port_stat[PM_PORT_A].pin[i].bf_exist = 1;
-        port_stat[PM_PORT_A].pin[i].bf_locked = 0;
-    }
-#endif
-#ifdef PINB
-    port_stat[PM_PORT_B].rpin = (sfr8p_t)GP_B_PIN;
-    port_stat[PM_PORT_B].rddr = (sfr8p_t)GP_B_DDR;
-    port_stat[PM_PORT_B].rport= (sfr8p_t)GP_B_PRT;
-    port_stat[PM_PORT_B].port_mask = 0;
-    port_stat[PM_PORT_B].pup_mask = 0;
-    for ( i = 0 ; i < PM_TOTALPINS ; ++i ) {
-        port_stat[PM_PORT_B].pin[i].bf_exist = 1;
-        port_stat[PM_PORT_B].pin[i].bf_locked = 0;
-    }
-#endif
-#ifdef PINC
-    port_stat[PM_PORT_C].rpin = (sfr8p_t)GP_C_PIN;
-    port_stat[PM_PORT_C].rddr = (sfr8p_t)GP_C_DDR;
-    port_stat[PM_PORT_C].rport= (sfr8p_t)GP_C_PRT;
-    port_stat[PM_PORT_C].port_mask = 0;
-    port_stat[PM_PORT_C].pup_mask = 0;
-    for ( i = 0 ; i < PM_TOTALPINS ; ++i ) {
-        port_stat[PM_PORT_C].pin[i].bf_exist = 1;
-        port_stat[PM_PORT_C].pin[i].bf_locked = 0;
-    }
-#endif
-#ifdef PIND
-    port_stat[PM_PORT_D].rpin = (sfr8p_t)GP_D_PIN;
-    port_stat[PM_PORT_D].rddr = (sfr8p_t)GP_D_DDR;
-    port_stat[PM_PORT_D].rport= (sfr8p_t)GP_D_PRT;
-    port_stat[PM_PORT_D].port_mask = 0;
-    port_stat[PM_PORT_D].pup_mask = 0;
-    for ( i = 0 ; i < PM_TOTALPINS ; ++i ) {
-        port_stat[PM_PORT_D].pin[i].bf_exist = 1;
-        port_stat[PM_PORT_D].pin[i].bf_locked = 0;
-    }
-#endif
-#ifdef PINE
-    port_stat[PM_PORT_E].rpin = (sfr8p_t)GP_E_PIN;
-    port_stat[PM_PORT_E].rddr = (sfr8p_t)GP_E_DDR;
-    port_stat[PM_PORT_E].rport= (sfr8p_t)GP_E_PRT;
-    port_stat[PM_PORT_E].port_mask = 0;
-    port_stat[PM_PORT_E].pup_mask = 0;
-    for ( i = 0 ; i < PM_TOTALPINS ; ++i ) {
-        port_stat[PM_PORT_E].pin[i].bf_exist = 1;
-        port_stat[PM_PORT_E].pin[i].bf_locked = 0;
-    }
-#endif
-#ifdef PINF
-    port_stat[PM_PORT_F].rpin = (sfr8p_t)GP_F_PIN;
-    port_stat[PM_PORT_F].rddr = (sfr8p_t)GP_F_DDR;
-    port_stat[PM_PORT_F].rport= (sfr8p_t)GP_F_PRT;
-    port_stat[PM_PORT_F].port_mask = 0;
-    port_stat[PM_PORT_F].pup_mask = 0;
-    for ( i = 0 ; i < PM_TOTALPINS ; ++i ) {
-        port_stat[PM_PORT_F].pin[i].bf_exist = 1;
-        port_stat[PM_PORT_F].pin[i].bf_locked = 0;
-    }
-#endif
-#ifdef PING
-    port_stat[PM_PORT_G].rpin = (sfr8p_t)GP_G_PIN;
-    port_stat[PM_PORT_G].rddr = (sfr8p_t)GP_G_DDR;
-    port_stat[PM_PORT_G].rport= (sfr8p_t)GP_G_PRT;
-    port_stat[PM_PORT_G].port_mask = 0;
-    port_stat[PM_PORT_G].pup_mask = 0;
-    for ( i = 0 ; i < 6 ; ++i ) {
-        port_stat[PM_PORT_G].pin[i].bf_exist = 1;
-        port_stat[PM_PORT_G].pin[i].bf_locked = 0;
-    }
-    for ( i = 6 ; i < PM_TOTALPINS ; ++i ) {
-        port_stat[PM_PORT_G].pin[i].bf_exist = 0;
-        port_stat[PM_PORT_G].pin[i].bf_locked = 0;
-    }
-#endif
-#ifdef PINH
-    port_stat[PM_PORT_H].rpin = (sfr8p_t)GP_H_PIN;
-    port_stat[PM_PORT_H].rddr = (sfr8p_t)GP_H_DDR;
-    port_stat[PM_PORT_H].rport= (sfr8p_t)GP_H_PRT;
-    port_stat[PM_PORT_H].port_mask = 0;
-    port_stat[PM_PORT_H].pup_mask = 0;
-    for ( i = 0 ; i < PM_TOTALPINS ; ++i ) {
-        port_stat[PM_PORT_H].pin[i].bf_exist = 1;
-        port_stat[PM_PORT_H].pin[i].bf_locked = 0;
-    }
-#endif
-#ifdef PINJ
-    port_stat[PM_PORT_J].rpin = (sfr8p_t)GP_J_PIN;
-    port_stat[PM_PORT_J].rddr = (sfr8p_t)GP_J_DDR;
-    port_stat[PM_PORT_J].rport= (sfr8p_t)GP_J_PRT;
-    port_stat[PM_PORT_J].port_mask = 0;
-    port_stat[PM_PORT_J].pup_mask = 0;
-    for ( i = 0 ; i < PM_TOTALPINS ; ++i ) {
-        port_stat[PM_PORT_J].pin[i].bf_exist = 1;
-        port_stat[PM_PORT_J].pin[i].bf_locked = 0;
-    }
-#endif
-#ifdef PINK
-    port_stat[PM_PORT_K].rpin = (sfr8p_t)GP_K_PIN;
-    port_stat[PM_PORT_K].rddr = (sfr8p_t)GP_K_DDR;
-    port_stat[PM_PORT_K].rport= (sfr8p_t)GP_K_PRT;
-    port_stat[PM_PORT_K].port_mask = 0;
-    port_stat[PM_PORT_K].pup_mask = 0;
-    for ( i = 0 ; i < PM_TOTALPINS ; ++i ) {
-        port_stat[PM_PORT_K].pin[i].bf_exist = 1;
-        port_stat[PM_PORT_K].pin[i].bf_locked = 0;
+    for ( p = 0 ; p < PORT_COUNT ; ++p ) {
+        uint16_t addr = port_desc[p].pin_addr;
+        port_stat[p].rpin  = GP_REG(addr);
+        port_stat[p].rddr  = GP_REG(addr + GP_OFS_DDR);
+        port_stat[p].rport = GP_REG(addr + GP_OFS_PRT);
+        port_stat[p].port_mask = 0;
+        port_stat[p].pup_mask = 0;
+        port_stat[p].sh_port = GP_RD(port_stat[p].rport);
+        port_stat[p].sh_ddr = GP_RD(port_stat[p].rddr);
+        port_stat[p].live_mask = 0;
+        for ( i = 0 ; i < PM_TOTALPINS ; ++i ) {
+            port_stat[p].pin[i].bf_exist = (port_desc[p].pin_mask & (1<<i)) ? 1 : 0;
+            port_stat[p].pin[i].bf_locked = 0;
+        }
     }
-#endif
-#ifdef PINL
-    port_stat[PM_PORT_L].rpin = (sfr8p_t)GP_L_PIN;
-    port_stat[PM_PORT_L].rddr = (sfr8p_t)GP_L_DDR;
-    port_stat[PM_PORT_L].rport= (sfr8p_t)GP_L_PRT;
-    port_stat[PM_PORT_L].port_mask = 0;
-    port_stat[PM_PORT_L].pup_mask = 0;
-    for ( i = 0 ; i < PM_TOTALPINS ; ++i ) {
-        port_stat[PM_PORT_L].pin[i].bf_exist = 1;
-        port_stat[PM_PORT_L].pin[i].bf_locked = 0;
+    for ( i = 0 ; i < MAX_GPIO_RSVD ; ++i ) {
+        reglist[i].p_port = NULL;
+        reglist[i].gen = 0;
     }
-#endif
-    s_nxt_hndl = 1;
+    s_used = 0;
+    s_free = 0;
+    s_peak = 0;
     pm_was_initialized = 1;
 }
 
 int pm_glb_pup_control(uint8_t pupctrl) {
-    if (pupctrl)
-        MCUCR = MCUCR | (1<<PUD);
-    else
-        MCUCR = MCUCR & (uint8_t)~(1<<PUD);
+    GP_ATOMIC {
+        if (pupctrl)
+            GP_WR(&MCUCR, MCUCR | (1<<PUD));
+        else
+            GP_WR(&MCUCR, MCUCR & (uint8_t)~(1<<PUD));
+    }
     return PM_SUCCESS;
 }
 
+/* Shadow Registers --------------------------------------------------
+ * PORTx, DDRx are written from the shadows, a write is one store.
+ * Callers hold off interrupts (GP_ATOMIC) from reading the shadow to
+ * writing it back, an ISR using the same port then sees no torn update.
+ * -------------------------------------------------------------------*/
+static uint8_t s_port_cur(const s_portstatus * pp) {
+    uint8_t live = pp->live_mask;
+    return (live) ? (uint8_t)((pp->sh_port & (uint8_t)~live) | (GP_RD(pp->rport) & live)) : pp->sh_port;
+}
+
+static uint8_t s_ddr_cur(const s_portstatus * pp) {
+    uint8_t live = pp->live_mask;
+    return (live) ? (uint8_t)((pp->sh_ddr & (uint8_t)~live) | (GP_RD(pp->rddr) & live)) : pp->sh_ddr;
+}
+
+static void s_port_wr(s_portstatus * pp, uint8_t val) {
+    pp->sh_port = val;
+    GP_WR(pp->rport, val);
+}
+
+static void s_ddr_wr(s_portstatus * pp, uint8_t val) {
+    pp->sh_ddr = val;
+    GP_WR(pp->rddr, val);
+}
+
 static void s_setmode_pin(s_portstatus * pp, uint8_t pin, uint8_t mode) {
-    sfr8p_t rddr = pp->rddr;
-    sfr8p_t rport = pp->rport;
-    switch (mode) {
-    case PINMODE_INPUT_TRI:
-        *rddr = *rddr & (uint8_t)~(1<<pin);     /* set 0:input                  */
-        *rport = *rport & (uint8_t)~(1<<pin);   /* write to port to clr pullup  */
-        pp->port_mask = pp->port_mask & (uint8_t)~(1<<pin);
-        pp->pup_mask = pp->pup_mask & (uint8_t)~(1<<pin);
-        break;
-    case PINMODE_INPUT_PU:
-        *rddr = *rddr & (uint8_t)~(1<<pin);     /* set 0:input                  */
-        *rport = *rport | (1<<pin);             /* write to port to set pullup  */
-        pp->port_mask = pp->port_mask & (uint8_t)~(1<<pin);
-        pp->pup_mask = pp->pup_mask | (1<<pin); /* this mode is the only one where the pullup-mask bit is set */
-        break;
-    case PINMODE_OUTPUT_LO:
-        *rddr = *rddr | (1<<pin);               /* set 1:output                 */
-        *rport = *rport & (uint8_t)~(1<<pin);   /* set pin low                  */
-        pp->port_mask = pp->port_mask | (1<<pin);
-        pp->pup_mask = pp->pup_mask & (uint8_t)~(1<<pin);
-        break;
-    case PINMODE_OUTPUT_HI:
-        *rddr = *rddr | (1<<pin);               /* set 1:output                 */
-        *rport = *rport | (1<<pin);             /* set pin high                 */
-        pp->port_mask = pp->port_mask | (1<<pin);
-        pp->pup_mask = pp->pup_mask & (uint8_t)~(1<<pin);
-        break;
-    default:
-        break;
+    GP_ATOMIC {
+        switch (mode) {
+        case PINMODE_INPUT_TRI:
+            s_ddr_wr(pp, s_ddr_cur(pp) & (uint8_t)~(1<<pin));      /* set 0:input                  */
+            s_port_wr(pp, s_port_cur(pp) & (uint8_t)~(1<<pin));    /* write to port to clr pullup  */
+            pp->port_mask = pp->port_mask & (uint8_t)~(1<<pin);
+            pp->pup_mask = pp->pup_mask & (uint8_t)~(1<<pin);
+            break;
+        case PINMODE_INPUT_PU:
+            s_ddr_wr(pp, s_ddr_cur(pp) & (uint8_t)~(1<<pin));      /* set 0:input                  */
+            s_port_wr(pp, s_port_cur(pp) | (1<<pin));              /* write to port to set pullup  */
+            pp->port_mask = pp->port_mask & (uint8_t)~(1<<pin);
+            pp->pup_mask = pp->pup_mask | (1<<pin); /* this mode is the only one where the pullup-mask bit is set */
+            break;
+        case PINMODE_OUTPUT_LO:
+            /* PORT before DDR, no glitch when coming from an input */
+            s_port_wr(pp, s_port_cur(pp) & (uint8_t)~(1<<pin));    /* set pin low                  */
+            s_ddr_wr(pp, s_ddr_cur(pp) | (1<<pin));                /* set 1:output                 */
+            pp->port_mask = pp->port_mask | (1<<pin);
+            pp->pup_mask = pp->pup_mask & (uint8_t)~(1<<pin);
+            break;
+        case PINMODE_OUTPUT_HI:
+            s_port_wr(pp, s_port_cur(pp) | (1<<pin));              /* set pin high                 */
+            s_ddr_wr(pp, s_ddr_cur(pp) | (1<<pin));                /* set 1:output                 */
+            pp->port_mask = pp->port_mask | (1<<pin);
+            pp->pup_mask = pp->pup_mask & (uint8_t)~(1<<pin);
+            break;
+        default:
+            break;
+        }
     }
 }
 
 static void s_setmode_port(s_portstatus * pp, uint8_t byt, uint8_t mode) {
-    sfr8p_t rddr = pp->rddr;
-    sfr8p_t rport = pp->rport;
-    switch (mode) {
-    case PINMODE_INPUT_TRI:
-        *rddr = 0;                  /* set 0:input                  */
-        *rport = 0;                 /* write to port to clr pullup  */
-        pp->port_mask = 0;
-        pp->pup_mask =0;
-        break;
-    case PINMODE_INPUT_PU:
-        *rddr = 0;                  /* set 0:input                  */
-        *rport = 0xff;              /* set *ALL* pullups            */
-        pp->port_mask = 0;
-        pp->pup_mask = 0xff;
-        break;
-    case PINMODE_OUTPUT_LO:
-    case PINMODE_OUTPUT_HI:
-        *rddr = 0xff;               /* set 1:output                 */
-        *rport = byt;               /* set pins as per 'byt'        */
-        pp->port_mask = 0xff;
-        pp->pup_mask = 0;
-        break;
-    default:
-        break;
+    GP_ATOMIC {
+        switch (mode) {
+        case PINMODE_INPUT_TRI:
+            s_ddr_wr(pp, 0);                                    /* set 0:input                  */
+            s_port_wr(pp, 0);                                   /* write to port to clr pullup  */
+            pp->port_mask = 0;
+            pp->pup_mask =0;
+            break;
+        case PINMODE_INPUT_PU:
+            s_ddr_wr(pp, 0);                                    /* set 0:input                  */
+            s_port_wr(pp, 0xff);                                /* set *ALL* pullups            */
+            pp->port_mask = 0;
+            pp->pup_mask = 0xff;
+            break;
+        case PINMODE_OUTPUT_LO:
+        case PINMODE_OUTPUT_HI:
+            s_port_wr(pp, byt);                                 /* set pins as per 'byt'        */
+            s_ddr_wr(pp, 0xff);                                 /* set 1:output                 */
+            pp->port_mask = 0xff;
+            pp->pup_mask = 0;
+            break;
+        default:
+            break;
+        }
+    }
+}
+
+static uint8_t s_slot_avail(void) {
+    return (s_free || (s_used < MAX_GPIO_RSVD)) ? 1 : 0;
+}
+
+/* take a slot, free list first. Check s_slot_avail() before. */
+static uint8_t s_slot_take(void) {
+    uint8_t idx;
+    if (s_free) {
+        idx = s_free - 1;
+        s_free = reglist[idx].next;
+    } else {
+        idx = s_used++;
+    }
+    reglist[idx].next = 0;
+    if (s_used > s_peak)
+        s_peak = s_used;
+    return idx;
+}
+
+/* unlink a slot from the free list */
+static void s_slot_unlink(uint8_t idx) {
+    uint8_t * link = &s_free;
+    while (*link) {
+        if (*link == idx + 1) {
+            *link = reglist[idx].next;
+            break;
+        }
+        link = &(reglist[*link - 1].next);
+    }
+}
+
+static void s_slot_give(uint8_t idx) {
+    reglist[idx].p_port = NULL;
+    reglist[idx].gen = (reglist[idx].gen + 1) & HNDL_GEN_MASK;
+    if (idx + 1 == s_used) {
+        /* top of the table: shrink, along with free slots now on top */
+        s_used--;
+        while (s_used && (reglist[s_used - 1].p_port == NULL)) {
+            s_slot_unlink(s_used - 1);
+            s_used--;
+        }
+    } else {
+        reglist[idx].next = s_free;
+        s_free = idx + 1;
     }
 }
 
 int pm_register_pin(uint8_t port, uint8_t pin, uint8_t mode) {
     int rc = PM_ERROR;
     //printf("[pm_register_pin] - port[%d] pin[%d] mode[%d]\n", port, pin, mode );
-    if ((port < PORT_COUNT) && (pin < PM_TOTALPINS) && (mode < PINMODE_TOTALMODES) && (s_nxt_hndl <= MAX_GPIO_RSVD)) {
+    if ((port < PORT_COUNT) && (pin < PM_TOTALPINS) && (mode < PINMODE_TOTALMODES) && s_slot_avail()) {
         if (port_stat[port].pin[pin].bf_exist && (port_stat[port].pin[pin].bf_locked == 0)) {
-            //printf("    pin is free... using handle[%d]\n", s_nxt_hndl);
-            rc = s_nxt_hndl;
-            s_nxt_hndl ++;
-            rc --; /* (!!!) correct rc to be an index, adjust it later back to a handle (1+) */
+            rc = s_slot_take(); /* (!!!) rc is an index, turned into a handle below */
             reglist[rc].p_port = &(port_stat[port]);
             reglist[rc].pinidx = pin;
             reglist[rc].port_state = 0; /* not used for pins */
@@ -356,7 +339,7 @@ int pm_register_pin(uint8_t port, uint8_t pin, uint8_t mode) {
             reglist[rc].p_port->pin[pin].bf_locked = 1;
             reglist[rc].p_port->pin[pin].bf_dir = mode;
             s_setmode_pin(reglist[rc].p_port, pin, mode);
-            rc ++; /* return rc back to a handle # */
+            rc = HNDL_MAKE(rc);
         }
     }
     return rc;
@@ -364,7 +347,7 @@ int pm_register_pin(uint8_t port, uint8_t pin, uint8_t mode) {
 
 int pm_register_prt(uint8_t port, uint8_t byt, uint8_t mode) {
     int rc = PM_ERROR;
-    if ((port < PORT_COUNT) && (mode < PINMODE_TOTALMODES) && (s_nxt_hndl <= MAX_GPIO_RSVD)) {
+    if ((port < PORT_COUNT) && (mode < PINMODE_TOTALMODES) && s_slot_avail()) {
         /* check all pins in this port to see if they are all free */
         uint8_t i, locked = 0;
         for ( i = 0 ; i < PM_TOTALPINS ; ++i ) {
@@ -375,9 +358,7 @@ int pm_register_prt(uint8_t port, uint8_t byt, uint8_t mode) {
         }
         if (locked == 0) {
             /* entire port is free */
-            rc = s_nxt_hndl;
-            s_nxt_hndl ++;
-            rc --; /* (!!!) correct rc to be an index, adjust it later back to a handle (1+) */
+            rc = s_slot_take(); /* (!!!) rc is an index, turned into a handle below */
             reglist[rc].p_port = &(port_stat[port]);
             reglist[rc].pinidx = PINIDX_PORT;   /* using the entire port */
             reglist[rc].port_state = 0;
@@ -390,7 +371,7 @@ int pm_register_prt(uint8_t port, uint8_t byt, uint8_t mode) {
             }
             /* setup port */
             s_setmode_port(reglist[rc].p_port, byt, mode);
-            rc ++; /* return rc back to a handle # */
+            rc = HNDL_MAKE(rc);
         }
     }
     return rc;
@@ -398,12 +379,40 @@ int pm_register_prt(uint8_t port, uint8_t byt, uint8_t mode) {
 
 static s_handle * s_findhndl(int hndl) {
     s_handle * shndl = NULL;
-    if ((hndl > 0) && (hndl < s_nxt_hndl)) {
-        shndl = &(reglist[hndl-1]);
+    uint8_t idx = (uint8_t)(hndl & 0xff) - 1;
+    if ((hndl > 0) && ((hndl & 0xff) != 0) && (idx < s_used) && (reglist[idx].p_port != NULL) &&
+        (reglist[idx].gen == (uint8_t)((unsigned)hndl >> 8))) {
+        shndl = &(reglist[idx]);
     }
     return shndl;
 }
 
+int pm_release(int hndl) {
+    int rc = PM_ERROR;
+    s_handle * rlst = s_findhndl(hndl);
+    if (rlst) {
+        s_portstatus * pp = rlst->p_port;
+        uint8_t i;
+        GP_ATOMIC {
+            if (rlst->pinidx == PINIDX_PORT) {
+                for ( i = 0 ; i < PM_TOTALPINS ; ++i )
+                    pp->pin[i].bf_locked = 0;
+                pp->live_mask = 0;
+            } else {
+                pp->pin[rlst->pinidx].bf_locked = 0;
+                pp->live_mask &= (uint8_t)~(1<<rlst->pinidx);
+            }
+            s_slot_give((uint8_t)(rlst - reglist));
+        }
+        rc = PM_SUCCESS;
+    }
+    return rc;
+}
+
+uint8_t pm_rsvd_peak(void) {
+    return s_peak;
+}
+
 int pm_chg_dir(int hndl, uint8_t mode) {
     int rc = PM_ERROR;
     s_handle * rlst = s_findhndl(hndl);
@@ -434,11 +443,22 @@ pm_dir_t pm_dir(int hndl) {
     if (rlst) {
         s_portstatus * port = rlst->p_port;
         uint8_t pinidx = (rlst->pinidx == PINIDX_PORT) ? 0 : rlst->pinidx;
-        dir = (*(port->rddr) & (1<<pinidx)) ? PINDIR_OUTPUT : PINDIR_INPUT;
+        dir = (s_ddr_cur(port) & (1<<pinidx)) ? PINDIR_OUTPUT : PINDIR_INPUT;
     }
     return dir;
 }
 
+int pm_hndl_info(int hndl, uint8_t * port, uint8_t * pin) {
+    int rc = PM_ERROR;
+    s_handle * rlst = s_findhndl(hndl);
+    if (rlst && port && pin) {
+        *port = (uint8_t)(rlst->p_port - port_stat);
+        *pin = (rlst->pinidx == PINIDX_PORT) ? PM_PIN_ALL : rlst->pinidx;
+        rc = PM_SUCCESS;
+    }
+    return rc;
+}
+
 int pm_out(int hndl, uint8_t value) {
     int rc = PM_ERROR;
     s_handle * rlst = s_findhndl(hndl);
@@ -447,7 +467,7 @@ int pm_out(int hndl, uint8_t value) {
         s_portstatus * pp = rlst->p_port;
         uint8_t pidx = rlst->pinidx;
         uint8_t rmask = (pidx == PINIDX_PORT) ? 0 : (uint8_t)~(1<<pidx); /* rmask - if writing entire port then throw everything away that was initially read */
-        uint8_t pval  = *(pp->rport) & rmask & pp->port_mask; /* read port, ignore bit-of-intrest (rmask), retain other outputs */
+        uint8_t pval;
         uint8_t wval = (pidx == PINIDX_PORT) 
             ? value 
             : (value) 
@@ -455,13 +475,16 @@ int pm_out(int hndl, uint8_t value) {
                 : 0; /* value to write is either entire byte or bit-shifted '1' (or '0') */
     
         //printf("    pidx[%02x] rmask[%02x] port_mask[%02x] pullup_mask[%02x] prev. port-value[%02x] write-value[%02x]\n",
-        //    pidx, rmask, pp->port_mask, pp->pup_mask, *(pp->rport), wval);
+        //    pidx, rmask, pp->port_mask, pp->pup_mask, pp->sh_port, wval);
                 
-        pval = pval | wval | pp->pup_mask; /* modified value to write is comprised of adjacent out-bits and any input w/ pullups set */
+        GP_ATOMIC {
+            pval = s_port_cur(pp) & rmask & pp->port_mask; /* shadow, ignore bit-of-intrest (rmask), retain other outputs */
+            pval = pval | wval | pp->pup_mask; /* modified value to write is comprised of adjacent out-bits and any input w/ pullups set */
+            s_port_wr(pp, pval);
+        }
         
         //printf("    mod. port-value[%02x]\n", pval);
         
-        *(pp->rport) = pval;
         rc = PM_SUCCESS;
     }
     return rc;
@@ -475,9 +498,9 @@ int pm_in(int hndl) {
         s_portstatus * pp = rlst->p_port;
         uint8_t pidx = rlst->pinidx;
         if (pidx == PINIDX_PORT) {
-            rc = *(pp->rpin);
+            rc = GP_RD(pp->rpin);
         } else {
-            rc = (*(pp->rpin) & (1<<pidx)) ? 1 : 0;
+            rc = (GP_RD(pp->rpin) & (1<<pidx)) ? 1 : 0;
         }
     }
     return rc;
@@ -492,7 +515,89 @@ int pm_tog(int hndl) {
         uint8_t pidx = rlst->pinidx;
         uint8_t wmask = (pidx == PINIDX_PORT) ? 0xff : (1<<pidx);
         if ((wmask & pp->port_mask) == wmask) {
-            *(pp->rpin) = wmask;
+            GP_ATOMIC {
+                pp->sh_port ^= wmask;
+                GP_WR(pp->rpin, wmask);
+            }
+        }
+        rc = PM_SUCCESS;
+    }
+    return rc;
+}
+
+// Are all pins in 'mask' there and registered?
+static uint8_t s_port_owned(uint8_t port, uint8_t mask) {
+    uint8_t i;
+    if (mask & (uint8_t)~port_desc[port].pin_mask)
+        return 0;
+    for ( i = 0 ; i < PM_TOTALPINS ; ++i ) {
+        if ((mask & (1<<i)) && (port_stat[port].pin[i].bf_locked == 0))
+            return 0;
+    }
+    return 1;
+}
+
+int pm_port_write_masked(uint8_t port, uint8_t mask, uint8_t value) {
+    int rc = PM_ERROR;
+    if ((port < PORT_COUNT) && s_port_owned(port, mask)) {
+        s_portstatus * pp = &(port_stat[port]);
+        if (mask) {
+            GP_ATOMIC {
+                s_port_wr(pp, (s_port_cur(pp) & (uint8_t)~mask) | (value & mask));
+            }
+        }
+        rc = PM_SUCCESS;
+    }
+    return rc;
+}
+
+int pm_out_batch(const pm_batch_t * batch, uint8_t count) {
+    int rc = PM_ERROR;
+    uint8_t bmask[PORT_COUNT] = {0};
+    uint8_t bval[PORT_COUNT] = {0};
+    uint8_t i, p;
+    if (batch) {
+        /* collect the changes per port, check all handles first */
+        for ( i = 0 ; i < count ; ++i ) {
+            s_handle * rlst = s_findhndl(batch[i].hndl);
+            uint8_t m, v;
+            if (!rlst)
+                break;
+            p = (uint8_t)(rlst->p_port - port_stat);
+            if (rlst->pinidx == PINIDX_PORT) {
+                m = port_desc[p].pin_mask;
+                v = batch[i].value;
+            } else {
+                m = (1<<rlst->pinidx);
+                v = (batch[i].value) ? m : 0;
+            }
+            v |= rlst->p_port->pup_mask & m;    /* inputs w/ pullups stay set, as pm_out() */
+            bmask[p] |= m;
+            bval[p] = (bval[p] & (uint8_t)~m) | (v & m);
+        }
+        if (i == count) {
+            GP_ATOMIC {
+                for ( p = 0 ; p < PORT_COUNT ; ++p ) {
+                    if (bmask[p]) {
+                        s_portstatus * pp = &(port_stat[p]);
+                        s_port_wr(pp, (s_port_cur(pp) & (uint8_t)~bmask[p]) | bval[p]);
+                    }
+                }
+            }
+            rc = PM_SUCCESS;
+        }
+    }
+    return rc;
+}
+
+int pm_static(int hndl) {
+    int rc = PM_ERROR;
+    s_handle * rlst = s_findhndl(hndl);
+    if (rlst) {
+        s_portstatus * pp = rlst->p_port;
+        uint8_t pidx = rlst->pinidx;
+        GP_ATOMIC {
+            pp->live_mask |= (pidx == PINIDX_PORT) ? 0xff : (1<<pidx);
         }
         rc = PM_SUCCESS;
     }
@@ -18,13 +18,27 @@
  * order to lock it.
  * (!) Non-GPIO Registration: Use PINMODE_UNCHANGED for the 'mode'.
  *
+ * PORTx and DDRx are written from shadow copies kept by the API, a
+ * pin write is one store and direction queries do not read the port.
+ * All read-modify-write sequences hold off interrupts, the API may be
+ * used from an ISR for pins of a port the main loop uses as well.
+ * Pins written behind the API's back must be declared, see
+ * pm_static(). PINx reads always go to the port.
+ *
  * EXTERNAL DEFINITIONS:
  * 
  * MAX_GPIO_RSVD (40)       Set the maximum number of GPIO reservations
  *                          to be used by the application. Reducing this
  *                          value to the total # of GPIO pins and ports
  *                          to be used by the application will save RAM
- *                          space from being wasted.
+ *                          space from being wasted. Handles given
+ *                          back with pm_release() are reused, size it
+ *                          to the most reservations held at once, see
+ *                          pm_rsvd_peak().
+ *
+ * EMULATE_LIB              Linux host build. All GPIO registers are
+ *                          emulated, gpio_emu.c must be in the compile
+ *                          order. See gpio_emu.h.
  *
  *********************************************************************/
 
@@ -33,14 +47,6 @@
 
 #include "avrlib.h"
 
-#ifdef EMULATE_LIB
- // (!) IMPORTANT (!) DO NOT SET TEST PORT COUNT BEYOND PORT-G
- //     The Addressing for PortH and beyond lies in a separate memory
- //     region and will break the test buffer, causing an overflow.
- #define TEST_PORT_COUNT  2  /* PortA, PortB */
- #define TEST_REGR_COUNT  (TEST_PORT_COUNT*3)
-#endif
-
 /* Generic Standard Return Codes ------------------------------------*/
 #define PM_SUCCESS          0
 #define PM_ERROR            (-1)
@@ -157,6 +163,32 @@ int pm_glb_pup_control(uint8_t pupctrl);
 int pm_register_pin(uint8_t port, uint8_t pin, uint8_t mode);
 int pm_register_prt(uint8_t port, uint8_t byt, uint8_t mode);
 
+/* Release a Registration -------------------------------------------
+ * -
+ * Unlocks the pin, or all pins of a port handle, for the next
+ * pm_register_pin(), pm_register_prt(). The pins are left as they
+ * are (direction, level, pullup), the next registration sets them.
+ * A pm_static() mark is dropped. Release an event on the pin
+ * (pm_release_event()) before the pin.
+ * -
+ * The slot is reused but the handle is not: each handle carries a
+ * generation count, calls with a released handle fail with PM_ERROR
+ * (PINDIR_ERROR) even after the slot went to a new registration.
+ * The count wraps after 128 releases of the same slot.
+ * -
+ * Arguments:
+ *  hndl        registration handle
+ * Returns:     PM_SUCCESS, PM_ERROR
+ * ------------------------------------------------------------------*/
+int pm_release(int hndl);
+
+/* Reservation Table Use --------------------------------------------
+ * -
+ * Most slots of the MAX_GPIO_RSVD table held at once since pm_init(),
+ * for sizing MAX_GPIO_RSVD in a production build.
+ * ------------------------------------------------------------------*/
+uint8_t pm_rsvd_peak(void);
+
 /* Change Pin, Port Direction ---------------------------------------
  * -
  * If a port, then all pins change to the same direction.
@@ -175,6 +207,17 @@ int pm_chg_dir(int hndl, uint8_t mode);
  * ------------------------------------------------------------------*/
 pm_dir_t pm_dir(int hndl);
 
+/* Query the port and pin of a handle -------------------------------
+ * -
+ * Arguments:
+ *  hndl        registration handle
+ *  port        (out) PM_PORT_*
+ *  pin         (out) PM_PIN_*, PM_PIN_ALL for a port handle
+ * Returns:     PM_SUCCESS, PM_ERROR
+ * ------------------------------------------------------------------*/
+#define PM_PIN_ALL          0xff
+int pm_hndl_info(int hndl, uint8_t * port, uint8_t * pin);
+
 /* Change Pin, Port State -------------------------------------------
  * -
  * For pins, a 0 will clear and any non-zero value will set the PIN
@@ -218,4 +261,109 @@ int pm_in(int hndl);
  * ------------------------------------------------------------------*/
 int pm_tog(int hndl);
 
+/* Batch Output - Several Pins, Ports In One Write ------------------
+ * -
+ * Pins that must change together, without the partial states that a
+ * row of pm_out() calls goes through. Interrupts are held off while
+ * the port is read, modified and written back, so an ISR using other
+ * pins of the same port cannot be undone.
+ * -
+ * pm_port_write_masked()
+ *  PORTx = (PORTx & ~mask) | (value & mask), one write. Every pin in
+ *  'mask' must exist and be registered (by anyone, see "Non-GPIO
+ *  Registration"). On input pins the bit sets the pullup, as pm_out().
+ * Arguments:
+ *  port        one of: PM_PORT_*
+ *  mask        pins to change, '1' = change
+ *  value       new levels of those pins
+ * Returns:     PM_SUCCESS, PM_ERROR
+ * -
+ * pm_out_batch()
+ *  pm_out() for 'count' handles, pins and ports, grouped by port: one
+ *  masked write per port involved, ports written in order A .. L. The
+ *  handles are all checked first, on an invalid one nothing is
+ *  written. A later entry for the same pin wins. Inputs with pullups
+ *  in an entry stay pulled up, as pm_out() leaves them.
+ * Arguments:
+ *  batch       { handle, value } list, value as for pm_out()
+ *  count       entries in 'batch'
+ * Returns:     PM_SUCCESS, PM_ERROR
+ * ------------------------------------------------------------------*/
+typedef struct pm_batch_type {
+    int         hndl;
+    uint8_t     value;
+} pm_batch_t;
+
+int pm_port_write_masked(uint8_t port, uint8_t mask, uint8_t value);
+int pm_out_batch(const pm_batch_t * batch, uint8_t count);
+
+/* Static Pins - Port and Pin Known At Compile Time -----------------
+ * -
+ * For hot paths (bus cycles, bit-banged shift registers). 'port' and
+ * 'pin' must be constants (PM_PORT_*, PM_PIN_*), the macros then
+ * resolve to the register at compile time. On the target:
+ *
+ *  pm_s_set(), pm_s_clr(), pm_s_tog()  one sbi or cbi  (ports A..G)
+ *  pm_s_in()                           one sbic/sbis or in + andi
+ *  pm_s_prt_out(), pm_s_prt_in()       one out or in   (ports A..G)
+ *
+ * Ports H..L sit above the sbi/cbi range: pin writes become lds, ori
+ * (andi), sts and are not atomic. Do not share such a port with an
+ * interrupt routine that writes it.
+ * -
+ * No handle and no checks. The pin or port must still be registered
+ * with pm_register_pin(), pm_register_prt() at init, this locks it
+ * and sets its mode. Then call pm_static() on the handle: the API
+ * keeps PORTx, DDRx in shadow registers and does not read them back,
+ * except for pins marked static. Without it, the next API write to
+ * the same port puts back the level the API last wrote.
+ * Static writes do not update the API's state:
+ *  - pm_s_set(), pm_s_clr() on an input switch its pullup
+ *  - pm_s_prt_dir() writes DDRx only, the registered mode is stale
+ *    until the next pm_chg_dir() on the handle.
+ * -
+ *  pm_static(hndl)         mark the pin or port as written by the
+ *                          pm_s_*() macros. Returns PM_SUCCESS, PM_ERROR
+ *  pm_s_out(port,pin,v)    pin low (v == 0) or high
+ *  pm_s_in(port,pin)       pin level, 0 or 1
+ *  pm_s_prt_out(port,v)    PORTx = v
+ *  pm_s_prt_in(port)       PINx
+ *  pm_s_prt_dir(port,v)    DDRx = v, '1' = output
+ * ------------------------------------------------------------------*/
+int pm_static(int hndl);
+
+#define PM_S_ADDR_PIN(port) \
+    (((port) < PM_PORT_H) ? (0x20 + 3 * (port)) : (0x100 + 3 * ((port) - PM_PORT_H)))
+#define PM_S_ADDR_DDR(port) (PM_S_ADDR_PIN(port) + 1)
+#define PM_S_ADDR_PRT(port) (PM_S_ADDR_PIN(port) + 2)
+
+#ifdef EMULATE_LIB
+ #include "gpio_emu.h"
+ /* through the register file, so port hooks (device models) see it */
+ #define PM_S_RD(addr)          emu_reg_read(EMU_REG(addr))
+ #define PM_S_WR(addr,v)        emu_reg_write(EMU_REG(addr), (uint8_t)(v))
+ #define PM_S_BSET(addr,b)      PM_S_WR((addr), PM_S_RD(addr) | (1<<(b)))
+ #define PM_S_BCLR(addr,b)      PM_S_WR((addr), PM_S_RD(addr) & (uint8_t)~(1<<(b)))
+ #define PM_S_BTOG(addr,b)      PM_S_WR((addr), 1<<(b))
+#else
+ #define PM_S_RD(addr)          (*(volatile uint8_t *)(addr))
+ #define PM_S_WR(addr,v)        (*(volatile uint8_t *)(addr) = (uint8_t)(v))
+ #define PM_S_BSET(addr,b)      (*(volatile uint8_t *)(addr) |= (uint8_t)(1<<(b)))
+ #define PM_S_BCLR(addr,b)      (*(volatile uint8_t *)(addr) &= (uint8_t)~(1<<(b)))
+ /* sbi on PINx writes only the one bit, lds/ori/sts would toggle
+  * every pin that reads high */
+ #define PM_S_BTOG(addr,b) \
+    (((addr) < 0x40) ? (void)PM_S_BSET((addr), (b)) : (void)PM_S_WR((addr), 1<<(b)))
+#endif
+
+#define pm_s_set(port,pin)      PM_S_BSET(PM_S_ADDR_PRT(port), (pin))
+#define pm_s_clr(port,pin)      PM_S_BCLR(PM_S_ADDR_PRT(port), (pin))
+#define pm_s_out(port,pin,v) \
+    do { if (v) pm_s_set((port),(pin)); else pm_s_clr((port),(pin)); } while (0)
+#define pm_s_tog(port,pin)      PM_S_BTOG(PM_S_ADDR_PIN(port), (pin))
+#define pm_s_in(port,pin)       ((PM_S_RD(PM_S_ADDR_PIN(port)) & (1<<(pin))) ? 1 : 0)
+#define pm_s_prt_out(port,v)    PM_S_WR(PM_S_ADDR_PRT(port), (v))
+#define pm_s_prt_in(port)       PM_S_RD(PM_S_ADDR_PIN(port))
+#define pm_s_prt_dir(port,v)    PM_S_WR(PM_S_ADDR_DDR(port), (v))
+
 #endif /* _GPIO_API_H_ */
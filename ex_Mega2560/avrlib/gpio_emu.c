@@ -0,0 +1,234 @@
+/**********************************************************************
+ * gpio_emu.c
+ *
+ * GPIO REGISTER FILE EMULATION (Linux host builds only)
+ * See gpio_emu.h for the emulated behaviour.
+ *
+ *********************************************************************/
+
+#ifdef EMULATE_LIB
+
+#include "gpio_api.h"
+#include "gpio_emu.h"
+
+uint8_t MCUCR = 0;
+uint8_t TEST_REGISTERS[TEST_REGR_COUNT];
+sfr8p_t TR_ADDR_BASE = (sfr8p_t)&(TEST_REGISTERS[0]);
+
+/* Port Map (ATmega2560) - data-space address of PINx, pins in use ---*/
+typedef struct s_emuport_type {
+    uint16_t    pin_addr;   /* PINx, DDRx = +1, PORTx = +2 */
+    uint8_t     pin_mask;   /* existing pins */
+} s_emuport;
+
+static const s_emuport emu_ports[TEST_PORT_COUNT] = {
+    { 0x20,  0xff },    /* A */
+    { 0x23,  0xff },    /* B */
+    { 0x26,  0xff },    /* C */
+    { 0x29,  0xff },    /* D */
+    { 0x2C,  0xff },    /* E */
+    { 0x2F,  0xff },    /* F */
+    { 0x32,  0x3f },    /* G - 6 pins */
+    { 0x100, 0xff },    /* H */
+    { 0x103, 0xff },    /* J */
+    { 0x106, 0xff },    /* K */
+    { 0x109, 0xff }     /* L */
+};
+
+/* External world - pins being driven into the MCU */
+static uint8_t ext_mask[TEST_PORT_COUNT];
+static uint8_t ext_val[TEST_PORT_COUNT];
+
+/* Attached hooks */
+typedef struct s_emuhook_type {
+    emu_hook_fn fn;
+    void *      ctx;
+    uint8_t     port;
+    uint8_t     events;
+    uint8_t     busy;       /* callback running */
+} s_emuhook;
+
+static s_emuhook emu_hooks[EMU_MAX_HOOKS];
+
+#define R_PIN(p)    TEST_REGISTERS[emu_ports[p].pin_addr - EMU_IO_BASE + EMU_REG_PIN]
+#define R_DDR(p)    TEST_REGISTERS[emu_ports[p].pin_addr - EMU_IO_BASE + EMU_REG_DDR]
+#define R_PORT(p)   TEST_REGISTERS[emu_ports[p].pin_addr - EMU_IO_BASE + EMU_REG_PORT]
+
+/* Find the port and register type for a register pointer. Returns the
+ * port # or -1 if the register is not a GPIO register.
+ */
+static int s_decode(sfr8p_t reg, uint8_t * kind) {
+    int rc = -1;
+    uintptr_t base = (uintptr_t)TR_ADDR_BASE;
+    uintptr_t addr = (uintptr_t)reg;
+    if (addr >= base && addr < base + TEST_REGR_COUNT) {
+        addr = addr - base + EMU_IO_BASE;
+        if (addr < 0x35) {
+            rc = (int)((addr - 0x20) / 3);              /* A .. G */
+        } else if (addr >= 0x100) {
+            rc = (int)((addr - 0x100) / 3) + PM_PORT_H; /* H .. L */
+        }
+        if (rc >= 0) {
+            *kind = (uint8_t)(addr - emu_ports[rc].pin_addr);
+        }
+    }
+    return rc;
+}
+
+static uint8_t s_level(uint8_t p) {
+    uint8_t ddr = R_DDR(p);
+    uint8_t prt = R_PORT(p);
+    uint8_t pup = (MCUCR & (1<<PUD)) ? 0 : (prt & (uint8_t)~ddr);
+    uint8_t in  = (ext_mask[p] & ext_val[p]) | ((uint8_t)~ext_mask[p] & pup);
+    return ((ddr & prt) | ((uint8_t)~ddr & in)) & emu_ports[p].pin_mask;
+}
+
+/* re-sample the pins into PINx */
+static void s_update(uint8_t p) {
+    R_PIN(p) = s_level(p);
+}
+
+static void s_update_all(void) {
+    uint8_t p;
+    for ( p = 0 ; p < TEST_PORT_COUNT ; ++p ) {
+        s_update(p);
+    }
+}
+
+/* run all hooks on port 'p' that want 'event' */
+static void s_notify(uint8_t p, uint8_t event) {
+    int i;
+    for ( i = 0 ; i < EMU_MAX_HOOKS ; ++i ) {
+        s_emuhook * ph = &emu_hooks[i];
+        if (ph->fn && !ph->busy && ph->port == p && (ph->events & event)) {
+            ph->busy = 1;
+            ph->fn(p, event, ph->ctx);
+            ph->busy = 0;
+        }
+    }
+}
+
+void emu_reset(void) {
+    int i;
+    for ( i = 0 ; i < TEST_REGR_COUNT ; ++i ) {
+        TEST_REGISTERS[i] = 0;
+    }
+    MCUCR = 0;
+    s_update_all();
+}
+
+uint8_t emu_reg_read(sfr8p_t reg) {
+    uint8_t kind;
+    int p = s_decode(reg, &kind);
+    if (p >= 0 && kind == EMU_REG_PIN) {
+        s_notify((uint8_t)p, EMU_EV_PIN_RD);
+        s_update((uint8_t)p);
+    }
+    return *reg;
+}
+
+void emu_reg_write(sfr8p_t reg, uint8_t val) {
+    uint8_t kind;
+    int p = s_decode(reg, &kind);
+    if (p < 0) {
+        *reg = val;
+        if (reg == (sfr8p_t)&MCUCR) {
+            s_update_all(); /* pullups may have changed */
+        }
+    } else {
+        if (kind == EMU_REG_PIN) {
+            /* writing '1' to PINxn toggles PORTxn */
+            R_PORT(p) ^= (val & emu_ports[p].pin_mask);
+        } else {
+            *reg = val & emu_ports[p].pin_mask;
+        }
+        s_update((uint8_t)p);
+        s_notify((uint8_t)p, (kind == EMU_REG_DDR) ? EMU_EV_DDR_WR : EMU_EV_PORT_WR);
+    }
+}
+
+sfr8p_t emu_port_reg(uint8_t port, uint8_t reg) {
+    sfr8p_t rc = NULL;
+    if (port < TEST_PORT_COUNT && reg <= EMU_REG_PORT) {
+        rc = EMU_REG(emu_ports[port].pin_addr + reg);
+    }
+    return rc;
+}
+
+int emu_pin_drive(uint8_t port, uint8_t mask, uint8_t value) {
+    int rc = PM_ERROR;
+    if (port < TEST_PORT_COUNT) {
+        ext_mask[port] |= mask;
+        ext_val[port] = (ext_val[port] & (uint8_t)~mask) | (value & mask);
+        s_update(port);
+        s_notify(port, EMU_EV_EXT);
+        rc = PM_SUCCESS;
+    }
+    return rc;
+}
+
+int emu_pin_release(uint8_t port, uint8_t mask) {
+    int rc = PM_ERROR;
+    if (port < TEST_PORT_COUNT) {
+        ext_mask[port] &= (uint8_t)~mask;
+        s_update(port);
+        s_notify(port, EMU_EV_EXT);
+        rc = PM_SUCCESS;
+    }
+    return rc;
+}
+
+uint8_t emu_pin_level(uint8_t port) {
+    return (port < TEST_PORT_COUNT) ? s_level(port) : 0;
+}
+
+uint8_t emu_port_pins(uint8_t port) {
+    return (port < TEST_PORT_COUNT) ? emu_ports[port].pin_mask : 0;
+}
+
+uint8_t emu_pin_driven(uint8_t port) {
+    uint8_t rc = 0;
+    if (port < TEST_PORT_COUNT) {
+        uint8_t ddr = R_DDR(port);
+        uint8_t pup = (MCUCR & (1<<PUD)) ? 0 : R_PORT(port);
+        rc = (ddr | ext_mask[port] | pup) & emu_ports[port].pin_mask;
+    }
+    return rc;
+}
+
+int emu_hook_add(uint8_t port, uint8_t events, emu_hook_fn fn, void * ctx) {
+    int rc = PM_ERROR;
+    int i;
+    if (port < TEST_PORT_COUNT && fn && (events & EMU_EV_ALL)) {
+        for ( i = 0 ; i < EMU_MAX_HOOKS ; ++i ) {
+            if (emu_hooks[i].fn == NULL) {
+                emu_hooks[i].fn     = fn;
+                emu_hooks[i].ctx    = ctx;
+                emu_hooks[i].port   = port;
+                emu_hooks[i].events = events;
+                emu_hooks[i].busy   = 0;
+                rc = i + 1;
+                break;
+            }
+        }
+    }
+    return rc;
+}
+
+int emu_hook_remove(int hndl) {
+    int rc = PM_ERROR;
+    if (hndl > 0 && hndl <= EMU_MAX_HOOKS && emu_hooks[hndl-1].fn) {
+        emu_hooks[hndl-1].fn = NULL;
+        rc = PM_SUCCESS;
+    }
+    return rc;
+}
+
+void emu_hook_clear(void) {
+    int i;
+    for ( i = 0 ; i < EMU_MAX_HOOKS ; ++i ) {
+        emu_hooks[i].fn = NULL;
+    }
+}
+
+#endif /* EMULATE_LIB */
@@ -0,0 +1,153 @@
+/**********************************************************************
+ * gpio_emu.h
+ *
+ * GPIO REGISTER FILE EMULATION (Linux host builds only)
+ * Emulates the ATmega2560 GPIO register file so that code written
+ * against the GPIO API can run natively on a Linux host. All 11 ports
+ * (A..L) are backed, at their real data-space addresses:
+ *
+ *   PortA..PortG   0x20 .. 0x34   (I/O space)
+ *   PortH..PortL   0x100 .. 0x10B (extended I/O space)
+ *
+ * The register file is a single byte array, TEST_REGISTERS[], which
+ * maps data-space address 0x20 to index 0. Unused addresses between
+ * PortG and PortH are held in the array but have no behaviour.
+ *
+ * Emulated behaviour:
+ *  - PINx reflects the level on each pin: DDR/PORT for outputs, an
+ *    external drive (see emu_pin_drive()) or the pullup for inputs.
+ *    Floating inputs read as '0'.
+ *  - Writing '1' to a PINx bit toggles the matching PORTx bit.
+ *  - MCUCR.PUD set disables all pullups.
+ *  - PortG only has 6 pins, bits 6,7 always read '0'.
+ *
+ * Peripheral models (see gpio_emu_dev.h) attach to ports with
+ * emu_hook_add() and are called when the MCU writes DDRx/PORTx, when
+ * it reads PINx and when an external drive changes. Models answer by
+ * driving the MCU's input pins with emu_pin_drive().
+ *
+ * The GPIO API (gpio_api.c) accesses registers through emu_reg_read()
+ * and emu_reg_write() when EMULATE_LIB is defined. Test code may poke
+ * TEST_REGISTERS[] directly, this bypasses the emulated behaviour.
+ *
+ * REQUIRED DEFINITIONS
+ *
+ *  EMULATE_LIB         gpio_emu.c compiles to nothing without it.
+ *
+ * OPTIONAL DEFINITIONS
+ *
+ *  EMU_MAX_HOOKS (16)  Maximum number of attached port hooks.
+ *
+ *********************************************************************/
+
+#ifndef _GPIO_EMU_H_
+#define _GPIO_EMU_H_
+
+#include "avrlib.h"
+
+#ifdef EMULATE_LIB
+
+/* Emulated Data-Space Window ---------------------------------------*/
+#define EMU_IO_BASE         0x20    /* PINA                 */
+#define EMU_IO_END          0x10C   /* PORTL + 1            */
+#define TEST_REGR_COUNT     (EMU_IO_END - EMU_IO_BASE)
+#define TEST_PORT_COUNT     11      /* PortA .. PortL       */
+
+/* Translate a data-space address into an emulated register pointer */
+#define EMU_REG(addr)       ((sfr8p_t)&(TEST_REGISTERS[(addr) - EMU_IO_BASE]))
+
+/* Register selectors, for emu_port_reg() ---------------------------*/
+#define EMU_REG_PIN         0
+#define EMU_REG_DDR         1
+#define EMU_REG_PORT        2
+
+/* Hook Events (bit flags) ------------------------------------------*/
+#define EMU_EV_DDR_WR       0x01    /* DDRx written                 */
+#define EMU_EV_PORT_WR      0x02    /* PORTx written (or PINx tog.) */
+#define EMU_EV_PIN_RD       0x04    /* PINx about to be read        */
+#define EMU_EV_EXT          0x08    /* external drive changed       */
+#define EMU_EV_WRITE        (EMU_EV_DDR_WR | EMU_EV_PORT_WR)
+#define EMU_EV_ALL          0x0F
+
+#ifndef EMU_MAX_HOOKS
+#define EMU_MAX_HOOKS       16
+#endif
+
+/* Hook callback: 'port' is PM_PORT_*, 'event' is one EMU_EV_* flag */
+typedef void (*emu_hook_fn)(uint8_t port, uint8_t event, void * ctx);
+
+/* MCUCR - only the PUD bit is emulated -----------------------------*/
+#define PUD                 4
+
+extern uint8_t MCUCR;
+extern uint8_t TEST_REGISTERS[TEST_REGR_COUNT];
+extern sfr8p_t TR_ADDR_BASE;
+
+/* Reset the register file ------------------------------------------
+ * -
+ * All PIN, DDR, PORT registers and MCUCR are cleared. External pin
+ * drives are left in place, they belong to the world outside the MCU.
+ * ------------------------------------------------------------------*/
+void emu_reset(void);
+
+/* Register Access --------------------------------------------------
+ * -
+ * Read or write an emulated register, with side-effects. Registers
+ * outside of the GPIO map (eg. MCUCR) are plain reads and writes.
+ * ------------------------------------------------------------------*/
+uint8_t emu_reg_read(sfr8p_t reg);
+void emu_reg_write(sfr8p_t reg, uint8_t val);
+
+/* Port Register Lookup ---------------------------------------------
+ * -
+ * Arguments:
+ *  port        one of: PM_PORT_*
+ *  reg         one of: EMU_REG_PIN, EMU_REG_DDR, EMU_REG_PORT
+ * Returns:     register pointer or NULL if invalid
+ * ------------------------------------------------------------------*/
+sfr8p_t emu_port_reg(uint8_t port, uint8_t reg);
+
+/* External Pin Stimulus --------------------------------------------
+ * -
+ * Drive input pins from "outside" the MCU. Driven pins override the
+ * pullup state. Output pins ignore external drives.
+ * -
+ * emu_pin_drive()      drive pins in 'mask' to the levels in 'value'
+ * emu_pin_release()    stop driving pins in 'mask' (float)
+ * emu_pin_level()      the actual levels on the port's pins, as seen
+ *                      from outside of the MCU.
+ * emu_pin_driven()     mask of pins with a defined level (MCU output,
+ *                      pullup or external drive), '0' = floating.
+ * Returns:     PM_SUCCESS, PM_ERROR (drive, release)
+ * ------------------------------------------------------------------*/
+int emu_pin_drive(uint8_t port, uint8_t mask, uint8_t value);
+int emu_pin_release(uint8_t port, uint8_t mask);
+uint8_t emu_pin_level(uint8_t port);
+uint8_t emu_pin_driven(uint8_t port);
+
+/* Port Pin Map -----------------------------------------------------
+ * -
+ * Returns:     mask of the pins that exist on 'port', 0 if invalid
+ * ------------------------------------------------------------------*/
+uint8_t emu_port_pins(uint8_t port);
+
+/* Port Hooks -------------------------------------------------------
+ * -
+ * Attach a callback to a port. The callback is run for each event in
+ * 'events' (EMU_EV_*). Write events are delivered after the register
+ * has been updated, PIN read events before PINx is sampled so that a
+ * model can update its drives in time. A hook is never re-entered
+ * from its own pin drives, other hooks on the port still see them.
+ * Hooks survive emu_reset().
+ * -
+ * emu_hook_add()       Returns: hook handle (>0) or PM_ERROR
+ * emu_hook_remove()    Returns: PM_SUCCESS, PM_ERROR
+ * emu_hook_clear()     remove all hooks
+ * ------------------------------------------------------------------*/
+int emu_hook_add(uint8_t port, uint8_t events, emu_hook_fn fn, void * ctx);
+int emu_hook_remove(int hndl);
+void emu_hook_clear(void);
+
+#endif /* EMULATE_LIB */
+
+#endif /* _GPIO_EMU_H_ */
@@ -0,0 +1,349 @@
+/**********************************************************************
+ * gpio_emu_dev.c
+ *
+ * PERIPHERAL MODELS FOR THE GPIO EMULATION (Linux host builds only)
+ * See gpio_emu_dev.h
+ *
+ *********************************************************************/
+
+#ifdef EMULATE_LIB
+
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+#include "gpio_api.h"
+#include "gpio_emu_dev.h"
+#include "libtime.h"
+
+/* level of one pin as seen from outside of the MCU */
+static uint8_t s_pin(uint8_t port, uint8_t pin) {
+    return (emu_pin_level(port) >> pin) & 1;
+}
+
+/* 74LS165 ----------------------------------------------------------*/
+
+static void s_74165_q(emu_74165_t * dev) {
+    emu_pin_drive(dev->q_port, (1 << dev->q_pin), (dev->sreg & 1) << dev->q_pin);
+}
+
+static void s_74165_hook(uint8_t port, uint8_t event, void * ctx) {
+    emu_74165_t * dev = (emu_74165_t *)ctx;
+    uint8_t ld = s_pin(dev->ld_port, dev->ld_pin);
+    uint8_t ck = s_pin(dev->ck_port, dev->ck_pin);
+    if (!ld) {
+        /* parallel load is asynchronous, Q7 follows the inputs */
+        dev->sreg = dev->inputs;
+        if (dev->ld_last) {
+            dev->loads++;
+        }
+    } else if (ck && !dev->ck_last) {
+        /* rising clock, shift towards Q7. SER is tied low. */
+        dev->sreg >>= 1;
+        dev->clocks++;
+    }
+    dev->ld_last = ld;
+    dev->ck_last = ck;
+    s_74165_q(dev);
+}
+
+int emu_74165_attach(emu_74165_t * dev) {
+    int rc = PM_ERROR;
+    if (dev && dev->chain > 0 && dev->chain <= EMU_74165_MAX_CHAIN) {
+        if (dev->chain < EMU_74165_MAX_CHAIN) {
+            dev->inputs &= ((uint32_t)1 << (8 * dev->chain)) - 1;
+        }
+        dev->sreg    = dev->inputs;
+        dev->loads   = 0;
+        dev->clocks  = 0;
+        dev->ld_last = s_pin(dev->ld_port, dev->ld_pin);
+        dev->ck_last = s_pin(dev->ck_port, dev->ck_pin);
+        dev->hook[0] = emu_hook_add(dev->ld_port, EMU_EV_WRITE, s_74165_hook, dev);
+        dev->hook[1] = PM_ERROR;
+        if (dev->ck_port != dev->ld_port) {
+            dev->hook[1] = emu_hook_add(dev->ck_port, EMU_EV_WRITE, s_74165_hook, dev);
+        }
+        if (dev->hook[0] > 0 && (dev->ck_port == dev->ld_port || dev->hook[1] > 0)) {
+            s_74165_q(dev);
+            rc = PM_SUCCESS;
+        } else {
+            emu_74165_detach(dev);
+        }
+    }
+    return rc;
+}
+
+void emu_74165_detach(emu_74165_t * dev) {
+    if (dev) {
+        emu_hook_remove(dev->hook[0]);
+        emu_hook_remove(dev->hook[1]);
+        dev->hook[0] = dev->hook[1] = PM_ERROR;
+        emu_pin_release(dev->q_port, (1 << dev->q_pin));
+    }
+}
+
+/* ICM7218A ---------------------------------------------------------*/
+
+static void s_7218_hook(uint8_t port, uint8_t event, void * ctx) {
+    emu_icm7218_t * dev = (emu_icm7218_t *)ctx;
+    uint8_t wr = s_pin(dev->wr_port, dev->wr_pin);
+    if (wr && !dev->wr_last) {
+        /* /WR rising edge, latch the input bus */
+        uint8_t id = emu_pin_level(dev->data_port);
+        dev->writes++;
+        if (s_pin(dev->mode_port, dev->mode_pin)) {
+            dev->ctrl = id;
+            dev->idx = (id & EMU_7218_DATA_COMING) ? 0 : EMU_7218_DIGITS;
+        } else if (dev->idx < EMU_7218_DIGITS) {
+            dev->digit[dev->idx++] = id;
+            if (dev->idx == EMU_7218_DIGITS) {
+                dev->updates++;
+            }
+        }
+    }
+    dev->wr_last = wr;
+}
+
+int emu_icm7218_attach(emu_icm7218_t * dev) {
+    int rc = PM_ERROR;
+    if (dev) {
+        int i;
+        for ( i = 0 ; i < EMU_7218_DIGITS ; ++i ) {
+            dev->digit[i] = 0;
+        }
+        dev->ctrl    = 0;
+        dev->idx     = EMU_7218_DIGITS;
+        dev->writes  = 0;
+        dev->updates = 0;
+        dev->wr_last = s_pin(dev->wr_port, dev->wr_pin);
+        /* data and MODE are sampled on the /WR edge only */
+        dev->hook = emu_hook_add(dev->wr_port, EMU_EV_WRITE, s_7218_hook, dev);
+        if (dev->hook > 0) {
+            rc = PM_SUCCESS;
+        }
+    }
+    return rc;
+}
+
+void emu_icm7218_detach(emu_icm7218_t * dev) {
+    if (dev) {
+        emu_hook_remove(dev->hook);
+        dev->hook = PM_ERROR;
+    }
+}
+
+char * emu_icm7218_text(emu_icm7218_t * dev, char * buf) {
+    static const char hex[] = "0123456789ABCDEF";
+    int i;
+    for ( i = 0 ; i < EMU_7218_DIGITS ; ++i ) {
+        buf[i] = hex[dev->digit[i] & 0x0f];
+    }
+    buf[EMU_7218_DIGITS] = '\0';
+    return buf;
+}
+
+/* 8085 Bus ---------------------------------------------------------*/
+
+/* level of an optional pin, 'dflt' if not wired */
+static uint8_t s_epin(emu_pin_t * pe, uint8_t dflt) {
+    return (pe->port < TEST_PORT_COUNT) ? s_pin(pe->port, pe->pin) : dflt;
+}
+
+static void s_edrive(emu_pin_t * pe, uint8_t lvl) {
+    if (pe->port < TEST_PORT_COUNT) {
+        emu_pin_drive(pe->port, (1 << pe->pin), (lvl ? 1 : 0) << pe->pin);
+    }
+}
+
+static void s_erelease(emu_pin_t * pe) {
+    if (pe->port < TEST_PORT_COUNT) {
+        emu_pin_release(pe->port, (1 << pe->pin));
+    }
+}
+
+static void s_8085_hlda(emu_bus8085_t * dev, uint8_t held) {
+    dev->held = held;
+    s_edrive(&dev->hlda, held);
+}
+
+static void s_8085_hook(uint8_t port, uint8_t event, void * ctx) {
+    emu_bus8085_t * dev = (emu_bus8085_t *)ctx;
+    uint8_t hold = s_epin(&dev->hold, 0);
+    uint8_t ale, rd, wr, rst, sel;
+    /* (1) HOLD/HLDA handshake */
+    if (hold != dev->last_hold) {
+        dev->countdown = dev->hold_latency;
+        dev->last_hold = hold;
+    }
+    if (hold != dev->held) {
+        if (dev->countdown && event == EMU_EV_PIN_RD && port == dev->hlda.port) {
+            dev->countdown--;
+        }
+        if (dev->countdown == 0) {
+            s_8085_hlda(dev, hold);
+        }
+    }
+    /* (2) bus cycles */
+    ale = s_epin(&dev->ale, 0);
+    rd  = s_epin(&dev->rd, 1);
+    wr  = s_epin(&dev->wr, 1);
+    rst = s_epin(&dev->reset, 1);
+    sel = dev->held && (s_epin(&dev->cs_en, 0) == 0);
+    if (!rst && dev->last_reset) {
+        dev->resets++;
+    }
+    if (dev->last_ale && !ale) {
+        dev->latch = ((uint16_t)emu_pin_level(dev->a_port) << 8) | emu_pin_level(dev->ad_port);
+    }
+    if (dev->last_rd && !rd) {
+        if (sel) {
+            uint8_t val = s_epin(&dev->iom, 0) ? dev->io[dev->latch & 0xff] : dev->mem[dev->latch];
+            if (*emu_port_reg(dev->ad_port, EMU_REG_DDR)) {
+                dev->errors++;  /* MCU still driving AD */
+            }
+            dev->rd_val = val;
+            dev->rd_valid = (dev->t_acc == 0);
+            dev->t_strobe = tm_emu_ns();
+            emu_pin_drive(dev->ad_port, 0xff, (dev->rd_valid) ? val : (uint8_t)~val);
+            dev->rd_cycles++;
+        } else {
+            dev->errors++;
+        }
+    } else if (!dev->last_rd && rd) {
+        emu_pin_release(dev->ad_port, 0xff);
+    } else if (!rd && !dev->rd_valid && sel) {
+        /* read in progress, data valid after t_acc */
+        if (tm_emu_ns() - dev->t_strobe >= dev->t_acc) {
+            dev->rd_valid = 1;
+            emu_pin_drive(dev->ad_port, 0xff, dev->rd_val);
+        } else if (event == EMU_EV_PIN_RD && port == dev->ad_port) {
+            dev->late++;
+        }
+    }
+    if (dev->last_wr && !wr) {
+        dev->t_strobe = tm_emu_ns();
+    } else if (!dev->last_wr && wr) {
+        if (sel) {
+            uint8_t val = emu_pin_level(dev->ad_port);
+            if (dev->t_wr && tm_emu_ns() - dev->t_strobe < dev->t_wr) {
+                dev->late++;    /* too short, not stored */
+            } else if (s_epin(&dev->iom, 0)) {
+                dev->io[dev->latch & 0xff] = val;
+            } else {
+                dev->mem[dev->latch] = val;
+            }
+            dev->wr_cycles++;
+        } else {
+            dev->errors++;
+        }
+    }
+    dev->last_ale   = ale;
+    dev->last_rd    = rd;
+    dev->last_wr    = wr;
+    dev->last_reset = rst;
+}
+
+int emu_bus8085_attach(emu_bus8085_t * dev, const char * image) {
+    int rc = PM_ERROR;
+    emu_pin_t * ctl[] = { &dev->ale, &dev->rd, &dev->wr, &dev->iom, 
+        &dev->hold, &dev->hlda, &dev->reset, &dev->cs_en };
+    uint16_t ports = 0;
+    uint8_t i;
+    void * map;
+    if (!dev || dev->ad_port >= TEST_PORT_COUNT || dev->a_port >= TEST_PORT_COUNT ||
+      dev->hold.port >= TEST_PORT_COUNT || dev->hlda.port >= TEST_PORT_COUNT) {
+        return rc;
+    }
+    /* target memory */
+    dev->fd = -1;
+    if (image) {
+        struct stat st;
+        if ((dev->fd = open(image, O_RDWR | O_CREAT, 0644)) < 0) {
+            return rc;
+        }
+        if (fstat(dev->fd, &st) != 0 || 
+          (st.st_size < EMU_8085_IMG_SIZE && ftruncate(dev->fd, EMU_8085_IMG_SIZE) != 0)) {
+            close(dev->fd);
+            return rc;
+        }
+        map = mmap(NULL, EMU_8085_IMG_SIZE, PROT_READ | PROT_WRITE, MAP_SHARED, dev->fd, 0);
+    } else {
+        map = mmap(NULL, EMU_8085_IMG_SIZE, PROT_READ | PROT_WRITE, MAP_PRIVATE | MAP_ANONYMOUS, -1, 0);
+    }
+    if (map == MAP_FAILED) {
+        if (dev->fd >= 0) {
+            close(dev->fd);
+        }
+        return rc;
+    }
+    dev->image = (uint8_t *)map;
+    dev->mem   = dev->image;
+    dev->io    = dev->image + EMU_8085_MEM_SIZE;
+    dev->rd_cycles = dev->wr_cycles = dev->resets = dev->errors = dev->late = 0;
+    dev->latch = 0;
+    dev->rd_valid = 1;
+    /* CPU owns the bus. Control lines idle inactive (driven by the CPU
+     * or pulled while it is held), MCU outputs override these drives. */
+    s_edrive(&dev->rd, 1);
+    s_edrive(&dev->wr, 1);
+    s_edrive(&dev->ale, 0);
+    s_edrive(&dev->iom, 0);
+    s_8085_hlda(dev, 0);
+    dev->countdown  = dev->hold_latency;
+    dev->last_hold  = s_epin(&dev->hold, 0);
+    dev->last_ale   = s_epin(&dev->ale, 0);
+    dev->last_rd    = s_epin(&dev->rd, 1);
+    dev->last_wr    = s_epin(&dev->wr, 1);
+    dev->last_reset = s_epin(&dev->reset, 1);
+    /* one hook per control port */
+    for ( i = 0 ; i < TEST_PORT_COUNT ; ++i ) {
+        dev->hook[i] = PM_ERROR;
+    }
+    for ( i = 0 ; i < sizeof(ctl)/sizeof(ctl[0]) ; ++i ) {
+        if (ctl[i]->port < TEST_PORT_COUNT) {
+            ports |= (1 << ctl[i]->port);
+        }
+    }
+    if (dev->t_acc) {
+        ports |= (1 << dev->ad_port);   /* AD reads, to time the data */
+    }
+    rc = PM_SUCCESS;
+    for ( i = 0 ; i < TEST_PORT_COUNT ; ++i ) {
+        if (ports & (1 << i)) {
+            if ((dev->hook[i] = emu_hook_add(i, EMU_EV_WRITE | EMU_EV_PIN_RD, s_8085_hook, dev)) < 0) {
+                rc = PM_ERROR;
+            }
+        }
+    }
+    if (rc != PM_SUCCESS) {
+        emu_bus8085_detach(dev);
+    }
+    return rc;
+}
+
+void emu_bus8085_detach(emu_bus8085_t * dev) {
+    uint8_t i;
+    if (dev && dev->image) {
+        for ( i = 0 ; i < TEST_PORT_COUNT ; ++i ) {
+            emu_hook_remove(dev->hook[i]);
+            dev->hook[i] = PM_ERROR;
+        }
+        s_erelease(&dev->rd);
+        s_erelease(&dev->wr);
+        s_erelease(&dev->ale);
+        s_erelease(&dev->iom);
+        s_erelease(&dev->hlda);
+        emu_pin_release(dev->ad_port, 0xff);
+        if (dev->fd >= 0) {
+            msync(dev->image, EMU_8085_IMG_SIZE, MS_SYNC);
+        }
+        munmap(dev->image, EMU_8085_IMG_SIZE);
+        if (dev->fd >= 0) {
+            close(dev->fd);
+        }
+        dev->fd    = -1;
+        dev->image = dev->mem = dev->io = NULL;
+    }
+}
+
+#endif /* EMULATE_LIB */
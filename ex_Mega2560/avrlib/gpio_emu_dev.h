@@ -0,0 +1,207 @@
+/**********************************************************************
+ * gpio_emu_dev.h
+ *
+ * PERIPHERAL MODELS FOR THE GPIO EMULATION (Linux host builds only)
+ * Chip level models that attach to the emulated GPIO register file
+ * (gpio_emu.h) through port hooks. A model watches the MCU's output
+ * pins and drives the MCU's input pins, so that driver code can be run
+ * unmodified against it.
+ *
+ * Each model is described by a caller owned struct. Fill in the pin
+ * assignment, call the *_attach() function, then read or change the
+ * model state through the struct. Pins are given as PM_PORT_* and
+ * PM_PIN_* values.
+ *
+ * MODELS
+ *
+ *  74LS165     8-bit parallel-in/serial-out shift register, 1..4 in
+ *              a chain. /PL low loads 'inputs', each rising CP edge
+ *              shifts one bit towards Q7. Bit 0 of 'inputs' is the
+ *              first bit presented on Q7.
+ *
+ *  ICM7218A    8-digit LED display driver, parallel input. A /WR
+ *              rising edge latches ID0..ID7: with MODE high as a
+ *              control word, with MODE low as digit data. A control
+ *              word with DATA COMING (ID7) set starts a sequential
+ *              update of digits 1..8.
+ *
+ *  8085 BUS    An 8085 system bus with 64K memory and 256 bytes of
+ *              I/O space, as seen by a bus master that takes the bus
+ *              over with HOLD/HLDA. HLDA follows HOLD after a set
+ *              number of HLDA reads. RD, WR idle high and ALE, IO/M
+ *              idle low unless the MCU drives them. When held: ALE
+ *              falling latches A0..A15, RD low drives AD0..AD7 with
+ *              the addressed byte, WR rising stores AD0..AD7. IO/M
+ *              selects memory or I/O. An optional active-low chip
+ *              select enable gates the strobes (RCU-85 EXTSEL).
+ *              Memory and I/O can be backed by an image file which
+ *              is mmap'ed, so the contents persist between runs.
+ *              Optional access times, in emulated time (libtime.h):
+ *              AD0..AD7 read as ~data until RD has been low for
+ *              't_acc', a WR pulse shorter than 't_wr' is lost.
+ *
+ * REQUIRED DEFINITIONS
+ *
+ *  EMULATE_LIB         gpio_emu_dev.c compiles to nothing without it.
+ *
+ *********************************************************************/
+
+#ifndef _GPIO_EMU_DEV_H_
+#define _GPIO_EMU_DEV_H_
+
+#include "avrlib.h"
+
+#ifdef EMULATE_LIB
+
+#include "gpio_emu.h"
+
+/* 74LS165 Shift Register Chain -------------------------------------*/
+#define EMU_74165_MAX_CHAIN     4
+
+typedef struct emu_74165_type {
+    /* pin assignment (MCU side) */
+    uint8_t     ld_port;    /* /PL  (MCU output) */
+    uint8_t     ld_pin;
+    uint8_t     ck_port;    /* CP   (MCU output) */
+    uint8_t     ck_pin;
+    uint8_t     q_port;     /* Q7   (MCU input)  */
+    uint8_t     q_pin;
+    uint8_t     chain;      /* # of chained devices, 1..4 */
+    /* parallel inputs, bit 0 shifts out first */
+    uint32_t    inputs;
+    /* model state */
+    uint32_t    sreg;
+    uint32_t    loads;      /* /PL pulses seen  */
+    uint32_t    clocks;     /* CP rising edges  */
+    uint8_t     ld_last;
+    uint8_t     ck_last;
+    int         hook[2];
+} emu_74165_t;
+
+/* Attach / Detach --------------------------------------------------
+ * -
+ * Arguments:
+ *  dev         model, pin assignment and 'chain' filled in
+ * Returns:     PM_SUCCESS, PM_ERROR
+ * ------------------------------------------------------------------*/
+int emu_74165_attach(emu_74165_t * dev);
+void emu_74165_detach(emu_74165_t * dev);
+
+/* ICM7218A Display Driver ------------------------------------------*/
+#define EMU_7218_DIGITS         8
+/* control word bits */
+#define EMU_7218_BANK           0x08
+#define EMU_7218_RUN            0x10    /* '0' = shutdown           */
+#define EMU_7218_NODECODE       0x20
+#define EMU_7218_HEX            0x40    /* '0' = Code-B             */
+#define EMU_7218_DATA_COMING    0x80
+
+typedef struct emu_icm7218_type {
+    /* pin assignment (MCU side) */
+    uint8_t     data_port;  /* ID0..ID7, all 8 pins */
+    uint8_t     wr_port;    /* /WRITE */
+    uint8_t     wr_pin;
+    uint8_t     mode_port;  /* MODE   */
+    uint8_t     mode_pin;
+    /* model state */
+    uint8_t     ctrl;       /* last control word */
+    uint8_t     digit[EMU_7218_DIGITS];
+    uint8_t     idx;        /* next digit of an update, 8 = idle */
+    uint32_t    writes;     /* /WR strobes seen */
+    uint32_t    updates;    /* completed 8 digit updates */
+    uint8_t     wr_last;
+    int         hook;
+} emu_icm7218_t;
+
+/* Attach / Detach --------------------------------------------------
+ * -
+ * Arguments:
+ *  dev         model, pin assignment filled in
+ * Returns:     PM_SUCCESS, PM_ERROR
+ * ------------------------------------------------------------------*/
+int emu_icm7218_attach(emu_icm7218_t * dev);
+void emu_icm7218_detach(emu_icm7218_t * dev);
+
+/* Display Contents -------------------------------------------------
+ * -
+ * Render the 8 digits as text, as the display would show them in
+ * HEX decode mode (low nibble of each digit). Digit 1 is leftmost.
+ * -
+ * Arguments:
+ *  dev         model
+ *  buf         output buffer, 9 chars minimum (nul terminated)
+ * Returns:     buf
+ * ------------------------------------------------------------------*/
+char * emu_icm7218_text(emu_icm7218_t * dev, char * buf);
+
+/* 8085 Bus --------------------------------------------------------*/
+#define EMU_8085_MEM_SIZE       0x10000
+#define EMU_8085_IO_SIZE        0x100
+#define EMU_8085_IMG_SIZE       (EMU_8085_MEM_SIZE + EMU_8085_IO_SIZE)
+#define EMU_PIN_NONE            0xff    /* emu_pin_t.port, not wired */
+
+typedef struct emu_pin_type {
+    uint8_t     port;       /* PM_PORT_* or EMU_PIN_NONE */
+    uint8_t     pin;        /* PM_PIN_*  */
+} emu_pin_t;
+
+typedef struct emu_bus8085_type {
+    /* pin assignment (MCU side) */
+    uint8_t     ad_port;    /* AD0..AD7 */
+    uint8_t     a_port;     /* A8..A15  */
+    emu_pin_t   ale;
+    emu_pin_t   rd;         /* /RD  */
+    emu_pin_t   wr;         /* /WR  */
+    emu_pin_t   iom;        /* IO/M, '1' = I/O */
+    emu_pin_t   hold;       /* MCU output */
+    emu_pin_t   hlda;       /* MCU input  */
+    emu_pin_t   reset;      /* /RESET, optional */
+    emu_pin_t   cs_en;      /* chip select enable, active low, optional */
+    uint8_t     hold_latency;   /* HLDA follows HOLD on this HLDA read, 0 = at once */
+    uint16_t    t_acc;      /* RD low to data valid, ns, 0 = at once */
+    uint16_t    t_wr;       /* shortest WR pulse, ns, 0 = any */
+    /* target memory, valid after attach */
+    uint8_t *   mem;        /* 64K */
+    uint8_t *   io;         /* 256 */
+    /* statistics */
+    uint32_t    rd_cycles;
+    uint32_t    wr_cycles;
+    uint32_t    resets;     /* /RESET pulses */
+    uint32_t    errors;     /* strobes while not held or not selected,
+                               MCU driving AD during a read */
+    uint32_t    late;       /* reads sampled before t_acc, writes lost
+                               to a WR pulse shorter than t_wr */
+    /* model state */
+    uint16_t    latch;      /* address latched on ALE */
+    uint8_t     held;       /* HLDA level */
+    uint8_t     countdown;
+    uint8_t     last_hold;
+    uint8_t     last_ale;
+    uint8_t     last_rd;
+    uint8_t     last_wr;
+    uint8_t     last_reset;
+    uint8_t     rd_val;     /* byte for the read in progress */
+    uint8_t     rd_valid;   /* rd_val is on AD0..AD7 */
+    uint64_t    t_strobe;   /* RD, WR falling edge (tm_emu_ns) */
+    int         hook[TEST_PORT_COUNT];
+    int         fd;
+    uint8_t *   image;
+} emu_bus8085_t;
+
+/* Attach / Detach --------------------------------------------------
+ * -
+ * Arguments:
+ *  dev         model, pin assignment filled in
+ *  image       memory image file, created and zero filled if it does
+ *              not exist (EMU_8085_IMG_SIZE bytes: memory then I/O).
+ *              NULL = volatile memory, zero filled.
+ * Returns:     PM_SUCCESS, PM_ERROR
+ * -
+ * Detach writes the image back to its file (if any).
+ * ------------------------------------------------------------------*/
+int emu_bus8085_attach(emu_bus8085_t * dev, const char * image);
+void emu_bus8085_detach(emu_bus8085_t * dev);
+
+#endif /* EMULATE_LIB */
+
+#endif /* _GPIO_EMU_DEV_H_ */
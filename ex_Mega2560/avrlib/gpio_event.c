@@ -0,0 +1,356 @@
+/**********************************************************************
+ * gpio_event.c
+ *
+ * GPIO EVENTS - pin change and external interrupts
+ * See gpio_event.h
+ *
+ *********************************************************************/
+
+#include "gpio_event.h"
+#include "libtime.h"
+
+#ifdef EMULATE_LIB
+ #include "gpio_emu.h"
+ #define EV_ATOMIC
+#else
+ #include <avr/io.h>
+ #include <avr/interrupt.h>
+ #include <util/atomic.h>
+ #define EV_ATOMIC       ATOMIC_BLOCK(ATOMIC_RESTORESTATE)
+#endif
+
+#define EV_QMASK        (PM_EV_QLEN - 1)
+
+#if (PM_EV_QLEN & EV_QMASK) != 0
+ #error "PM_EV_QLEN must be a power of 2"
+#endif
+
+/* Interrupt source of a pin: INTn = n (0..7), PCINTn = EV_SRC_PCINT + n */
+#define EV_SRC_PCINT    8
+#define EV_SRC_NONE     0xff
+
+typedef struct ev_slot_type {
+    pm_event_fn         fn;         /* NULL := free */
+    void *              ctx;
+    int                 hndl;
+    uint32_t            t_ok;       /* debounce: next edge taken from this tm_millis() time */
+    uint16_t            debounce;
+    uint8_t             flags;
+    uint8_t             port;
+    uint8_t             pin;
+    uint8_t             src;
+    volatile uint8_t    level;      /* last level seen */
+    volatile uint8_t    stable;     /* last level taken */
+} ev_slot_t;
+
+static ev_slot_t            ev_tab[PM_MAX_EVENTS];
+static volatile uint8_t     evq_slot[PM_EV_QLEN];
+static volatile uint8_t     evq_level[PM_EV_QLEN];
+static volatile uint8_t     evq_head = 0;       /* next write */
+static volatile uint8_t     evq_used = 0;
+static volatile uint16_t    evq_lost = 0;
+
+/* which pin has which vector ----------------------------------------*/
+static uint8_t s_src(uint8_t port, uint8_t pin) {
+    uint8_t src = EV_SRC_NONE;
+    switch (port) {
+    case PM_PORT_D:
+        if (pin <= PM_PIN_3)
+            src = pin;                          /* INT0..3 */
+        break;
+    case PM_PORT_E:
+        if (pin >= PM_PIN_4)
+            src = pin;                          /* INT4..7 */
+        else if (pin == PM_PIN_0)
+            src = EV_SRC_PCINT + 8;
+        break;
+    case PM_PORT_B:
+        src = EV_SRC_PCINT + pin;               /* PCINT0..7 */
+        break;
+    case PM_PORT_J:
+        if (pin <= PM_PIN_6)
+            src = EV_SRC_PCINT + 9 + pin;       /* PCINT9..15 */
+        break;
+    case PM_PORT_K:
+        src = EV_SRC_PCINT + 16 + pin;          /* PCINT16..23 */
+        break;
+    default:
+        break;
+    }
+    return src;
+}
+
+/* Edge handling, interrupt context ---------------------------------*/
+static void s_take(uint8_t s, uint8_t level) {
+    ev_slot_t * ev = &ev_tab[s];
+    ev->stable = level;
+    if (ev->debounce)
+        ev->t_ok = tm_deadline_ms(ev->debounce);
+    if (ev->flags & ((level) ? PM_EDGE_RISING : PM_EDGE_FALLING)) {
+        if (ev->flags & PM_EV_DEFER) {
+            if (evq_used < PM_EV_QLEN) {
+                evq_slot[evq_head] = s;
+                evq_level[evq_head] = level;
+                evq_head = (evq_head + 1) & EV_QMASK;
+                evq_used++;
+            } else {
+                evq_lost++;
+            }
+        } else {
+            ev->fn(ev->hndl, level, ev->ctx);
+        }
+    }
+}
+
+static void s_edge(uint8_t s, uint8_t level) {
+    ev_slot_t * ev = &ev_tab[s];
+    ev->level = level;
+    if (level == ev->stable)
+        return;
+    if (ev->debounce && !tm_expired(ev->t_ok))
+        return;                                 /* pm_event_poll() settles it */
+    s_take(s, level);
+}
+
+/* a port changed: pass the levels of its event pins on */
+static void s_port_edge(uint8_t port, uint8_t levels) {
+    uint8_t s;
+    for ( s = 0 ; s < PM_MAX_EVENTS ; ++s ) {
+        if (ev_tab[s].fn && ev_tab[s].port == port) {
+            uint8_t level = (levels >> ev_tab[s].pin) & 1;
+            if (level != ev_tab[s].level)
+                s_edge(s, level);
+        }
+    }
+}
+
+#ifdef EMULATE_LIB
+
+/* Emulation: one hook per port with events --------------------------*/
+static int ev_hook[PORT_COUNT];
+
+static void s_emu_hook(uint8_t port, uint8_t event, void * ctx) {
+    (void)event;
+    (void)ctx;
+    s_port_edge(port, emu_pin_level(port));
+}
+
+static uint8_t s_read_level(uint8_t port, uint8_t pin) {
+    return (emu_pin_level(port) >> pin) & 1;
+}
+
+static void s_src_enable(uint8_t port, uint8_t src) {
+    (void)src;
+    if (ev_hook[port] <= 0)
+        ev_hook[port] = emu_hook_add(port, EMU_EV_EXT | EMU_EV_WRITE, s_emu_hook, NULL);
+}
+
+static void s_src_disable(uint8_t port, uint8_t src) {
+    uint8_t s;
+    (void)src;
+    for ( s = 0 ; s < PM_MAX_EVENTS ; ++s ) {
+        if (ev_tab[s].fn && ev_tab[s].port == port)
+            return;                             /* still in use */
+    }
+    if (ev_hook[port] > 0) {
+        emu_hook_remove(ev_hook[port]);
+        ev_hook[port] = 0;
+    }
+}
+
+#else
+
+/* Target: INTn any edge, PCINT group masks ---------------------------*/
+static uint8_t s_pin_reg(uint8_t port) {
+    switch (port) {
+    case PM_PORT_B: return PINB;
+    case PM_PORT_D: return PIND;
+    case PM_PORT_E: return PINE;
+    case PM_PORT_J: return PINJ;
+    case PM_PORT_K: return PINK;
+    default:        return 0;
+    }
+}
+
+static uint8_t s_read_level(uint8_t port, uint8_t pin) {
+    return (s_pin_reg(port) >> pin) & 1;
+}
+
+static void s_src_enable(uint8_t port, uint8_t src) {
+    (void)port;
+    if (src < EV_SRC_PCINT) {
+        uint8_t sh = (uint8_t)((src & 3) << 1);
+        if (src < 4)
+            EICRA = (uint8_t)((EICRA & ~(3 << sh)) | (1 << sh));  /* ISCn = 01, any edge */
+        else
+            EICRB = (uint8_t)((EICRB & ~(3 << sh)) | (1 << sh));
+        EIFR = (uint8_t)(1 << src);
+        EIMSK |= (uint8_t)(1 << src);
+    } else {
+        uint8_t n = src - EV_SRC_PCINT;
+        uint8_t bit = (uint8_t)(1 << (n & 7));
+        switch (n >> 3) {
+        case 0: PCMSK0 |= bit; break;
+        case 1: PCMSK1 |= bit; break;
+        default: PCMSK2 |= bit; break;
+        }
+        PCIFR = (uint8_t)(1 << (n >> 3));
+        PCICR |= (uint8_t)(1 << (n >> 3));
+    }
+}
+
+static void s_src_disable(uint8_t port, uint8_t src) {
+    (void)port;
+    if (src < EV_SRC_PCINT) {
+        EIMSK &= (uint8_t)~(1 << src);
+    } else {
+        uint8_t n = src - EV_SRC_PCINT;
+        uint8_t bit = (uint8_t)(1 << (n & 7));
+        switch (n >> 3) {
+        case 0: PCMSK0 &= (uint8_t)~bit; if (!PCMSK0) PCICR &= (uint8_t)~(1 << 0); break;
+        case 1: PCMSK1 &= (uint8_t)~bit; if (!PCMSK1) PCICR &= (uint8_t)~(1 << 1); break;
+        default: PCMSK2 &= (uint8_t)~bit; if (!PCMSK2) PCICR &= (uint8_t)~(1 << 2); break;
+        }
+    }
+}
+
+/* INTn: only the one pin */
+#define EV_INT_ISR(n, port) \
+ISR(INT##n##_vect) { s_port_edge((port), s_pin_reg(port)); }
+
+EV_INT_ISR(0, PM_PORT_D)
+EV_INT_ISR(1, PM_PORT_D)
+EV_INT_ISR(2, PM_PORT_D)
+EV_INT_ISR(3, PM_PORT_D)
+EV_INT_ISR(4, PM_PORT_E)
+EV_INT_ISR(5, PM_PORT_E)
+EV_INT_ISR(6, PM_PORT_E)
+EV_INT_ISR(7, PM_PORT_E)
+
+/* PCINT: s_port_edge() only looks at pins with an event */
+ISR(PCINT0_vect) {
+    s_port_edge(PM_PORT_B, PINB);
+}
+
+ISR(PCINT1_vect) {
+    s_port_edge(PM_PORT_E, PINE);
+    s_port_edge(PM_PORT_J, PINJ);
+}
+
+ISR(PCINT2_vect) {
+    s_port_edge(PM_PORT_K, PINK);
+}
+
+#endif /* EMULATE_LIB */
+
+/* --- API -----------------------------------------------------------*/
+
+int pm_register_event(int hndl, uint8_t flags, uint16_t debounce_ms, pm_event_fn fn, void * ctx) {
+    int rc = PM_ERROR;
+    uint8_t port, pin, src, s, fs = PM_MAX_EVENTS;
+    if (fn && (flags & PM_EDGE_BOTH) && (pm_hndl_info(hndl, &port, &pin) == PM_SUCCESS) &&
+      (pin != PM_PIN_ALL) && ((src = s_src(port, pin)) != EV_SRC_NONE)) {
+        for ( s = 0 ; s < PM_MAX_EVENTS ; ++s ) {
+            if (ev_tab[s].fn == NULL) {
+                if (fs == PM_MAX_EVENTS)
+                    fs = s;
+            } else if (ev_tab[s].hndl == hndl) {
+                fs = PM_MAX_EVENTS;             /* has one */
+                break;
+            }
+        }
+        if (fs < PM_MAX_EVENTS) {
+            ev_slot_t * ev = &ev_tab[fs];
+            tm_init();
+            EV_ATOMIC {
+                ev->ctx      = ctx;
+                ev->hndl     = hndl;
+                ev->debounce = debounce_ms;
+                ev->t_ok     = tm_millis();
+                ev->flags    = flags;
+                ev->port     = port;
+                ev->pin      = pin;
+                ev->src      = src;
+                ev->level    = s_read_level(port, pin);
+                ev->stable   = ev->level;
+                ev->fn       = fn;
+                s_src_enable(port, src);
+            }
+            rc = PM_SUCCESS;
+        }
+    }
+    return rc;
+}
+
+int pm_release_event(int hndl) {
+    int rc = PM_ERROR;
+    uint8_t s, i;
+    for ( s = 0 ; s < PM_MAX_EVENTS ; ++s ) {
+        if (ev_tab[s].fn && ev_tab[s].hndl == hndl) {
+            EV_ATOMIC {
+                ev_tab[s].fn = NULL;
+                s_src_disable(ev_tab[s].port, ev_tab[s].src);
+                /* drop its queued edges, a new event may get the slot */
+                for ( i = 0 ; i < evq_used ; ++i ) {
+                    uint8_t q = (evq_head - evq_used + i) & EV_QMASK;
+                    if (evq_slot[q] == s)
+                        evq_slot[q] = PM_MAX_EVENTS;
+                }
+            }
+            rc = PM_SUCCESS;
+            break;
+        }
+    }
+    return rc;
+}
+
+void pm_event_poll(void) {
+    uint8_t s, level, take;
+    /* queued edges */
+    while (evq_used) {
+        pm_event_fn fn = NULL;
+        void * ctx = NULL;
+        int hndl = 0;
+        EV_ATOMIC {
+            uint8_t q = (evq_head - evq_used) & EV_QMASK;
+            s = evq_slot[q];
+            level = evq_level[q];
+            evq_used--;
+            if (s < PM_MAX_EVENTS && ev_tab[s].fn) {
+                fn = ev_tab[s].fn;
+                ctx = ev_tab[s].ctx;
+                hndl = ev_tab[s].hndl;
+            }
+        }
+        if (fn)
+            fn(hndl, level, ctx);
+    }
+    /* debounced pins that moved during the lockout */
+    for ( s = 0 ; s < PM_MAX_EVENTS ; ++s ) {
+        ev_slot_t * ev = &ev_tab[s];
+        if (ev->fn && ev->debounce && (ev->level != ev->stable)) {
+            take = 0;
+            EV_ATOMIC {
+                if (tm_expired(ev->t_ok)) {
+                    level = s_read_level(ev->port, ev->pin);
+                    ev->level = level;
+                    if (level != ev->stable) {
+                        ev->stable = level;
+                        ev->t_ok = tm_deadline_ms(ev->debounce);
+                        take = (ev->flags & ((level) ? PM_EDGE_RISING : PM_EDGE_FALLING)) ? 1 : 0;
+                    }
+                }
+            }
+            if (take)
+                ev->fn(ev->hndl, level, ev->ctx);
+        }
+    }
+}
+
+uint16_t pm_event_lost(void) {
+    uint16_t n;
+    EV_ATOMIC {
+        n = evq_lost;
+    }
+    return n;
+}
@@ -0,0 +1,104 @@
+/**********************************************************************
+ * gpio_event.h
+ *
+ * GPIO EVENTS - pin change and external interrupts
+ * Calls back on edges of a registered GPIO input pin instead of having
+ * the application poll it. Built on the ATmega2560 INTn and PCINT
+ * vectors, only pins wired to one of them can have an event:
+ *
+ *  INT0 .. INT3    PD0 .. PD3      (own vector each)
+ *  INT4 .. INT7    PE4 .. PE7
+ *  PCINT0 .. 7     PB0 .. PB7      (PCINT0_vect)
+ *  PCINT8          PE0             (PCINT1_vect)
+ *  PCINT9 .. 15    PJ0 .. PJ6      (PCINT1_vect)
+ *  PCINT16 .. 23   PK0 .. PK7      (PCINT2_vect)
+ *
+ * INTn is used where a pin has both. The vectors are set for any edge,
+ * rising/falling is sorted out by reading the pin in the ISR.
+ *
+ * DELIVERY
+ *  PM_EV_ISR       the callback runs in the interrupt, keep it short.
+ *  PM_EV_DEFER     the edge is queued, pm_event_poll() (main loop)
+ *                  runs the callback. Edges that find the queue full
+ *                  are counted, see pm_event_lost().
+ *
+ * DEBOUNCE
+ *  With debounce_ms > 0 the first edge is taken at once, then the pin
+ *  is ignored for debounce_ms (system tick, libtime). If the pin has
+ *  settled at a different level by then, pm_event_poll() delivers that
+ *  level: for PM_EV_ISR events this last call comes from the main loop.
+ *  Debounced events need pm_event_poll() called regularly.
+ *
+ * EMULATE_LIB
+ *  No vectors: a port hook (gpio_emu.h) watches the emulated pins and
+ *  runs the same edge code on every external drive or port write. The
+ *  pin table above still applies.
+ *
+ * OPTIONAL DEFINITIONS
+ *
+ *  PM_MAX_EVENTS (8)   Event table size.
+ *  PM_EV_QLEN (8)      Deferred queue length, a power of 2.
+ *
+ *  gpio_api.c and libtime.c must be linked. Global interrupts must be
+ *  on, pm_register_event() calls tm_init() which enables them.
+ *
+ *********************************************************************/
+
+#ifndef _GPIO_EVENT_H_
+#define _GPIO_EVENT_H_
+
+#include "avrlib.h"
+#include "gpio_api.h"
+
+#ifndef PM_MAX_EVENTS
+#define PM_MAX_EVENTS       8
+#endif
+
+#ifndef PM_EV_QLEN
+#define PM_EV_QLEN          8
+#endif
+
+/* Edges and delivery, or'ed into 'flags' ---------------------------*/
+#define PM_EDGE_RISING      0x01
+#define PM_EDGE_FALLING     0x02
+#define PM_EDGE_BOTH        (PM_EDGE_RISING | PM_EDGE_FALLING)
+#define PM_EV_ISR           0x00
+#define PM_EV_DEFER         0x04
+
+/* Callback: the pin's handle and its new level (0, 1) --------------*/
+typedef void (*pm_event_fn)(int hndl, uint8_t level, void * ctx);
+
+/* Register an Event ------------------------------------------------
+ * -
+ * The pin must be registered (pm_register_pin()), normally as an
+ * input. One event per pin.
+ * -
+ * Arguments:
+ *  hndl        pin handle
+ *  flags       PM_EDGE_* | PM_EV_ISR or PM_EV_DEFER
+ *  debounce_ms 0: every edge, else the lockout after a taken edge
+ *  fn, ctx     callback and its argument
+ * Returns:     PM_SUCCESS, PM_ERROR (no vector for the pin, already
+ *              has an event, table full, bad arguments)
+ * ------------------------------------------------------------------*/
+int pm_register_event(int hndl, uint8_t flags, uint16_t debounce_ms, pm_event_fn fn, void * ctx);
+
+/* Remove an Event --------------------------------------------------
+ * -
+ * Masks the pin's interrupt. Queued, not yet delivered edges of the
+ * pin are dropped.
+ * Returns:     PM_SUCCESS, PM_ERROR (no event on 'hndl')
+ * ------------------------------------------------------------------*/
+int pm_release_event(int hndl);
+
+/* Main Loop Service ------------------------------------------------
+ * -
+ * Runs the queued PM_EV_DEFER callbacks, oldest first, and settles
+ * debounced pins. Does nothing when there is no work.
+ * ------------------------------------------------------------------*/
+void pm_event_poll(void);
+
+/* Deferred edges dropped on a full queue, since the start ----------*/
+uint16_t pm_event_lost(void);
+
+#endif /* _GPIO_EVENT_H_ */
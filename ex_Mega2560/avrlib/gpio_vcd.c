@@ -0,0 +1,182 @@
+/**********************************************************************
+ * gpio_vcd.c
+ *
+ * GPIO WAVEFORM RECORDER (Linux host builds only)
+ * See gpio_vcd.h
+ *
+ *********************************************************************/
+
+#ifdef EMULATE_LIB
+
+#include <stdio.h>
+#include <time.h>
+#include "gpio_api.h"
+#include "gpio_emu.h"
+#include "gpio_vcd.h"
+#include "libtime.h"
+
+static const char vcd_portletter[TEST_PORT_COUNT] = "ABCDEFGHJKL";
+
+static FILE *       vcd_fp = NULL;
+static uint16_t     vcd_ports = 0;
+static int          vcd_hook[TEST_PORT_COUNT];
+static uint8_t      vcd_lvl[TEST_PORT_COUNT];   /* last written levels  */
+static uint8_t      vcd_drv[TEST_PORT_COUNT];   /* last driven mask     */
+static uint64_t     vcd_time = 0;               /* last '#' timestamp   */
+static uint32_t     vcd_nchg = 0;
+static const char * vcd_names[TEST_PORT_COUNT][PM_TOTALPINS];
+
+/* VCD identifier codes: pins are one char '!'.., ports are '~'+letter */
+#define VCD_PIN_ID(port,pin)    ((char)('!' + ((port) * PM_TOTALPINS) + (pin)))
+
+static char s_bitval(uint8_t lvl, uint8_t drv, uint8_t pin) {
+    char rc = 'z';
+    if (drv & (1 << pin)) {
+        rc = (lvl & (1 << pin)) ? '1' : '0';
+    }
+    return rc;
+}
+
+/* write the 8-bit vector for a port, MSB first */
+static void s_write_port(uint8_t port, uint8_t lvl, uint8_t drv) {
+    int i;
+    fputc('b', vcd_fp);
+    for ( i = PM_TOTALPINS-1 ; i >= 0 ; --i ) {
+        fputc(s_bitval(lvl, drv, (uint8_t)i), vcd_fp);
+    }
+    fprintf(vcd_fp, " ~%c\n", vcd_portletter[port]);
+}
+
+static void s_sample(uint8_t port, uint8_t event, void * ctx) {
+    uint8_t lvl, drv, pins, chg;
+    uint8_t i;
+    uint64_t now;
+    if (!vcd_fp || event == EMU_EV_PIN_RD) {
+        return;
+    }
+    pins = emu_port_pins(port);
+    drv  = emu_pin_driven(port);
+    lvl  = emu_pin_level(port) & drv;
+    chg  = ((lvl ^ vcd_lvl[port]) | (drv ^ vcd_drv[port])) & pins;
+    if (chg) {
+        now = tm_emu_ns();
+        if (now != vcd_time) {
+            fprintf(vcd_fp, "#%llu\n", (unsigned long long)now);
+            vcd_time = now;
+        }
+        for ( i = 0 ; i < PM_TOTALPINS ; ++i ) {
+            if (chg & (1 << i)) {
+                fprintf(vcd_fp, "%c%c\n", s_bitval(lvl, drv, i), VCD_PIN_ID(port, i));
+                vcd_nchg++;
+            }
+        }
+        s_write_port(port, lvl, drv);
+        vcd_lvl[port] = lvl;
+        vcd_drv[port] = drv;
+    }
+}
+
+int vcd_name(uint8_t port, uint8_t pin, const char * name) {
+    int rc = PM_ERROR;
+    if (!vcd_fp && port < TEST_PORT_COUNT && pin < PM_TOTALPINS) {
+        vcd_names[port][pin] = name;
+        rc = PM_SUCCESS;
+    }
+    return rc;
+}
+
+int vcd_open(const char * path, uint16_t ports) {
+    int rc = PM_ERROR;
+    uint8_t p, i, pins;
+    time_t now;
+    if (vcd_fp || !path || (ports & VCD_ALL_PORTS) == 0) {
+        return rc;
+    }
+    if ((vcd_fp = fopen(path, "w")) == NULL) {
+        return rc;
+    }
+    vcd_ports = ports & VCD_ALL_PORTS;
+    vcd_time  = tm_emu_ns();
+    vcd_nchg  = 0;
+    /* header */
+    now = time(NULL);
+    fprintf(vcd_fp, "$date %s$end\n", ctime(&now));
+    fprintf(vcd_fp, "$version avrlib gpio_vcd $end\n");
+    fprintf(vcd_fp, "$timescale 1ns $end\n");
+    fprintf(vcd_fp, "$scope module atmega2560 $end\n");
+    for ( p = 0 ; p < TEST_PORT_COUNT ; ++p ) {
+        vcd_hook[p] = PM_ERROR;
+        if (!(vcd_ports & VCD_PORT(p))) {
+            continue;
+        }
+        pins = emu_port_pins(p);
+        for ( i = 0 ; i < PM_TOTALPINS ; ++i ) {
+            if (!(pins & (1 << i))) {
+                continue;
+            }
+            if (vcd_names[p][i]) {
+                fprintf(vcd_fp, "$var wire 1 %c %s $end\n", VCD_PIN_ID(p, i), vcd_names[p][i]);
+            } else {
+                fprintf(vcd_fp, "$var wire 1 %c P%c%d $end\n", VCD_PIN_ID(p, i), vcd_portletter[p], i);
+            }
+        }
+        fprintf(vcd_fp, "$var wire 8 ~%c PORT%c [7:0] $end\n", vcd_portletter[p], vcd_portletter[p]);
+    }
+    fprintf(vcd_fp, "$upscope $end\n");
+    fprintf(vcd_fp, "$enddefinitions $end\n");
+    /* initial values */
+    fprintf(vcd_fp, "#%llu\n$dumpvars\n", (unsigned long long)vcd_time);
+    rc = PM_SUCCESS;
+    for ( p = 0 ; p < TEST_PORT_COUNT ; ++p ) {
+        if (!(vcd_ports & VCD_PORT(p))) {
+            continue;
+        }
+        pins = emu_port_pins(p);
+        vcd_drv[p] = emu_pin_driven(p);
+        vcd_lvl[p] = emu_pin_level(p) & vcd_drv[p];
+        for ( i = 0 ; i < PM_TOTALPINS ; ++i ) {
+            if (pins & (1 << i)) {
+                fprintf(vcd_fp, "%c%c\n", s_bitval(vcd_lvl[p], vcd_drv[p], i), VCD_PIN_ID(p, i));
+            }
+        }
+        s_write_port(p, vcd_lvl[p], vcd_drv[p]);
+        vcd_hook[p] = emu_hook_add(p, EMU_EV_WRITE | EMU_EV_EXT, s_sample, NULL);
+        if (vcd_hook[p] < 0) {
+            rc = PM_ERROR;
+        }
+    }
+    fprintf(vcd_fp, "$end\n");
+    if (rc != PM_SUCCESS) {
+        vcd_close();
+    }
+    return rc;
+}
+
+void vcd_close(void) {
+    uint8_t p;
+    if (vcd_fp) {
+        for ( p = 0 ; p < TEST_PORT_COUNT ; ++p ) {
+            if (vcd_ports & VCD_PORT(p)) {
+                emu_hook_remove(vcd_hook[p]);
+                vcd_hook[p] = PM_ERROR;
+            }
+        }
+        /* end marker, so the last state has a visible width */
+        if (tm_emu_ns() != vcd_time) {
+            fprintf(vcd_fp, "#%llu\n", (unsigned long long)tm_emu_ns());
+        }
+        fclose(vcd_fp);
+        vcd_fp = NULL;
+        vcd_ports = 0;
+    }
+}
+
+uint8_t vcd_isOpen(void) {
+    return (vcd_fp != NULL);
+}
+
+uint32_t vcd_changes(void) {
+    return vcd_nchg;
+}
+
+#endif /* EMULATE_LIB */
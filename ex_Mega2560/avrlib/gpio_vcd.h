@@ -0,0 +1,84 @@
+/**********************************************************************
+ * gpio_vcd.h
+ *
+ * GPIO WAVEFORM RECORDER (Linux host builds only)
+ * Records every pin transition on the emulated GPIO ports (gpio_emu.h)
+ * into a Value Change Dump (VCD) file, for viewing in GTKWave or any
+ * other VCD viewer.
+ *
+ * Timestamps are emulated target time (tm_emu_ns() in libtime.h), in
+ * nanoseconds. Time advances with the tm_delay_*() calls made by the
+ * code under test, so the trace shows the timing the target would run
+ * with, not the host's wall clock. Code between delays takes no time.
+ *
+ * Each recorded port gets one wire per pin (default name eg. "PK0",
+ * or a name given with vcd_name()) plus an 8-bit vector "PORTK".
+ * Floating pins (input, no pullup, not driven externally) show 'z'.
+ *
+ * Typical use:
+ *
+ *      vcd_name(PM_PORT_K, PM_PIN_0, "DISP_WR");
+ *      vcd_open("disp.vcd", VCD_PORT(PM_PORT_F) | VCD_PORT(PM_PORT_K));
+ *      disp_update(&info);
+ *      vcd_close();
+ *
+ * REQUIRED DEFINITIONS
+ *
+ *  EMULATE_LIB         gpio_vcd.c compiles to nothing without it.
+ *                      libtime.c and gpio_emu.c must be linked.
+ *
+ *********************************************************************/
+
+#ifndef _GPIO_VCD_H_
+#define _GPIO_VCD_H_
+
+#include "avrlib.h"
+
+#ifdef EMULATE_LIB
+
+/* Port selection for vcd_open() */
+#define VCD_PORT(p)         ((uint16_t)1 << (p))
+#define VCD_ALL_PORTS       0x07FF
+
+/* Name a Signal ----------------------------------------------------
+ * -
+ * Give a pin a signal name in the trace. Must be called before
+ * vcd_open(). The name string is not copied and must stay valid.
+ * -
+ * Arguments:
+ *  port        PM_PORT_*
+ *  pin         PM_PIN_*
+ *  name        signal name, no spaces. NULL = default name.
+ * Returns:     PM_SUCCESS, PM_ERROR
+ * ------------------------------------------------------------------*/
+int vcd_name(uint8_t port, uint8_t pin, const char * name);
+
+/* Start Recording --------------------------------------------------
+ * -
+ * Create the VCD file and record the current pin states. Only one
+ * recording can be open at a time.
+ * -
+ * Arguments:
+ *  path        output file name (overwritten)
+ *  ports       ports to record, VCD_PORT(PM_PORT_*) ... or'ed
+ * Returns:     PM_SUCCESS, PM_ERROR
+ * ------------------------------------------------------------------*/
+int vcd_open(const char * path, uint16_t ports);
+
+/* Stop Recording ---------------------------------------------------
+ * -
+ * Write the final timestamp and close the file.
+ * ------------------------------------------------------------------*/
+void vcd_close(void);
+
+/* Recording state --------------------------------------------------
+ * -
+ * vcd_isOpen()         Returns: 1 if recording
+ * vcd_changes()        Returns: # of pin value changes written
+ * ------------------------------------------------------------------*/
+uint8_t vcd_isOpen(void);
+uint32_t vcd_changes(void);
+
+#endif /* EMULATE_LIB */
+
+#endif /* _GPIO_VCD_H_ */
@@ -0,0 +1,158 @@
+/****************************************************************************
+ * libmem.c
+ * RAM usage: stack high-water mark, heap and static footprint.
+ *
+ * Version 1.0
+ *
+ * See libmem.h
+ *
+ ***************************************************************************/
+
+#include "libmem.h"
+
+#ifdef EMULATE_LIB
+
+/* host program segments, from the linker */
+extern char __data_start, _edata, __bss_start, _end;
+
+/* Painted host stack region, [mem_lo .. mem_hi). Kept as addresses,
+ * the region outlives the frame that painted it. */
+static uintptr_t mem_lo = 0;
+static uintptr_t mem_hi = 0;
+
+/* keep clear of the painting code's own frame */
+#define MEM_EMU_MARGIN  1024
+
+static uint16_t s_clamp(unsigned long n) {
+    return (n > 0xffff) ? 0xffff : (uint16_t)n;
+}
+
+static void __attribute__((noinline)) s_paint(void) {
+    volatile uint8_t area[MEM_EMU_STACK];
+    int i;
+    for ( i = 0 ; i < MEM_EMU_STACK ; ++i ) {
+        area[i] = MEM_PAINT;
+    }
+    mem_lo = (uintptr_t)area;
+    mem_hi = mem_lo + MEM_EMU_STACK;
+}
+
+void mem_init(void) {
+    s_paint();
+}
+
+void __attribute__((noinline)) mem_reset(void) {
+    volatile uint8_t here;
+    uintptr_t p;
+    if (mem_lo) {
+        for ( p = mem_lo ; p < (uintptr_t)&here - MEM_EMU_MARGIN ; ++p ) {
+            *(volatile uint8_t *)p = MEM_PAINT;
+        }
+    }
+}
+
+void mem_get(mem_info_t * info) {
+    volatile uint8_t here;
+    uintptr_t sp = (uintptr_t)&here;
+    uintptr_t p;
+    if (!info)
+        return;
+    info->data = s_clamp((unsigned long)(&_edata - &__data_start));
+    info->bss  = s_clamp((unsigned long)(&_end - &__bss_start));
+    info->heap = 0;         /* the host's malloc() is not ours to count */
+    info->stack = info->stack_max = info->free = info->free_min = 0;
+    if (mem_lo) {
+        for ( p = mem_lo ; p < mem_hi && *(volatile uint8_t *)p == MEM_PAINT ; ++p )
+            ;
+        info->free_min  = s_clamp(p - mem_lo);
+        info->stack_max = s_clamp(mem_hi - p);
+        if (sp >= mem_lo && sp < mem_hi) {
+            info->stack = s_clamp(mem_hi - sp);
+            info->free  = s_clamp(sp - mem_lo);
+        }
+    }
+}
+
+#else /* AVR */
+
+#include <util/atomic.h>
+
+/* avr-libc / linker symbols */
+extern uint8_t __data_start, __data_end, __bss_start, __bss_end, __heap_start;
+extern char * __brkval;
+
+/* Paint __heap_start .. RAMEND (__stack) at reset, before .data and .bss
+ * are set up (.init4), so it can not rely on r1 or the C runtime. */
+void mem_paint(void) __attribute__((naked, used, section(".init1")));
+void mem_paint(void) {
+    __asm__ __volatile__ (
+        "    ldi r30, lo8(__heap_start)\n"
+        "    ldi r31, hi8(__heap_start)\n"
+        "    ldi r24, %0\n"
+        "    ldi r25, hi8(__stack)\n"
+        "    rjmp 2f\n"
+        "1:  st Z+, r24\n"
+        "2:  cpi r30, lo8(__stack)\n"
+        "    cpc r31, r25\n"
+        "    brlo 1b\n"
+        "    breq 1b\n"
+        :: "M" (MEM_PAINT));
+}
+
+// bottom of the free RAM, above the heap
+static uint8_t * s_low(void) {
+    return __brkval ? (uint8_t *)__brkval : &__heap_start;
+}
+
+void mem_init(void) {
+}
+
+/* bytes per run of the bulk paint, SP and the heap end are read
+ * again between runs */
+#define MEM_PAINT_CHUNK 256
+
+void mem_reset(void) {
+    uint8_t * p = s_low();
+    uint8_t * end;
+    uint8_t * top;
+    /* interrupts on: an ISR frame is never deeper than MEM_GUARD */
+    for (;;) {
+        top = (uint8_t *)SP - MEM_GUARD;
+        if (p < s_low())
+            p = s_low();
+        if (p >= top)
+            break;
+        end = (top - p > MEM_PAINT_CHUNK) ? p + MEM_PAINT_CHUNK : top;
+        while (p < end) {
+            *p++ = MEM_PAINT;
+        }
+    }
+    /* next to SP: interrupts off, no ISR frame is there */
+    ATOMIC_BLOCK(ATOMIC_RESTORESTATE) {
+        for ( ; p < (uint8_t *)SP ; ++p ) {
+            *p = MEM_PAINT;
+        }
+    }
+}
+
+void mem_get(mem_info_t * info) {
+    uint8_t * low;
+    uint8_t * sp;
+    uint8_t * p;
+    if (!info)
+        return;
+    low = s_low();
+    sp  = (uint8_t *)SP;
+    info->data = (uint16_t)(&__data_end - &__data_start);
+    info->bss  = (uint16_t)(&__bss_end - &__bss_start);
+    info->heap = (uint16_t)(low - &__heap_start);
+    // SP points at the next free byte
+    info->stack = (uint16_t)((uint8_t *)RAMEND - sp);
+    info->free  = (sp >= low) ? (uint16_t)(sp - low + 1) : 0;
+    for ( p = low ; p <= sp && *p == MEM_PAINT ; ++p )
+        ;
+    info->free_min  = (uint16_t)(p - low);
+    info->stack_max = (uint16_t)((uint8_t *)RAMEND + 1 - p);
+}
+
+#endif /* EMULATE_LIB */
@@ -0,0 +1,77 @@
+/****************************************************************************
+ * libmem.h
+ * RAM usage: stack high-water mark, heap and static footprint.
+ *
+ * Version 1.0
+ *
+ * The free RAM between the heap (or the end of .bss) and the stack is
+ * painted with MEM_PAINT before main() runs. Whatever the stack or heap
+ * has written over since can be measured, so mem_get() reports the
+ * deepest stack seen, not only the current depth. Linking libmem.c is
+ * all it takes, the painting runs from the .init1 section.
+ *
+ * The static footprint per module (.data and .bss of each object) is a
+ * link time figure, see 'make ramuse' in the application Makefile.
+ *
+ *  AVR Target  : SRAM from __heap_start (__brkval once malloc() has run)
+ *                to RAMEND. .data/.bss come from the linker symbols.
+ *  EMULATE_LIB : mem_init() paints MEM_EMU_STACK bytes of the host stack
+ *                below its caller, stack figures are relative to that
+ *                caller. .data/.bss are those of the host program.
+ *
+ * OPTIONAL DEFINITIONS
+ *
+ *  MEM_EMU_STACK (16384)   Linux builds, bytes of host stack painted.
+ *  MEM_GUARD (128)         AVR, mem_reset(): bytes below the stack
+ *                          pointer painted with interrupts off. Must
+ *                          cover the deepest ISR stack use (nested
+ *                          ISRs included), the rest is painted with
+ *                          interrupts on.
+ *
+ ***************************************************************************/
+
+#ifndef _LIBMEM_H_
+#define _LIBMEM_H_
+
+#include "avrlib.h"
+
+#define MEM_PAINT       0xc5
+
+#ifndef MEM_EMU_STACK
+#define MEM_EMU_STACK   16384
+#endif
+
+#ifndef MEM_GUARD
+#define MEM_GUARD       128
+#endif
+
+/* RAM usage, in bytes */
+typedef struct mem_info_type {
+    uint16_t data;          /* .data, initialized statics */
+    uint16_t bss;           /* .bss, zeroed statics */
+    uint16_t heap;          /* malloc() arena in use */
+    uint16_t stack;         /* current stack depth */
+    uint16_t stack_max;     /* deepest stack since the painting */
+    uint16_t free;          /* now, between heap and stack */
+    uint16_t free_min;      /* never touched, the margin left */
+} mem_info_t;
+
+/* Set up the measurement ----------------------------------------------
+ * -
+ * AVR Target: nothing to do, the RAM was painted at reset. Linux builds:
+ * paints the emulated stack region, call it early in main().
+ */
+void mem_init(void);
+
+/* Read the RAM usage -------------------------------------------------*/
+void mem_get(mem_info_t * info);
+
+/* Restart the high-water mark ----------------------------------------
+ * -
+ * Repaints the free RAM below the current stack pointer. AVR: the
+ * bulk in short runs with interrupts on, only the MEM_GUARD bytes next
+ * to the stack pointer with interrupts off.
+ */
+void mem_reset(void);
+
+#endif /* _LIBMEM_H_ */
@@ -0,0 +1,173 @@
+/****************************************************************************
+ * libprof.c
+ * Cycle profiling probes.
+ *
+ * Version 1.0
+ *
+ * See libprof.h
+ *
+ ***************************************************************************/
+
+#include "libprof.h"
+
+#ifdef EMULATE_LIB
+ #include <time.h>
+#else
+ #include <avr/io.h>
+ #include <avr/interrupt.h>
+ #include <util/atomic.h>
+#endif
+
+typedef struct prof_probe_type {
+    uint32_t    start;
+    uint8_t     active;
+    prof_stat_t st;
+} prof_probe_t;
+
+static prof_probe_t prof_tab[PROF_MAX_PROBES];
+static uint32_t     prof_overhead = 0;
+static uint8_t      prof_running = 0;
+
+#ifdef EMULATE_LIB
+
+/* Profiling clock - CLOCK_MONOTONIC, ns ----------------------------*/
+
+static void s_clock_init(void) {
+}
+
+static uint32_t s_now(void) {
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return (uint32_t)((uint64_t)ts.tv_sec * 1000000000ULL + (uint64_t)ts.tv_nsec);
+}
+
+uint16_t prof_ticks_per_us(void) {
+    return 1000;
+}
+
+#else
+
+/* Profiling clock - Timer1, normal mode, clk/1 ---------------------*/
+
+static volatile uint16_t prof_ovf = 0;
+
+ISR(TIMER1_OVF_vect)
+{
+    prof_ovf++;
+}
+
+static void s_clock_init(void) {
+    TCCR1B = 0;                         /* stop while configuring */
+    TCCR1A = 0;                         /* normal mode, TOP = 0xffff */
+    TCNT1  = 0;
+    TIFR1  = _BV(TOV1);
+    TIMSK1 |= _BV(TOIE1);
+    TCCR1B = _BV(CS10);                 /* clk/1, start */
+}
+
+static uint32_t s_now(void) {
+    uint16_t hi, lo;
+    ATOMIC_BLOCK(ATOMIC_RESTORESTATE) {
+        lo = TCNT1;
+        hi = prof_ovf;
+        /* counter wrapped, overflow interrupt still pending */
+        if ((TIFR1 & _BV(TOV1)) && lo < 0x8000) {
+            hi++;
+        }
+    }
+    return ((uint32_t)hi << 16) | lo;
+}
+
+uint16_t prof_ticks_per_us(void) {
+    return (uint16_t)(F_CPU / 1000000UL);
+}
+
+#endif /* EMULATE_LIB */
+
+
+void prof_begin(uint8_t id) {
+    if (id < PROF_MAX_PROBES) {
+        prof_tab[id].active = 1;
+        prof_tab[id].start  = s_now();
+    }
+}
+
+void prof_end(uint8_t id) {
+    uint32_t t = s_now();
+    prof_stat_t * st;
+    if (id < PROF_MAX_PROBES && prof_tab[id].active) {
+        prof_tab[id].active = 0;
+        st = &prof_tab[id].st;
+        t -= prof_tab[id].start;
+        t = (t > prof_overhead) ? t - prof_overhead : 0;
+        if (st->count == 0 || t < st->min) {
+            st->min = t;
+        }
+        if (t > st->max) {
+            st->max = t;
+        }
+        st->total = (st->total + t < st->total) ? 0xffffffffUL : st->total + t;
+        st->count++;
+    }
+}
+
+void prof_reset(void) {
+    uint8_t i;
+    for ( i = 0 ; i < PROF_MAX_PROBES ; ++i ) {
+#ifndef EMULATE_LIB
+        ATOMIC_BLOCK(ATOMIC_RESTORESTATE)
+#endif
+        {
+            prof_tab[i].active   = 0;
+            prof_tab[i].st.count = 0;
+            prof_tab[i].st.min   = 0;
+            prof_tab[i].st.max   = 0;
+            prof_tab[i].st.total = 0;
+        }
+    }
+}
+
+void prof_init(void) {
+    uint8_t i;
+    uint32_t best = 0xffffffffUL;
+    if (!prof_running) {
+        prof_running = 1;
+        s_clock_init();
+    }
+    /* cost of an empty probe, best of a few */
+    prof_overhead = 0;
+    for ( i = 0 ; i < 8 ; ++i ) {
+        prof_reset();
+        prof_begin(0);
+        prof_end(0);
+        if (prof_tab[0].st.min < best) {
+            best = prof_tab[0].st.min;
+        }
+    }
+    prof_overhead = best;
+    prof_reset();
+}
+
+int prof_name(uint8_t id, const char * name) {
+    int rc = PROF_ERROR;
+    if (id < PROF_MAX_PROBES) {
+        prof_tab[id].st.name = name;
+        rc = PROF_SUCCESS;
+    }
+    return rc;
+}
+
+int prof_get(uint8_t id, prof_stat_t * stat) {
+    int rc = PROF_ERROR;
+    if (id < PROF_MAX_PROBES && stat) {
+#ifdef EMULATE_LIB
+        *stat = prof_tab[id].st;
+#else
+        ATOMIC_BLOCK(ATOMIC_RESTORESTATE) {
+            *stat = prof_tab[id].st;
+        }
+#endif
+        rc = PROF_SUCCESS;
+    }
+    return rc;
+}
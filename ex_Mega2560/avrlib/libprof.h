@@ -0,0 +1,106 @@
+/****************************************************************************
+ * libprof.h
+ * Cycle profiling probes.
+ *
+ * Version 1.0
+ *
+ * A probe measures the time between PROF_BEGIN(id) and PROF_END(id) and
+ * keeps count, min, max and total in a static table. Probes can be put
+ * in ISRs and in the mainline, each probe id must only be used from one
+ * of them. Probes nest, an inner probe's time is included in the outer.
+ *
+ *      PROF_BEGIN(PROF_PARSER);
+ *      ...
+ *      PROF_END(PROF_PARSER);
+ *
+ * TICKS
+ *  AVR Target  : CPU cycles. Timer1 runs free at clk/1 and is reserved
+ *                by this library, the overflow interrupt extends it to
+ *                32 bits (wraps after 268 s at 16 MHz). The application
+ *                enables interrupts, prof_init() does not.
+ *  EMULATE_LIB : nanoseconds, CLOCK_MONOTONIC.
+ *  The cost of an empty BEGIN/END pair is measured in prof_init() and
+ *  taken off every sample.
+ *
+ * OPTIONAL DEFINITIONS
+ *
+ *  PROF_ENABLE          Probes are compiled in. Without it PROF_BEGIN
+ *                       and PROF_END are empty and libprof.c need not
+ *                       be linked.
+ *  PROF_MAX_PROBES (8)  Size of the probe table.
+ *
+ ***************************************************************************/
+
+#ifndef _LIBPROF_H_
+#define _LIBPROF_H_
+
+#include "avrlib.h"
+
+#define PROF_SUCCESS    0
+#define PROF_ERROR      (-1)
+
+#ifndef PROF_MAX_PROBES
+#define PROF_MAX_PROBES 8
+#endif
+
+/* avrlib probes, applications number theirs from PROF_USER */
+#define PROF_UART_RX    0       /* serial Rx complete ISR */
+#define PROF_UART_TX    1       /* serial data register empty ISR */
+#define PROF_PARSER     2       /* pollParser() pass */
+#define PROF_USER       3
+
+#ifdef PROF_ENABLE
+ #define PROF_BEGIN(id)     prof_begin(id)
+ #define PROF_END(id)       prof_end(id)
+#else
+ #define PROF_BEGIN(id)
+ #define PROF_END(id)
+#endif
+
+/* Probe statistics, in ticks */
+typedef struct prof_stat_type {
+    const char * name;      /* NULL := unnamed */
+    uint32_t     count;
+    uint32_t     min;
+    uint32_t     max;
+    uint32_t     total;     /* saturates */
+} prof_stat_t;
+
+/* Start the profiling clock ------------------------------------------
+ * -
+ * Clears the table and measures the probe overhead. Safe to call more
+ * than once, the clock is only set up the first time.
+ */
+void prof_init(void);
+
+/* Probe start / stop, use the PROF_BEGIN / PROF_END macros -----------
+ * -
+ * Out of range ids are ignored. An END without a BEGIN is ignored.
+ */
+void prof_begin(uint8_t id);
+void prof_end(uint8_t id);
+
+/* Name a probe, for reports -----------------------------------------
+ * -
+ * Arguments:   id      probe id
+ *              name    static string, eg. "bus"
+ * Returns:     PROF_ERROR, PROF_SUCCESS
+ */
+int prof_name(uint8_t id, const char * name);
+
+/* Read a probe ------------------------------------------------------
+ * -
+ * Arguments:   id      probe id
+ *              stat    copy of the probe statistics, min is 0 while
+ *                      count is 0
+ * Returns:     PROF_ERROR, PROF_SUCCESS
+ */
+int prof_get(uint8_t id, prof_stat_t * stat);
+
+/* Clear all probe statistics, names are kept ------------------------*/
+void prof_reset(void);
+
+/* Ticks per microsecond, to convert reported figures ----------------*/
+uint16_t prof_ticks_per_us(void);
+
+#endif /* _LIBPROF_H_ */
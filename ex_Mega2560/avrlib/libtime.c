@@ -1,38 +1,352 @@
 /****************************************************************************
  * libtime.c
  * API for time-based operations.
- * 
- * Version 1.0
+ *
+ * Version 1.2
  *
  * DO NOT CALL NATIVE AVR C functions from eg. time.h. Use this API
  * to get an adaptation layer and additional custom functions. This API
  * can be emulated in Linux.
- * 
+ *
  * OPTIONAL DEFINITIONS
  *
  *  EMULATE_LIB          If defined then the underlying OS time functions
  *                       are moved to Linux OS based ones, used for target
  *                       emulation
- * 
+ *  TM_EMU_VIRTUAL       (EMULATE_LIB) start in virtual time mode
+ *
  ***************************************************************************/
 
+#include "libtime.h"
+#include "libtrace.h"
 
 #ifdef EMULATE_LIB
+ #include <unistd.h>
+ #include <time.h>
+#else
+ #include <avr/io.h>
+ #include <avr/interrupt.h>
+ #include <util/atomic.h>
+ #include <util/delay_basic.h>
+#endif
 
-#include <unistd.h>
-#include "libtime.h"
+static uint8_t tm_running = 0;
+
+/* Software timer table, fn == NULL : free */
+typedef struct tm_timer_type {
+    uint32_t    due;        /* tm_millis() time of the next call */
+    uint32_t    period;     /* 0 := one-shot */
+    tm_timer_fn fn;
+    void *      ctx;
+} tm_timer_t;
+
+static tm_timer_t tm_timers[TM_MAX_TIMERS];
+
+
+/* Timer0 clk/64, also the raw tick count unit in emulation */
+#define TM_T0_PRESCALE  64UL
+
+uint32_t tm_ticks_us(uint32_t ticks) {
+    return (ticks >> 8) * 1000UL + ((ticks & 0xff) * TM_T0_PRESCALE) / (TM_F_CPU / 1000000UL);
+}
+
+#ifdef EMULATE_LIB
+
+static uint64_t emu_ns = 0;   /* emulated target time */
+static struct timespec tm_base;
+#ifdef TM_EMU_VIRTUAL
+static uint8_t emu_virtual = 1;
+#else
+static uint8_t emu_virtual = 0;
+#endif
 
 /* --------------------------------------------------------------------
  * tm_delay_ms()
- * Perform a blocking delay for a specific amount of time, in 
- * milliseconds. The delay is a non-negative integer time and not a
- * floating point value (as used in the AVR native delay).
+ * Perform a blocking delay for a specific amount of time, in
+ * milliseconds.
+ * ------------------------------------------------------------------*/
+void tm_delay_ms(uint16_t ms) {
+    emu_ns += (uint64_t)ms * 1000000ULL;
+    if (!emu_virtual) {
+        usleep((useconds_t)ms * 1000);
+    }
+}
+
+/* --------------------------------------------------------------------
+ * tm_delay_us()
+ * Perform a blocking delay for a specific amount of time, in
+ * microseconds.
+ * ------------------------------------------------------------------*/
+void tm_delay_us(uint16_t us) {
+    emu_ns += (uint64_t)us * 1000ULL;
+    if (!emu_virtual) {
+        usleep((useconds_t)us);
+    }
+}
+
+/* --------------------------------------------------------------------
+ * tm_delay_cycles()
+ * Target time only, at TM_F_CPU: a cycle delay is far below the host's
+ * sleep resolution.
+ * ------------------------------------------------------------------*/
+void tm_delay_cycles(uint32_t cycles) {
+    emu_ns += ((uint64_t)cycles * 1000000000ULL) / TM_F_CPU;
+}
+
+/* --------------------------------------------------------------------
+ * tm_emu_ns()
+ * Emulated target time, in nanoseconds since start-up.
+ * ------------------------------------------------------------------*/
+uint64_t tm_emu_ns(void) {
+    return emu_ns;
+}
+
+void tm_emu_advance(uint64_t ns) {
+    emu_ns += ns;
+}
+
+void tm_emu_virtual(uint8_t enable) {
+    emu_virtual = enable ? 1 : 0;
+}
+
+uint8_t tm_emu_isVirtual(void) {
+    return emu_virtual;
+}
+
+/* System Tick - CLOCK_MONOTONIC, or tm_emu_ns() in virtual time ----*/
+
+void tm_init(void) {
+    if (!tm_running) {
+        clock_gettime(CLOCK_MONOTONIC, &tm_base);
+        tm_running = 1;
+    }
+}
+
+static uint64_t s_elapsed_us(void) {
+    struct timespec ts;
+    if (!tm_running) {
+        tm_init();
+    }
+    if (emu_virtual) {
+        return emu_ns / 1000;
+    }
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return (uint64_t)(((int64_t)(ts.tv_sec - tm_base.tv_sec) * 1000000000LL
+         + ((int64_t)ts.tv_nsec - (int64_t)tm_base.tv_nsec)) / 1000);
+}
+
+uint32_t tm_millis(void) {
+    return (uint32_t)(s_elapsed_us() / 1000);
+}
+
+uint32_t tm_micros(void) {
+    return (uint32_t)s_elapsed_us();
+}
+
+uint32_t tm_ticks_raw(void) {
+    uint64_t us;
+    if (!tm_running) {
+        return 0;
+    }
+    us = s_elapsed_us();
+    return ((uint32_t)(us / 1000) << 8) |
+        (uint32_t)(((us % 1000) * (TM_F_CPU / 1000000UL)) / TM_T0_PRESCALE);
+}
+
+#else
+
+/* System Tick - Timer0, CTC mode, clk/64 ---------------------------*/
+#define TM_T0_TOP       ((uint8_t)((F_CPU / TM_T0_PRESCALE / 1000UL) - 1))  /* 249 @ 16 MHz */
+
+static volatile uint32_t tm_ms = 0;
+
+ISR(TIMER0_COMPA_vect)
+{
+    tm_ms++;
+}
+
+void tm_init(void) {
+    if (!tm_running) {
+        tm_running = 1;
+        TCCR0B = 0;                         /* stop while configuring */
+        TCCR0A = _BV(WGM01);                /* CTC, TOP = OCR0A */
+        OCR0A  = TM_T0_TOP;
+        TCNT0  = 0;
+        TIFR0  = _BV(OCF0A);
+        TIMSK0 |= _BV(OCIE0A);
+        TCCR0B = _BV(CS01) | _BV(CS00);     /* clk/64, start */
+    }
+}
+
+uint32_t tm_millis(void) {
+    uint32_t ms;
+    if (!tm_running) {
+        tm_init();
+    }
+    ATOMIC_BLOCK(ATOMIC_RESTORESTATE) {
+        ms = tm_ms;
+    }
+    return ms;
+}
+
+uint32_t tm_micros(void) {
+    uint32_t ms;
+    uint8_t cnt;
+    if (!tm_running) {
+        tm_init();
+    }
+    ATOMIC_BLOCK(ATOMIC_RESTORESTATE) {
+        ms  = tm_ms;
+        cnt = TCNT0;
+        /* counter wrapped, tick interrupt still pending */
+        if ((TIFR0 & _BV(OCF0A)) && cnt < TM_T0_TOP) {
+            ms++;
+        }
+    }
+    return ms * 1000UL + ((uint32_t)cnt * TM_T0_PRESCALE) / (F_CPU / 1000000UL);
+}
+
+/* no lock: the caller has interrupts off */
+uint32_t tm_ticks_raw(void) {
+    uint32_t ms;
+    uint8_t cnt;
+    if (!tm_running) {
+        return 0;
+    }
+    ms  = tm_ms;
+    cnt = TCNT0;
+    if ((TIFR0 & _BV(OCF0A)) && cnt < TM_T0_TOP) {
+        ms++;
+    }
+    return (ms << 8) | cnt;
+}
+
+/* Delays, runtime argument ------------------------------------------
+ * Constant arguments never get here, see libtime.h.
+ * _delay_loop_2() is 4 cycles per count, the few cycles of call and
+ * setup are taken off the count.
  * ------------------------------------------------------------------*/
-void tm_delay_ms(double delay) {
-    useconds_t udelay = (useconds_t)(delay * 1000.0);
-    usleep(udelay);
+#define TM_LOOP_CYCLES      4UL
+#define TM_LOOP_OVERHEAD    12UL    /* call, return, argument setup */
+
+void tm_delay_cycles_rt(uint32_t cycles) {
+    if (cycles <= TM_LOOP_OVERHEAD + TM_LOOP_CYCLES) {
+        return;
+    }
+    cycles = (cycles - TM_LOOP_OVERHEAD) / TM_LOOP_CYCLES;
+    while (cycles > 0xffffUL) {
+        _delay_loop_2(0);           /* 65536 counts */
+        cycles -= 0x10000UL;
+    }
+    if (cycles) {
+        _delay_loop_2((uint16_t)cycles);
+    }
+}
+
+void tm_delay_us_rt(uint16_t us) {
+    tm_delay_cycles_rt(TM_US_CYCLES(us));
+}
+
+void tm_delay_ms_rt(uint16_t ms) {
+    while (ms--) {
+        /* one count less per ms for the outer loop */
+        _delay_loop_2((uint16_t)(TM_US_CYCLES(1000UL) / TM_LOOP_CYCLES - 1));
+    }
 }
 
 #endif /* EMULATE_LIB */
 
 
+/* Deadlines --------------------------------------------------------*/
+
+uint32_t tm_deadline_ms(uint32_t ms) {
+    return tm_millis() + ms;
+}
+
+uint8_t tm_expired(uint32_t deadline) {
+    return ((int32_t)(tm_millis() - deadline) >= 0);
+}
+
+uint32_t tm_deadline_us(uint32_t us) {
+    return tm_micros() + us;
+}
+
+uint8_t tm_expired_us(uint32_t deadline) {
+    return ((int32_t)(tm_micros() - deadline) >= 0);
+}
+
+/* Software Timers --------------------------------------------------*/
+
+int tm_timer_start(uint32_t ms, uint8_t mode, tm_timer_fn fn, void * ctx) {
+    int rc = TM_ERROR;
+    uint8_t i;
+    if (!fn || (mode == TM_PERIODIC && ms == 0)) {
+        return rc;
+    }
+    for ( i = 0 ; i < TM_MAX_TIMERS ; ++i ) {
+        if (tm_timers[i].fn == NULL) {
+            tm_timers[i].due    = tm_deadline_ms(ms);
+            tm_timers[i].period = (mode == TM_PERIODIC) ? ms : 0;
+            tm_timers[i].ctx    = ctx;
+            tm_timers[i].fn     = fn;
+            rc = (int)i + 1;
+            break;
+        }
+    }
+    return rc;
+}
+
+int tm_timer_stop(int hndl) {
+    int rc = TM_ERROR;
+    if (hndl > 0 && hndl <= TM_MAX_TIMERS && tm_timers[hndl-1].fn) {
+        tm_timers[hndl-1].fn = NULL;
+        rc = TM_SUCCESS;
+    }
+    return rc;
+}
+
+int tm_timer_poll(void) {
+    int rc = 0;
+    uint8_t i;
+    uint32_t now = tm_millis();
+    tm_timer_t * t;
+    tm_timer_fn fn;
+    void * ctx;
+    for ( i = 0 ; i < TM_MAX_TIMERS ; ++i ) {
+        t = &tm_timers[i];
+        if (t->fn == NULL || (int32_t)(now - t->due) < 0) {
+            continue;
+        }
+        fn  = t->fn;
+        ctx = t->ctx;
+        if (t->period) {
+            t->due += t->period;
+            if ((int32_t)(now - t->due) >= 0) {
+                t->due = now + t->period;   /* fell behind, drop calls */
+            }
+        } else {
+            t->fn = NULL;
+        }
+        TRACE(TRACE_TIMER, i + 1);
+        fn(ctx);
+        rc++;
+    }
+    return rc;
+}
+
+void tm_idle(void) {
+#ifdef EMULATE_LIB
+    uint8_t i;
+    uint32_t now = tm_millis();
+    for ( i = 0 ; i < TM_MAX_TIMERS ; ++i ) {
+        if (tm_timers[i].fn && (int32_t)(now - tm_timers[i].due) >= 0) {
+            return;     /* a timer is due, don't sleep */
+        }
+    }
+    if (emu_virtual) {
+        emu_ns += 1000000;
+    } else {
+        usleep(1000);
+    }
+#endif
+}
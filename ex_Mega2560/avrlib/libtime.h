@@ -2,48 +2,244 @@
  * libtime.h
  * API for time-based operations.
  * 
- * Version 1.0
+ * Version 1.2
  *
  * DO NOT CALL NATIVE AVR C functions from eg. time.h. Use this API
  * to get an adaptation layer and additional custom functions. This API
  * can be emulated in Linux.
  * 
+ * SYSTEM TICK
+ *  AVR Target  : Timer0 in CTC mode, 1 ms interrupt. Timer0 is reserved
+ *                by this library. Needs F_CPU, the tick is exact when
+ *                F_CPU is a multiple of 64 kHz (eg. 16 MHz).
+ *  EMULATE_LIB : CLOCK_MONOTONIC, or in virtual time tm_emu_ns().
+ *  The tick starts on tm_init() or on the first tm_millis()/tm_micros()
+ *  call. Both counters wrap, use tm_expired*() to compare times.
+ *
+ * SOFTWARE TIMERS
+ *  A small table of one-shot and periodic timers. Callbacks are not
+ *  run from the interrupt, they run from tm_timer_poll() which the
+ *  application calls from its main loop:
+ *
+ *      tm_timer_start(20, TM_PERIODIC, scan_panel, NULL);
+ *      while (1) {
+ *          poll_serial();          (no blocking delays)
+ *          tm_timer_poll();
+ *          tm_idle();
+ *      }
+ *
  * OPTIONAL DEFINITIONS
  *
  *  EMULATE_LIB          If defined then the underlying OS time functions
  *                       are moved to Linux OS based ones, used for target
- *                       emulation. libtime.c *must* be in the compile order.
- *                       AVR Targets : libtime.c is not required.
+ *                       emulation.
+ *  TM_EMU_VIRTUAL       (EMULATE_LIB) Start in virtual time mode, see
+ *                       tm_emu_virtual().
+ *  TM_MAX_TIMERS (8)    Size of the software timer table.
+ *
+ *  libtime.c *must* be in the compile order (AVR target and emulation).
+ *  Exception: AVR target code that only uses constant delays.
  * 
  ***************************************************************************/
 
 #ifndef _LIBTIME_H_
 #define _LIBTIME_H_
 
+#include "avrlib.h"
+
+#define TM_SUCCESS      0
+#define TM_ERROR        (-1)
+
+#define TM_ONESHOT      0
+#define TM_PERIODIC     1
+
+#ifndef TM_MAX_TIMERS
+#define TM_MAX_TIMERS   8
+#endif
+
+/* Software timer callback, 'ctx' as given to tm_timer_start() */
+typedef void (*tm_timer_fn)(void * ctx);
+
+/* Start the System Tick ---------------------------------------------
+ * -
+ * Start the 1 ms tick. Interrupts are not enabled here, the
+ * application enables them (sei()) once its drivers are set up, the
+ * tick counts from then on. Called automatically by the first
+ * tm_millis() / tm_micros(), call it early to start the clock at a
+ * known point. Repeated calls do nothing.
+ * ------------------------------------------------------------------*/
+void tm_init(void);
+
+/* Time Since Start-up -----------------------------------------------
+ * -
+ * tm_millis()      Returns: milliseconds, wraps after ~49 days
+ * tm_micros()      Returns: microseconds, wraps after ~71 minutes.
+ *                  Target resolution is one Timer0 count (4 us at 16 MHz).
+ * ------------------------------------------------------------------*/
+uint32_t tm_millis(void);
+uint32_t tm_micros(void);
+
+/* Raw Tick, for Time Stamps -----------------------------------------
+ * -
+ * tm_ticks_raw()   Returns: (ms << 8) | Timer0 count, ms modulo 2^24
+ *                  (wraps after ~4.6 hours). 0 while the tick is not
+ *                  started, it does not start it.
+ * tm_ticks_us(t)   Returns: a raw tick in microseconds, as tm_micros()
+ *                  (wraps after ~71 minutes).
+ * tm_ticks_raw() is a few loads and no lock or multiply: call it with
+ * interrupts off (an ISR, an ATOMIC_BLOCK) for a consistent reading,
+ * convert later outside of the critical section.
+ * EMULATE_LIB: the count is the one Timer0 would have at TM_F_CPU.
+ * ------------------------------------------------------------------*/
+uint32_t tm_ticks_raw(void);
+uint32_t tm_ticks_us(uint32_t ticks);
+
+/* Deadlines ---------------------------------------------------------
+ * -
+ * tm_deadline_ms(ms)   Returns: the tm_millis() time 'ms' from now
+ * tm_expired(dl)       Returns: (True) tm_millis() has reached 'dl'
+ * tm_deadline_us(us)   as above, tm_micros() time
+ * tm_expired_us(dl)
+ * Valid for deadlines up to half the counter range ahead.
+ * ------------------------------------------------------------------*/
+uint32_t tm_deadline_ms(uint32_t ms);
+uint8_t tm_expired(uint32_t deadline);
+uint32_t tm_deadline_us(uint32_t us);
+uint8_t tm_expired_us(uint32_t deadline);
+
+/* Start a Software Timer --------------------------------------------
+ * -
+ * Arguments:
+ *  ms          time until the first (or only) call, then the period
+ *  mode        TM_ONESHOT, TM_PERIODIC
+ *  fn          callback, run from tm_timer_poll()
+ *  ctx         passed to the callback
+ * Returns:     timer handle > 0, TM_ERROR if the table is full
+ * -
+ * A one-shot timer is freed after its callback has run. A periodic
+ * timer keeps its phase: a late poll does not shift later calls, but
+ * calls missed by more than a whole period are dropped, not bunched.
+ * ------------------------------------------------------------------*/
+int tm_timer_start(uint32_t ms, uint8_t mode, tm_timer_fn fn, void * ctx);
+
+/* Stop a Software Timer ---------------------------------------------
+ * -
+ * May be called from any timer callback, including the timer's own.
+ * Returns:     TM_SUCCESS, TM_ERROR (not running)
+ * ------------------------------------------------------------------*/
+int tm_timer_stop(int hndl);
+
+/* Run Due Timers ----------------------------------------------------
+ * -
+ * Call from the main loop. Runs the callback of every timer that is
+ * due, in table order.
+ * Returns:     # of callbacks run
+ * ------------------------------------------------------------------*/
+int tm_timer_poll(void);
+
+/* Main Loop Idle ----------------------------------------------------
+ * -
+ * Call at the end of a main loop pass that found nothing to do.
+ * AVR Target  : returns at once.
+ * EMULATE_LIB : sleeps 1 ms unless a software timer is already due,
+ *               so a polling main loop does not spin a host core.
+ *               In virtual time the clock is moved on 1 ms instead.
+ * ------------------------------------------------------------------*/
+void tm_idle(void);
+
+/* Delays ------------------------------------------------------------
+ * -
+ * tm_delay_ms(ms)      blocking delays, integer arguments
+ * tm_delay_us(us)
+ * tm_delay_cycles(n)   blocking delay of 'n' CPU cycles, for bus strobes
+ *                      and other sub-microsecond timing
+ * -
+ * AVR Target  : with a compile-time constant argument each delay is one
+ *               cycle-exact __builtin_avr_delay_cycles() sequence, no
+ *               floating point and no call. A runtime argument calls a
+ *               counted cycle loop in libtime.c (loop overhead is taken
+ *               off, error is a few cycles per call). Constant delays
+ *               need optimization (-Os, -O2), without it every delay
+ *               takes the runtime path.
+ * EMULATE_LIB : delays move tm_emu_ns() forward; ms and us delays also
+ *               sleep unless in virtual time. Cycles are counted at
+ *               TM_F_CPU.
+ * ------------------------------------------------------------------*/
+#ifdef F_CPU
+ #define TM_F_CPU           F_CPU
+#else
+ #define TM_F_CPU           16000000UL      /* emulation: Mega2560 clock */
+#endif
+#define TM_US_CYCLES(us)    ((uint32_t)(TM_F_CPU / 1000000UL) * (uint32_t)(us))
+#define TM_NS_CYCLES(ns)    (((uint32_t)(TM_F_CPU / 1000000UL) * (uint32_t)(ns) + 999UL) / 1000UL)
+
 #ifdef EMULATE_LIB
- #include <stdint.h>
- /* --------------------------------------------------------------------
-  * tm_delay_ms()
-  * Perform a blocking delay for a specific amount of time, in 
-  * milliseconds. The delay is a non-negative integer time and not a
-  * floating point value (as used in the AVR native delay).
-  * ------------------------------------------------------------------*/
- void tm_delay_ms(double delay);
+ void tm_delay_ms(uint16_t ms);
+ void tm_delay_us(uint16_t us);
+ void tm_delay_cycles(uint32_t cycles);
 #else
- #define tm_delay_ms  _delay_ms
- #include <util/delay.h>
+ /* runtime argument versions, libtime.c */
+ void tm_delay_ms_rt(uint16_t ms);
+ void tm_delay_us_rt(uint16_t us);
+ void tm_delay_cycles_rt(uint32_t cycles);
+
+ static inline void tm_delay_cycles(uint32_t cycles) __attribute__((always_inline));
+ static inline void tm_delay_us(uint16_t us) __attribute__((always_inline));
+ static inline void tm_delay_ms(uint16_t ms) __attribute__((always_inline));
+
+ static inline void tm_delay_cycles(uint32_t cycles) {
+ #ifdef __OPTIMIZE__
+    if (__builtin_constant_p(cycles)) {
+        __builtin_avr_delay_cycles(cycles);
+        return;
+    }
+ #endif
+    tm_delay_cycles_rt(cycles);
+ }
+
+ static inline void tm_delay_us(uint16_t us) {
+ #ifdef __OPTIMIZE__
+    if (__builtin_constant_p(us)) {
+        __builtin_avr_delay_cycles(TM_US_CYCLES(us));
+        return;
+    }
+ #endif
+    tm_delay_us_rt(us);
+ }
+
+ static inline void tm_delay_ms(uint16_t ms) {
+ #ifdef __OPTIMIZE__
+    if (__builtin_constant_p(ms)) {
+        __builtin_avr_delay_cycles(TM_US_CYCLES(1000UL) * ms);
+        return;
+    }
+ #endif
+    tm_delay_ms_rt(ms);
+ }
 #endif /* EMULATE_LIB */
 
 #ifdef EMULATE_LIB
  /* --------------------------------------------------------------------
-  * tm_delay_us()
-  * Perform a blocking delay for a specific amount of time, in 
-  * microseconds. The delay is a non-negative integer time and not a
-  * floating point value (as used in the AVR native delay).
+  * tm_emu_ns()
+  * Emulated target time, in nanoseconds since start-up. Only the
+  * tm_delay_*() calls (and tm_emu_advance, tm_idle in virtual time)
+  * move it forward, code in between delays takes no time. Use it to
+  * timestamp emulated I/O.
   * ------------------------------------------------------------------*/
- void tm_delay_us(double delay);
-#else
- #define tm_delay_us  _delay_us
+ uint64_t tm_emu_ns(void);
+ void tm_emu_advance(uint64_t ns);
+
+ /* --------------------------------------------------------------------
+  * tm_emu_virtual()
+  * Virtual time mode on (1) or off (0). In virtual time the delays do
+  * not sleep, they only move tm_emu_ns() forward, and tm_millis() /
+  * tm_micros() follow tm_emu_ns() instead of the host clock. Code under
+  * test then runs as fast as the host allows and its timing is exactly
+  * reproducible. Select the mode before the first use of the tick.
+  * Default: off, on when built with TM_EMU_VIRTUAL.
+  * ------------------------------------------------------------------*/
+ void tm_emu_virtual(uint8_t enable);
+ uint8_t tm_emu_isVirtual(void);
 #endif /* EMULATE_LIB */
 
 #endif /* _LIBTIME_H_ */
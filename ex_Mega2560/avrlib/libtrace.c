@@ -0,0 +1,125 @@
+/****************************************************************************
+ * libtrace.c
+ * Binary event trace ring.
+ *
+ * Version 1.0
+ *
+ * See libtrace.h
+ *
+ ***************************************************************************/
+
+#include "libtrace.h"
+#include "libtime.h"
+#include "chardev.h"
+
+#ifdef EMULATE_LIB
+ #define TRACE_ATOMIC
+#else
+ #include <util/atomic.h>
+ #define TRACE_ATOMIC   ATOMIC_BLOCK(ATOMIC_RESTORESTATE)
+#endif
+
+#define TRACE_MASK      (TRACE_LEN - 1)
+
+#if (TRACE_LEN & TRACE_MASK) != 0
+ #error "TRACE_LEN must be a power of 2"
+#endif
+
+static trace_evt_t       tr_ring[TRACE_LEN];
+static volatile uint16_t tr_head = 0;      /* next write */
+static volatile uint16_t tr_used = 0;
+static volatile uint16_t tr_lost = 0;
+
+void trace_put(uint16_t id, uint16_t arg) {
+    trace_evt_t * e;
+    TRACE_ATOMIC {
+        e = &tr_ring[tr_head];
+        e->time = tm_ticks_raw();   /* to us in trace_get() */
+        e->id   = id;
+        e->arg  = arg;
+        tr_head = (tr_head + 1) & TRACE_MASK;
+        if (tr_used < TRACE_LEN) {
+            tr_used++;
+        } else if (tr_lost < 0xffff) {
+            tr_lost++;      /* overwrote the oldest */
+        }
+    }
+}
+
+uint8_t trace_get(trace_evt_t * evt) {
+    uint8_t rc = 0;
+    if (evt) {
+        TRACE_ATOMIC {
+            if (tr_used) {
+                *evt = tr_ring[(tr_head - tr_used) & TRACE_MASK];
+                tr_used--;
+                rc = 1;
+            }
+        }
+        if (rc) {
+            evt->time = tm_ticks_us(evt->time);
+        }
+    }
+    return rc;
+}
+
+uint16_t trace_count(void) {
+    uint16_t n;
+    TRACE_ATOMIC {
+        n = tr_used;
+    }
+    return n;
+}
+
+uint16_t trace_lost(void) {
+    uint16_t n;
+    TRACE_ATOMIC {
+        n = tr_lost;
+        tr_lost = 0;
+    }
+    return n;
+}
+
+void trace_clear(void) {
+    TRACE_ATOMIC {
+        tr_used = 0;
+        tr_lost = 0;
+    }
+}
+
+void trace_encode(const trace_evt_t * evt, uint8_t * rec) {
+    uint8_t i, x = 0;
+    rec[0] = TRACE_SYNC;
+    rec[1] = (uint8_t)evt->time;
+    rec[2] = (uint8_t)(evt->time >> 8);
+    rec[3] = (uint8_t)(evt->time >> 16);
+    rec[4] = (uint8_t)(evt->time >> 24);
+    rec[5] = (uint8_t)evt->id;
+    rec[6] = (uint8_t)(evt->id >> 8);
+    rec[7] = (uint8_t)evt->arg;
+    rec[8] = (uint8_t)(evt->arg >> 8);
+    for ( i = 1 ; i < TRACE_REC_LEN-1 ; ++i ) {
+        x ^= rec[i];
+    }
+    rec[TRACE_REC_LEN-1] = x;
+}
+
+int trace_flush(int fhnd) {
+    int rc = 0;
+    int room = 0;
+    trace_evt_t evt;
+    uint8_t rec[TRACE_REC_LEN];
+    if (cd_ioctl(fhnd, CMD_TX_PEEK, &room) != DEV_SUCCESS) {
+        return DEV_FAIL;
+    }
+    while (room >= TRACE_REC_LEN && trace_get(&evt)) {
+        trace_encode(&evt, rec);
+        if (cd_write(fhnd, (const char *)rec, TRACE_REC_LEN) != TRACE_REC_LEN) {
+            rc = DEV_FAIL;
+            break;
+        }
+        room -= TRACE_REC_LEN;
+        rc++;
+    }
+    return rc;
+}
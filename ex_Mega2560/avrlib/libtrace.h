@@ -0,0 +1,104 @@
+/****************************************************************************
+ * libtrace.h
+ * Binary event trace ring.
+ *
+ * Version 1.0
+ *
+ * TRACE(id, arg) stores a 16-bit event id, a 16-bit argument and a
+ * time stamp in a static RAM ring. It can be called from ISRs and the
+ * mainline, it does not block and does no I/O. The ring keeps the raw
+ * tick (tm_ticks_raw(), no lock, no multiply), trace_get() converts it
+ * to microseconds. Events before tm_init() are stamped 0. When the
+ * ring is full the oldest event is overwritten and counted as lost, so
+ * the ring always holds the latest history.
+ *
+ * The ring is drained by the application, either lazily from the main
+ * loop into a spare serial port with trace_flush() (binary records), or
+ * on demand, eg. a monitor command reading trace_get(). tracedec (see
+ * ../tools) turns the records into a timeline.
+ *
+ * RECORD FORMAT (trace_encode, TRACE_REC_LEN bytes)
+ *
+ *  [0]     TRACE_SYNC (0x7e)
+ *  [1..4]  time, us, little endian
+ *  [5..6]  event id, little endian
+ *  [7..8]  argument, little endian
+ *  [9]     XOR of bytes [1..8]
+ *
+ * OPTIONAL DEFINITIONS
+ *
+ *  TRACE_ENABLE         TRACE() is compiled in. Without it TRACE() is
+ *                       empty and libtrace.c need not be linked.
+ *  TRACE_LEN (64)       Ring size in events, a power of 2. 8 bytes each.
+ *
+ *  libtime.c must be linked, for the time stamps.
+ *
+ ***************************************************************************/
+
+#ifndef _LIBTRACE_H_
+#define _LIBTRACE_H_
+
+#include "avrlib.h"
+
+#ifndef TRACE_LEN
+#define TRACE_LEN       64
+#endif
+
+#define TRACE_REC_LEN   10
+#define TRACE_SYNC      0x7e
+
+/* avrlib events, applications number theirs from TRACE_USER */
+#define TRACE_CMD_BEGIN 0x0001  /* cmdparser: command called, arg = list index */
+#define TRACE_CMD_END   0x0002  /* cmdparser: command returned, arg = rc */
+#define TRACE_UART_OVF  0x0003  /* serial Rx byte lost, arg = minor */
+#define TRACE_TIMER     0x0004  /* libtime timer callback, arg = handle */
+#define TRACE_USER      0x0100
+
+#ifdef TRACE_ENABLE
+ #define TRACE(id, arg)     trace_put((id), (uint16_t)(arg))
+#else
+ #define TRACE(id, arg)
+#endif
+
+typedef struct trace_evt_type {
+    uint32_t time;      /* us, as tm_micros() (raw tick in the ring) */
+    uint16_t id;
+    uint16_t arg;
+} trace_evt_t;
+
+/* Store an event, use the TRACE macro -------------------------------*/
+void trace_put(uint16_t id, uint16_t arg);
+
+/* Take the oldest event ---------------------------------------------
+ * -
+ * Arguments:   evt     event copy
+ * Returns:     1 if an event was taken, 0 if the ring is empty
+ */
+uint8_t trace_get(trace_evt_t * evt);
+
+/* Events waiting in the ring ----------------------------------------*/
+uint16_t trace_count(void);
+
+/* Events overwritten since the last call, the count is cleared ------*/
+uint16_t trace_lost(void);
+
+/* Empty the ring ----------------------------------------------------*/
+void trace_clear(void);
+
+/* Encode an event as a binary record --------------------------------
+ * -
+ * Arguments:   evt     event
+ *              rec     TRACE_REC_LEN bytes
+ */
+void trace_encode(const trace_evt_t * evt, uint8_t * rec);
+
+/* Move events to an open character device ---------------------------
+ * -
+ * Writes whole binary records while the device's Tx buffer has room
+ * (CMD_TX_PEEK), never blocks. Call from the main loop.
+ * Arguments:   fhnd    chardev file handle, eg. a spare UART
+ * Returns:     records written, DEV_FAIL on a device error
+ */
+int trace_flush(int fhnd);
+
+#endif /* _LIBTRACE_H_ */
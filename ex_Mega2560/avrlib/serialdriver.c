@@ -43,12 +43,19 @@
  *   strings are just printed to stdout0 and input can be manually 
  *   inserted into the minor devices Rx buffer (minor-1) by the 
  *   enabled function minor_emu1_push(const char * buf, int len)
+ *   With TDD_PRINTF the interrupt control stubs trace to stdout.
+ *   uart_emu1_set_isr() installs a function that is called wherever
+ *   the target would enable the Rx or Tx interrupt, standing in for the
+ *   ISRs. It may move data with uart_emu1_get_tx() / uart_emu1_put_rx()
+ *   (eg. to a pty, see RCU85Monitor/rcu85host.c).
  * 
  ***************************************************************************/
 
 
 //#include "serialdriver.h"
 #include "driver.h"        // the new Driver API
+#include "libprof.h"
+#include "libtrace.h"
 #ifndef UART_ENABLE_EMU_1
  #include <avr/io.h>
  #include <avr/interrupt.h>
@@ -199,15 +206,22 @@ typedef struct serial_dinst_type {
 
 #ifdef UART_ENABLE_EMU_1
  #define F_CPU 8000000L
- void ENABLE_INTR_RECV_COMPLETE()  { printf("*** ENABLE_INTR_RECV_COMPLETE\n"); }
- void DISABLE_INTR_RECV_COMPLETE() { printf("*** DISABLE_INTR_RECV_COMPLETE\n"); }   
- void ENABLE_INTR_TR_FIFO_EMPTY()  { printf("*** ENABLE_INTR_TR_FIFO_EMPTY\n"); }
- void DISABLE_INTR_TR_FIFO_EMPTY() { printf("*** DISABLE_INTR_TR_FIFO_EMPTY\n"); }
- void ENABLE_INTR_TR_COMPLETE()    { printf("*** ENABLE_INTR_TR_COMPLETE\n"); }
- void DISABLE_INTR_TR_COMPLETE()   { printf("*** DISABLE_INTR_TR_COMPLETE\n"); }
- void __ENTER_CRITICAL_SECTION__() { printf("*** __ENTER_CRITICAL_SECTION__ --> cli()\n"); }
- void __EXIT_CRITICAL_SECTION__()  { printf("*** __EXIT_CRITICAL_SECTION__ --> sei()\n"); }
- void sei() { printf("*** sei()\n"); }
+ #ifdef TDD_PRINTF
+  #define EMU_TRACE(s)  printf("*** " s "\n")
+ #else
+  #define EMU_TRACE(s)
+ #endif
+ // stands in for the Rx / Tx ISRs, see uart_emu1_set_isr()
+ static void (*uart_emu1_isr)(void) = NULL;
+ void ENABLE_INTR_RECV_COMPLETE()  { EMU_TRACE("ENABLE_INTR_RECV_COMPLETE"); if (uart_emu1_isr) { PROF_BEGIN(PROF_UART_RX); uart_emu1_isr(); PROF_END(PROF_UART_RX); } }
+ void DISABLE_INTR_RECV_COMPLETE() { EMU_TRACE("DISABLE_INTR_RECV_COMPLETE"); }
+ void ENABLE_INTR_TR_FIFO_EMPTY()  { EMU_TRACE("ENABLE_INTR_TR_FIFO_EMPTY"); if (uart_emu1_isr) { PROF_BEGIN(PROF_UART_TX); uart_emu1_isr(); PROF_END(PROF_UART_TX); } }
+ void DISABLE_INTR_TR_FIFO_EMPTY() { EMU_TRACE("DISABLE_INTR_TR_FIFO_EMPTY"); }
+ void ENABLE_INTR_TR_COMPLETE()    { EMU_TRACE("ENABLE_INTR_TR_COMPLETE"); }
+ void DISABLE_INTR_TR_COMPLETE()   { EMU_TRACE("DISABLE_INTR_TR_COMPLETE"); }
+ void __ENTER_CRITICAL_SECTION__() { EMU_TRACE("__ENTER_CRITICAL_SECTION__ --> cli()"); }
+ void __EXIT_CRITICAL_SECTION__()  { EMU_TRACE("__EXIT_CRITICAL_SECTION__ --> sei()"); }
+ void sei() { EMU_TRACE("sei()"); }
 #else
  // ====== MACROS To Enable/Disable Interrupt Service Routines =========
  // [Rx] Read FIFO, Rx FIFO FULL
@@ -424,6 +438,7 @@ static serdinst_t * s_find_minor_ctx_by_minor_num(int p);
 // Rx Complete
 ISR(USART0_RX_vect)
 {
+    PROF_BEGIN(PROF_UART_RX);
     // cannot pass data in, ISR must get the instance from the root driver.
     // if the port is closed then NULL is returned!
     serdinst_t * inst = s_find_minor_ctx_by_minor_num(0);
@@ -431,6 +446,7 @@ ISR(USART0_RX_vect)
         if (inst->serbuf_rd_used >= SERBUF_MAX_LEN) {
             inst->voidbyte = SER_FIFO; // clear the ISR!
             inst->serbuf_rd_overflow ++;
+            TRACE(TRACE_UART_OVF, 0);
         } else {
             inst->serbuf_rd[inst->serbuf_rd_head++] = SER_FIFO;
             if (inst->serbuf_rd_head == SERBUF_MAX_LEN) {
@@ -444,6 +460,7 @@ ISR(USART0_RX_vect)
         // it has to be read to clear the flag
         inst->voidbyte = SER_FIFO;
     }
+    PROF_END(PROF_UART_RX);
 }
 
 // Tx Complete
@@ -457,6 +474,7 @@ ISR(USART0_TX_vect)
 // DATA Register Empty - UDRE1 bit is set, Tx FIFO can be (re-)filled
 ISR(USART0_UDRE_vect)
 {
+    PROF_BEGIN(PROF_UART_TX);
     // cannot pass data in, ISR must get the instance from the root driver.
     // if the port is closed then NULL is returned!
     serdinst_t * inst = s_find_minor_ctx_by_minor_num(0);
@@ -472,6 +490,7 @@ ISR(USART0_UDRE_vect)
     } else {
         DISABLE_INTR_TR_FIFO_EMPTY(); // shutdown the Tx ISR
     }
+    PROF_END(PROF_UART_TX);
 }
 
 #endif /* UART_ENABLE_PORT_0 */
@@ -482,6 +501,7 @@ ISR(USART0_UDRE_vect)
 // Rx Complete
 ISR(USART1_RX_vect)
 {
+    PROF_BEGIN(PROF_UART_RX);
     // cannot pass data in, ISR must get the instance from the root driver.
     // if the port is closed then NULL is returned!
     serdinst_t * inst = s_find_minor_ctx_by_minor_num(1);
@@ -489,6 +509,7 @@ ISR(USART1_RX_vect)
         if (inst->serbuf_rd_used >= SERBUF_MAX_LEN) {
             inst->voidbyte = SER_FIFO; // clear the ISR!
             inst->serbuf_rd_overflow ++;
+            TRACE(TRACE_UART_OVF, 1);
         } else {
             inst->serbuf_rd[inst->serbuf_rd_head++] = SER_FIFO;
             if (inst->serbuf_rd_head == SERBUF_MAX_LEN) {
@@ -502,6 +523,7 @@ ISR(USART1_RX_vect)
         // it has to be read to clear the flag
         inst->voidbyte = SER_FIFO;
     }
+    PROF_END(PROF_UART_RX);
 }
 
 // Tx Complete
@@ -515,6 +537,7 @@ ISR(USART1_TX_vect)
 // DATA Register Empty - UDRE1 bit is set, Tx FIFO can be (re-)filled
 ISR(USART1_UDRE_vect)
 {
+    PROF_BEGIN(PROF_UART_TX);
     // cannot pass data in, ISR must get the instance from the root driver.
     // if the port is closed then NULL is returned!
     serdinst_t * inst = s_find_minor_ctx_by_minor_num(1);
@@ -531,6 +554,7 @@ ISR(USART1_UDRE_vect)
     } else {
         DISABLE_INTR_TR_FIFO_EMPTY(); // shutdown the Tx ISR
     }
+    PROF_END(PROF_UART_TX);
 }
 
 #endif /* UART_ENABLE_PORT_1 */
@@ -541,6 +565,7 @@ ISR(USART1_UDRE_vect)
 // Rx Complete
 ISR(USART2_RX_vect)
 {
+    PROF_BEGIN(PROF_UART_RX);
     // cannot pass data in, ISR must get the instance from the root driver.
     // if the port is closed then NULL is returned!
     serdinst_t * inst = s_find_minor_ctx_by_minor_num(2);
@@ -548,6 +573,7 @@ ISR(USART2_RX_vect)
         if (inst->serbuf_rd_used >= SERBUF_MAX_LEN) {
             inst->voidbyte = SER_FIFO; // clear the ISR!
             inst->serbuf_rd_overflow ++;
+            TRACE(TRACE_UART_OVF, 2);
         } else {
             inst->serbuf_rd[inst->serbuf_rd_head++] = SER_FIFO;
             if (inst->serbuf_rd_head == SERBUF_MAX_LEN) {
@@ -561,6 +587,7 @@ ISR(USART2_RX_vect)
         // it has to be read to clear the flag
         inst->voidbyte = SER_FIFO;
     }
+    PROF_END(PROF_UART_RX);
 }
 
 // Tx Complete
@@ -574,6 +601,7 @@ ISR(USART2_TX_vect)
 // DATA Register Empty - UDRE1 bit is set, Tx FIFO can be (re-)filled
 ISR(USART2_UDRE_vect)
 {
+    PROF_BEGIN(PROF_UART_TX);
     // cannot pass data in, ISR must get the instance from the root driver.
     // if the port is closed then NULL is returned!
     serdinst_t * inst = s_find_minor_ctx_by_minor_num(2);
@@ -590,6 +618,7 @@ ISR(USART2_UDRE_vect)
     } else {
         DISABLE_INTR_TR_FIFO_EMPTY(); // shutdown the Tx ISR
     }
+    PROF_END(PROF_UART_TX);
 }
 
 #endif /* UART_ENABLE_PORT_2 */
@@ -600,6 +629,7 @@ ISR(USART2_UDRE_vect)
 // Rx Complete
 ISR(USART3_RX_vect)
 {
+    PROF_BEGIN(PROF_UART_RX);
     // cannot pass data in, ISR must get the instance from the root driver.
     // if the port is closed then NULL is returned!
     serdinst_t * inst = s_find_minor_ctx_by_minor_num(3);
@@ -607,6 +637,7 @@ ISR(USART3_RX_vect)
         if (inst->serbuf_rd_used >= SERBUF_MAX_LEN) {
             inst->voidbyte = SER_FIFO; // clear the ISR!
             inst->serbuf_rd_overflow ++;
+            TRACE(TRACE_UART_OVF, 3);
         } else {
             inst->serbuf_rd[inst->serbuf_rd_head++] = SER_FIFO;
             if (inst->serbuf_rd_head == SERBUF_MAX_LEN) {
@@ -620,6 +651,7 @@ ISR(USART3_RX_vect)
         // it has to be read to clear the flag
         inst->voidbyte = SER_FIFO;
     }
+    PROF_END(PROF_UART_RX);
 }
 
 // Tx Complete
@@ -633,6 +665,7 @@ ISR(USART3_TX_vect)
 // DATA Register Empty - UDRE1 bit is set, Tx FIFO can be (re-)filled
 ISR(USART3_UDRE_vect)
 {
+    PROF_BEGIN(PROF_UART_TX);
     // cannot pass data in, ISR must get the instance from the root driver.
     // if the port is closed then NULL is returned!
     serdinst_t * inst = s_find_minor_ctx_by_minor_num(3);
@@ -649,6 +682,7 @@ ISR(USART3_UDRE_vect)
     } else {
         DISABLE_INTR_TR_FIFO_EMPTY(); // shutdown the Tx ISR
     }
+    PROF_END(PROF_UART_TX);
 }
 
 #endif /* UART_ENABLE_PORT_3 */
@@ -942,6 +976,11 @@ int uart_emu1_get_tx(char * strn, int maxread) {
     }
     return rc;
 }
+// install the emulated ISR (NULL = none). Called whenever the driver
+// (re-)enables its Rx or Tx interrupt, with the buffers consistent.
+void uart_emu1_set_isr(void (*isr)(void)) {
+    uart_emu1_isr = isr;
+}
 // put data into the RX buffer so that it can be read by cd_read() call
 int uart_emu1_put_rx(const char * strn, int len) {
     int rc = -1;
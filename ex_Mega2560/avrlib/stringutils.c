@@ -245,3 +245,16 @@ uint8_t sutil_asciinumber(char * at, int32_t ival) {
     return sp;
 }
 
+uint8_t sutil_asciiunsigned(char * at, uint32_t uval) {
+    char    rev[10];
+    uint8_t n = 0, sp = 0;
+    do {
+        rev[n++] = '0' + (char)(uval % 10);
+        uval /= 10;
+    } while (uval);
+    while (n) {
+        at[sp++] = rev[--n];
+    }
+    return sp;
+}
+
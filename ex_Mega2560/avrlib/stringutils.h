@@ -105,5 +105,12 @@ uint8_t sutil_asciihex_long(char * at, uint32_t hval, uint8_t prefix, uint8_t uc
 // return # bytes advanced into 'at'
 uint8_t sutil_asciinumber(char * at, int32_t ival);
 
+// sutil_asciiunsigned()
+// Same as sutil_asciinumber() for an unsigned value, 0 .. 4294967295.
+// (!) Given buffer must be at least 11 bytes.
+// - 
+// return # bytes advanced into 'at'
+uint8_t sutil_asciiunsigned(char * at, uint32_t uval);
+
 
 #endif /* _STRINGUTILS_H_ */
@@ -0,0 +1,472 @@
+/*
+ * avrbench.c
+ *
+ * Micro-benchmarks for avrlib hot paths, built natively in Linux (see
+ * Makefile). Not a pass/fail test: each benchmark runs a fixed amount
+ * of work several times and reports the best host time, one line each:
+ *
+ *  BENCH <name> unit=<unit> count=<n> best_s=<s> rate=<units/s> [target_ns=<ns/unit>]
+ *
+ * 'target_ns' is emulated target time (tm_emu_ns()) per unit, where the
+ * code under test has bus or line delays. Time is virtual, so delays
+ * cost no host time and the figures measure the code itself.
+ *
+ * USAGE
+ *
+ *  avrbench [-r repeat] [-b baseline]
+ *
+ *  -r      runs per benchmark, best is reported (default 5)
+ *  -b      earlier output to compare against, adds 'base=' (its rate)
+ *          and 'ratio=' (rate / base, > 1 is faster) to each line
+ *
+ * Benchmarks
+ *  cd_write_loop, cd_read_loop     chardev through the loopback driver
+ *  cd_write_uart, cd_read_uart     chardev through the emulated UART
+ *  parser_iom, parser_read         pollParser() with RCU85 commands
+ *  strntohex                       sutil_strntohex(), 2 digit pairs
+ *  ihex_hwrt                       RCU85 'hwrt' Intel HEX upload, end to end
+ *  pm_out, pm_in                   GPIO port writes / reads
+ *  pm_s_out, pm_s_in               the same through the static pin macros
+ *  rcmem_write, rcmem_read         bus_action() against the 8085 bus model
+ *
+ */
+
+#include <avrlib/chardev.h>
+#include <avrlib/driver.h>
+#include <avrlib/cmdparser.h>
+#include <avrlib/stringutils.h>
+#include <avrlib/gpio_api.h>
+#include <avrlib/gpio_emu_dev.h>
+#include <avrlib/libtime.h>
+#include <RCU85Monitor/rcu85mem.h>
+#include <RCU85Monitor/kybd_led_io.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+
+/* MOCK backend hooks (loopback_driver.c, serialdriver.c) */
+extern int mock_loop_write(int instance, const char * buf, int len);
+extern int mock_loop_read(int instance, char * buf, int maxlen);
+extern int uart_emu1_get_tx(char * strn, int maxread);
+extern int uart_emu1_put_rx(const char * strn, int len);
+extern void uart_emu1_set_isr(void (*isr)(void));
+
+/* rcu85cmds.c display data, normally in rcu85mon.c */
+kybd_t mon_info;
+
+#define CD_BYTES        (1024L * 1024L)
+#define PARSER_CMDS     2000
+#define HEX_TEXT_LEN    4096
+#define HEX_PASSES      64
+#define IHEX_BASE       0x8000
+#define IHEX_LEN        4096
+#define IHEX_RECLEN     16
+#define PM_OPS          1000000L
+#define RCMEM_CHUNK     1024
+#define RCMEM_PASSES    64
+
+#define MAX_BASE        32
+
+// RCU-85 bus wiring (see rcu85mem.c)
+static emu_bus8085_t bus = {
+    PM_PORT_A,                  /* AD0..7   */
+    PM_PORT_C,                  /* A8..15   */
+    { PM_PORT_G, PM_PIN_2 },    /* ALE      */
+    { PM_PORT_G, PM_PIN_1 },    /* /RD      */
+    { PM_PORT_G, PM_PIN_0 },    /* /WR      */
+    { PM_PORT_L, PM_PIN_0 },    /* IO/M     */
+    { PM_PORT_L, PM_PIN_1 },    /* HOLD     */
+    { PM_PORT_L, PM_PIN_2 },    /* HLDA     */
+    { PM_PORT_L, PM_PIN_3 },    /* /RESET   */
+    { PM_PORT_K, PM_PIN_7 },    /* EXTSEL   */
+    0                           /* HLDA latency */
+};
+
+static int  repeat = 5;
+static int  loop_hnd = -1;
+static int  uart_hnd = -1;
+static int  pm_hout = -1;
+static int  pm_hin = -1;
+static char wbuf[RCMEM_CHUNK];
+static char rbuf[RCMEM_CHUNK];
+static char hextext[HEX_TEXT_LEN];
+static char * ihex = NULL;          /* "hwrt\r\n" + records */
+static uint8_t ihex_data[IHEX_LEN];
+static int  failed = 0;
+
+static struct {
+    char   name[24];
+    double rate;
+} base[MAX_BASE];
+static int base_count = 0;
+
+static double s_wall(void) {
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return (double)ts.tv_sec + (double)ts.tv_nsec / 1e9;
+}
+
+/* === SERIAL LINE FEEDER ============================================
+ * Emulated UART ISR while the parser runs: drains Tx, and feeds Rx
+ * from 'feed'. The first line is fed on its own, the rest only once
+ * the parser has echoed it (a '\n' on Tx): a command must be alone in
+ * the buffer when pollParser() reads it, like a human typing 'hwrt'
+ * before pasting the records.
+ */
+static const char * feed = NULL;
+static int  feed_len = 0;
+static int  feed_state = 0;         /* 0 first line, 1 wait for echo, 2 open */
+static long tx_count = 0;
+
+static void s_feeder(void) {
+    char txb[64];
+    const char * nl;
+    int n, i, max;
+    while ((n = uart_emu1_get_tx(txb, sizeof(txb))) > 0) {
+        tx_count += n;
+        for ( i = 0 ; i < n && feed_state == 1 ; ++i )
+            if (txb[i] == '\n')
+                feed_state = 2;
+    }
+    if (feed_len > 0 && feed_state != 1) {
+        max = feed_len;
+        if (feed_state == 0) {
+            nl = memchr(feed, '\n', feed_len);
+            max = nl ? (int)(nl - feed) + 1 : feed_len;
+        }
+        n = uart_emu1_put_rx(feed, max);
+        if (n > 0) {
+            feed += n;
+            feed_len -= n;
+            if (feed_state == 0 && n == max)
+                feed_state = 1;
+        }
+    }
+}
+
+/* === BENCHMARKS ====================================================
+ * Each one does a fixed amount of work and returns its unit count.
+ */
+
+static double b_cd_write_loop(void) {
+    long done = 0;
+    int n;
+    while (done < CD_BYTES) {
+        n = cd_write(loop_hnd, wbuf, 64);
+        if (n <= 0)
+            break;
+        mock_loop_read(1, rbuf, 64);
+        done += n;
+    }
+    return (double)done;
+}
+
+static double b_cd_read_loop(void) {
+    long done = 0;
+    int n;
+    while (done < CD_BYTES) {
+        mock_loop_write(1, wbuf, 64);
+        n = cd_read(loop_hnd, rbuf, 64);
+        if (n <= 0)
+            break;
+        done += n;
+    }
+    return (double)done;
+}
+
+static double b_cd_write_uart(void) {
+    long done = 0;
+    int n;
+    while (done < CD_BYTES) {
+        n = cd_write(uart_hnd, wbuf, 32);
+        if (n <= 0)
+            break;
+        uart_emu1_get_tx(rbuf, 64);
+        done += n;
+    }
+    return (double)done;
+}
+
+static double b_cd_read_uart(void) {
+    long done = 0;
+    int n;
+    while (done < CD_BYTES) {
+        uart_emu1_put_rx(wbuf, 32);
+        n = cd_read(uart_hnd, rbuf, 32);
+        if (n <= 0)
+            break;
+        done += n;
+    }
+    return (double)done;
+}
+
+static double s_parser_cmds(const char * cmd) {
+    int i, len = strlen(cmd);
+    for ( i = 0 ; i < PARSER_CMDS ; ++i ) {
+        uart_emu1_put_rx(cmd, len);
+        if (pollParser() != 0) {
+            failed = 1;
+            break;
+        }
+    }
+    return (double)i;
+}
+
+static double b_parser_iom(void) {
+    return s_parser_cmds("iom\r\n");
+}
+
+static double b_parser_read(void) {
+    return s_parser_cmds("read 0 40\r\n");
+}
+
+static double b_strntohex(void) {
+    int pass, i;
+    volatile uint16_t sum = 0;
+    for ( pass = 0 ; pass < HEX_PASSES ; ++pass ) {
+        for ( i = 0 ; i < HEX_TEXT_LEN ; i += 2 ) {
+            sum += sutil_strntohex(hextext + i, 2);
+        }
+    }
+    return (double)HEX_PASSES * HEX_TEXT_LEN;
+}
+
+static double b_ihex_hwrt(void) {
+    int len = strlen(ihex);
+    memset(bus.mem + IHEX_BASE, 0, IHEX_LEN);
+    feed = ihex;
+    feed_len = len;
+    feed_state = 0;
+    rcmem_hold();               /* 'hwrt' expects a 'halt' first */
+    s_feeder();                 /* the 'hwrt' line */
+    if (pollParser() != 0 || rcmem_release(NO_CPU_RESET) != RCM_SUCCESS || feed_len != 0 ||
+        memcmp(bus.mem + IHEX_BASE, ihex_data, IHEX_LEN) != 0) {
+        printf("# ihex_hwrt: upload failed, %d bytes not taken\n", feed_len);
+        failed = 1;
+    }
+    feed_len = 0;
+    return (double)len;
+}
+
+static double b_pm_out(void) {
+    long i;
+    for ( i = 0 ; i < PM_OPS ; ++i ) {
+        pm_out(pm_hout, (uint8_t)i);
+    }
+    return (double)PM_OPS;
+}
+
+static double b_pm_in(void) {
+    long i;
+    volatile int v = 0;
+    for ( i = 0 ; i < PM_OPS ; ++i ) {
+        v += pm_in(pm_hin);
+    }
+    return (double)PM_OPS;
+}
+
+static double b_pm_s_out(void) {
+    long i;
+    for ( i = 0 ; i < PM_OPS ; ++i ) {
+        pm_s_prt_out(PM_PORT_B, (uint8_t)i);
+    }
+    return (double)PM_OPS;
+}
+
+static double b_pm_s_in(void) {
+    long i;
+    volatile int v = 0;
+    for ( i = 0 ; i < PM_OPS ; ++i ) {
+        v += pm_s_prt_in(PM_PORT_D);
+    }
+    return (double)PM_OPS;
+}
+
+static double b_rcmem_write(void) {
+    int i;
+    rcmem_hold();
+    for ( i = 0 ; i < RCMEM_PASSES ; ++i ) {
+        if (rcmem_write(0x4000, (uint8_t *)wbuf, RCMEM_CHUNK, SET_MEM_ACCESS) != RCMEM_CHUNK)
+            failed = 1;
+    }
+    rcmem_release(NO_CPU_RESET);
+    return (double)RCMEM_PASSES * RCMEM_CHUNK;
+}
+
+static double b_rcmem_read(void) {
+    int i;
+    rcmem_hold();
+    for ( i = 0 ; i < RCMEM_PASSES ; ++i ) {
+        if (rcmem_read(0x4000, (uint8_t *)rbuf, RCMEM_CHUNK, SET_MEM_ACCESS) != RCMEM_CHUNK)
+            failed = 1;
+    }
+    rcmem_release(NO_CPU_RESET);
+    if (memcmp(rbuf, wbuf, RCMEM_CHUNK) != 0)
+        failed = 1;
+    return (double)RCMEM_PASSES * RCMEM_CHUNK;
+}
+
+/* === HARNESS =======================================================*/
+
+static void s_load_base(const char * fname) {
+    FILE * f = fopen(fname, "r");
+    char line[256];
+    char * r;
+    if (!f) {
+        perror(fname);
+        exit(1);
+    }
+    while (fgets(line, sizeof(line), f) && base_count < MAX_BASE) {
+        if (sscanf(line, "BENCH %23s", base[base_count].name) == 1 &&
+            (r = strstr(line, " rate=")) != NULL) {
+            base[base_count].rate = atof(r + 6);
+            base_count++;
+        }
+    }
+    fclose(f);
+}
+
+static void s_run(const char * name, const char * unit, double (*fn)(void)) {
+    double t0, t, best = 0.0, count = 0.0;
+    uint64_t e0, emu = 0;
+    int i;
+    for ( i = 0 ; i < repeat ; ++i ) {
+        e0 = tm_emu_ns();
+        t0 = s_wall();
+        count = fn();
+        t = s_wall() - t0;
+        if (i == 0 || t < best) {
+            best = t;
+            emu = tm_emu_ns() - e0;
+        }
+    }
+    if (best <= 0.0)
+        best = 1e-9;
+    printf("BENCH %s unit=%s count=%.0f best_s=%.6f rate=%.0f",
+        name, unit, count, best, count / best);
+    if (emu && count > 0)
+        printf(" target_ns=%.1f", (double)emu / count);
+    for ( i = 0 ; i < base_count ; ++i ) {
+        if (strcmp(base[i].name, name) == 0 && base[i].rate > 0) {
+            printf(" base=%.0f ratio=%.3f", base[i].rate, count / best / base[i].rate);
+            break;
+        }
+    }
+    printf("\n");
+    fflush(stdout);
+}
+
+static void s_setup_data(void) {
+    int i, r;
+    uint16_t addr;
+    uint8_t crc;
+    char * p;
+    for ( i = 0 ; i < RCMEM_CHUNK ; ++i ) {
+        wbuf[i] = (char)(i * 7 + 3);
+    }
+    for ( i = 0 ; i < HEX_TEXT_LEN ; ++i ) {
+        hextext[i] = "0123456789abcdefABCDEF"[(i * 5) % 22];
+    }
+    /* 'hwrt' + IHEX_LEN bytes in IHEX_RECLEN byte records + EOF */
+    ihex = malloc(16 + (IHEX_LEN / IHEX_RECLEN) * (16 + 2 * IHEX_RECLEN) + 32);
+    p = ihex + sprintf(ihex, "hwrt\r\n");
+    for ( r = 0 ; r < IHEX_LEN / IHEX_RECLEN ; ++r ) {
+        addr = IHEX_BASE + r * IHEX_RECLEN;
+        crc = IHEX_RECLEN + (addr >> 8) + (addr & 0xff);
+        p += sprintf(p, ":%02X%04X00", IHEX_RECLEN, addr);
+        for ( i = 0 ; i < IHEX_RECLEN ; ++i ) {
+            ihex_data[r * IHEX_RECLEN + i] = (uint8_t)(r + i * 13);
+            crc += ihex_data[r * IHEX_RECLEN + i];
+            p += sprintf(p, "%02X", ihex_data[r * IHEX_RECLEN + i]);
+        }
+        p += sprintf(p, "%02X\r\n", (uint8_t)(0x100 - crc));
+    }
+    sprintf(p, ":00000001FF\r\n");
+}
+
+int main(int argc, char * argv[]) {
+    int i;
+    for ( i = 1 ; i < argc ; ++i ) {
+        if (strcmp(argv[i], "-r") == 0 && i + 1 < argc) {
+            repeat = atoi(argv[++i]);
+            if (repeat < 1)
+                repeat = 1;
+        } else if (strcmp(argv[i], "-b") == 0 && i + 1 < argc) {
+            s_load_base(argv[++i]);
+        } else {
+            fprintf(stderr, "usage: %s [-r repeat] [-b baseline]\n", argv[0]);
+            return 2;
+        }
+    }
+
+    tm_emu_virtual(1);
+    tm_init();
+    System_DriverStartup();
+    System_driverInit();
+    pm_init();
+    if (emu_bus8085_attach(&bus, NULL) != PM_SUCCESS || rcmem_init() != RCM_SUCCESS) {
+        fprintf(stderr, "avrbench: bus model setup failed\n");
+        return 1;
+    }
+    s_setup_data();
+    printf("# avrbench repeat=%d\n", repeat);
+
+    /* chardev, loopback */
+    loop_hnd = cd_open("/dev/loop/1", 0);
+    if (loop_hnd <= 0) {
+        fprintf(stderr, "avrbench: no loopback device\n");
+        return 1;
+    }
+    s_run("cd_write_loop", "bytes", b_cd_write_loop);
+    s_run("cd_read_loop",  "bytes", b_cd_read_loop);
+    cd_close(loop_hnd);
+
+    /* chardev, emulated UART (no ISR, the benchmark moves the data) */
+    uart_hnd = cd_open("/dev/uart/1,115200,8,N,1", 0);
+    if (uart_hnd <= 0) {
+        fprintf(stderr, "avrbench: no emulated UART\n");
+        return 1;
+    }
+    s_run("cd_write_uart", "bytes", b_cd_write_uart);
+    s_run("cd_read_uart",  "bytes", b_cd_read_uart);
+    cd_close(uart_hnd);
+
+    /* string utilities */
+    s_run("strntohex", "bytes", b_strntohex);
+
+    /* GPIO */
+    pm_hout = pm_register_prt(PM_PORT_B, 0x00, PINMODE_OUTPUT_LO);
+    pm_hin  = pm_register_prt(PM_PORT_D, 0x00, PINMODE_INPUT_TRI);
+    if (pm_hout <= 0 || pm_hin <= 0) {
+        fprintf(stderr, "avrbench: GPIO registration failed\n");
+        return 1;
+    }
+    s_run("pm_out", "ops", b_pm_out);
+    s_run("pm_in",  "ops", b_pm_in);
+    s_run("pm_s_out", "ops", b_pm_s_out);
+    s_run("pm_s_in",  "ops", b_pm_s_in);
+
+    /* RCU85 bus */
+    s_run("rcmem_write", "bytes", b_rcmem_write);
+    s_run("rcmem_read",  "bytes", b_rcmem_read);
+
+    /* command parser on the emulated UART, RCU85 command set */
+    uart_emu1_set_isr(s_feeder);
+    if (startParser("/dev/uart/1,115200,8,N,1", 0) != 0) {
+        fprintf(stderr, "avrbench: parser did not start\n");
+        return 1;
+    }
+    s_run("parser_iom",  "cmds",  b_parser_iom);
+    s_run("parser_read", "cmds",  b_parser_read);
+    s_run("ihex_hwrt",   "bytes", b_ihex_hwrt);
+    uart_emu1_set_isr(NULL);
+
+    emu_bus8085_detach(&bus);
+    free(ihex);
+    if (failed) {
+        printf("# avrbench: FAILED, a benchmark did not complete its work\n");
+        return 1;
+    }
+    return 0;
+}
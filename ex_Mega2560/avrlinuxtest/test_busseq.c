@@ -0,0 +1,315 @@
+/*
+ * test_busseq.c
+ *
+ * TDD For avrlib/(Bus Sequencer)
+ * Programs run against the emulated GPIO register file, waits are
+ * checked in virtual time (16 cycles = 1 us).
+ *
+ * Supports lib ver: 1.0
+ *
+ */
+
+#include <avrlib/busseq.h>
+#include <avrlib/gpio_emu.h>
+#include <avrlib/libtime.h>
+#include <stdio.h>
+#include <string.h>
+#include <CUnit/CUnit.h>
+#include <CUnit/Basic.h>
+
+// MOCK backend hooks, for GPIO register access (gpio_emu.h)
+#define T_PIN(p)    (*emu_port_reg((p),EMU_REG_PIN))
+#define T_DDR(p)    (*emu_port_reg((p),EMU_REG_DDR))
+#define T_PORT(p)   (*emu_port_reg((p),EMU_REG_PORT))
+
+/* PortC: outputs, PortJ: inputs, PortL: control pins (above the sbi range) */
+static int h_portc, h_portj, h_portl;
+
+static const bs_step_t prog_pins[] BS_PROGMEM = {
+    BS_WR(PM_PORT_C, 0xa5),
+    BS_SET(PM_PORT_L, 0x03),
+    BS_CLR(PM_PORT_L, 0x01),
+    BS_TOG(PM_PORT_L, 0x0c),
+    BS_PULSE(PM_PORT_L, 0x10, TM_US_CYCLES(2)),
+    BS_WAIT(TM_US_CYCLES(1)),
+    BS_DIR(PM_PORT_C, 0x0f),
+    BS_END()
+};
+
+/* 0: address, 2: data from buf, count passes */
+static const bs_step_t prog_out[] BS_PROGMEM = {
+    BS_ALO(PM_PORT_C),
+    BS_AHI(PM_PORT_L),
+    BS_OUT(PM_PORT_C),
+    BS_PULSE(PM_PORT_L, 0x80, BS_T(1)),
+    BS_INC(),
+    BS_LOOP(0),
+    BS_END()
+};
+
+static const bs_step_t prog_in[] BS_PROGMEM = {
+    BS_IN(PM_PORT_J),
+    BS_LOOP(0),
+    BS_END()
+};
+
+/* shift in PC0 while toggling it: 1, 0, 1, ... first bit to b0 */
+static const bs_step_t prog_shift[] BS_PROGMEM = {
+    BS_REP(8),
+    BS_TOG(PM_PORT_C, 0x01),
+    BS_SHIN(PM_PORT_C, 0x01),
+    BS_DJNZ(1),
+    BS_PUT(),
+    BS_LOOP(0),
+    BS_END()
+};
+
+/* passes counted on the address */
+static const bs_step_t prog_rep0[] BS_PROGMEM = {
+    BS_REP(0),
+    BS_INC(),
+    BS_DJNZ(1),
+    BS_END()
+};
+
+static const bs_step_t prog_rep300[] BS_PROGMEM = {
+    BS_REP(300),
+    BS_INC(),
+    BS_DJNZ(1),
+    BS_END()
+};
+
+/* the DJNZ with nothing counted falls through */
+static const bs_step_t prog_djnz0[] BS_PROGMEM = {
+    BS_INC(),
+    BS_DJNZ(0),
+    BS_END()
+};
+
+static const bs_step_t prog_rep_open[] BS_PROGMEM = {
+    BS_REP(0),
+    BS_INC(),
+    BS_END()
+};
+
+static const bs_step_t prog_wait[] BS_PROGMEM = {
+    BS_WAIT(BS_T(0)),
+    BS_END()
+};
+
+static const bs_step_t prog_bad[] BS_PROGMEM = {
+    BS_WAIT(1),
+    { 0x7f, 0, 0, 0 },
+    BS_END()
+};
+
+/* records PORTL writes, pulse order of PL7 */
+static uint8_t l_log[16];
+static int l_count = 0;
+
+static void hook_portl(uint8_t port, uint8_t event, void * ctx) {
+    (void)ctx;
+    if ((port == PM_PORT_L) && (event == EMU_EV_PORT_WR) && (l_count < 16)) {
+        l_log[l_count++] = T_PORT(PM_PORT_L);
+    }
+}
+
+// ======== TEST SUITE ================================================
+
+int init_suite(void) {
+    tm_emu_virtual(1);
+    if (bs_measure() != BS_STEP_CYCLES) return -1;
+    pm_init();
+    h_portc = pm_register_prt(PM_PORT_C, 0, PINMODE_OUTPUT_LO);
+    h_portj = pm_register_prt(PM_PORT_J, 0, PINMODE_INPUT_TRI);
+    h_portl = pm_register_prt(PM_PORT_L, 0, PINMODE_OUTPUT_LO);
+    pm_static(h_portc);
+    pm_static(h_portl);
+    return (h_portc > 0 && h_portj > 0 && h_portl > 0) ? 0 : -1;
+}
+
+int clean_suite(void) {
+    return 0;
+}
+
+void test_bs_pins(void) {
+    bs_ctx_t bc = { NULL, 0, 0, 0, NULL };
+    uint64_t t0;
+
+    printf("\n");
+    printf("[test_bs_pins] -----------------------------------------------\n");
+    T_PORT(PM_PORT_L) = 0x00;
+    t0 = tm_emu_ns();
+    CU_ASSERT_FATAL ( bs_run(prog_pins, &bc) == 0 );
+    CU_ASSERT_FATAL ( T_PORT(PM_PORT_C) == 0xa5 );
+    CU_ASSERT_FATAL ( T_PORT(PM_PORT_L) == 0x0e );   /* set 0,1, clr 0, tog 2,3, pulse 4 */
+    CU_ASSERT_FATAL ( T_DDR(PM_PORT_C) == 0x0f );
+    /* 8 steps of BS_STEP_CYCLES (1500 ns), the 2 us pulse rounded up to
+     * 33 cycles, the 1 us wait is within the steps around it */
+    CU_ASSERT_FATAL ( tm_emu_ns() - t0 == 8 * 1500 + 2062 );
+    T_DDR(PM_PORT_C) = 0xff;
+}
+
+void test_bs_buffer(void) {
+    uint8_t data[4] = { 0x11, 0x22, 0x33, 0x44 };
+    uint16_t tim[2] = { 0, TM_US_CYCLES(1) };
+    bs_ctx_t bc = { data, 4, 0x12fe, 0, tim };
+    uint64_t t0;
+    int i, hk;
+
+    printf("\n");
+    printf("[test_bs_buffer] ---------------------------------------------\n");
+    printf("Address, data out, timing slot\n");
+    l_count = 0;
+    hk = emu_hook_add(PM_PORT_L, EMU_EV_PORT_WR, hook_portl, NULL);
+    CU_ASSERT_FATAL ( hk > 0 );
+    t0 = tm_emu_ns();
+    CU_ASSERT_FATAL ( bs_run(prog_out, &bc) == 4 );
+    emu_hook_remove(hk);
+    /* 4 passes of 6 steps and the end, 1 us pulses of 17 cycles */
+    CU_ASSERT_FATAL ( tm_emu_ns() - t0 == 25 * 1500 + 4 * 1062 );
+    CU_ASSERT_FATAL ( bc.addr == 0x1302 && bc.count == 0 );
+    CU_ASSERT_FATAL ( T_PORT(PM_PORT_C) == 0x44 );
+    /* per pass: AHI, pulse PL7 (2 writes) */
+    CU_ASSERT_FATAL ( l_count == 12 );
+    for ( i = 0 ; i < 4 ; ++i ) {
+        uint8_t ahi = (i < 2) ? 0x12 : 0x13;
+        CU_ASSERT_FATAL ( l_log[3*i] == ahi );
+        CU_ASSERT_FATAL ( l_log[3*i+1] == (ahi | 0x80) );
+        CU_ASSERT_FATAL ( l_log[3*i+2] == ahi );
+    }
+    printf("I/O: the low byte on both\n");
+    bc.buf = data;
+    bc.count = 1;
+    bc.addr = 0x12fe;
+    bc.flags = BS_F_IO;
+    CU_ASSERT_FATAL ( bs_run(prog_out, &bc) == 1 );
+    CU_ASSERT_FATAL ( T_PORT(PM_PORT_L) == 0xfe );
+
+    printf("Data in, count 0 runs once\n");
+    memset(data, 0, sizeof(data));
+    emu_pin_drive(PM_PORT_J, 0x7f, 0x5a);
+    bc.count = 0;
+    CU_ASSERT_FATAL ( bs_run(prog_in, &bc) == 1 );
+    CU_ASSERT_FATAL ( data[0] == 0x5a && data[1] == 0 );
+    bc.count = 3;
+    CU_ASSERT_FATAL ( bs_run(prog_in, &bc) == 3 );
+    CU_ASSERT_FATAL ( data[2] == 0x5a && data[3] == 0 );
+    emu_pin_release(PM_PORT_J, 0x7f);
+}
+
+void test_bs_shift(void) {
+    uint8_t data[2] = { 0, 0 };
+    bs_ctx_t bc = { data, 2, 0, 0, NULL };
+
+    printf("\n");
+    printf("[test_bs_shift] ----------------------------------------------\n");
+    T_PORT(PM_PORT_C) = 0x00;
+    CU_ASSERT_FATAL ( bs_run(prog_shift, &bc) == 2 );
+    CU_ASSERT_FATAL ( data[0] == 0x55 && data[1] == 0x55 );
+    CU_ASSERT_FATAL ( (T_PORT(PM_PORT_C) & 0x01) == 0 );
+}
+
+void test_bs_rep(void) {
+    bs_ctx_t bc = { NULL, 1, 0, 0, NULL };
+
+    printf("\n");
+    printf("[test_bs_rep] ------------------------------------------------\n");
+    printf("step time measured as emulated\n");
+    CU_ASSERT_FATAL ( bs_step_cycles() == BS_STEP_CYCLES );
+    printf("REP 0: no passes, REP 300: all of them\n");
+    CU_ASSERT_FATAL ( bs_run(prog_rep0, &bc) == 0 );
+    CU_ASSERT_FATAL ( bc.addr == 0 );
+    CU_ASSERT_FATAL ( bs_run(prog_rep300, &bc) == 0 );
+    CU_ASSERT_FATAL ( bc.addr == 300 );
+    printf("DJNZ on a counter of 0: once through\n");
+    bc.addr = 0;
+    CU_ASSERT_FATAL ( bs_run(prog_djnz0, &bc) == 0 );
+    CU_ASSERT_FATAL ( bc.addr == 1 );
+    printf("REP 0 without its DJNZ\n");
+    CU_ASSERT_FATAL ( bs_run(prog_rep_open, &bc) == BS_ERROR );
+}
+
+void test_bs_wait_round(void) {
+    uint16_t tim[1];
+    bs_ctx_t bc = { NULL, 1, 0, 0, tim };
+    uint16_t n;
+    uint64_t t0, t1;
+
+    printf("\n");
+    printf("[test_bs_wait_round] -----------------------------------------\n");
+    printf("within a step: no wait, then whole loop passes\n");
+    CU_ASSERT_FATAL ( bs_wait_round(0) == 0 );
+    CU_ASSERT_FATAL ( bs_wait_round(BS_STEP_CYCLES) == 0 );
+    CU_ASSERT_FATAL ( bs_wait_round(BS_STEP_CYCLES + 1) == BS_STEP_CYCLES + 3 );
+    CU_ASSERT_FATAL ( bs_wait_round(BS_STEP_CYCLES + 3) == BS_STEP_CYCLES + 3 );
+    CU_ASSERT_FATAL ( bs_wait_round(BS_STEP_CYCLES + 4) == BS_STEP_CYCLES + 3 + BS_WAIT_STEP );
+    CU_ASSERT_FATAL ( bs_wait_round(64) == 67 );
+    printf("a rounded wait runs as long as the value it came from\n");
+    for ( n = 0 ; n < 80 ; ++n ) {
+        tim[0] = n;
+        t0 = tm_emu_ns();
+        CU_ASSERT_FATAL ( bs_run(prog_wait, &bc) == 0 );
+        t1 = tm_emu_ns();
+        tim[0] = bs_wait_round(n);
+        CU_ASSERT_FATAL ( tim[0] >= n || tim[0] == 0 );
+        CU_ASSERT_FATAL ( bs_run(prog_wait, &bc) == 0 );
+        CU_ASSERT_FATAL ( tm_emu_ns() - t1 == t1 - t0 );
+    }
+}
+
+void test_bs_errors(void) {
+    bs_ctx_t bc = { NULL, 1, 0, 0, NULL };
+
+    printf("\n");
+    printf("[test_bs_errors] ---------------------------------------------\n");
+    CU_ASSERT_FATAL ( bs_run(prog_bad, &bc) == BS_ERROR );
+    CU_ASSERT_FATAL ( bs_run(prog_in, &bc) == BS_ERROR );       /* no buffer */
+    CU_ASSERT_FATAL ( bs_run(NULL, &bc) == BS_ERROR );
+    CU_ASSERT_FATAL ( bs_run(prog_pins, NULL) == BS_ERROR );
+}
+
+int main() {
+	// system init
+	printf("{TDD} System Init...\n");
+
+    CU_pSuite pSuite = NULL;
+    if (CUE_SUCCESS != CU_initialize_registry())
+        return CU_get_error();
+
+    pSuite = CU_add_suite("Test Suite - Bus sequencer", init_suite, clean_suite);
+    if (pSuite == NULL) {
+        CU_cleanup_registry();
+        return CU_get_error();
+    }
+
+    if ( !CU_add_test(pSuite, "[BUSSEQ] Pin steps, waits", test_bs_pins) ) {
+        CU_cleanup_registry();
+        return CU_get_error();
+    }
+    if ( !CU_add_test(pSuite, "[BUSSEQ] Buffer, address, loop", test_bs_buffer) ) {
+        CU_cleanup_registry();
+        return CU_get_error();
+    }
+    if ( !CU_add_test(pSuite, "[BUSSEQ] Shift in, inner loop", test_bs_shift) ) {
+        CU_cleanup_registry();
+        return CU_get_error();
+    }
+    if ( !CU_add_test(pSuite, "[BUSSEQ] Repeat counter, step time", test_bs_rep) ) {
+        CU_cleanup_registry();
+        return CU_get_error();
+    }
+    if ( !CU_add_test(pSuite, "[BUSSEQ] Wait rounding", test_bs_wait_round) ) {
+        CU_cleanup_registry();
+        return CU_get_error();
+    }
+    if ( !CU_add_test(pSuite, "[BUSSEQ] Errors", test_bs_errors) ) {
+        CU_cleanup_registry();
+        return CU_get_error();
+    }
+
+    CU_basic_set_mode(CU_BRM_VERBOSE);
+    CU_basic_run_tests();
+    CU_cleanup_registry();
+    return CU_get_error();
+}
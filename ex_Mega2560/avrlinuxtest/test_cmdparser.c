@@ -3,7 +3,7 @@
  *
  * TDD For avrlib/cmdparser.*
  *
- * Supports lib ver: 1.0
+ * Supports lib ver: 1.1
  *
  */
 
@@ -378,6 +378,11 @@ void test_cmdparser(void) {
     char cmd4_resp[] = "cmd_bar";
     char cmd5[] = "foo 3 4\r\n";
     char cmd8[] = "hwrt\r\n";
+    char cmd9[] = "cmdstats\r\n";
+    char cmd10[] = "cmdstats reset\r\n";
+    char stats[512];
+    char * line;
+    int  count, v[5];
     char resp_ok[] = "\r\nOK\r\n";
     char resp_err[] = "Error (";
 
@@ -468,6 +473,62 @@ void test_cmdparser(void) {
     rxb[len] = '\0';
     printf("{test_cmdparser} (readback) Cmd Resp :: %s", rxb);
     
+    // [9] built-in command statistics
+    printf("\n***[9]***\n");
+    mock_loop_write(inst,cmd9,strlen(cmd9));
+    pollParser();
+    len = mock_loop_read(inst,stats,sizeof(stats)-1);
+    stats[len] = '\0';
+    printf("{test_cmdparser} (readback) Cmd Resp :: %s", stats);
+    CU_ASSERT_FATAL( StringContains(stats,"Command statistics") );
+    CU_ASSERT_FATAL( StringContains(stats,resp_ok) );
+    // foo: [3],[4] ran, [7] was refused; bar: [6] ran, [5] was refused
+    CU_ASSERT_FATAL( (line = strstr(stats,"\nfoo")) != NULL );
+    CU_ASSERT_FATAL( strncmp(line+1, "foo          2 ", 15) == 0 );    /* count in column 14 */
+    CU_ASSERT_FATAL( sscanf(line+4, "%d %d %d %d %d %d", &count, &v[0], &v[1], &v[2], &v[3], &v[4]) == 6 );
+    CU_ASSERT_FATAL( count == 2 );
+    CU_ASSERT_FATAL( v[0] <= v[1] && v[2] <= v[3] && v[0] <= v[2] );
+    CU_ASSERT_FATAL( v[4] > (int)(2 * strlen(resp_ok)) );
+    CU_ASSERT_FATAL( (line = strstr(stats,"\nbar")) != NULL );
+    CU_ASSERT_FATAL( sscanf(line+4, "%d", &count) == 1 && count == 1 );
+    CU_ASSERT_FATAL( !StringContains(stats,"\ncmdstats ") );
+
+    mock_loop_write(inst,cmd10,strlen(cmd10));
+    pollParser();
+    len = mock_loop_read(inst,rxb,128);
+    rxb[len] = '\0';
+    CU_ASSERT_FATAL( StringContains(rxb,resp_ok) );
+    mock_loop_write(inst,cmd9,strlen(cmd9));
+    pollParser();
+    len = mock_loop_read(inst,stats,sizeof(stats)-1);
+    stats[len] = '\0';
+    printf("{test_cmdparser} (readback) Cmd Resp :: %s", stats);
+    CU_ASSERT_FATAL( !StringContains(stats,"\nfoo") );
+
+    // [10] a line longer than the command buffer (80), no CR: dropped with an
+    // error, the parser then takes commands again
+    printf("\n***[10]***\n");
+    memset(rxb, 'x', 90);
+    mock_loop_write(inst,rxb,90);
+    pollParser();
+    pollParser();
+    len = mock_loop_read(inst,stats,sizeof(stats)-1);
+    stats[len] = '\0';
+    CU_ASSERT_FATAL( StringContains(stats,resp_err) );
+    mock_loop_write(inst,cmd1,strlen(cmd1));
+    pollParser();
+    len = mock_loop_read(inst,stats,sizeof(stats)-1);
+    stats[len] = '\0';
+    printf("{test_cmdparser} (readback) Cmd Resp :: %s", stats);
+    CU_ASSERT_FATAL( StringContains(stats,resp_err) );      /* the 10 left over */
+    mock_loop_write(inst,cmd1,strlen(cmd1));
+    pollParser();
+    len = mock_loop_read(inst,rxb,128);
+    rxb[len] = '\0';
+    printf("{test_cmdparser} (readback) Cmd Resp :: %s", rxb);
+    CU_ASSERT_FATAL( StringContains(rxb,cmd1_resp) );
+    CU_ASSERT_FATAL( StringContains(rxb,resp_ok) );
+    
     // just exit, parser cannot be closed...
 
 }
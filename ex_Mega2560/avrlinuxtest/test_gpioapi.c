@@ -8,16 +8,17 @@
  */
 
 #include <avrlib/gpio_api.h>
+#include <avrlib/gpio_emu.h>
 #include <stdio.h>
 #include <string.h>
 #include <CUnit/CUnit.h>
 #include <CUnit/Basic.h>
 
 
-// MOCK backend hooks, for GPIO register access
-extern uint8_t MCUCR;
-extern uint8_t TEST_REGISTERS[6];
-extern sfr8p_t TR_ADDR_BASE;
+// MOCK backend hooks, for GPIO register access (gpio_emu.h)
+#define T_PIN(p)    (*emu_port_reg((p),EMU_REG_PIN))
+#define T_DDR(p)    (*emu_port_reg((p),EMU_REG_DDR))
+#define T_PORT(p)   (*emu_port_reg((p),EMU_REG_PORT))
 
 
 // ======== TEST SUITE ================================================
@@ -42,45 +43,23 @@ static void print_bin_byte( uint8_t byt ) {
     }
 }
 
-static char * portname[3] = {
-    "PORTA", "PORTB", ""
+static char * portname[TEST_PORT_COUNT] = {
+    "PORTA", "PORTB", "PORTC", "PORTD", "PORTE", "PORTF",
+    "PORTG", "PORTH", "PORTJ", "PORTK", "PORTL"
 };
 
 // does not test to see if the pin is actually an output - DO THIS YOURSELF!
+// (sets the PORT bit, the pin is then pulled up)
 static void set_input( uint8_t port, uint8_t pinmask) {
     printf("{set_input} port[%02x] pinmask[%02x]\n", port, pinmask);
     if (port < TEST_PORT_COUNT) {
-        TEST_REGISTERS[(port*3)+2] |= pinmask; // PORT value 
-        TEST_REGISTERS[(port*3)+0] |= pinmask; // PIN  value (read uses PIN)
+        T_PORT(port) |= pinmask; // PORT value 
+        T_PIN(port)  |= pinmask; // PIN  value (read uses PIN)
         printf("{set_input} PIN[%02x] DDR[%02x] PORT[%02x]\n", 
-            TEST_REGISTERS[(port*3)+0], 
-            TEST_REGISTERS[(port*3)+1],
-            TEST_REGISTERS[(port*3)+2] );
+            T_PIN(port), T_DDR(port), T_PORT(port) );
     }
 }
 
-// does not test to see if the pin is actually an output - DO THIS YOURSELF!
-static void clr_input( uint8_t port, uint8_t pinmask) {
-    if (port < TEST_PORT_COUNT) {
-        TEST_REGISTERS[(port*3)+2] &= (uint8_t)~pinmask; // PORT value 
-        TEST_REGISTERS[(port*3)+0] &= (uint8_t)~pinmask; // PIN  value (read uses PIN)
-    }
-}
-
-// fix the PIN readings (reflected outputs from the PORT) as PIN register is *SIMULATED*
-static void fix_pin(uint8_t port) {
-    // To emulate port feedback to PIN register, copy all PORT(OUTPUT) settings into the PIN register as well.
-    TEST_REGISTERS[(port*3)+0] = TEST_REGISTERS[(port*3)+1] & TEST_REGISTERS[(port*3)+2];
-}
-
-// transfer PIN set-bits to flip corresponding PORT outputs then clear PIN
-static void fix_port(uint8_t port) {
-    uint8_t pin = TEST_REGISTERS[(port*3)+0];
-    TEST_REGISTERS[(port*3)+0] = 0;
-    pin &= TEST_REGISTERS[(port*3)+1]; // mask out all inputs
-    TEST_REGISTERS[(port*3)+2] ^= pin;  // flip outputs
-}
-
 static void dump_port( uint8_t port ) {
     if (port < TEST_PORT_COUNT) {
         
@@ -88,16 +67,16 @@ static void dump_port( uint8_t port ) {
         
         printf("      [HH] (76543210)\n");
 
-        printf("  PIN [%02x] (", TEST_REGISTERS[(port*3)+0]);
-        print_bin_byte(TEST_REGISTERS[(port*3)+0]);
+        printf("  PIN [%02x] (", T_PIN(port));
+        print_bin_byte(T_PIN(port));
         printf(")\n");
         
-        printf("  DDR [%02x] (", TEST_REGISTERS[(port*3)+1]);
-        print_bin_byte(TEST_REGISTERS[(port*3)+1]);
+        printf("  DDR [%02x] (", T_DDR(port));
+        print_bin_byte(T_DDR(port));
         printf(")\n");
         
-        printf(" PORT [%02x] (", TEST_REGISTERS[(port*3)+2]);
-        print_bin_byte(TEST_REGISTERS[(port*3)+2]);
+        printf(" PORT [%02x] (", T_PORT(port));
+        print_bin_byte(T_PORT(port));
         printf(")\n");
         
         printf("\n");
@@ -105,6 +84,7 @@ static void dump_port( uint8_t port ) {
 }
 
 static int thndl = 1;
+static int tportf = 0;  /* PortF handle, test_gpio_batch -> test_gpio_release */
 
 void test_gpio_bits(void) {
     //int var;
@@ -214,12 +194,12 @@ void test_gpio_bits(void) {
     CU_ASSERT_FATAL ( TEST_REGISTERS[(PM_PORT_A*3)+1] == 0x10 );
     CU_ASSERT_FATAL ( TEST_REGISTERS[(PM_PORT_A*3)+2] == 0x43 );
 
-    printf("Toggle bit 4 (simulated, check PINA4 for change)\n");
+    printf("Toggle bit 4 (PINA4 write flips PORTA4)\n");
     CU_ASSERT_FATAL ( (TEST_REGISTERS[(PM_PORT_A*3)+0] & 0x10) == 0 );
     CU_ASSERT_FATAL ( pm_tog(pa4) == PM_SUCCESS );
     CU_ASSERT_FATAL ( (TEST_REGISTERS[(PM_PORT_A*3)+0] & 0x10) == 0x10 );
+    CU_ASSERT_FATAL ( TEST_REGISTERS[(PM_PORT_A*3)+2] == 0x53 );
     dump_port(PM_PORT_A);
-    TEST_REGISTERS[(PM_PORT_A*3)+0] = 0;
     
     printf("[test_gpio_bits] - COMPLETED\n");
     //s_setmode_pin(s_portstatus * pp, uint8_t pin, uint8_t mode)
@@ -237,7 +217,7 @@ void test_gpio_port(void) {
     dump_port(PM_PORT_B);
     /* port a should not have changed */
     CU_ASSERT_FATAL ( TEST_REGISTERS[(PM_PORT_A*3)+1] == 0x10 );
-    CU_ASSERT_FATAL ( TEST_REGISTERS[(PM_PORT_A*3)+2] == 0x43 );
+    CU_ASSERT_FATAL ( TEST_REGISTERS[(PM_PORT_A*3)+2] == 0x53 );
     /* initial portb assignments */
     CU_ASSERT_FATAL ( TEST_REGISTERS[(PM_PORT_B*3)+1] == 0xff );
     CU_ASSERT_FATAL ( TEST_REGISTERS[(PM_PORT_B*3)+2] == 0xaa );
@@ -253,7 +233,6 @@ void test_gpio_port(void) {
     port_general = 0;
 
     printf("Read PortB \n");
-    fix_pin(PM_PORT_B);  // have to call this as PIN reg is simulated.
     var = pm_in(portb);
     CU_ASSERT_FATAL ( pm_dir(portb) == PINDIR_OUTPUT );
     dump_port(PM_PORT_B);
@@ -261,20 +240,19 @@ void test_gpio_port(void) {
     
     printf("Write PortB \n");
     CU_ASSERT_FATAL ( pm_out(portb,0x15) == PM_SUCCESS );
-    fix_pin(PM_PORT_B); 
     CU_ASSERT_FATAL ( pm_dir(portb) == PINDIR_OUTPUT );
     CU_ASSERT_FATAL ( TEST_REGISTERS[(PM_PORT_B*3)+1] == 0xff );
     CU_ASSERT_FATAL ( TEST_REGISTERS[(PM_PORT_B*3)+2] == 0x15 );
     dump_port(PM_PORT_B);
 
-    printf("Toggle PortB (simulated, check PINB - all outputs will flip\n");
+    printf("Toggle PortB (all outputs will flip)\n");
     CU_ASSERT_FATAL ( TEST_REGISTERS[(PM_PORT_B*3)+0] == 0x15 );
     CU_ASSERT_FATAL ( pm_tog(portb) == PM_SUCCESS );
     CU_ASSERT_FATAL ( pm_dir(portb) == PINDIR_OUTPUT );
-    CU_ASSERT_FATAL ( TEST_REGISTERS[(PM_PORT_B*3)+0] == 0xff ); // PINB
-    fix_port(PM_PORT_B); // use PINx to flip PORTx, zero PINx if outputs
+    CU_ASSERT_FATAL ( TEST_REGISTERS[(PM_PORT_B*3)+0] == 0xea ); // PINB
+    CU_ASSERT_FATAL ( TEST_REGISTERS[(PM_PORT_B*3)+2] == 0xea ); // PORTB
+    CU_ASSERT_FATAL ( pm_in(portb) == 0xea );
     dump_port(PM_PORT_B);
-    TEST_REGISTERS[(PM_PORT_B*3)+0] = 0;
     
     printf("Change PortB to all inputs\n");
     CU_ASSERT_FATAL ( pm_chg_dir(portb,PINMODE_INPUT_TRI) == PM_SUCCESS );
@@ -282,6 +260,325 @@ void test_gpio_port(void) {
     dump_port(PM_PORT_B);
 }
 
+void test_gpio_extports(void) {
+    int pl2, ph3, portk, portg;
+
+    printf("\n");
+    printf("[test_gpio_extports] PortG,H,K,L -------------------------\n");
+
+    printf("PortL - extended I/O space (0x109..0x10B)\n");
+    pl2 = pm_register_pin(PM_PORT_L, PM_PIN_2, PINMODE_INPUT_TRI);
+    CU_ASSERT_FATAL ( pl2 == thndl++ );
+    CU_ASSERT_FATAL ( emu_port_reg(PM_PORT_L, EMU_REG_PIN) == &(TEST_REGISTERS[0x109 - EMU_IO_BASE]) );
+    CU_ASSERT_FATAL ( pm_dir(pl2) == PINDIR_INPUT );
+    CU_ASSERT_FATAL ( pm_in(pl2) == 0 );     /* floating */
+    printf("Drive PL2 high from outside\n");
+    CU_ASSERT_FATAL ( emu_pin_drive(PM_PORT_L, 0x04, 0x04) == PM_SUCCESS );
+    CU_ASSERT_FATAL ( pm_in(pl2) == 1 );
+    CU_ASSERT_FATAL ( emu_pin_release(PM_PORT_L, 0x04) == PM_SUCCESS );
+    CU_ASSERT_FATAL ( pm_in(pl2) == 0 );
+    dump_port(PM_PORT_L);
+
+    printf("PortH - pullup input, global pullup disable (MCUCR.PUD)\n");
+    ph3 = pm_register_pin(PM_PORT_H, PM_PIN_3, PINMODE_INPUT_PU);
+    CU_ASSERT_FATAL ( ph3 == thndl++ );
+    CU_ASSERT_FATAL ( TEST_REGISTERS[0x102 - EMU_IO_BASE] == 0x08 ); /* PORTH */
+    CU_ASSERT_FATAL ( pm_in(ph3) == 1 );
+    CU_ASSERT_FATAL ( pm_glb_pup_control(PM_PUP_DISABLED) == PM_SUCCESS );
+    CU_ASSERT_FATAL ( (MCUCR & (1<<PUD)) != 0 );
+    CU_ASSERT_FATAL ( pm_in(ph3) == 0 );
+    CU_ASSERT_FATAL ( pm_glb_pup_control(PM_PUP_ENABLED) == PM_SUCCESS );
+    CU_ASSERT_FATAL ( pm_in(ph3) == 1 );
+    printf("Drive PH3 low, overrides the pullup\n");
+    emu_pin_drive(PM_PORT_H, 0x08, 0x00);
+    CU_ASSERT_FATAL ( pm_in(ph3) == 0 );
+    emu_pin_release(PM_PORT_H, 0x08);
+    dump_port(PM_PORT_H);
+
+    printf("PortK - full port, write and toggle\n");
+    portk = pm_register_prt(PM_PORT_K, 0x81, PINMODE_OUTPUT_LO);
+    CU_ASSERT_FATAL ( portk == thndl++ );
+    CU_ASSERT_FATAL ( TEST_REGISTERS[0x107 - EMU_IO_BASE] == 0xff ); /* DDRK */
+    CU_ASSERT_FATAL ( pm_in(portk) == 0x81 );
+    CU_ASSERT_FATAL ( pm_tog(portk) == PM_SUCCESS );
+    CU_ASSERT_FATAL ( T_PORT(PM_PORT_K) == 0x7e );
+    CU_ASSERT_FATAL ( pm_in(portk) == 0x7e );
+    dump_port(PM_PORT_K);
+
+    printf("PortG - 6 pins only\n");
+    portg = pm_register_prt(PM_PORT_G, 0xff, PINMODE_OUTPUT_HI);
+    CU_ASSERT_FATAL ( portg == thndl++ );
+    CU_ASSERT_FATAL ( pm_in(portg) == 0x3f );
+    CU_ASSERT_FATAL ( pm_register_pin(PM_PORT_G, PM_PIN_6, PINMODE_UNCHANGED) == PM_ERROR );
+    dump_port(PM_PORT_G);
+}
+
+static int hook_events[EMU_EV_ALL+1];
+
+static void test_hook_fn(uint8_t port, uint8_t event, void * ctx) {
+    hook_events[event]++;
+    if (event == EMU_EV_PIN_RD && ctx) {
+        /* model: PJ7 follows PJ0 */
+        emu_pin_drive(PM_PORT_J, 0x80, (emu_pin_level(PM_PORT_J) & 0x01) << 7);
+    }
+}
+
+void test_gpio_hooks(void) {
+    int pj0, pj7, hk;
+
+    printf("\n");
+    printf("[test_gpio_hooks] PortJ model hooks -------------------------\n");
+    memset(hook_events, 0, sizeof(hook_events));
+
+    hk = emu_hook_add(PM_PORT_J, EMU_EV_ALL, test_hook_fn, (void *)1);
+    CU_ASSERT_FATAL ( hk > 0 );
+    CU_ASSERT_FATAL ( emu_hook_add(PM_PORT_J, 0, test_hook_fn, NULL) == PM_ERROR );
+    CU_ASSERT_FATAL ( emu_hook_add(TEST_PORT_COUNT, EMU_EV_ALL, test_hook_fn, NULL) == PM_ERROR );
+
+    pj0 = pm_register_pin(PM_PORT_J, PM_PIN_0, PINMODE_OUTPUT_LO);
+    CU_ASSERT_FATAL ( pj0 == thndl++ );
+    CU_ASSERT_FATAL ( hook_events[EMU_EV_DDR_WR] > 0 );
+    pj7 = pm_register_pin(PM_PORT_J, PM_PIN_7, PINMODE_INPUT_TRI);
+    CU_ASSERT_FATAL ( pj7 == thndl++ );
+
+    printf("Write PJ0, PJ7 follows through the hook\n");
+    hook_events[EMU_EV_PORT_WR] = 0;
+    CU_ASSERT_FATAL ( pm_out(pj0, 1) == PM_SUCCESS );
+    CU_ASSERT_FATAL ( hook_events[EMU_EV_PORT_WR] == 1 );
+    CU_ASSERT_FATAL ( pm_in(pj7) == 1 );
+    CU_ASSERT_FATAL ( hook_events[EMU_EV_PIN_RD] > 0 );
+    CU_ASSERT_FATAL ( hook_events[EMU_EV_EXT] == 0 );   /* not re-entered */
+    CU_ASSERT_FATAL ( pm_tog(pj0) == PM_SUCCESS );
+    CU_ASSERT_FATAL ( hook_events[EMU_EV_PORT_WR] == 2 );
+    CU_ASSERT_FATAL ( pm_in(pj7) == 0 );
+
+    printf("External drive\n");
+    emu_pin_drive(PM_PORT_J, 0x02, 0x02);
+    CU_ASSERT_FATAL ( hook_events[EMU_EV_EXT] == 1 );
+    emu_pin_release(PM_PORT_J, 0x82);
+    CU_ASSERT_FATAL ( hook_events[EMU_EV_EXT] == 2 );
+
+    printf("Remove hook\n");
+    CU_ASSERT_FATAL ( emu_hook_remove(hk) == PM_SUCCESS );
+    CU_ASSERT_FATAL ( emu_hook_remove(hk) == PM_ERROR );
+    CU_ASSERT_FATAL ( pm_out(pj0, 1) == PM_SUCCESS );
+    CU_ASSERT_FATAL ( hook_events[EMU_EV_PORT_WR] == 2 );
+    CU_ASSERT_FATAL ( pm_in(pj7) == 0 );
+    dump_port(PM_PORT_J);
+}
+
+void test_gpio_static(void) {
+    int pd3, pd5, porte, pl6;
+
+    printf("\n");
+    printf("[test_gpio_static] Static pins, PortD,E,L ------------------\n");
+    CU_ASSERT_FATAL ( PM_S_ADDR_PIN(PM_PORT_A) == 0x20 );
+    CU_ASSERT_FATAL ( PM_S_ADDR_PIN(PM_PORT_G) == 0x32 );
+    CU_ASSERT_FATAL ( PM_S_ADDR_PIN(PM_PORT_H) == 0x100 );
+    CU_ASSERT_FATAL ( PM_S_ADDR_PRT(PM_PORT_L) == 0x10B );
+
+    printf("Registered with the API, driven without the handle\n");
+    pd3 = pm_register_pin(PM_PORT_D, PM_PIN_3, PINMODE_OUTPUT_LO);
+    CU_ASSERT_FATAL ( pd3 == thndl++ );
+    pd5 = pm_register_pin(PM_PORT_D, PM_PIN_5, PINMODE_INPUT_TRI);
+    CU_ASSERT_FATAL ( pd5 == thndl++ );
+    CU_ASSERT_FATAL ( pm_static(pd3) == PM_SUCCESS );
+    CU_ASSERT_FATAL ( pm_static(thndl + 5) == PM_ERROR );
+    pm_s_set(PM_PORT_D, PM_PIN_3);
+    CU_ASSERT_FATAL ( T_PORT(PM_PORT_D) == 0x08 );
+    CU_ASSERT_FATAL ( pm_in(pd3) == 1 );
+    CU_ASSERT_FATAL ( pm_s_in(PM_PORT_D, PM_PIN_3) == 1 );
+    pm_s_out(PM_PORT_D, PM_PIN_3, 0);
+    CU_ASSERT_FATAL ( pm_s_in(PM_PORT_D, PM_PIN_3) == 0 );
+    pm_s_tog(PM_PORT_D, PM_PIN_3);
+    CU_ASSERT_FATAL ( T_PORT(PM_PORT_D) == 0x08 );
+    pm_s_tog(PM_PORT_D, PM_PIN_3);
+    CU_ASSERT_FATAL ( T_PORT(PM_PORT_D) == 0x00 );
+    printf("Input pin, neighbour writes leave it alone\n");
+    emu_pin_drive(PM_PORT_D, 0x20, 0x20);
+    CU_ASSERT_FATAL ( pm_s_in(PM_PORT_D, PM_PIN_5) == 1 );
+    pm_s_set(PM_PORT_D, PM_PIN_3);
+    CU_ASSERT_FATAL ( T_PORT(PM_PORT_D) == 0x08 );  /* no pullup on PD5 */
+    CU_ASSERT_FATAL ( pm_in(pd5) == 1 );
+    emu_pin_release(PM_PORT_D, 0x20);
+    CU_ASSERT_FATAL ( pm_s_in(PM_PORT_D, PM_PIN_5) == 0 );
+    dump_port(PM_PORT_D);
+
+    printf("PortE - full port, direction and data\n");
+    porte = pm_register_prt(PM_PORT_E, 0, PINMODE_INPUT_TRI);
+    CU_ASSERT_FATAL ( porte == thndl++ );
+    CU_ASSERT_FATAL ( pm_static(porte) == PM_SUCCESS );
+    pm_s_prt_out(PM_PORT_E, 0xa5);
+    pm_s_prt_dir(PM_PORT_E, 0xff);
+    CU_ASSERT_FATAL ( pm_dir(porte) == PINDIR_OUTPUT );
+    CU_ASSERT_FATAL ( pm_s_prt_in(PM_PORT_E) == 0xa5 );
+    CU_ASSERT_FATAL ( pm_in(porte) == 0xa5 );
+    pm_s_prt_dir(PM_PORT_E, 0x00);
+    pm_s_prt_out(PM_PORT_E, 0x00);
+    emu_pin_drive(PM_PORT_E, 0xff, 0x3c);
+    CU_ASSERT_FATAL ( pm_s_prt_in(PM_PORT_E) == 0x3c );
+    emu_pin_release(PM_PORT_E, 0xff);
+    CU_ASSERT_FATAL ( pm_s_prt_in(PM_PORT_E) == 0x00 );
+    dump_port(PM_PORT_E);
+
+    printf("PortL - extended I/O space, toggle only touches its pin\n");
+    pl6 = pm_register_pin(PM_PORT_L, PM_PIN_6, PINMODE_OUTPUT_HI);
+    CU_ASSERT_FATAL ( pl6 == thndl++ );
+    CU_ASSERT_FATAL ( pm_static(pl6) == PM_SUCCESS );
+    CU_ASSERT_FATAL ( pm_s_in(PM_PORT_L, PM_PIN_6) == 1 );
+    pm_s_tog(PM_PORT_L, PM_PIN_6);
+    CU_ASSERT_FATAL ( pm_s_in(PM_PORT_L, PM_PIN_6) == 0 );
+    CU_ASSERT_FATAL ( (T_PORT(PM_PORT_L) & 0xbf) == 0 );
+    pm_s_out(PM_PORT_L, PM_PIN_6, 1);
+    CU_ASSERT_FATAL ( pm_in(pl6) == 1 );
+    dump_port(PM_PORT_L);
+}
+
+void test_gpio_batch(void) {
+    int pc0, pc1, pc7, pc4, portf;
+    pm_batch_t batch[4];
+
+    printf("\n");
+    printf("[test_gpio_batch] Batch output, PortC,F -----------------------\n");
+    pc0 = pm_register_pin(PM_PORT_C, PM_PIN_0, PINMODE_OUTPUT_LO);
+    CU_ASSERT_FATAL ( pc0 == thndl++ );
+    pc1 = pm_register_pin(PM_PORT_C, PM_PIN_1, PINMODE_OUTPUT_HI);
+    CU_ASSERT_FATAL ( pc1 == thndl++ );
+    pc7 = pm_register_pin(PM_PORT_C, PM_PIN_7, PINMODE_OUTPUT_LO);
+    CU_ASSERT_FATAL ( pc7 == thndl++ );
+    pc4 = pm_register_pin(PM_PORT_C, PM_PIN_4, PINMODE_INPUT_PU);
+    CU_ASSERT_FATAL ( pc4 == thndl++ );
+    portf = pm_register_prt(PM_PORT_F, 0x00, PINMODE_OUTPUT_LO);
+    CU_ASSERT_FATAL ( portf == thndl++ );
+    tportf = portf;
+    CU_ASSERT_FATAL ( T_PORT(PM_PORT_C) == 0x12 );
+
+    printf("Masked port write, one PORTx write\n");
+    hook_events[EMU_EV_PORT_WR] = 0;
+    CU_ASSERT_FATAL ( emu_hook_add(PM_PORT_C, EMU_EV_PORT_WR, test_hook_fn, NULL) > 0 );
+    CU_ASSERT_FATAL ( pm_port_write_masked(PM_PORT_C, 0x83, 0x81) == PM_SUCCESS );
+    CU_ASSERT_FATAL ( hook_events[EMU_EV_PORT_WR] == 1 );
+    CU_ASSERT_FATAL ( T_PORT(PM_PORT_C) == 0x91 );  /* PC4 pullup kept */
+    CU_ASSERT_FATAL ( pm_port_write_masked(PM_PORT_C, 0x00, 0xff) == PM_SUCCESS );
+    CU_ASSERT_FATAL ( hook_events[EMU_EV_PORT_WR] == 1 );
+    printf("Unregistered or missing pins are refused\n");
+    CU_ASSERT_FATAL ( pm_port_write_masked(PM_PORT_C, 0x04, 0x04) == PM_ERROR );
+    CU_ASSERT_FATAL ( pm_port_write_masked(PM_PORT_G, 0x40, 0x40) == PM_ERROR );
+    CU_ASSERT_FATAL ( pm_port_write_masked(PORT_COUNT, 0x01, 0x01) == PM_ERROR );
+    CU_ASSERT_FATAL ( T_PORT(PM_PORT_C) == 0x91 );
+
+    printf("Batch across handles and ports\n");
+    batch[0].hndl = pc0;    batch[0].value = 0;
+    batch[1].hndl = portf;  batch[1].value = 0x5a;
+    batch[2].hndl = pc1;    batch[2].value = 1;
+    batch[3].hndl = pc7;    batch[3].value = 0;
+    hook_events[EMU_EV_PORT_WR] = 0;
+    CU_ASSERT_FATAL ( pm_out_batch(batch, 4) == PM_SUCCESS );
+    CU_ASSERT_FATAL ( hook_events[EMU_EV_PORT_WR] == 1 );  /* PortC once */
+    CU_ASSERT_FATAL ( T_PORT(PM_PORT_C) == 0x12 );
+    CU_ASSERT_FATAL ( pm_in(portf) == 0x5a );
+    printf("Later entry for the same pin wins\n");
+    batch[3].hndl = pc0;    batch[3].value = 1;
+    CU_ASSERT_FATAL ( pm_out_batch(batch, 4) == PM_SUCCESS );
+    CU_ASSERT_FATAL ( pm_in(pc0) == 1 );
+    printf("A pulled-up input in the batch keeps its pullup\n");
+    batch[0].hndl = pc4;    batch[0].value = 0;
+    CU_ASSERT_FATAL ( pm_out_batch(batch, 4) == PM_SUCCESS );
+    CU_ASSERT_FATAL ( T_PORT(PM_PORT_C) == 0x13 );
+    CU_ASSERT_FATAL ( pm_out(pc4, 0) == PM_SUCCESS );
+    CU_ASSERT_FATAL ( T_PORT(PM_PORT_C) == 0x13 );     /* as pm_out() */
+    printf("An invalid handle writes nothing\n");
+    batch[1].value = 0xa5;
+    batch[3].hndl = thndl + 5;
+    CU_ASSERT_FATAL ( pm_out_batch(batch, 4) == PM_ERROR );
+    CU_ASSERT_FATAL ( pm_in(portf) == 0x5a );
+    CU_ASSERT_FATAL ( pm_out_batch(NULL, 1) == PM_ERROR );
+    CU_ASSERT_FATAL ( pm_out_batch(batch, 0) == PM_SUCCESS );
+    emu_hook_clear();
+    dump_port(PM_PORT_C);
+    dump_port(PM_PORT_F);
+}
+
+void test_gpio_shadow(void) {
+    int pc5, pc6, pd7;
+
+    printf("\n");
+    printf("[test_gpio_shadow] Shadow PORTx/DDRx, PortC,D ------------------\n");
+    printf("Direction from the shadow, DDRC changed behind the API\n");
+    pc5 = pm_register_pin(PM_PORT_C, PM_PIN_5, PINMODE_OUTPUT_LO);
+    CU_ASSERT_FATAL ( pc5 == thndl++ );
+    T_DDR(PM_PORT_C) &= (uint8_t)~0x20;    /* poke, no API */
+    CU_ASSERT_FATAL ( pm_dir(pc5) == PINDIR_OUTPUT );
+    printf("Next write puts back what the API wrote\n");
+    T_PORT(PM_PORT_C) = 0x00;
+    CU_ASSERT_FATAL ( pm_out(pc5, 1) == PM_SUCCESS );
+    CU_ASSERT_FATAL ( T_PORT(PM_PORT_C) == 0x33 );  /* PC0,1 hi, PC4 pullup, PC5 */
+    CU_ASSERT_FATAL ( pm_chg_dir(pc5, PINMODE_OUTPUT_LO) == PM_SUCCESS );
+    CU_ASSERT_FATAL ( T_DDR(PM_PORT_C) == 0xa3 );
+    printf("Toggle keeps the shadow in step\n");
+    CU_ASSERT_FATAL ( pm_tog(pc5) == PM_SUCCESS );
+    CU_ASSERT_FATAL ( T_PORT(PM_PORT_C) == 0x33 );
+    pc6 = pm_register_pin(PM_PORT_C, PM_PIN_6, PINMODE_OUTPUT_LO);
+    CU_ASSERT_FATAL ( pc6 == thndl++ );
+    CU_ASSERT_FATAL ( T_PORT(PM_PORT_C) == 0x33 );
+    CU_ASSERT_FATAL ( pm_port_write_masked(PM_PORT_C, 0x60, 0x40) == PM_SUCCESS );
+    CU_ASSERT_FATAL ( T_PORT(PM_PORT_C) == 0x53 );
+    printf("Static pins are read back\n");
+    pd7 = pm_register_pin(PM_PORT_D, PM_PIN_7, PINMODE_OUTPUT_LO);
+    CU_ASSERT_FATAL ( pd7 == thndl++ );
+    pm_s_set(PM_PORT_D, PM_PIN_3);      /* PD3 is pm_static() */
+    CU_ASSERT_FATAL ( pm_out(pd7, 1) == PM_SUCCESS );
+    CU_ASSERT_FATAL ( T_PORT(PM_PORT_D) == 0x88 );
+    pm_s_clr(PM_PORT_D, PM_PIN_3);
+    CU_ASSERT_FATAL ( pm_out(pd7, 0) == PM_SUCCESS );
+    CU_ASSERT_FATAL ( T_PORT(PM_PORT_D) == 0x00 );
+    dump_port(PM_PORT_C);
+    dump_port(PM_PORT_D);
+}
+
+void test_gpio_release(void) {
+    int ph0, ph1, nh0, ph4, pf2, portf;
+    uint8_t peak;
+
+    printf("\n");
+    printf("[test_gpio_release] Release and reuse, PortF,H -----------------\n");
+    ph0 = pm_register_pin(PM_PORT_H, PM_PIN_0, PINMODE_OUTPUT_LO);
+    CU_ASSERT_FATAL ( ph0 == thndl++ );
+    ph1 = pm_register_pin(PM_PORT_H, PM_PIN_1, PINMODE_OUTPUT_LO);
+    CU_ASSERT_FATAL ( ph1 == thndl++ );
+    printf("Released handle is dead\n");
+    CU_ASSERT_FATAL ( pm_release(ph0) == PM_SUCCESS );
+    CU_ASSERT_FATAL ( pm_release(ph0) == PM_ERROR );
+    CU_ASSERT_FATAL ( pm_dir(ph0) == PINDIR_ERROR );
+    CU_ASSERT_FATAL ( pm_out(ph0, 1) == PM_ERROR );
+    CU_ASSERT_FATAL ( pm_release(0) == PM_ERROR );
+    CU_ASSERT_FATAL ( pm_release(0x100) == PM_ERROR );
+    printf("Pin and slot are reused, the handle is not\n");
+    nh0 = pm_register_pin(PM_PORT_H, PM_PIN_0, PINMODE_OUTPUT_HI);
+    CU_ASSERT_FATAL ( nh0 == ph0 + 0x100 );
+    CU_ASSERT_FATAL ( pm_dir(nh0) == PINDIR_OUTPUT );
+    CU_ASSERT_FATAL ( pm_out(ph0, 0) == PM_ERROR );
+    CU_ASSERT_FATAL ( (T_PORT(PM_PORT_H) & 0x01) == 0x01 );
+    printf("Top of the table shrinks, free slots below it too\n");
+    peak = pm_rsvd_peak();
+    CU_ASSERT_FATAL ( peak == (uint8_t)(ph1 & 0xff) );
+    CU_ASSERT_FATAL ( pm_release(nh0) == PM_SUCCESS );
+    CU_ASSERT_FATAL ( pm_release(ph1) == PM_SUCCESS );
+    ph4 = pm_register_pin(PM_PORT_H, PM_PIN_4, PINMODE_INPUT_TRI);
+    CU_ASSERT_FATAL ( ph4 == ph0 + 0x200 );
+    CU_ASSERT_FATAL ( pm_rsvd_peak() == peak );
+    printf("Port handle: all pins unlocked\n");
+    portf = tportf;
+    CU_ASSERT_FATAL ( pm_register_pin(PM_PORT_F, PM_PIN_2, PINMODE_UNCHANGED) == PM_ERROR );
+    CU_ASSERT_FATAL ( pm_release(portf) == PM_SUCCESS );
+    pf2 = pm_register_pin(PM_PORT_F, PM_PIN_2, PINMODE_OUTPUT_LO);
+    CU_ASSERT_FATAL ( pf2 == portf + 0x100 );
+    CU_ASSERT_FATAL ( pm_register_prt(PM_PORT_F, 0, PINMODE_INPUT_TRI) == PM_ERROR );
+    CU_ASSERT_FATAL ( pm_out(portf, 0xff) == PM_ERROR );
+    CU_ASSERT_FATAL ( pm_release(pf2) == PM_SUCCESS );
+    CU_ASSERT_FATAL ( pm_release(ph4) == PM_SUCCESS );
+}
+
 int main() {
 	// system init
 	printf("{TDD} System Init...\n");
@@ -291,7 +588,7 @@ int main() {
     if (CUE_SUCCESS != CU_initialize_registry())
         return CU_get_error();
         
-    pSuite = CU_add_suite("Test Suite - GPIO API (PortA,B 8-bits each)", init_suite, clean_suite);
+    pSuite = CU_add_suite("Test Suite - GPIO API (PortA..L)", init_suite, clean_suite);
     if (pSuite == NULL) {
         CU_cleanup_registry();
         return CU_get_error();
@@ -305,6 +602,30 @@ int main() {
         CU_cleanup_registry();
         return CU_get_error();
     }
+    if ( !CU_add_test(pSuite, "[GPIO_API] Extended ports (G..L)", test_gpio_extports) ) {
+        CU_cleanup_registry();
+        return CU_get_error();
+    }
+    if ( !CU_add_test(pSuite, "[GPIO_API] Emulation model hooks", test_gpio_hooks) ) {
+        CU_cleanup_registry();
+        return CU_get_error();
+    }
+    if ( !CU_add_test(pSuite, "[GPIO_API] Static (compile-time) pins", test_gpio_static) ) {
+        CU_cleanup_registry();
+        return CU_get_error();
+    }
+    if ( !CU_add_test(pSuite, "[GPIO_API] Batch and masked port writes", test_gpio_batch) ) {
+        CU_cleanup_registry();
+        return CU_get_error();
+    }
+    if ( !CU_add_test(pSuite, "[GPIO_API] Shadow registers", test_gpio_shadow) ) {
+        CU_cleanup_registry();
+        return CU_get_error();
+    }
+    if ( !CU_add_test(pSuite, "[GPIO_API] Release, handle reuse", test_gpio_release) ) {
+        CU_cleanup_registry();
+        return CU_get_error();
+    }
 
     CU_basic_set_mode(CU_BRM_VERBOSE);
     CU_basic_run_tests();
@@ -0,0 +1,227 @@
+/*
+ * test_gpioevent.c
+ *
+ * TDD For avrlib/(GPIO pin change and external interrupt events)
+ * Emulated build: edges are made with emu_pin_drive(), the event code
+ * runs from a port hook in place of the INTn/PCINT vectors. Virtual
+ * time, debounce lockouts are stepped with tm_emu_advance().
+ *
+ * Supports lib ver: 1.0
+ *
+ */
+
+#include <avrlib/gpio_event.h>
+#include <avrlib/gpio_emu.h>
+#include <avrlib/libtime.h>
+#include <stdio.h>
+#include <string.h>
+#include <CUnit/CUnit.h>
+#include <CUnit/Basic.h>
+
+#define EV_LOG_LEN  32
+
+static int     ev_hndl[EV_LOG_LEN];
+static uint8_t ev_level[EV_LOG_LEN];
+static int     ev_count = 0;
+
+static void ev_log(int hndl, uint8_t level, void * ctx) {
+    (void)ctx;
+    if (ev_count < EV_LOG_LEN) {
+        ev_hndl[ev_count] = hndl;
+        ev_level[ev_count] = level;
+    }
+    ev_count++;
+}
+
+static void ev_clear(void) {
+    ev_count = 0;
+    memset(ev_hndl, 0, sizeof(ev_hndl));
+    memset(ev_level, 0, sizeof(ev_level));
+}
+
+// ======== TEST SUITE ================================================
+
+int init_suite(void) {
+    tm_emu_virtual(1);
+    pm_init();
+    return 0;
+}
+
+int clean_suite(void) {
+    return 0;
+}
+
+void test_event_register(void) {
+    int pd2, pl2, portb;
+
+    printf("\n");
+    printf("[test_event_register] ---------------------------------------\n");
+    pd2 = pm_register_pin(PM_PORT_D, PM_PIN_2, PINMODE_INPUT_TRI);
+    pl2 = pm_register_pin(PM_PORT_L, PM_PIN_2, PINMODE_INPUT_TRI);
+    portb = pm_register_prt(PM_PORT_B, 0, PINMODE_INPUT_TRI);
+    CU_ASSERT_FATAL ( pd2 > 0 && pl2 > 0 && portb > 0 );
+
+    printf("PL2 has no INTn/PCINT, ports and bad arguments are refused\n");
+    CU_ASSERT_FATAL ( pm_register_event(pl2, PM_EDGE_BOTH, 0, ev_log, NULL) == PM_ERROR );
+    CU_ASSERT_FATAL ( pm_register_event(portb, PM_EDGE_BOTH, 0, ev_log, NULL) == PM_ERROR );
+    CU_ASSERT_FATAL ( pm_register_event(pd2, PM_EDGE_BOTH, 0, NULL, NULL) == PM_ERROR );
+    CU_ASSERT_FATAL ( pm_register_event(pd2, PM_EV_DEFER, 0, ev_log, NULL) == PM_ERROR );
+    CU_ASSERT_FATAL ( pm_register_event(99, PM_EDGE_BOTH, 0, ev_log, NULL) == PM_ERROR );
+
+    printf("PD2 (INT2), once\n");
+    CU_ASSERT_FATAL ( pm_register_event(pd2, PM_EDGE_BOTH, 0, ev_log, NULL) == PM_SUCCESS );
+    CU_ASSERT_FATAL ( pm_register_event(pd2, PM_EDGE_RISING, 0, ev_log, NULL) == PM_ERROR );
+    CU_ASSERT_FATAL ( pm_release_event(pd2) == PM_SUCCESS );
+    CU_ASSERT_FATAL ( pm_release_event(pd2) == PM_ERROR );
+    CU_ASSERT_FATAL ( pm_release_event(pl2) == PM_ERROR );
+}
+
+void test_event_isr(void) {
+    int pd3;
+
+    printf("\n");
+    printf("[test_event_isr] ---------------------------------------------\n");
+    ev_clear();
+    pd3 = pm_register_pin(PM_PORT_D, PM_PIN_3, PINMODE_INPUT_TRI);
+    CU_ASSERT_FATAL ( pm_register_event(pd3, PM_EDGE_RISING | PM_EV_ISR, 0, ev_log, NULL) == PM_SUCCESS );
+
+    printf("Rising edge, called at once\n");
+    emu_pin_drive(PM_PORT_D, 0x08, 0x08);
+    CU_ASSERT_FATAL ( ev_count == 1 );
+    CU_ASSERT_FATAL ( ev_hndl[0] == pd3 && ev_level[0] == 1 );
+    printf("Falling edge is not asked for, other pins do not count\n");
+    emu_pin_drive(PM_PORT_D, 0x08, 0x00);
+    emu_pin_drive(PM_PORT_D, 0x10, 0x10);
+    emu_pin_release(PM_PORT_D, 0x10);
+    CU_ASSERT_FATAL ( ev_count == 1 );
+    emu_pin_drive(PM_PORT_D, 0x08, 0x08);
+    CU_ASSERT_FATAL ( ev_count == 2 );
+    pm_event_poll();
+    CU_ASSERT_FATAL ( ev_count == 2 );
+    CU_ASSERT_FATAL ( pm_release_event(pd3) == PM_SUCCESS );
+    emu_pin_release(PM_PORT_D, 0x08);
+    CU_ASSERT_FATAL ( ev_count == 2 );
+}
+
+void test_event_defer(void) {
+    int pk6, pj0, i;
+
+    printf("\n");
+    printf("[test_event_defer] -------------------------------------------\n");
+    ev_clear();
+    pk6 = pm_register_pin(PM_PORT_K, PM_PIN_6, PINMODE_INPUT_TRI);
+    pj0 = pm_register_pin(PM_PORT_J, PM_PIN_0, PINMODE_INPUT_PU);
+    CU_ASSERT_FATAL ( pm_register_event(pk6, PM_EDGE_BOTH | PM_EV_DEFER, 0, ev_log, NULL) == PM_SUCCESS );
+    CU_ASSERT_FATAL ( pm_register_event(pj0, PM_EDGE_FALLING | PM_EV_DEFER, 0, ev_log, NULL) == PM_SUCCESS );
+
+    printf("Queued, run in order by pm_event_poll()\n");
+    emu_pin_drive(PM_PORT_K, 0x40, 0x40);
+    emu_pin_drive(PM_PORT_J, 0x01, 0x00);
+    emu_pin_drive(PM_PORT_K, 0x40, 0x00);
+    CU_ASSERT_FATAL ( ev_count == 0 );
+    pm_event_poll();
+    CU_ASSERT_FATAL ( ev_count == 3 );
+    CU_ASSERT_FATAL ( ev_hndl[0] == pk6 && ev_level[0] == 1 );
+    CU_ASSERT_FATAL ( ev_hndl[1] == pj0 && ev_level[1] == 0 );
+    CU_ASSERT_FATAL ( ev_hndl[2] == pk6 && ev_level[2] == 0 );
+
+    printf("Full queue drops and counts\n");
+    ev_clear();
+    CU_ASSERT_FATAL ( pm_event_lost() == 0 );
+    for ( i = 0 ; i < PM_EV_QLEN + 2 ; ++i ) {
+        emu_pin_drive(PM_PORT_K, 0x40, (i & 1) ? 0x00 : 0x40);
+    }
+    CU_ASSERT_FATAL ( pm_event_lost() == 2 );
+    pm_event_poll();
+    CU_ASSERT_FATAL ( ev_count == PM_EV_QLEN );
+
+    printf("Release drops queued edges of the pin\n");
+    ev_clear();
+    emu_pin_drive(PM_PORT_K, 0x40, 0x40);
+    emu_pin_release(PM_PORT_J, 0x01);           /* pullup, rising: not asked for */
+    emu_pin_drive(PM_PORT_J, 0x01, 0x00);
+    CU_ASSERT_FATAL ( pm_release_event(pk6) == PM_SUCCESS );
+    pm_event_poll();
+    CU_ASSERT_FATAL ( ev_count == 1 );
+    CU_ASSERT_FATAL ( ev_hndl[0] == pj0 );
+    CU_ASSERT_FATAL ( pm_release_event(pj0) == PM_SUCCESS );
+    emu_pin_release(PM_PORT_K, 0x40);
+    emu_pin_release(PM_PORT_J, 0x01);
+}
+
+void test_event_debounce(void) {
+    int pe4;
+
+    printf("\n");
+    printf("[test_event_debounce] ----------------------------------------\n");
+    ev_clear();
+    pe4 = pm_register_pin(PM_PORT_E, PM_PIN_4, PINMODE_INPUT_PU);
+    CU_ASSERT_FATAL ( pm_register_event(pe4, PM_EDGE_BOTH | PM_EV_ISR, 10, ev_log, NULL) == PM_SUCCESS );
+
+    printf("First edge at once, bounces in the lockout ignored\n");
+    emu_pin_drive(PM_PORT_E, 0x10, 0x00);
+    CU_ASSERT_FATAL ( ev_count == 1 && ev_level[0] == 0 );
+    emu_pin_release(PM_PORT_E, 0x10);
+    emu_pin_drive(PM_PORT_E, 0x10, 0x00);
+    emu_pin_release(PM_PORT_E, 0x10);
+    tm_emu_advance(5000000ULL);
+    pm_event_poll();
+    CU_ASSERT_FATAL ( ev_count == 1 );
+    printf("Settled high after the lockout, delivered by pm_event_poll()\n");
+    tm_emu_advance(6000000ULL);
+    pm_event_poll();
+    CU_ASSERT_FATAL ( ev_count == 2 && ev_level[1] == 1 );
+    pm_event_poll();
+    CU_ASSERT_FATAL ( ev_count == 2 );
+
+    printf("Bounce that ends where it started: nothing more\n");
+    tm_emu_advance(11000000ULL);
+    emu_pin_drive(PM_PORT_E, 0x10, 0x00);
+    CU_ASSERT_FATAL ( ev_count == 3 && ev_level[2] == 0 );
+    emu_pin_release(PM_PORT_E, 0x10);
+    emu_pin_drive(PM_PORT_E, 0x10, 0x00);
+    tm_emu_advance(11000000ULL);
+    pm_event_poll();
+    CU_ASSERT_FATAL ( ev_count == 3 );
+    printf("Past the lockout, the next edge is taken at once\n");
+    emu_pin_release(PM_PORT_E, 0x10);
+    CU_ASSERT_FATAL ( ev_count == 4 && ev_level[3] == 1 );
+    CU_ASSERT_FATAL ( pm_release_event(pe4) == PM_SUCCESS );
+}
+
+int main() {
+	// system init
+	printf("{TDD} System Init...\n");
+
+    CU_pSuite pSuite = NULL;
+    if (CUE_SUCCESS != CU_initialize_registry())
+        return CU_get_error();
+
+    pSuite = CU_add_suite("Test Suite - GPIO events (INTn, PCINT)", init_suite, clean_suite);
+    if (pSuite == NULL) {
+        CU_cleanup_registry();
+        return CU_get_error();
+    }
+
+    if ( !CU_add_test(pSuite, "[GPIO_EVENT] Registration", test_event_register) ) {
+        CU_cleanup_registry();
+        return CU_get_error();
+    }
+    if ( !CU_add_test(pSuite, "[GPIO_EVENT] ISR delivery", test_event_isr) ) {
+        CU_cleanup_registry();
+        return CU_get_error();
+    }
+    if ( !CU_add_test(pSuite, "[GPIO_EVENT] Deferred delivery, queue", test_event_defer) ) {
+        CU_cleanup_registry();
+        return CU_get_error();
+    }
+    if ( !CU_add_test(pSuite, "[GPIO_EVENT] Debounce", test_event_debounce) ) {
+        CU_cleanup_registry();
+        return CU_get_error();
+    }
+
+    CU_basic_set_mode(CU_BRM_VERBOSE);
+    CU_basic_run_tests();
+    CU_cleanup_registry();
+    return CU_get_error();
+}
@@ -0,0 +1,200 @@
+/*
+ * test_kybdledio.c
+ *
+ * TDD For RCU85Monitor/(Keyboard Scan and LED Display)
+ * System test: kybd_led_io.c runs against the 74LS165 and ICM7218A
+ * models attached to the emulated GPIO register file.
+ *
+ * Supports lib ver: 1.1
+ *
+ */
+
+#include <RCU85Monitor/kybd_led_io.h>
+#include <avrlib/busseq.h>
+#include <avrlib/gpio_api.h>
+#include <avrlib/gpio_emu_dev.h>
+#include <avrlib/gpio_vcd.h>
+#include <avrlib/libtime.h>
+#include <stdio.h>
+#include <string.h>
+#include <CUnit/CUnit.h>
+#include <CUnit/Basic.h>
+
+// RCU-85 keyboard/display wiring (see kybd_led_io.c)
+static emu_74165_t kbd = {
+    PM_PORT_K, PM_PIN_4,    /* /LOAD    */
+    PM_PORT_K, PM_PIN_5,    /* CLOCK    */
+    PM_PORT_K, PM_PIN_6,    /* SER.OUT  */
+    3                       /* 24 bits  */
+};
+
+static emu_icm7218_t disp = {
+    PM_PORT_F,              /* ID0..7   */
+    PM_PORT_K, PM_PIN_0,    /* /WRITE   */
+    PM_PORT_K, PM_PIN_1     /* MODE     */
+};
+
+kybd_t mon_info;
+
+
+// ======== TEST SUITE ================================================
+
+int init_suite(void) {
+    bs_measure();
+    return 0;
+}
+
+int clean_suite(void) {
+    return 0;
+}
+
+void test_kybdio_init(void) {
+    printf("\n");
+    printf("[test_kybdio_init] ----------------------------------------\n");
+    CU_ASSERT_FATAL ( kybdio_sysinit() == KD_SUCCESS );
+    CU_ASSERT_FATAL ( kybd_isInitializaed() );
+    CU_ASSERT_FATAL ( disp_isInitializaed() );
+    /* display gets one control word: bank A, run, HEX decode */
+    CU_ASSERT_FATAL ( disp.writes == 1 );
+    CU_ASSERT_FATAL ( disp.ctrl == (EMU_7218_BANK | EMU_7218_RUN | EMU_7218_HEX) );
+    CU_ASSERT_FATAL ( disp.idx == EMU_7218_DIGITS );
+}
+
+void test_kybdio_scan(void) {
+    kybd_t kd;
+
+    printf("\n");
+    printf("[test_kybdio_scan] ----------------------------------------\n");
+    memset(&kd, 0, sizeof(kd));
+    kbd.inputs = 0x12345a;
+    CU_ASSERT_FATAL ( kybd_scan(&kd) == KD_SUCCESS );
+    printf("scan: A[%02x%02x] D[%02x]\n", kd.ds.dat.addr_hi, kd.ds.dat.addr_lo, kd.ds.dat.data);
+    CU_ASSERT_FATAL ( kbd.loads == 1 );
+    CU_ASSERT_FATAL ( kbd.clocks == 24 );
+    CU_ASSERT_FATAL ( kd.ds.dat.data == 0x5a );
+    CU_ASSERT_FATAL ( kd.ds.dat.addr_lo == 0x34 );
+    CU_ASSERT_FATAL ( kd.ds.dat.addr_hi == 0x12 );
+
+    printf("re-scan, keys changed\n");
+    kbd.inputs = 0x80ff01;
+    CU_ASSERT_FATAL ( kybd_scan(&kd) == KD_SUCCESS );
+    CU_ASSERT_FATAL ( kbd.loads == 2 );
+    CU_ASSERT_FATAL ( kd.ds.dat.data == 0x01 );
+    CU_ASSERT_FATAL ( kd.ds.dat.addr_lo == 0xff );
+    CU_ASSERT_FATAL ( kd.ds.dat.addr_hi == 0x80 );
+}
+
+void test_kybdio_disp(void) {
+    char txt[EMU_7218_DIGITS+1];
+
+    printf("\n");
+    printf("[test_kybdio_disp] ----------------------------------------\n");
+    mon_info.ds.dat.addr_hi = 0xbe;
+    mon_info.ds.dat.addr_lo = 0xef;
+    mon_info.ds.dat.data    = 0x5a;
+    CU_ASSERT_FATAL ( disp_update(&mon_info) == KD_SUCCESS );
+    printf("display: [%s]\n", emu_icm7218_text(&disp, txt));
+    CU_ASSERT_FATAL ( disp.updates == 1 );
+    CU_ASSERT_FATAL ( (disp.ctrl & EMU_7218_DATA_COMING) != 0 );
+    CU_ASSERT_FATAL ( strcmp(emu_icm7218_text(&disp, txt), "BEEF5A00") == 0 );
+
+    mon_info.ds.dat.addr_hi = 0x00;
+    mon_info.ds.dat.addr_lo = 0x12;
+    CU_ASSERT_FATAL ( disp_update(&mon_info) == KD_SUCCESS );
+    CU_ASSERT_FATAL ( disp.updates == 2 );
+    CU_ASSERT_FATAL ( strcmp(emu_icm7218_text(&disp, txt), "00125A00") == 0 );
+    CU_ASSERT_FATAL ( disp.writes == 1 + 2*(1 + EMU_7218_DIGITS) );
+}
+
+#define VCD_FILE    "test_kybdledio.vcd"
+
+void test_kybdio_vcd(void) {
+    FILE * fp;
+    char line[128];
+    char tstamp[32];
+    uint64_t t0;
+    int wr_falls = 0, defs = 0, named = 0, tfound = 0;
+
+    printf("\n");
+    printf("[test_kybdio_vcd] -----------------------------------------\n");
+    CU_ASSERT_FATAL ( vcd_name(PM_PORT_K, PM_PIN_0, "DISP_WR") == PM_SUCCESS );
+    CU_ASSERT_FATAL ( vcd_name(PM_PORT_K, PM_PIN_1, "DISP_MODE") == PM_SUCCESS );
+    CU_ASSERT_FATAL ( vcd_open(VCD_FILE, VCD_PORT(PM_PORT_F) | VCD_PORT(PM_PORT_K)) == PM_SUCCESS );
+    CU_ASSERT_FATAL ( vcd_isOpen() );
+    CU_ASSERT_FATAL ( vcd_open(VCD_FILE, VCD_ALL_PORTS) == PM_ERROR );  /* one at a time */
+
+    t0 = tm_emu_ns();
+    mon_info.ds.dat.addr_hi = 0x85;
+    CU_ASSERT_FATAL ( disp_update(&mon_info) == KD_SUCCESS );
+    /* 9 writes: 5 steps each (BS_STEP_CYCLES, 1500 ns), a /WR of 1 us
+     * rounded up to 17 cycles; pre and post within the steps. REP, 8 DJNZ
+     * and END make 55 steps. */
+    printf("disp_update: %llu ns emulated, %u pin changes\n", 
+        (unsigned long long)(tm_emu_ns() - t0), vcd_changes());
+    CU_ASSERT_FATAL ( tm_emu_ns() - t0 == 55 * 1500 + 9 * 1062 );
+    CU_ASSERT_FATAL ( vcd_changes() > 0 );
+    vcd_close();
+    CU_ASSERT_FATAL ( !vcd_isOpen() );
+
+    /* check the dump: signal defs, 9 /WR strobes, the last /WR edge
+     * (WAIT, DJNZ, END follow it) */
+    snprintf(tstamp, sizeof(tstamp), "#%llu\n", (unsigned long long)(t0 + 52 * 1500 + 9 * 1062));
+    fp = fopen(VCD_FILE, "r");
+    CU_ASSERT_FATAL ( fp != NULL );
+    while (fgets(line, sizeof(line), fp)) {
+        if (strstr(line, "$enddefinitions")) defs++;
+        if (strstr(line, " DISP_WR ")) named++;
+        if (strcmp(line, "0i\n") == 0) wr_falls++;     /* PK0 is id 'i' */
+        if (strcmp(line, tstamp) == 0) tfound++;
+    }
+    fclose(fp);
+    printf("vcd: defs[%d] named[%d] /WR falls[%d] end[%d]\n", defs, named, wr_falls, tfound);
+    CU_ASSERT_FATAL ( defs == 1 );
+    CU_ASSERT_FATAL ( named == 1 );
+    CU_ASSERT_FATAL ( wr_falls == 9 );
+    CU_ASSERT_FATAL ( tfound == 1 );
+}
+
+int main() {
+	// system init
+	printf("{TDD} System Init...\n");
+	pm_init();
+	// /WRITE and /LOAD idle high before the MCU drives them
+	emu_pin_drive(PM_PORT_K, 0x11, 0x11);
+	if (emu_74165_attach(&kbd) != PM_SUCCESS || emu_icm7218_attach(&disp) != PM_SUCCESS) {
+	    printf("{TDD} device models failed to attach!\n");
+	    return -1;
+	}
+
+    CU_pSuite pSuite = NULL;
+    if (CUE_SUCCESS != CU_initialize_registry())
+        return CU_get_error();
+
+    pSuite = CU_add_suite("Test Suite - RCU85 Keyboard/LED I/O (emulated devices)", init_suite, clean_suite);
+    if (pSuite == NULL) {
+        CU_cleanup_registry();
+        return CU_get_error();
+    }
+
+    if ( !CU_add_test(pSuite, "[KYBDIO] Init", test_kybdio_init) ) {
+        CU_cleanup_registry();
+        return CU_get_error();
+    }
+    if ( !CU_add_test(pSuite, "[KYBDIO] Keyboard scan (74LS165 x3)", test_kybdio_scan) ) {
+        CU_cleanup_registry();
+        return CU_get_error();
+    }
+    if ( !CU_add_test(pSuite, "[KYBDIO] Display update (ICM7218A)", test_kybdio_disp) ) {
+        CU_cleanup_registry();
+        return CU_get_error();
+    }
+    if ( !CU_add_test(pSuite, "[KYBDIO] VCD trace of a display update", test_kybdio_vcd) ) {
+        CU_cleanup_registry();
+        return CU_get_error();
+    }
+
+    CU_basic_set_mode(CU_BRM_VERBOSE);
+    CU_basic_run_tests();
+    CU_cleanup_registry();
+    return CU_get_error();
+}
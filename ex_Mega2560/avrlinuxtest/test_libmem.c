@@ -0,0 +1,98 @@
+/*
+ * test_libmem.c
+ *
+ * TDD For avrlib/(RAM usage, stack high-water mark)
+ * Emulated build: the painted region is MEM_EMU_STACK bytes of host
+ * stack below init_suite()'s caller, figures are checked with bounds.
+ *
+ * Supports lib ver: 1.0
+ *
+ */
+
+#include <avrlib/libmem.h>
+#include <stdio.h>
+#include <CUnit/CUnit.h>
+#include <CUnit/Basic.h>
+
+// ======== TEST SUITE ================================================
+
+int init_suite(void) {
+    mem_init();
+    return 0;
+}
+
+int clean_suite(void) {
+    return 0;
+}
+
+// Use about 'depth' KB of stack
+static int __attribute__((noinline)) deep(int depth) {
+    volatile uint8_t buf[1024];
+    int i;
+    for ( i = 0 ; i < (int)sizeof(buf) ; ++i ) {
+        buf[i] = (uint8_t)(i + depth);
+    }
+    return (depth > 1) ? buf[depth] + deep(depth - 1) : buf[0];
+}
+
+static void prmem(const mem_info_t * mi) {
+    printf("data %u bss %u heap %u stack %u max %u free %u min %u\n",
+        mi->data, mi->bss, mi->heap, mi->stack, mi->stack_max, mi->free, mi->free_min);
+}
+
+void test_mem_highwater(void) {
+    mem_info_t mi;
+    uint16_t max0;
+
+    printf("\n");
+    printf("[test_mem_highwater] ---------------------------------------\n");
+    mem_get(&mi);
+    prmem(&mi);
+    CU_ASSERT_FATAL ( mi.bss > 0 );
+    CU_ASSERT_FATAL ( mi.stack > 0 && mi.stack <= mi.stack_max );
+    CU_ASSERT_FATAL ( mi.free_min <= mi.free );
+    CU_ASSERT_FATAL ( mi.stack_max + mi.free_min == MEM_EMU_STACK );
+    max0 = mi.stack_max;
+
+    printf("a deeper call moves the high-water mark\n");
+    deep(6);
+    mem_get(&mi);
+    prmem(&mi);
+    CU_ASSERT_FATAL ( mi.stack_max >= 6 * 1024 && mi.stack_max > max0 );
+    CU_ASSERT_FATAL ( mi.stack < mi.stack_max );
+    CU_ASSERT_FATAL ( mi.stack_max + mi.free_min == MEM_EMU_STACK );
+
+    printf("reset restarts it from the current depth\n");
+    mem_reset();
+    mem_get(&mi);
+    prmem(&mi);
+    CU_ASSERT_FATAL ( mi.stack_max < 6 * 1024 );
+    CU_ASSERT_FATAL ( mi.stack_max >= mi.stack );
+
+    mem_get(NULL);      /* ignored */
+}
+
+int main() {
+	// system init
+	printf("{TDD} System Init...\n");
+
+    CU_pSuite pSuite = NULL;
+    if (CUE_SUCCESS != CU_initialize_registry())
+        return CU_get_error();
+
+    pSuite = CU_add_suite("Test Suite - libmem (RAM usage)", init_suite, clean_suite);
+    if (pSuite == NULL) {
+        CU_cleanup_registry();
+        return CU_get_error();
+    }
+
+    if ( !CU_add_test(pSuite, "[LIBMEM] Stack high-water mark", test_mem_highwater) ) {
+        CU_cleanup_registry();
+        return CU_get_error();
+    }
+
+    CU_basic_set_mode(CU_BRM_VERBOSE);
+    CU_basic_run_tests();
+    CU_cleanup_registry();
+    return CU_get_error();
+}
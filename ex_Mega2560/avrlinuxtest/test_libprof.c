@@ -0,0 +1,121 @@
+/*
+ * test_libprof.c
+ *
+ * TDD For avrlib/(Cycle profiling probes)
+ * Emulated build: ticks are CLOCK_MONOTONIC nanoseconds. Probes are
+ * timed around host sleeps, so times are checked with generous bounds.
+ *
+ * Supports lib ver: 1.0
+ *
+ */
+
+#define PROF_ENABLE
+#include <avrlib/libprof.h>
+#include <stdio.h>
+#include <unistd.h>
+#include <CUnit/CUnit.h>
+#include <CUnit/Basic.h>
+
+// ======== TEST SUITE ================================================
+
+int init_suite(void) {
+    prof_init();
+    return 0;
+}
+
+int clean_suite(void) {
+    return 0;
+}
+
+void test_prof_probe(void) {
+    prof_stat_t st;
+    int i;
+
+    printf("\n");
+    printf("[test_prof_probe] ------------------------------------------\n");
+    CU_ASSERT_FATAL ( prof_ticks_per_us() == 1000 );
+    CU_ASSERT_FATAL ( prof_get(0, &st) == PROF_SUCCESS );
+    CU_ASSERT_FATAL ( st.count == 0 && st.min == 0 && st.max == 0 && st.total == 0 );
+
+    printf("empty probe: overhead is taken off\n");
+    PROF_BEGIN(0);
+    PROF_END(0);
+    CU_ASSERT_FATAL ( prof_get(0, &st) == PROF_SUCCESS );
+    printf("empty: %u ns\n", st.min);
+    CU_ASSERT_FATAL ( st.count == 1 && st.min < 10000 );
+
+    printf("timed probes\n");
+    for ( i = 1 ; i <= 3 ; ++i ) {
+        PROF_BEGIN(1);
+        usleep(i * 2000);
+        PROF_END(1);
+    }
+    CU_ASSERT_FATAL ( prof_get(1, &st) == PROF_SUCCESS );
+    printf("count %u min %u max %u total %u\n", st.count, st.min, st.max, st.total);
+    CU_ASSERT_FATAL ( st.count == 3 );
+    CU_ASSERT_FATAL ( st.min >= 2000000 && st.min <= st.max );
+    CU_ASSERT_FATAL ( st.max >= 6000000 && st.max < 500000000 );
+    CU_ASSERT_FATAL ( st.total >= 12000000 && st.total >= st.min + st.max );
+
+    printf("nested probes, END without BEGIN\n");
+    PROF_BEGIN(2);
+    PROF_BEGIN(3);
+    usleep(1000);
+    PROF_END(3);
+    PROF_END(2);
+    PROF_END(2);
+    CU_ASSERT_FATAL ( prof_get(2, &st) == PROF_SUCCESS && st.count == 1 );
+    CU_ASSERT_FATAL ( st.min >= 1000000 );
+    CU_ASSERT_FATAL ( prof_get(3, &st) == PROF_SUCCESS && st.count == 1 );
+}
+
+void test_prof_table(void) {
+    prof_stat_t st;
+
+    printf("\n");
+    printf("[test_prof_table] ------------------------------------------\n");
+    CU_ASSERT_FATAL ( prof_name(PROF_PARSER, "parser") == PROF_SUCCESS );
+    CU_ASSERT_FATAL ( prof_name(PROF_MAX_PROBES, "none") == PROF_ERROR );
+    CU_ASSERT_FATAL ( prof_get(PROF_MAX_PROBES, &st) == PROF_ERROR );
+    CU_ASSERT_FATAL ( prof_get(0, NULL) == PROF_ERROR );
+    PROF_BEGIN(PROF_MAX_PROBES);    /* ignored */
+    PROF_END(PROF_MAX_PROBES);
+
+    printf("reset clears the figures, keeps the names\n");
+    PROF_BEGIN(PROF_PARSER);
+    prof_reset();
+    PROF_END(PROF_PARSER);          /* started before the reset, dropped */
+    CU_ASSERT_FATAL ( prof_get(1, &st) == PROF_SUCCESS && st.count == 0 && st.total == 0 );
+    CU_ASSERT_FATAL ( prof_get(PROF_PARSER, &st) == PROF_SUCCESS );
+    CU_ASSERT_FATAL ( st.count == 0 );
+    CU_ASSERT_FATAL ( st.name && st.name[0] == 'p' );
+}
+
+int main() {
+	// system init
+	printf("{TDD} System Init...\n");
+
+    CU_pSuite pSuite = NULL;
+    if (CUE_SUCCESS != CU_initialize_registry())
+        return CU_get_error();
+
+    pSuite = CU_add_suite("Test Suite - libprof (profiling probes)", init_suite, clean_suite);
+    if (pSuite == NULL) {
+        CU_cleanup_registry();
+        return CU_get_error();
+    }
+
+    if ( !CU_add_test(pSuite, "[LIBPROF] Probes", test_prof_probe) ) {
+        CU_cleanup_registry();
+        return CU_get_error();
+    }
+    if ( !CU_add_test(pSuite, "[LIBPROF] Probe table", test_prof_table) ) {
+        CU_cleanup_registry();
+        return CU_get_error();
+    }
+
+    CU_basic_set_mode(CU_BRM_VERBOSE);
+    CU_basic_run_tests();
+    CU_cleanup_registry();
+    return CU_get_error();
+}
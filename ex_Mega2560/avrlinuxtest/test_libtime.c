@@ -0,0 +1,229 @@
+/*
+ * test_libtime.c
+ *
+ * TDD For avrlib/(System tick, deadlines, software timers)
+ * Emulated build: the tick is CLOCK_MONOTONIC, or tm_emu_ns() in virtual
+ * time. The common tests hold in both modes, so timings are checked with
+ * generous upper bounds. The virtual time test checks exact timings.
+ *
+ * Supports lib ver: 1.2
+ *
+ */
+
+#include <avrlib/libtime.h>
+#include <stdio.h>
+#include <time.h>
+#include <CUnit/CUnit.h>
+#include <CUnit/Basic.h>
+
+static int calls[TM_MAX_TIMERS+1];
+static int self_hndl = 0;
+
+static void cb_count(void * ctx) {
+    calls[(int)(intptr_t)ctx]++;
+}
+
+static void cb_selfstop(void * ctx) {
+    calls[(int)(intptr_t)ctx]++;
+    tm_timer_stop(self_hndl);
+}
+
+/* poll timers for 'ms' milliseconds */
+static void run_for(uint32_t ms) {
+    uint32_t dl = tm_deadline_ms(ms);
+    while (!tm_expired(dl)) {
+        tm_timer_poll();
+        tm_idle();
+    }
+}
+
+// ======== TEST SUITE ================================================
+
+int init_suite(void) {
+    return 0;
+}
+
+int clean_suite(void) {
+    return 0;
+}
+
+void test_tm_tick(void) {
+    uint32_t m0, m1, u0, u1;
+
+    printf("\n");
+    printf("[test_tm_tick] ---------------------------------------------\n");
+    tm_init();
+    m0 = tm_millis();
+    u0 = tm_micros();
+    tm_delay_ms(20);
+    m1 = tm_millis();
+    u1 = tm_micros();
+    printf("20 ms delay: %u ms, %u us\n", m1 - m0, u1 - u0);
+    CU_ASSERT_FATAL ( m1 - m0 >= 19 && m1 - m0 < 500 );
+    CU_ASSERT_FATAL ( u1 - u0 >= 19000 && u1 - u0 < 500000 );
+    CU_ASSERT_FATAL ( tm_micros() >= u1 );
+
+    printf("raw tick: ms, Timer0 count (4 us)\n");
+    CU_ASSERT_FATAL ( tm_ticks_us((5UL << 8) | 100) == 5400 );
+    u0 = tm_micros();
+    u1 = tm_ticks_us(tm_ticks_raw());
+    CU_ASSERT_FATAL ( u1 - (u0 & ~3UL) < 1000 );
+}
+
+void test_tm_deadline(void) {
+    uint32_t dl;
+
+    printf("\n");
+    printf("[test_tm_deadline] -----------------------------------------\n");
+    dl = tm_deadline_ms(30);
+    CU_ASSERT_FATAL ( !tm_expired(dl) );
+    tm_delay_ms(35);
+    CU_ASSERT_FATAL ( tm_expired(dl) );
+    dl = tm_deadline_us(20000);
+    CU_ASSERT_FATAL ( !tm_expired_us(dl) );
+    tm_delay_ms(25);
+    CU_ASSERT_FATAL ( tm_expired_us(dl) );
+
+    printf("compare across the counter wrap\n");
+    CU_ASSERT_FATAL ( tm_expired(tm_millis() - 0x10) );
+    CU_ASSERT_FATAL ( !tm_expired(tm_millis() + 0x7fff0000UL) );
+    CU_ASSERT_FATAL ( tm_expired(tm_millis() + 0x80010000UL) );    /* > half range: in the past */
+}
+
+void test_tm_timers(void) {
+    int h1, h2, h3, i;
+    int hndl[TM_MAX_TIMERS];
+
+    printf("\n");
+    printf("[test_tm_timers] -------------------------------------------\n");
+    CU_ASSERT_FATAL ( tm_timer_start(10, TM_PERIODIC, NULL, NULL) == TM_ERROR );
+    CU_ASSERT_FATAL ( tm_timer_start(0, TM_PERIODIC, cb_count, NULL) == TM_ERROR );
+    CU_ASSERT_FATAL ( tm_timer_poll() == 0 );
+
+    printf("one-shot, periodic\n");
+    h1 = tm_timer_start(20, TM_ONESHOT, cb_count, (void *)1);
+    h2 = tm_timer_start(10, TM_PERIODIC, cb_count, (void *)2);
+    CU_ASSERT_FATAL ( h1 > 0 && h2 > 0 && h1 != h2 );
+    CU_ASSERT_FATAL ( tm_timer_poll() == 0 );
+    run_for(105);
+    printf("calls: one-shot %d, periodic %d\n", calls[1], calls[2]);
+    CU_ASSERT_FATAL ( calls[1] == 1 );
+    CU_ASSERT_FATAL ( calls[2] >= 5 && calls[2] <= 10 );
+    CU_ASSERT_FATAL ( tm_timer_stop(h1) == TM_ERROR );  /* one-shot freed */
+    CU_ASSERT_FATAL ( tm_timer_stop(h2) == TM_SUCCESS );
+    CU_ASSERT_FATAL ( tm_timer_stop(h2) == TM_ERROR );
+    i = calls[2];
+    run_for(25);
+    CU_ASSERT_FATAL ( calls[2] == i );
+
+    printf("a periodic timer stops itself\n");
+    self_hndl = tm_timer_start(5, TM_PERIODIC, cb_selfstop, (void *)3);
+    CU_ASSERT_FATAL ( self_hndl > 0 );
+    run_for(30);
+    CU_ASSERT_FATAL ( calls[3] == 1 );
+
+    printf("late poll: periodic calls are dropped, not bunched\n");
+    h3 = tm_timer_start(5, TM_PERIODIC, cb_count, (void *)4);
+    tm_delay_ms(40);
+    CU_ASSERT_FATAL ( tm_timer_poll() == 1 );
+    CU_ASSERT_FATAL ( tm_timer_poll() == 0 );
+    CU_ASSERT_FATAL ( tm_timer_stop(h3) == TM_SUCCESS );
+
+    printf("table full\n");
+    for ( i = 0 ; i < TM_MAX_TIMERS ; ++i ) {
+        hndl[i] = tm_timer_start(1000, TM_ONESHOT, cb_count, (void *)0);
+        CU_ASSERT_FATAL ( hndl[i] > 0 );
+    }
+    CU_ASSERT_FATAL ( tm_timer_start(1000, TM_ONESHOT, cb_count, (void *)0) == TM_ERROR );
+    for ( i = 0 ; i < TM_MAX_TIMERS ; ++i ) {
+        CU_ASSERT_FATAL ( tm_timer_stop(hndl[i]) == TM_SUCCESS );
+    }
+    CU_ASSERT_FATAL ( calls[0] == 0 );
+}
+
+void test_tm_virtual(void) {
+    uint8_t mode = tm_emu_isVirtual();
+    uint32_t m0, u0, n;
+    uint64_t e0;
+    struct timespec w0, w1;
+    int h;
+
+    printf("\n");
+    printf("[test_tm_virtual] ------------------------------------------\n");
+    tm_emu_virtual(1);
+    clock_gettime(CLOCK_MONOTONIC, &w0);
+    m0 = tm_millis();
+    u0 = tm_micros();
+    e0 = tm_emu_ns();
+    tm_delay_ms(1000);
+    tm_delay_us(250);
+    CU_ASSERT_FATAL ( tm_millis() - m0 == 1000 );
+    CU_ASSERT_FATAL ( tm_micros() - u0 == 1000250 );
+    CU_ASSERT_FATAL ( tm_emu_ns() - e0 == 1000250000ULL );
+
+    printf("cycle delays, %lu Hz\n", (unsigned long)TM_F_CPU);
+    CU_ASSERT_FATAL ( TM_US_CYCLES(10) == 10 * (TM_F_CPU / 1000000UL) );
+    CU_ASSERT_FATAL ( TM_NS_CYCLES(1000) == TM_F_CPU / 1000000UL );
+    CU_ASSERT_FATAL ( TM_NS_CYCLES(1) == 1 );      /* rounds up */
+    e0 = tm_emu_ns();
+    tm_delay_cycles(TM_US_CYCLES(3));
+    tm_delay_cycles(TM_F_CPU);
+    CU_ASSERT_FATAL ( tm_emu_ns() - e0 == 1000003000ULL );
+
+    printf("tm_idle() moves the clock, timers run on it\n");
+    calls[5] = 0;
+    h = tm_timer_start(7, TM_PERIODIC, cb_count, (void *)5);
+    n = 0;
+    m0 = tm_millis();
+    while (tm_millis() - m0 <= 70) {
+        tm_timer_poll();
+        tm_idle();
+        n++;
+    }
+    CU_ASSERT_FATAL ( tm_timer_stop(h) == TM_SUCCESS );
+    printf("70 ms: %d calls, %u idle passes\n", calls[5], n);
+    CU_ASSERT_FATAL ( calls[5] == 10 );
+    CU_ASSERT_FATAL ( n == 71 );
+
+    clock_gettime(CLOCK_MONOTONIC, &w1);
+    printf("host time: %.3f ms\n", (w1.tv_sec - w0.tv_sec) * 1e3 + (w1.tv_nsec - w0.tv_nsec) / 1e6);
+    CU_ASSERT_FATAL ( w1.tv_sec - w0.tv_sec < 1 );
+    tm_emu_virtual(mode);
+}
+
+int main() {
+	// system init
+	printf("{TDD} System Init...\n");
+
+    CU_pSuite pSuite = NULL;
+    if (CUE_SUCCESS != CU_initialize_registry())
+        return CU_get_error();
+
+    pSuite = CU_add_suite("Test Suite - libtime (tick, deadlines, timers)", init_suite, clean_suite);
+    if (pSuite == NULL) {
+        CU_cleanup_registry();
+        return CU_get_error();
+    }
+
+    if ( !CU_add_test(pSuite, "[LIBTIME] System tick", test_tm_tick) ) {
+        CU_cleanup_registry();
+        return CU_get_error();
+    }
+    if ( !CU_add_test(pSuite, "[LIBTIME] Deadlines", test_tm_deadline) ) {
+        CU_cleanup_registry();
+        return CU_get_error();
+    }
+    if ( !CU_add_test(pSuite, "[LIBTIME] Software timers", test_tm_timers) ) {
+        CU_cleanup_registry();
+        return CU_get_error();
+    }
+    if ( !CU_add_test(pSuite, "[LIBTIME] Virtual time", test_tm_virtual) ) {
+        CU_cleanup_registry();
+        return CU_get_error();
+    }
+
+    CU_basic_set_mode(CU_BRM_VERBOSE);
+    CU_basic_run_tests();
+    CU_cleanup_registry();
+    return CU_get_error();
+}
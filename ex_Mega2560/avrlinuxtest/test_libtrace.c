@@ -0,0 +1,129 @@
+/*
+ * test_libtrace.c
+ *
+ * TDD For avrlib/(Binary event trace ring)
+ * Emulated build: time stamps come from the (virtual) libtime clock.
+ *
+ * Supports lib ver: 1.0
+ *
+ */
+
+#define TRACE_ENABLE
+#include <avrlib/libtrace.h>
+#include <avrlib/libtime.h>
+#include <stdio.h>
+#include <CUnit/CUnit.h>
+#include <CUnit/Basic.h>
+
+// ======== TEST SUITE ================================================
+
+int init_suite(void) {
+    trace_clear();
+    return 0;
+}
+
+int clean_suite(void) {
+    return 0;
+}
+
+void test_trace_ring(void) {
+    trace_evt_t evt;
+    uint32_t t0;
+    int i;
+
+    printf("\n");
+    printf("[test_trace_ring] ------------------------------------------\n");
+    CU_ASSERT_FATAL ( trace_count() == 0 );
+    CU_ASSERT_FATAL ( trace_get(&evt) == 0 );
+    CU_ASSERT_FATAL ( trace_get(NULL) == 0 );
+
+    printf("events come out in order, time stamped\n");
+    t0 = tm_micros();
+    TRACE(TRACE_CMD_BEGIN, 3);
+    tm_delay_ms(2);
+    TRACE(TRACE_CMD_END, -1);
+    CU_ASSERT_FATAL ( trace_count() == 2 );
+    CU_ASSERT_FATAL ( trace_get(&evt) == 1 );
+    CU_ASSERT_FATAL ( evt.id == TRACE_CMD_BEGIN && evt.arg == 3 );
+    CU_ASSERT_FATAL ( (uint32_t)(evt.time - t0) < 1000 );
+    t0 = evt.time;
+    CU_ASSERT_FATAL ( trace_get(&evt) == 1 );
+    CU_ASSERT_FATAL ( evt.id == TRACE_CMD_END && evt.arg == 0xffff );
+    printf("delta %u us\n", (unsigned)(evt.time - t0));
+    CU_ASSERT_FATAL ( (uint32_t)(evt.time - t0) >= 2000 );
+    CU_ASSERT_FATAL ( trace_count() == 0 && trace_get(&evt) == 0 );
+    CU_ASSERT_FATAL ( trace_lost() == 0 );
+
+    printf("a full ring keeps the latest events\n");
+    for ( i = 0 ; i < TRACE_LEN + 5 ; ++i ) {
+        TRACE(TRACE_USER, i);
+    }
+    CU_ASSERT_FATAL ( trace_count() == TRACE_LEN );
+    CU_ASSERT_FATAL ( trace_lost() == 5 );
+    CU_ASSERT_FATAL ( trace_lost() == 0 );
+    CU_ASSERT_FATAL ( trace_get(&evt) == 1 && evt.arg == 5 );
+    for ( i = 6 ; trace_get(&evt) ; ++i ) {
+        CU_ASSERT_FATAL ( evt.arg == i );
+    }
+    CU_ASSERT_FATAL ( i == TRACE_LEN + 5 );
+
+    printf("clear\n");
+    TRACE(TRACE_TIMER, 1);
+    trace_clear();
+    CU_ASSERT_FATAL ( trace_count() == 0 && trace_get(&evt) == 0 );
+}
+
+void test_trace_encode(void) {
+    trace_evt_t evt;
+    uint8_t rec[TRACE_REC_LEN];
+    uint8_t x = 0;
+    int i;
+
+    printf("\n");
+    printf("[test_trace_encode] ----------------------------------------\n");
+    evt.time = 0x12345678;
+    evt.id   = TRACE_USER + 1;
+    evt.arg  = 0xbeef;
+    trace_encode(&evt, rec);
+    for ( i = 0 ; i < TRACE_REC_LEN ; ++i ) {
+        printf("%02x ", rec[i]);
+    }
+    printf("\n");
+    CU_ASSERT_FATAL ( rec[0] == TRACE_SYNC );
+    CU_ASSERT_FATAL ( rec[1] == 0x78 && rec[2] == 0x56 && rec[3] == 0x34 && rec[4] == 0x12 );
+    CU_ASSERT_FATAL ( rec[5] == 0x01 && rec[6] == 0x01 );
+    CU_ASSERT_FATAL ( rec[7] == 0xef && rec[8] == 0xbe );
+    for ( i = 1 ; i < TRACE_REC_LEN - 1 ; ++i ) {
+        x ^= rec[i];
+    }
+    CU_ASSERT_FATAL ( rec[TRACE_REC_LEN-1] == x );
+}
+
+int main() {
+	// system init
+	printf("{TDD} System Init...\n");
+
+    CU_pSuite pSuite = NULL;
+    if (CUE_SUCCESS != CU_initialize_registry())
+        return CU_get_error();
+
+    pSuite = CU_add_suite("Test Suite - libtrace (event trace ring)", init_suite, clean_suite);
+    if (pSuite == NULL) {
+        CU_cleanup_registry();
+        return CU_get_error();
+    }
+
+    if ( !CU_add_test(pSuite, "[LIBTRACE] Ring", test_trace_ring) ) {
+        CU_cleanup_registry();
+        return CU_get_error();
+    }
+    if ( !CU_add_test(pSuite, "[LIBTRACE] Record encoding", test_trace_encode) ) {
+        CU_cleanup_registry();
+        return CU_get_error();
+    }
+
+    CU_basic_set_mode(CU_BRM_VERBOSE);
+    CU_basic_run_tests();
+    CU_cleanup_registry();
+    return CU_get_error();
+}
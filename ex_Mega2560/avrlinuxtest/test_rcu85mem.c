@@ -0,0 +1,441 @@
+/*
+ * test_rcu85mem.c
+ *
+ * TDD For RCU85Monitor/(RCU85 Memory Manager)
+ * System test: rcu85mem.c runs against the 8085 bus model attached to
+ * the emulated GPIO register file. The model's memory is the oracle
+ * for every write, and the source for every read.
+ *
+ * Virtual time, the idle release timer is stepped with tm_emu_advance().
+ *
+ * Also reports bus_action() throughput, as bytes per second of host
+ * time and of emulated target time.
+ *
+ * Supports lib ver: 1.0
+ *
+ */
+
+#include <RCU85Monitor/rcu85mem.h>
+#include <avrlib/busseq.h>
+#include <avrlib/gpio_api.h>
+#include <avrlib/gpio_emu_dev.h>
+#include <avrlib/libtime.h>
+#include <stdio.h>
+#include <string.h>
+#include <time.h>
+#include <CUnit/CUnit.h>
+#include <CUnit/Basic.h>
+
+#define IMG_FILE    "test_rcu85mem.img"
+#define BENCH_LEN   1024
+
+// RCU-85 bus wiring (see rcu85mem.c)
+static emu_bus8085_t bus = {
+    PM_PORT_A,                  /* AD0..7   */
+    PM_PORT_C,                  /* A8..15   */
+    { PM_PORT_G, PM_PIN_2 },    /* ALE      */
+    { PM_PORT_G, PM_PIN_1 },    /* /RD      */
+    { PM_PORT_G, PM_PIN_0 },    /* /WR      */
+    { PM_PORT_L, PM_PIN_0 },    /* IO/M     */
+    { PM_PORT_L, PM_PIN_1 },    /* HOLD     */
+    { PM_PORT_L, PM_PIN_2 },    /* HLDA     */
+    { PM_PORT_L, PM_PIN_3 },    /* /RESET   */
+    { PM_PORT_K, PM_PIN_7 },    /* EXTSEL   */
+    5                           /* HLDA latency */
+};
+
+static uint8_t wbuf[BENCH_LEN];
+static uint8_t rbuf[BENCH_LEN];
+
+/* PortC (A8..15), PortK (EXTSEL) writes during a transfer */
+static int c_writes = 0, k_writes = 0;
+
+static void hook_count(uint8_t port, uint8_t event, void * ctx) {
+    (void)ctx;
+    if (event == EMU_EV_PORT_WR) {
+        if (port == PM_PORT_C) c_writes++;
+        if (port == PM_PORT_K) k_writes++;
+    }
+}
+
+static double s_wall(void) {
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return (double)ts.tv_sec + (double)ts.tv_nsec / 1e9;
+}
+
+// ======== TEST SUITE ================================================
+
+int init_suite(void) {
+    tm_emu_virtual(1);
+    bs_measure();
+    return 0;
+}
+
+int clean_suite(void) {
+    return 0;
+}
+
+void test_rcmem_hold(void) {
+    printf("\n");
+    printf("[test_rcmem_hold] -----------------------------------------\n");
+    CU_ASSERT_FATAL ( rcmem_init() == RCM_SUCCESS );
+    CU_ASSERT_FATAL ( !rcmem_isHeld() );
+    CU_ASSERT_FATAL ( bus.held == 0 );
+    printf("no XMEM in the emulation, GPIO bus cycles\n");
+    CU_ASSERT_FATAL ( !rcmem_isXmem() );
+    CU_ASSERT_FATAL ( rcmem_xmem(1) == RCM_ERROR );
+    CU_ASSERT_FATAL ( rcmem_xmem(0) == RCM_SUCCESS );
+
+    printf("CPU slow to acknowledge, hold times out\n");
+    bus.hold_latency = 150;
+    CU_ASSERT_FATAL ( rcmem_hold() == RCM_TIMEOUT );
+    CU_ASSERT_FATAL ( !rcmem_isHeld() );
+    printf("retry, HLDA arrives\n");
+    CU_ASSERT_FATAL ( rcmem_hold() == RCM_SUCCESS );
+    CU_ASSERT_FATAL ( rcmem_isHeld() );
+    CU_ASSERT_FATAL ( bus.held == 1 );
+    CU_ASSERT_FATAL ( rcmem_hold() == RCM_ERROR );  /* already held */
+
+    printf("release with reset\n");
+    bus.hold_latency = 5;
+    CU_ASSERT_FATAL ( rcmem_release(RESET_CPU) == RCM_SUCCESS );
+    CU_ASSERT_FATAL ( !rcmem_isHeld() );
+    CU_ASSERT_FATAL ( bus.held == 0 );
+    CU_ASSERT_FATAL ( bus.resets == 1 );
+    CU_ASSERT_FATAL ( rcmem_release(NO_CPU_RESET) == RCM_ERROR );
+    CU_ASSERT_FATAL ( bus.errors == 0 );
+}
+
+void test_rcmem_rw(void) {
+    uint16_t i;
+
+    printf("\n");
+    printf("[test_rcmem_rw] -------------------------------------------\n");
+    for ( i = 0 ; i < BENCH_LEN ; ++i ) {
+        wbuf[i] = (uint8_t)(i * 7 + 3);
+    }
+    printf("not held, access refused\n");
+    CU_ASSERT_FATAL ( rcmem_write(0x8000, wbuf, 16, SET_MEM_ACCESS) == RCM_ERROR );
+    CU_ASSERT_FATAL ( bus.wr_cycles == 0 );
+
+    CU_ASSERT_FATAL ( rcmem_hold() == RCM_SUCCESS );
+    printf("memory write, crossing a page\n");
+    CU_ASSERT_FATAL ( rcmem_write(0x80f8, wbuf, 16, SET_MEM_ACCESS) == 16 );
+    CU_ASSERT_FATAL ( bus.wr_cycles == 16 );
+    CU_ASSERT_FATAL ( memcmp(&bus.mem[0x80f8], wbuf, 16) == 0 );
+    CU_ASSERT_FATAL ( bus.mem[0x80f7] == 0 && bus.mem[0x8108] == 0 );
+
+    printf("memory read back\n");
+    memset(rbuf, 0, sizeof(rbuf));
+    CU_ASSERT_FATAL ( rcmem_read(0x80f8, rbuf, 16, SET_MEM_ACCESS) == 16 );
+    CU_ASSERT_FATAL ( bus.rd_cycles == 16 );
+    CU_ASSERT_FATAL ( memcmp(rbuf, wbuf, 16) == 0 );
+
+    printf("I/O write, read\n");
+    CU_ASSERT_FATAL ( rcmem_write(0x10, &wbuf[100], 2, SET_IO_ACCESS) == 2 );
+    CU_ASSERT_FATAL ( bus.io[0x10] == wbuf[100] && bus.io[0x11] == wbuf[101] );
+    CU_ASSERT_FATAL ( bus.mem[0x1010] == 0 );   /* not in memory */
+    bus.io[0x20] = 0xa5;
+    CU_ASSERT_FATAL ( rcmem_read(0x20, rbuf, 1, SET_IO_ACCESS) == 1 );
+    CU_ASSERT_FATAL ( rbuf[0] == 0xa5 );
+
+    CU_ASSERT_FATAL ( rcmem_release(NO_CPU_RESET) == RCM_SUCCESS );
+    CU_ASSERT_FATAL ( bus.errors == 0 );
+}
+
+void test_rcmem_burst(void) {
+    rcm_timing_t tm = { 16, 32, 16 }, tq;
+    uint32_t wr0, rd0;
+    uint64_t e0;
+    int hc, hk;
+
+    printf("\n");
+    printf("[test_rcmem_burst] ----------------------------------------\n");
+    CU_ASSERT_FATAL ( rcmem_hold() == RCM_SUCCESS );
+    hc = emu_hook_add(PM_PORT_C, EMU_EV_PORT_WR, hook_count, NULL);
+    hk = emu_hook_add(PM_PORT_K, EMU_EV_PORT_WR, hook_count, NULL);
+    CU_ASSERT_FATAL ( hc > 0 && hk > 0 );
+
+    printf("300 bytes over 3 pages: A8..15 once per page, one EXTSEL\n");
+    wr0 = bus.wr_cycles;
+    c_writes = k_writes = 0;
+    CU_ASSERT_FATAL ( rcmem_write(0x20f8, wbuf, 300, SET_MEM_ACCESS) == 300 );
+    CU_ASSERT_FATAL ( bus.wr_cycles - wr0 == 300 );
+    CU_ASSERT_FATAL ( memcmp(&bus.mem[0x20f8], wbuf, 300) == 0 );
+    CU_ASSERT_FATAL ( c_writes == 3 && k_writes == 2 );
+    rd0 = bus.rd_cycles;
+    c_writes = k_writes = 0;
+    memset(rbuf, 0, sizeof(rbuf));
+    CU_ASSERT_FATAL ( rcmem_read(0x20f8, rbuf, 300, SET_MEM_ACCESS) == 300 );
+    CU_ASSERT_FATAL ( bus.rd_cycles - rd0 == 300 );
+    CU_ASSERT_FATAL ( memcmp(rbuf, wbuf, 300) == 0 );
+    CU_ASSERT_FATAL ( c_writes == 3 && k_writes == 2 );
+
+    printf("single byte: a full cycle\n");
+    c_writes = k_writes = 0;
+    CU_ASSERT_FATAL ( rcmem_write(0x2300, wbuf, 1, SET_MEM_ACCESS) == 1 );
+    CU_ASSERT_FATAL ( c_writes == 1 && k_writes == 2 );
+    emu_hook_remove(hc);
+    emu_hook_remove(hk);
+
+    printf("timing: setup, strobe, hold per byte\n");
+    rcmem_set_timing(&tm);
+    rcmem_get_timing(&tq);
+    CU_ASSERT_FATAL ( tq.setup == 16 && tq.strobe == 32 && tq.hold == 16 );
+    e0 = tm_emu_ns();
+    CU_ASSERT_FATAL ( rcmem_write(0x2400, wbuf, 10, SET_MEM_ACCESS) == 10 );
+    /* steps of BS_STEP_CYCLES (1500 ns): write 10 per byte + 3, read
+     * 13 per byte + 2. Setup and hold are within a step, the strobe
+     * wait less a step is 8 cycles: 11 with the loop (687 ns) */
+    CU_ASSERT_FATAL ( tm_emu_ns() - e0 == 103 * 1500 + 10 * 687 );
+    e0 = tm_emu_ns();
+    CU_ASSERT_FATAL ( rcmem_read(0x2400, rbuf, 10, SET_MEM_ACCESS) == 10 );
+    CU_ASSERT_FATAL ( tm_emu_ns() - e0 == 132 * 1500 + 10 * 687 );
+    CU_ASSERT_FATAL ( memcmp(rbuf, wbuf, 10) == 0 );
+    rcmem_set_timing(NULL);
+    rcmem_get_timing(&tq);
+    CU_ASSERT_FATAL ( tq.setup == 0 && tq.hold == 0 );
+
+    CU_ASSERT_FATAL ( rcmem_release(NO_CPU_RESET) == RCM_SUCCESS );
+    CU_ASSERT_FATAL ( bus.errors == 0 );
+}
+
+void test_rcmem_calibrate(void) {
+    rcm_timing_t tq, t4 = { 0, TM_US_CYCLES(4), 0 };
+    uint64_t t0, t_from;
+    uint16_t i;
+
+    printf("\n");
+    printf("[test_rcmem_calibrate] ------------------------------------\n");
+    /* the model takes 4 us from /RD to data, a /WR of 3.5 us: beyond the
+     * two steps of a strobe (3 us) */
+    emu_bus8085_detach(&bus);
+    bus.t_acc = 4000;
+    bus.t_wr = 3500;
+    CU_ASSERT_FATAL ( emu_bus8085_attach(&bus, IMG_FILE) == PM_SUCCESS );
+    for ( i = 0 ; i < 64 ; ++i ) {
+        bus.mem[0x3000 + i] = (uint8_t)i;
+    }
+    CU_ASSERT_FATAL ( rcmem_timing_load() == RCM_ERROR );       /* nothing saved */
+    printf("not held, bad arguments\n");
+    CU_ASSERT_FATAL ( rcmem_calibrate(0x3010, RCM_CAL_LEN, &tq) == RCM_ERROR );
+    CU_ASSERT_FATAL ( rcmem_hold() == RCM_SUCCESS );
+    CU_ASSERT_FATAL ( rcmem_calibrate(0x3010, 0, &tq) == RCM_ERROR );
+    CU_ASSERT_FATAL ( rcmem_calibrate(0x3010, RCM_CAL_LEN + 1, &tq) == RCM_ERROR );
+    CU_ASSERT_FATAL ( rcmem_calibrate(0xfff0, RCM_CAL_LEN, &tq) == RCM_ERROR );
+
+    printf("default timing too short for the model, found from the 4 us start\n");
+    rcmem_set_timing(NULL);
+    CU_ASSERT_FATAL ( rcmem_calibrate(0x3010, RCM_CAL_LEN, &tq) == RCM_SUCCESS );
+    CU_ASSERT_FATAL ( tq.setup == 0 && tq.strobe == 55 && tq.hold == 0 );
+
+    printf("4 us strobe (67) down to 43 cycles (5 loop passes), + 11 margin: 55\n");
+    rcmem_set_timing(&t4);
+    t0 = tm_emu_ns();
+    CU_ASSERT_FATAL ( rcmem_read(0x3100, rbuf, 64, SET_MEM_ACCESS) == 64 );
+    t_from = tm_emu_ns() - t0;
+    CU_ASSERT_FATAL ( rcmem_calibrate(0x3010, RCM_CAL_LEN, &tq) == RCM_SUCCESS );
+    printf("setup %u strobe %u hold %u, late %u\n", tq.setup, tq.strobe, tq.hold, bus.late);
+    CU_ASSERT_FATAL ( tq.setup == 0 && tq.strobe == 55 && tq.hold == 0 );
+    CU_ASSERT_FATAL ( bus.late > 0 );
+    for ( i = 0 ; i < 64 ; ++i ) {
+        CU_ASSERT_FATAL ( bus.mem[0x3000 + i] == (uint8_t)i );  /* put back */
+    }
+    printf("the bus cycle is shorter: 64 reads of 3 loop passes less\n");
+    t0 = tm_emu_ns();
+    CU_ASSERT_FATAL ( rcmem_read(0x3100, rbuf, 64, SET_MEM_ACCESS) == 64 );
+    printf("read 64: %llu ns, was %llu ns\n",
+        (unsigned long long)(tm_emu_ns() - t0), (unsigned long long)t_from);
+    CU_ASSERT_FATAL ( t_from - (tm_emu_ns() - t0) == 64 * 750 );
+    bus.late = 0;
+    CU_ASSERT_FATAL ( rcmem_write(0x3100, wbuf, 64, SET_MEM_ACCESS) == 64 );
+    CU_ASSERT_FATAL ( rcmem_read(0x3100, rbuf, 64, SET_MEM_ACCESS) == 64 );
+    CU_ASSERT_FATAL ( memcmp(rbuf, wbuf, 64) == 0 && bus.late == 0 );
+
+    printf("saved, loaded\n");
+    CU_ASSERT_FATAL ( rcmem_timing_save() == RCM_SUCCESS );
+    rcmem_set_timing(NULL);
+    CU_ASSERT_FATAL ( rcmem_timing_load() == RCM_SUCCESS );
+    rcmem_get_timing(&tq);
+    CU_ASSERT_FATAL ( tq.setup == 0 && tq.strobe == 55 && tq.hold == 0 );
+
+    printf("a bus too slow for the start timing: the present one is kept\n");
+    CU_ASSERT_FATAL ( rcmem_release(NO_CPU_RESET) == RCM_SUCCESS );
+    emu_bus8085_detach(&bus);
+    bus.t_acc = 8000;
+    CU_ASSERT_FATAL ( emu_bus8085_attach(&bus, IMG_FILE) == PM_SUCCESS );
+    CU_ASSERT_FATAL ( rcmem_hold() == RCM_SUCCESS );
+    tq.strobe = 3;
+    rcmem_set_timing(&tq);
+    CU_ASSERT_FATAL ( rcmem_calibrate(0x3010, RCM_CAL_LEN, &tq) == RCM_ERROR );
+    CU_ASSERT_FATAL ( tq.setup == 0 && tq.strobe == 3 && tq.hold == 0 );
+
+    rcmem_set_timing(NULL);
+    CU_ASSERT_FATAL ( rcmem_release(NO_CPU_RESET) == RCM_SUCCESS );
+    CU_ASSERT_FATAL ( bus.errors == 0 );
+    emu_bus8085_detach(&bus);
+    bus.t_acc = 0;
+    bus.t_wr = 0;
+    CU_ASSERT_FATAL ( emu_bus8085_attach(&bus, IMG_FILE) == PM_SUCCESS );
+}
+
+void test_rcmem_transaction(void) {
+    int i;
+
+    printf("\n");
+    printf("[test_rcmem_transaction] ----------------------------------\n");
+    CU_ASSERT_FATAL ( !rcmem_isHeld() );
+    CU_ASSERT_FATAL ( rcmem_commit() == RCM_ERROR );
+    printf("nested, held by the first begin\n");
+    CU_ASSERT_FATAL ( rcmem_begin() == RCM_SUCCESS );
+    CU_ASSERT_FATAL ( rcmem_isHeld() && bus.held == 1 );
+    CU_ASSERT_FATAL ( rcmem_begin() == RCM_SUCCESS );
+    CU_ASSERT_FATAL ( rcmem_release(NO_CPU_RESET) == RCM_ERROR );
+    CU_ASSERT_FATAL ( rcmem_commit() == RCM_SUCCESS );
+    CU_ASSERT_FATAL ( rcmem_release(NO_CPU_RESET) == RCM_ERROR );
+    CU_ASSERT_FATAL ( rcmem_commit() == RCM_SUCCESS );
+    CU_ASSERT_FATAL ( rcmem_isHeld() );
+
+    printf("a run of writes, one hold\n");
+    for ( i = 0 ; i < 10 ; ++i ) {
+        tm_emu_advance((RCM_IDLE_MS / 2) * 1000000ULL);
+        tm_timer_poll();
+        CU_ASSERT_FATAL ( rcmem_isHeld() && bus.held == 1 );
+        CU_ASSERT_FATAL ( rcmem_begin() == RCM_SUCCESS );
+        CU_ASSERT_FATAL ( rcmem_write(0x5000 + i, &wbuf[i], 1, SET_MEM_ACCESS) == 1 );
+        CU_ASSERT_FATAL ( rcmem_commit() == RCM_SUCCESS );
+    }
+    CU_ASSERT_FATAL ( memcmp(&bus.mem[0x5000], wbuf, 10) == 0 );
+    printf("idle, released\n");
+    tm_emu_advance((RCM_IDLE_MS - 1) * 1000000ULL);
+    tm_timer_poll();
+    CU_ASSERT_FATAL ( rcmem_isHeld() );
+    tm_emu_advance(2000000ULL);
+    tm_timer_poll();
+    CU_ASSERT_FATAL ( !rcmem_isHeld() && bus.held == 0 );
+
+    printf("halt while held for a transaction: stays held\n");
+    CU_ASSERT_FATAL ( rcmem_begin() == RCM_SUCCESS );
+    CU_ASSERT_FATAL ( rcmem_hold() == RCM_SUCCESS );
+    CU_ASSERT_FATAL ( rcmem_commit() == RCM_SUCCESS );
+    CU_ASSERT_FATAL ( rcmem_begin() == RCM_SUCCESS );
+    CU_ASSERT_FATAL ( rcmem_commit() == RCM_SUCCESS );
+    tm_emu_advance(2 * RCM_IDLE_MS * 1000000ULL);
+    tm_timer_poll();
+    CU_ASSERT_FATAL ( rcmem_isHeld() );
+    CU_ASSERT_FATAL ( rcmem_release(NO_CPU_RESET) == RCM_SUCCESS );
+    CU_ASSERT_FATAL ( !rcmem_isHeld() && bus.held == 0 );
+
+    printf("run right after a transaction\n");
+    CU_ASSERT_FATAL ( rcmem_begin() == RCM_SUCCESS );
+    CU_ASSERT_FATAL ( rcmem_commit() == RCM_SUCCESS );
+    CU_ASSERT_FATAL ( rcmem_release(NO_CPU_RESET) == RCM_SUCCESS );
+    tm_emu_advance(2 * RCM_IDLE_MS * 1000000ULL);
+    CU_ASSERT_FATAL ( tm_timer_poll() == 0 );
+    CU_ASSERT_FATAL ( bus.errors == 0 );
+}
+
+void test_rcmem_image(void) {
+    printf("\n");
+    printf("[test_rcmem_image] ----------------------------------------\n");
+    /* memory written through the bus persists in the image file */
+    CU_ASSERT_FATAL ( rcmem_hold() == RCM_SUCCESS );
+    CU_ASSERT_FATAL ( rcmem_write(0xfff0, wbuf, 16, SET_MEM_ACCESS) == 16 );
+    CU_ASSERT_FATAL ( rcmem_write(0xff, wbuf, 1, SET_IO_ACCESS) == 1 );
+    CU_ASSERT_FATAL ( rcmem_release(NO_CPU_RESET) == RCM_SUCCESS );
+    emu_bus8085_detach(&bus);
+    CU_ASSERT_FATAL ( bus.mem == NULL );
+
+    CU_ASSERT_FATAL ( emu_bus8085_attach(&bus, IMG_FILE) == PM_SUCCESS );
+    CU_ASSERT_FATAL ( memcmp(&bus.mem[0xfff0], wbuf, 16) == 0 );
+    CU_ASSERT_FATAL ( bus.io[0xff] == wbuf[0] );
+    CU_ASSERT_FATAL ( rcmem_hold() == RCM_SUCCESS );
+    memset(rbuf, 0, sizeof(rbuf));
+    CU_ASSERT_FATAL ( rcmem_read(0xfff0, rbuf, 16, SET_MEM_ACCESS) == 16 );
+    CU_ASSERT_FATAL ( memcmp(rbuf, wbuf, 16) == 0 );
+    CU_ASSERT_FATAL ( rcmem_release(NO_CPU_RESET) == RCM_SUCCESS );
+}
+
+void test_rcmem_bench(void) {
+    double t0, t_wr, t_rd;
+    uint64_t e0, e_wr, e_rd;
+
+    printf("\n");
+    printf("[test_rcmem_bench] ----------------------------------------\n");
+    CU_ASSERT_FATAL ( rcmem_hold() == RCM_SUCCESS );
+    t0 = s_wall();
+    e0 = tm_emu_ns();
+    CU_ASSERT_FATAL ( rcmem_write(0x4000, wbuf, BENCH_LEN, SET_MEM_ACCESS) == BENCH_LEN );
+    t_wr = s_wall() - t0;
+    e_wr = tm_emu_ns() - e0;
+    t0 = s_wall();
+    e0 = tm_emu_ns();
+    CU_ASSERT_FATAL ( rcmem_read(0x4000, rbuf, BENCH_LEN, SET_MEM_ACCESS) == BENCH_LEN );
+    t_rd = s_wall() - t0;
+    e_rd = tm_emu_ns() - e0;
+    CU_ASSERT_FATAL ( rcmem_release(NO_CPU_RESET) == RCM_SUCCESS );
+    CU_ASSERT_FATAL ( memcmp(rbuf, wbuf, BENCH_LEN) == 0 );
+    CU_ASSERT_FATAL ( bus.errors == 0 );
+
+    printf("BENCH rcmem_write bytes=%d host_Bps=%.0f target_ns_per_byte=%llu\n",
+        BENCH_LEN, BENCH_LEN / t_wr, (unsigned long long)(e_wr / BENCH_LEN));
+    printf("BENCH rcmem_read  bytes=%d host_Bps=%.0f target_ns_per_byte=%llu\n",
+        BENCH_LEN, BENCH_LEN / t_rd, (unsigned long long)(e_rd / BENCH_LEN));
+}
+
+int main() {
+	// system init
+	printf("{TDD} System Init...\n");
+	remove(IMG_FILE);
+	pm_init();
+	if (emu_bus8085_attach(&bus, IMG_FILE) != PM_SUCCESS) {
+	    printf("{TDD} bus model failed to attach!\n");
+	    return -1;
+	}
+
+    CU_pSuite pSuite = NULL;
+    if (CUE_SUCCESS != CU_initialize_registry())
+        return CU_get_error();
+
+    pSuite = CU_add_suite("Test Suite - RCU85 Memory Manager (emulated 8085 bus)", init_suite, clean_suite);
+    if (pSuite == NULL) {
+        CU_cleanup_registry();
+        return CU_get_error();
+    }
+
+    if ( !CU_add_test(pSuite, "[RCMEM] Hold, release", test_rcmem_hold) ) {
+        CU_cleanup_registry();
+        return CU_get_error();
+    }
+    if ( !CU_add_test(pSuite, "[RCMEM] Memory, I/O read/write", test_rcmem_rw) ) {
+        CU_cleanup_registry();
+        return CU_get_error();
+    }
+    if ( !CU_add_test(pSuite, "[RCMEM] Burst transfers, bus timing", test_rcmem_burst) ) {
+        CU_cleanup_registry();
+        return CU_get_error();
+    }
+    if ( !CU_add_test(pSuite, "[RCMEM] Bus timing calibration", test_rcmem_calibrate) ) {
+        CU_cleanup_registry();
+        return CU_get_error();
+    }
+    if ( !CU_add_test(pSuite, "[RCMEM] Transactions, idle release", test_rcmem_transaction) ) {
+        CU_cleanup_registry();
+        return CU_get_error();
+    }
+    if ( !CU_add_test(pSuite, "[RCMEM] Image file persistence", test_rcmem_image) ) {
+        CU_cleanup_registry();
+        return CU_get_error();
+    }
+    if ( !CU_add_test(pSuite, "[RCMEM] Throughput", test_rcmem_bench) ) {
+        CU_cleanup_registry();
+        return CU_get_error();
+    }
+
+    CU_basic_set_mode(CU_BRM_VERBOSE);
+    CU_basic_run_tests();
+    CU_cleanup_registry();
+    emu_bus8085_detach(&bus);
+    return CU_get_error();
+}
@@ -240,6 +240,32 @@ void test_stringutils_sutil_asciinumber(void) {
     //printf("VALUE[-2147483648] --> len[%d] :: %s\n", (int)ret, strbuf);
 }
 
+void test_stringutils_sutil_asciiunsigned(void) {
+    char strbuf[12];
+    uint8_t ret;
+
+	memset(strbuf,0,sizeof(strbuf));
+    ret = sutil_asciiunsigned(strbuf,0);
+	CU_ASSERT(ret == 1);
+	CU_ASSERT_STRING_EQUAL(strbuf,"0");
+
+	memset(strbuf,0,sizeof(strbuf));
+    ret = sutil_asciiunsigned(strbuf,12003);
+	CU_ASSERT(ret == 5);
+	CU_ASSERT_STRING_EQUAL(strbuf,"12003");
+
+    // above the int32_t range
+	memset(strbuf,0,sizeof(strbuf));
+    ret = sutil_asciiunsigned(strbuf,2147483648UL);
+	CU_ASSERT(ret == 10);
+	CU_ASSERT_STRING_EQUAL(strbuf,"2147483648");
+
+	memset(strbuf,0,sizeof(strbuf));
+    ret = sutil_asciiunsigned(strbuf,4294967295UL);
+	CU_ASSERT(ret == 10);
+	CU_ASSERT_STRING_EQUAL(strbuf,"4294967295");
+}
+
 int main() {
 
     CU_pSuite pSuite = NULL;
@@ -259,7 +285,8 @@ int main() {
          !CU_add_test(pSuite, "test stringutils / sutil_asciihex_byte()", test_stringutils_sutil_asciihex_byte) || 
          !CU_add_test(pSuite, "test stringutils / sutil_asciihex_word()", test_stringutils_sutil_asciihex_word) ||
          !CU_add_test(pSuite, "test stringutils / sutil_asciihex_long()", test_stringutils_sutil_asciihex_long) ||
-         !CU_add_test(pSuite, "test stringutils / sutil_asciinumber()",   test_stringutils_sutil_asciinumber)   ) {
+         !CU_add_test(pSuite, "test stringutils / sutil_asciinumber()",   test_stringutils_sutil_asciinumber)   ||
+         !CU_add_test(pSuite, "test stringutils / sutil_asciiunsigned()", test_stringutils_sutil_asciiunsigned) ) {
         CU_cleanup_registry();
         return CU_get_error();
     }
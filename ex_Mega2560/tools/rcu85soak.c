@@ -0,0 +1,779 @@
+/*********************************************************************
+ * rcu85soak.c
+ *
+ * Version 1.0
+ * ---
+ * Session replay and soak load for the RCU85 Monitor (Linux). Plays
+ * recorded operator sessions into the host build of the monitor
+ * (../RCU85Monitor/rcu85mon_host) over its pty, at a set fraction of
+ * the line rate, for a number of loops or for hours. It reports
+ *
+ *  - Rx bytes the monitor dropped (its Rx overflow count, SIGUSR1)
+ *  - commands and hex records, errors and timeouts
+ *  - response latency percentiles, for commands and hex records
+ *  - stack high-water mark and least free RAM ('mem' command)
+ *
+ * every report interval, and at the end compares the monitor's memory
+ * image (RCU85_IMAGE) with what the session wrote.
+ *
+ * USAGE
+ *
+ *  rcu85soak [options] session [session ...]
+ *
+ *  -x path     monitor to run, default ../RCU85Monitor/rcu85mon_host
+ *  -d device   use a monitor that is already running on a pty or tty,
+ *              no overflow count and no image check
+ *  -I image    RCU85_IMAGE for the monitor, default soak.img. Its
+ *              contents, if any, are the starting point of the check.
+ *  -b baud     line rate, passed on as RCU85_BAUD (0: unpaced pty),
+ *              default 19200
+ *  -s percent  send speed, percent of the line rate, default 100
+ *  -g ms       think time between commands, default 0
+ *  -n loops    play the sessions this many times, default 1
+ *  -t seconds  or keep playing them for this long
+ *  -i seconds  report interval, default 60
+ *  -T ms       response timeout, default 5000
+ *
+ * Exits 1 on timeouts or an image mismatch.
+ *
+ * SESSION FILES hold what the operator typed, one line per command.
+ * Empty lines and lines starting with '#' are skipped.
+ *  - commands wait for the monitor's "OK" or "Error" before the next
+ *  - the lines after 'hwrt' are Intel HEX records, pasted: they go out
+ *    back to back and each is matched with its " OK" when it comes.
+ *    The paste starts once the monitor has taken the 'hwrt' line.
+ *  - the line after 'bwrt' (or 'b') is its hex data, sent without CR
+ * 'write', 'hwrt' and 'bwrt' (after 'addr'), in the 'iom' address map
+ * set, update the expected image when the monitor reports success.
+ *
+ * REPORT lines (latencies in us, pNN over the interval, max overall)
+ *
+ *  SOAK t=<s> loops=.. cmds=.. recs=.. errors=.. timeouts=..
+ *       overflow=.. cmd_p50=.. cmd_p90=.. cmd_p99=.. cmd_max=..
+ *       rec_p50=.. rec_p99=.. rec_max=.. stack_max=.. free_min=..
+ *
+ **********************************************************************/
+
+#define _GNU_SOURCE
+#include <avrlib/gpio_emu_dev.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <stdint.h>
+#include <string.h>
+#include <errno.h>
+#include <fcntl.h>
+#include <math.h>
+#include <poll.h>
+#include <signal.h>
+#include <termios.h>
+#include <time.h>
+#include <unistd.h>
+#include <sys/wait.h>
+
+#define OUT_LEN     65536
+#define LINE_LEN    256
+#define PEND_MAX    1024
+#define HIST_LEN    200     /* 20 buckets per decade, 1 us .. 100 s */
+
+/* options */
+static const char * opt_mon   = "../RCU85Monitor/rcu85mon_host";
+static const char * opt_dev   = NULL;
+static const char * opt_image = "soak.img";
+static long     opt_baud  = 19200;
+static long     opt_pct   = 100;
+static long     opt_think = 0;
+static long     opt_loops = 0;
+static long     opt_secs  = 0;
+static long     opt_ival  = 60;
+static long     opt_tmout = 5000;
+
+/* the monitor */
+static pid_t    mon_pid = -1;
+static int      mon_fd  = -1;       /* serial port */
+static int      mon_out = -1;       /* its stdout, LED lines */
+static int      mon_err = -1;       /* its stderr, STATS lines */
+static char     errline[LINE_LEN];
+static size_t   errlen = 0;
+static unsigned long long overflow = 0;
+static int      stats_seen = 0;
+
+/* what came back, from out_pos on not yet matched */
+static char     out[OUT_LEN];
+static size_t   out_len = 0;
+static size_t   out_pos = 0;
+
+/* send pacing */
+static double   rate = 0.0;         /* bytes/s, 0 = as fast as it goes */
+static double   pace_t = 0.0;       /* when the next byte may go */
+
+/* expected image */
+static uint8_t  shadow[EMU_8085_IMG_SIZE];
+static uint8_t  map_io = 0;
+static uint16_t bw_addr = 0;
+
+/* hex records sent, waiting for their response */
+typedef struct {
+    double   t;
+    uint8_t  type;
+    uint8_t  len;
+    uint16_t addr;
+    uint8_t  data[32];
+} pend_t;
+static pend_t   pend[PEND_MAX];
+static int      pend_head = 0;
+static int      pend_cnt  = 0;
+
+/* statistics */
+typedef struct {
+    unsigned long n;
+    unsigned long b[HIST_LEN];
+    double max;
+} hist_t;
+static hist_t   h_cmd, h_rec;       /* interval */
+static double   max_cmd = 0.0, max_rec = 0.0;
+static unsigned long n_cmds = 0, n_recs = 0, n_errors = 0, n_tmout = 0, n_loops = 0;
+static unsigned stack_max = 0, free_min = 0;
+static double   t_start;
+
+static double now(void) {
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return (double)ts.tv_sec + (double)ts.tv_nsec / 1e9;
+}
+
+/* --- Latency histograms --------------------------------------------*/
+
+static void hist_add(hist_t * h, double * max, double s) {
+    double us = s * 1e6;
+    int i = (us < 1.0) ? 0 : (int)(log10(us) * 20.0);
+    if (i >= HIST_LEN)
+        i = HIST_LEN - 1;
+    h->b[i]++;
+    h->n++;
+    if (us > h->max)
+        h->max = us;
+    if (us > *max)
+        *max = us;
+}
+
+/* upper edge of the bucket holding the p'th percentile, us (not past the max seen) */
+static unsigned long hist_pct(const hist_t * h, int p) {
+    unsigned long want, acc = 0;
+    double edge;
+    int i;
+    if (h->n == 0)
+        return 0;
+    want = (h->n * (unsigned long)p + 99) / 100;
+    for ( i = 0 ; i < HIST_LEN ; ++i ) {
+        acc += h->b[i];
+        if (acc >= want)
+            break;
+    }
+    edge = pow(10.0, (i + 1) / 20.0);
+    return (unsigned long)((edge < h->max) ? edge : h->max);
+}
+
+/* --- Monitor I/O ---------------------------------------------------*/
+
+static void parse_errline(void) {
+    const char * p;
+    if (strncmp(errline, "STATS ", 6) == 0 && (p = strstr(errline, "overflow=")) != NULL) {
+        overflow = strtoull(p + 9, NULL, 10);
+        stats_seen++;
+    } else if (errline[0]) {
+        fprintf(stderr, "monitor: %s\n", errline);
+    }
+}
+
+/* read whatever is there, waiting up to 'wait' seconds for the first */
+static void pump(double wait) {
+    struct pollfd pfd[3];
+    char buf[1024];
+    int n, i, nfd = 0;
+    pfd[nfd].fd = mon_fd;  pfd[nfd++].events = POLLIN;
+    if (mon_out >= 0) { pfd[nfd].fd = mon_out; pfd[nfd++].events = POLLIN; }
+    if (mon_err >= 0) { pfd[nfd].fd = mon_err; pfd[nfd++].events = POLLIN; }
+    if (poll(pfd, nfd, (int)(wait * 1000.0)) <= 0)
+        return;
+    if (pfd[0].revents & POLLIN) {
+        if (out_len == OUT_LEN) {
+            memmove(out, out + out_pos, out_len - out_pos);
+            out_len -= out_pos;
+            out_pos = 0;
+            if (out_len == OUT_LEN)
+                out_len = out_pos = 0;  /* nothing matched in 64K, drop it */
+        }
+        n = (int)read(mon_fd, out + out_len, OUT_LEN - out_len);
+        if (n > 0)
+            out_len += (size_t)n;
+    }
+    for ( i = 1 ; i < nfd ; ++i ) {
+        if (!(pfd[i].revents & (POLLIN | POLLHUP)))
+            continue;
+        n = (int)read(pfd[i].fd, buf, sizeof(buf));
+        if (n <= 0) {
+            close(pfd[i].fd);
+            if (pfd[i].fd == mon_out) mon_out = -1; else mon_err = -1;
+        } else if (pfd[i].fd == mon_err) {
+            int k;
+            for ( k = 0 ; k < n ; ++k ) {
+                if (buf[k] == '\n') {
+                    errline[errlen] = '\0';
+                    parse_errline();
+                    errlen = 0;
+                } else if (errlen < LINE_LEN - 1) {
+                    errline[errlen++] = buf[k];
+                }
+            }
+        } /* stdout: the LED display, not needed */
+    }
+}
+
+static void send_paced(const char * s, size_t len) {
+    while (len) {
+        double t = now();
+        size_t n = len;
+        if (rate > 0.0) {
+            if (pace_t < t - 0.01)
+                pace_t = t;             /* an idle line banks no time */
+            n = (t >= pace_t) ? (size_t)((t - pace_t) * rate) + 1 : 0;
+            if (n > len)
+                n = len;
+        }
+        if (n) {
+            ssize_t w = write(mon_fd, s, n);
+            if (w > 0) {
+                s += w;
+                len -= (size_t)w;
+                if (rate > 0.0)
+                    pace_t += (double)w / rate;
+            }
+        }
+        pump(len ? 0.001 : 0.0);
+    }
+}
+
+/* earliest of the strings in the unmatched output, -1 if none */
+static int find_first(const char * const * str, size_t * at) {
+    int i, best = -1;
+    char * bp = NULL;
+    for ( i = 0 ; str[i] ; ++i ) {
+        char * p = memmem(out + out_pos, out_len - out_pos, str[i], strlen(str[i]));
+        if (p && (!bp || p < bp)) {
+            bp = p;
+            best = i;
+        }
+    }
+    if (best >= 0)
+        *at = (size_t)(bp - out);
+    return best;
+}
+
+/* wait for the end of a command's response: 0 OK, 1 error, -1 timeout.
+ * 'resp' gets the response text. */
+static int wait_cmd(char * resp, size_t rlen) {
+    static const char * const ends[] = { "OK\r\n\r\n", "Error (", NULL };
+    double limit = now() + opt_tmout / 1000.0;
+    size_t at = 0, end;
+    int k;
+    for (;;) {
+        k = find_first(ends, &at);
+        if (k == 0) {
+            end = at + 6;
+            break;
+        }
+        if (k == 1) {
+            char * e = memmem(out + at, out_len - at, "\r\n", 2);
+            if (e) {
+                end = (size_t)(e - out) + 2;
+                break;
+            }
+        }
+        if (now() > limit)
+            return -1;
+        pump(0.01);
+    }
+    if (resp) {
+        size_t n = end - out_pos;
+        if (n >= rlen)
+            n = rlen - 1;
+        memcpy(resp, out + out_pos, n);
+        resp[n] = '\0';
+    }
+    out_pos = end;
+    return (k == 0) ? 0 : 1;
+}
+
+/* wait for the parser to take a command line ("\r\n" after the echo),
+ * as an operator would before pasting into 'hwrt' or 'bwrt': typeahead
+ * after the CR is read along with it and the line is never taken. */
+static int wait_echo(void) {
+    double limit = now() + opt_tmout / 1000.0;
+    char * p;
+    while ((p = memmem(out + out_pos, out_len - out_pos, "\r\n", 2)) == NULL) {
+        if (now() > limit)
+            return -1;
+        pump(0.01);
+    }
+    out_pos = (size_t)(p - out) + 2;
+    return 0;
+}
+
+/* --- Expected image ------------------------------------------------*/
+
+static void shadow_put(uint16_t addr, const uint8_t * data, int len) {
+    int i;
+    for ( i = 0 ; i < len ; ++i ) {
+        if (map_io)
+            shadow[EMU_8085_MEM_SIZE + ((addr + i) & 0xff)] = data[i];
+        else
+            shadow[(uint16_t)(addr + i)] = data[i];
+    }
+}
+
+static int hexval(char c) {
+    if (c >= '0' && c <= '9') return c - '0';
+    c |= 0x20;
+    return (c >= 'a' && c <= 'f') ? c - 'a' + 10 : -1;
+}
+
+static int hexbyte(const char * s) {
+    int h = hexval(s[0]);
+    int l = (h >= 0) ? hexval(s[1]) : -1;
+    return (l >= 0) ? (h << 4 | l) : -1;
+}
+
+/* parse ':LLAAAATT<data>CC' into a pending record */
+static int parse_rec(const char * s, pend_t * r) {
+    int i, v;
+    if (s[0] != ':' || strlen(s) < 11)
+        return -1;
+    r->len  = (uint8_t)hexbyte(s + 1);
+    r->addr = (uint16_t)(hexbyte(s + 3) << 8 | hexbyte(s + 5));
+    r->type = (uint8_t)hexbyte(s + 7);
+    if (r->len > sizeof(r->data) || strlen(s) < (size_t)(11 + 2 * r->len))
+        return -1;
+    for ( i = 0 ; i < r->len ; ++i ) {
+        if ((v = hexbyte(s + 9 + 2 * i)) < 0)
+            return -1;
+        r->data[i] = (uint8_t)v;
+    }
+    return 0;
+}
+
+/* --- Records in flight ---------------------------------------------*/
+
+/* match responses to sent records, oldest first */
+static void match_recs(void) {
+    static const char * const resp[] = { " OK\r\n", " END\r\n", " CRC-ERR\r\n", "Error (", NULL };
+    size_t at;
+    int k;
+    while (pend_cnt) {
+        pend_t * r = &pend[pend_head];
+        k = find_first(resp, &at);
+        if (k < 0) {
+            if (now() - r->t > opt_tmout / 1000.0) {
+                n_tmout++;
+                pend_head = (pend_head + 1) % PEND_MAX;
+                pend_cnt--;
+                continue;
+            }
+            return;
+        }
+        out_pos = at + strlen(resp[k]);
+        if (k == 3) {
+            /* hwrt gave up, the rest of the paste goes to the parser */
+            n_errors += (unsigned long)pend_cnt;
+            pend_cnt = 0;
+            out_pos = at;
+            return;
+        }
+        n_recs++;
+        hist_add(&h_rec, &max_rec, now() - r->t);
+        if (k == 2) {
+            n_errors++;
+        } else if (r->type == 0) {
+            shadow_put(r->addr, r->data, r->len);
+        }
+        pend_head = (pend_head + 1) % PEND_MAX;
+        pend_cnt--;
+    }
+}
+
+static void drain_recs(void) {
+    while (pend_cnt) {
+        pump(0.01);
+        match_recs();
+    }
+}
+
+/* wait for 'hwrt' to finish. If bytes of the paste were lost it may
+ * still be waiting for records: Ctrl-C is not a hex character, it makes
+ * it give up with a syntax error. */
+static void end_hwrt(void) {
+    drain_recs();
+    if (wait_cmd(NULL, 0) < 0) {
+        n_tmout++;
+        send_paced("\x03", 1);
+        if (wait_cmd(NULL, 0) < 0)
+            n_tmout++;
+    }
+}
+
+/* --- Reports -------------------------------------------------------*/
+
+static void read_mem(void) {
+    char resp[512];
+    const char * p;
+    send_paced("mem\r", 4);
+    if (wait_cmd(resp, sizeof(resp)) == 0) {
+        if ((p = strstr(resp, "max")) != NULL)
+            stack_max = (unsigned)strtoul(p + 3, NULL, 10);
+        if ((p = strstr(resp, "min")) != NULL)
+            free_min = (unsigned)strtoul(p + 3, NULL, 10);
+    }
+}
+
+static void report(void) {
+    if (mon_pid > 0) {
+        int seen = stats_seen;
+        double limit = now() + 0.5;
+        kill(mon_pid, SIGUSR1);
+        while (stats_seen == seen && now() < limit)
+            pump(0.01);
+    }
+    read_mem();
+    printf("SOAK t=%.0f loops=%lu cmds=%lu recs=%lu errors=%lu timeouts=%lu overflow=%llu "
+        "cmd_p50=%lu cmd_p90=%lu cmd_p99=%lu cmd_max=%.0f rec_p50=%lu rec_p99=%lu rec_max=%.0f "
+        "stack_max=%u free_min=%u\n",
+        now() - t_start, n_loops, n_cmds, n_recs, n_errors, n_tmout, overflow,
+        hist_pct(&h_cmd, 50), hist_pct(&h_cmd, 90), hist_pct(&h_cmd, 99), max_cmd,
+        hist_pct(&h_rec, 50), hist_pct(&h_rec, 99), max_rec, stack_max, free_min);
+    fflush(stdout);
+    memset(&h_cmd, 0, sizeof(h_cmd));
+    memset(&h_rec, 0, sizeof(h_rec));
+}
+
+/* --- Session replay ------------------------------------------------*/
+
+typedef enum { ST_CMD = 0, ST_HWRT, ST_BWRT } st_t;
+
+static int is_cmd(const char * noun, const char * l, const char * s) {
+    return strcmp(noun, l) == 0 || (s && strcmp(noun, s) == 0);
+}
+
+static void run_cmd(char * line) {
+    char resp[1024];
+    char noun[16] = "";
+    char * args;
+    double t0;
+    int rc;
+    sscanf(line, "%15s", noun);
+    send_paced(line, strlen(line));
+    t0 = now();
+    send_paced("\r", 1);
+    rc = wait_cmd(resp, sizeof(resp));
+    if (rc < 0) {
+        n_tmout++;
+        return;
+    }
+    n_cmds++;
+    hist_add(&h_cmd, &max_cmd, now() - t0);
+    if (rc > 0 || strstr(resp, "ERROR") || strstr(resp, "failed")) {
+        n_errors++;
+        return;
+    }
+    args = line + strspn(line, " \t");
+    args += strcspn(args, " \t");
+    if (is_cmd(noun, "write", "w") && strstr(resp, "Write OK")) {
+        uint8_t data[16];
+        char * p;
+        int n = 0;
+        uint16_t addr = (uint16_t)strtoul(args, &p, 16);
+        while (n < (int)sizeof(data) && *(p += strspn(p, " \t")))
+            data[n++] = (uint8_t)strtoul(p, &p, 16);
+        shadow_put(addr, data, n);
+    } else if (is_cmd(noun, "iom", "im")) {
+        if (strstr(args, "io"))  map_io = 1;
+        if (strstr(args, "mem")) map_io = 0;
+    } else if (is_cmd(noun, "addr", "a") && *(args + strspn(args, " \t"))) {
+        bw_addr = (uint16_t)strtoul(args, NULL, 16);
+    }
+}
+
+static void think(void) {
+    if (opt_think > 0) {
+        double limit = now() + opt_think / 1000.0;
+        while (now() < limit)
+            pump(0.01);
+        match_recs();
+    }
+}
+
+static int play(const char * file, double * t_report) {
+    FILE * f = fopen(file, "r");
+    char line[LINE_LEN];
+    st_t st = ST_CMD;
+    if (!f) {
+        perror(file);
+        return -1;
+    }
+    while (fgets(line, sizeof(line), f)) {
+        line[strcspn(line, "\r\n")] = '\0';
+        if (line[0] == '\0' || line[0] == '#')
+            continue;
+        if (st == ST_HWRT && line[0] != ':') {
+            /* paste ended without an EOF record */
+            end_hwrt();
+            st = ST_CMD;
+        }
+        if (st == ST_HWRT) {
+            pend_t * r = &pend[(pend_head + pend_cnt) % PEND_MAX];
+            if (pend_cnt == PEND_MAX)
+                drain_recs();
+            r->type = 0xff;
+            send_paced(line, strlen(line));
+            if (parse_rec(line, r) == 0) {
+                r->t = now();
+                pend_cnt++;
+            }
+            send_paced("\r\n", 2);
+            match_recs();
+            if (r->type == 1) {
+                end_hwrt();
+                st = ST_CMD;
+            }
+        } else if (st == ST_BWRT) {
+            char resp[256];
+            const char * p;
+            double t0;
+            int rc;
+            send_paced(line, strlen(line));
+            t0 = now();
+            rc = wait_cmd(resp, sizeof(resp));
+            if (rc < 0) {
+                n_tmout++;
+            } else {
+                n_cmds++;
+                hist_add(&h_cmd, &max_cmd, now() - t0);
+                if (rc > 0 || strstr(resp, "ERROR")) {
+                    n_errors++;
+                } else {
+                    for ( p = line ; *p ; ) {
+                        int v = hexbyte(p);
+                        if (v >= 0) {
+                            uint8_t b = (uint8_t)v;
+                            shadow_put(bw_addr++, &b, 1);
+                            p += 2;
+                        } else {
+                            p++;
+                        }
+                    }
+                }
+            }
+            st = ST_CMD;
+            think();
+        } else {
+            char noun[16] = "";
+            sscanf(line, "%15s", noun);
+            if (strcmp(noun, "hwrt") == 0) {
+                send_paced("hwrt\r", 5);
+                if (wait_echo() < 0)
+                    n_tmout++;
+                st = ST_HWRT;
+            } else if (is_cmd(noun, "bwrt", "b")) {
+                send_paced(line, strlen(line));
+                send_paced("\r", 1);
+                if (wait_echo() < 0)
+                    n_tmout++;
+                st = ST_BWRT;
+            } else {
+                run_cmd(line);
+                think();
+            }
+        }
+        if (st == ST_CMD && now() >= *t_report) {
+            report();
+            *t_report = now() + opt_ival;
+        }
+    }
+    if (st == ST_HWRT) {
+        end_hwrt();
+    }
+    fclose(f);
+    return 0;
+}
+
+/* --- Setup ---------------------------------------------------------*/
+
+static int start_monitor(void) {
+    int po[2], pe[2];
+    char line[LINE_LEN], baud[16];
+    char * p;
+    FILE * f;
+    if (pipe(po) != 0 || pipe(pe) != 0)
+        return -1;
+    mon_pid = fork();
+    if (mon_pid < 0)
+        return -1;
+    if (mon_pid == 0) {
+        dup2(po[1], 1);
+        dup2(pe[1], 2);
+        close(po[0]); close(po[1]); close(pe[0]); close(pe[1]);
+        setenv("RCU85_IMAGE", opt_image, 1);
+        if (opt_baud > 0) {
+            snprintf(baud, sizeof(baud), "%ld", opt_baud);
+            setenv("RCU85_BAUD", baud, 1);
+        } else {
+            unsetenv("RCU85_BAUD");
+        }
+        execl(opt_mon, opt_mon, (char *)NULL);
+        perror(opt_mon);
+        _exit(127);
+    }
+    close(po[1]);
+    close(pe[1]);
+    mon_err = pe[0];
+    /* "rcu85mon: serial port on /dev/pts/N" */
+    f = fdopen(po[0], "r");
+    while (fgets(line, sizeof(line), f)) {
+        if ((p = strstr(line, "serial port on ")) != NULL) {
+            p += 15;
+            p[strcspn(p, "\r\n")] = '\0';
+            mon_fd = open(p, O_RDWR | O_NOCTTY);
+            break;
+        }
+    }
+    mon_out = dup(po[0]);
+    fcntl(mon_out, F_SETFL, O_NONBLOCK);
+    fclose(f);
+    return (mon_fd >= 0) ? 0 : -1;
+}
+
+static void stop_monitor(void) {
+    int status;
+    double limit = now() + 5.0;
+    if (mon_pid <= 0)
+        return;
+    kill(mon_pid, SIGTERM);
+    while (waitpid(mon_pid, &status, WNOHANG) == 0 && now() < limit)
+        pump(0.01);
+    while (mon_err >= 0 && now() < limit)
+        pump(0.01);     /* the last STATS line */
+    mon_pid = -1;
+}
+
+static long verify_image(void) {
+    uint8_t img[EMU_8085_IMG_SIZE];
+    long i, bad = 0;
+    FILE * f = fopen(opt_image, "rb");
+    if (!f || fread(img, 1, sizeof(img), f) != sizeof(img)) {
+        fprintf(stderr, "rcu85soak: cannot read image %s\n", opt_image);
+        if (f) fclose(f);
+        return -1;
+    }
+    fclose(f);
+    for ( i = 0 ; i < EMU_8085_IMG_SIZE ; ++i ) {
+        if (img[i] != shadow[i]) {
+            if (bad < 8)
+                fprintf(stderr, "rcu85soak: %s 0x%04lx: 0x%02x, expected 0x%02x\n",
+                    (i < EMU_8085_MEM_SIZE) ? "mem" : "io",
+                    (i < EMU_8085_MEM_SIZE) ? i : i - EMU_8085_MEM_SIZE, img[i], shadow[i]);
+            bad++;
+        }
+    }
+    return bad;
+}
+
+static void usage(void) {
+    fprintf(stderr,
+        "usage: rcu85soak [-x monitor | -d device] [-I image] [-b baud] [-s percent]\n"
+        "                 [-g ms] [-n loops | -t seconds] [-i seconds] [-T ms] session...\n");
+    exit(2);
+}
+
+int main(int argc, char * argv[]) {
+    double t_report, t_end;
+    struct termios tio;
+    long bad = 0;
+    int opt, i;
+    FILE * f;
+
+    while ((opt = getopt(argc, argv, "x:d:I:b:s:g:n:t:i:T:")) != -1) {
+        switch (opt) {
+        case 'x': opt_mon   = optarg; break;
+        case 'd': opt_dev   = optarg; break;
+        case 'I': opt_image = optarg; break;
+        case 'b': opt_baud  = atol(optarg); break;
+        case 's': opt_pct   = atol(optarg); break;
+        case 'g': opt_think = atol(optarg); break;
+        case 'n': opt_loops = atol(optarg); break;
+        case 't': opt_secs  = atol(optarg); break;
+        case 'i': opt_ival  = atol(optarg); break;
+        case 'T': opt_tmout = atol(optarg); break;
+        default:  usage();
+        }
+    }
+    if (optind >= argc)
+        usage();
+    if (opt_loops <= 0 && opt_secs <= 0)
+        opt_loops = 1;
+    if (opt_baud > 0 && opt_pct > 0)
+        rate = opt_baud / 10.0 * opt_pct / 100.0;
+    signal(SIGPIPE, SIG_IGN);
+
+    if (opt_dev) {
+        mon_fd = open(opt_dev, O_RDWR | O_NOCTTY);
+        if (mon_fd < 0) {
+            perror(opt_dev);
+            return 2;
+        }
+    } else {
+        /* the image as it is now is the expected starting point */
+        if ((f = fopen(opt_image, "rb")) != NULL) {
+            if (fread(shadow, 1, sizeof(shadow), f) != sizeof(shadow))
+                memset(shadow, 0, sizeof(shadow));
+            fclose(f);
+        }
+        if (start_monitor() != 0) {
+            fprintf(stderr, "rcu85soak: cannot start %s\n", opt_mon);
+            return 2;
+        }
+    }
+    /* no echo, no line editing: every byte as it comes */
+    if (tcgetattr(mon_fd, &tio) == 0) {
+        cfmakeraw(&tio);
+        tcsetattr(mon_fd, TCSANOW, &tio);
+    }
+
+    /* settle, drop the banner */
+    t_start = now();
+    while (now() - t_start < 0.5)
+        pump(0.05);
+    out_pos = out_len;
+
+    t_start = now();
+    t_end = t_start + opt_secs;
+    t_report = t_start + opt_ival;
+    while ((opt_loops > 0 && n_loops < (unsigned long)opt_loops) ||
+           (opt_secs > 0 && now() < t_end)) {
+        for ( i = optind ; i < argc ; ++i ) {
+            if (play(argv[i], &t_report) != 0) {
+                stop_monitor();
+                return 2;
+            }
+        }
+        n_loops++;
+    }
+    report();
+
+    if (!opt_dev) {
+        stop_monitor();
+        bad = verify_image();
+        printf("SOAK image=%s %s", opt_image, (bad == 0) ? "OK" : "MISMATCH");
+        if (bad > 0)
+            printf(" bytes=%ld", bad);
+        printf(" overflow=%llu\n", overflow);
+    }
+    return (bad != 0 || n_tmout) ? 1 : 0;
+}
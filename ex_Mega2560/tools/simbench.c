@@ -0,0 +1,557 @@
+/*********************************************************************
+ * simbench.c
+ *
+ * Version 1.0
+ * ---
+ * Cycle counts of the real firmware (Linux). Runs an atmega2560 ELF
+ * under simavr, plays a scenario script into UART1 and reports the
+ * simulated CPU cycles each benchmark took. Host builds of avrlib
+ * (avrlinuxtest/bench) time the logic, this times the AVR code the
+ * compiler really produced: 8-bit arithmetic, lpm, software division
+ * and the ISRs all cost what they cost on the part.
+ *
+ * The RCU85 side of the board is modelled on the GPIO ports the way
+ * rcu85mem.c drives them: HLDA follows HOLD, addresses are latched on
+ * the falling edge of ALE, /RD drives a 64K memory (256 I/O bytes if
+ * IO/M is high) onto AD0..7 and /WR stores from it, while EXT_SEL is
+ * low. Strobes without a hold are counted as errors, the pins turning
+ * around at hold and release are not. The keyboard/LED panel pins are
+ * left alone.
+ *
+ * USAGE
+ *
+ *  simbench [-m mcu] [-f hz] [-b baud] [-v file.vcd] script firmware.elf
+ *
+ *  -m mcu      simavr core, default atmega2560
+ *  -f hz       CPU clock, default 16000000 (the ELF's, if it has one)
+ *  -b baud     UART1 rate the firmware uses, only for the wire time
+ *              figure, default 19200
+ *  -v file     VCD trace of ports A, C, G, K and L (gtkwave)
+ *
+ * Exits 1 if a step times out, verify fails or the core crashes.
+ *
+ * SCRIPT, one step per line, '#' starts a comment line. Text arguments
+ * take the rest of the line, with \r \n \t \s (space) \\ and \xHH.
+ *
+ *  timeout ms          limit for each wait, in target time (def. 5000)
+ *  bench name          start a benchmark: cycle, byte and bus counters
+ *  end                 stop it, prints one line
+ *                          BENCH sim_<name> cycles=.. target_us=..
+ *                          in=.. out=.. wire_cycles=.. rd=.. wr=..
+ *                      cycles run to the last byte out of UART1,
+ *                      wire_cycles is the time the larger byte count
+ *                      needs on the wire alone.
+ *  send text           queue text into UART1 Rx
+ *  expect text         wait for text in the UART1 output
+ *  expectn n text      wait for n more matches of text
+ *  idle ms             wait until UART1 has been quiet for ms
+ *  paste bytes width   queue 'bytes' of text, lines of 'width'
+ *                      characters ending in \r
+ *  ihex addr len       Intel HEX upload of a test pattern, 16 byte
+ *                      records, each sent after the previous " OK"
+ *                      (the echo outruns the input otherwise)
+ *  verify addr len     compare RCU85 memory with the test pattern
+ *
+ * Build: needs libsimavr and libelf, see 'make simbench' in this
+ * folder and in RCU85Monitor.
+ *
+ **********************************************************************/
+
+#define _GNU_SOURCE
+#include <stdio.h>
+#include <stdlib.h>
+#include <stdint.h>
+#include <string.h>
+#include <unistd.h>
+#include <sim_avr.h>
+#include <sim_elf.h>
+#include <sim_irq.h>
+#include <sim_vcd_file.h>
+#include <avr_uart.h>
+#include <avr_ioport.h>
+
+/* ATmega2560 PORTx, data space addresses */
+#define REG_PORTA   0x22
+#define REG_PORTC   0x28
+#define REG_PORTG   0x34
+#define REG_PORTK   0x108
+#define REG_PORTL   0x10b
+
+/* RCU85 bus pins, rcu85mem.c */
+#define G_WR        0x01
+#define G_RD        0x02
+#define G_ALE       0x04
+#define K_EXTSEL    0x80
+#define L_IOM       0x01
+#define L_HOLD      0x02
+#define L_HLDA      2       /* pin number */
+
+#define RXBUF_LEN   65536
+#define TXQ_LEN     65536
+
+static avr_t * avr = NULL;
+static avr_irq_t * uart_in = NULL;
+static avr_irq_t * pin_a[8];
+static avr_irq_t * pin_hlda = NULL;
+static uint32_t freq = 16000000;
+static uint32_t baud = 19200;
+
+/* UART1, target Tx (our input) and Rx queue */
+static char     rxbuf[RXBUF_LEN];
+static size_t   rx_len  = 0;
+static size_t   rx_seen = 0;
+static uint64_t rx_total = 0;
+static uint64_t rx_last_cycle = 0;
+static uint8_t  txq[TXQ_LEN];
+static size_t   tx_head = 0;
+static size_t   tx_len  = 0;
+static uint64_t tx_total = 0;
+static int      xon = 1;
+
+/* RCU85 bus model */
+static struct {
+    uint8_t  mem[0x10000];
+    uint8_t  io[0x100];
+    uint16_t latch;
+    uint8_t  held;
+    uint8_t  last_g;
+    int      busy;
+    unsigned long rd, wr, errors;
+} bus;
+
+/* benchmark in progress */
+static char     b_name[32] = "";
+static uint64_t b_cycle0;
+static uint64_t b_rx0, b_tx0;
+static unsigned long b_rd0, b_wr0;
+static uint32_t tmout_ms = 5000;
+static int      failed = 0;
+
+static uint8_t pattern(uint16_t addr) {
+    return (uint8_t)(addr * 7 + (addr >> 8) + 0x5a);
+}
+
+/* --- UART1 ---------------------------------------------------------*/
+
+static void uart_out_hook(struct avr_irq_t * irq, uint32_t value, void * param) {
+    (void)irq; (void)param;
+    if (rx_len == RXBUF_LEN) {
+        /* keep the unseen tail */
+        size_t keep = rx_len - rx_seen;
+        memmove(rxbuf, rxbuf + rx_seen, keep);
+        rx_len = keep;
+        rx_seen = 0;
+        if (rx_len == RXBUF_LEN) {
+            rx_len = rx_seen = 0;
+        }
+    }
+    rxbuf[rx_len++] = (char)value;
+    rx_total++;
+    rx_last_cycle = avr->cycle;
+}
+
+static void uart_xon_hook(struct avr_irq_t * irq, uint32_t value, void * param) {
+    (void)irq; (void)value; (void)param;
+    xon = 1;
+}
+
+static void uart_xoff_hook(struct avr_irq_t * irq, uint32_t value, void * param) {
+    (void)irq; (void)value; (void)param;
+    xon = 0;
+}
+
+static void queue(const void * data, size_t len) {
+    if (tx_head == tx_len) {
+        tx_head = tx_len = 0;
+    }
+    if (len > TXQ_LEN - tx_len) {
+        fprintf(stderr, "simbench: send queue full\n");
+        len = TXQ_LEN - tx_len;
+        failed = 1;
+    }
+    memcpy(txq + tx_len, data, len);
+    tx_len += len;
+}
+
+/* --- RCU85 bus -----------------------------------------------------*/
+
+static void bus_eval(void) {
+    uint8_t g = avr->data[REG_PORTG];
+    uint8_t l = avr->data[REG_PORTL];
+    uint8_t hold = (l & L_HOLD) ? 1 : 0;
+    uint8_t sel;
+    int i;
+    if (bus.busy)
+        return;     /* our own pin changes */
+    bus.busy = 1;
+    if (hold != bus.held) {
+        bus.held = hold;
+        avr_raise_irq(pin_hlda, hold);
+    }
+    sel = bus.held && !(avr->data[REG_PORTK] & K_EXTSEL);
+    if ((bus.last_g & G_ALE) && !(g & G_ALE)) {
+        bus.latch = ((uint16_t)avr->data[REG_PORTC] << 8) | avr->data[REG_PORTA];
+    }
+    if ((bus.last_g & G_RD) && !(g & G_RD)) {
+        if (sel) {
+            uint8_t val = (l & L_IOM) ? bus.io[bus.latch & 0xff] : bus.mem[bus.latch];
+            for ( i = 0 ; i < 8 ; ++i ) {
+                avr_raise_irq(pin_a[i], (val >> i) & 1);
+            }
+            bus.rd++;
+        } else if (!bus.held) {
+            bus.errors++;
+        }
+    }
+    if (!(bus.last_g & G_WR) && (g & G_WR)) {
+        if (sel) {
+            uint8_t val = avr->data[REG_PORTA];
+            if (l & L_IOM) {
+                bus.io[bus.latch & 0xff] = val;
+            } else {
+                bus.mem[bus.latch] = val;
+            }
+            bus.wr++;
+        } else if (!bus.held) {
+            bus.errors++;
+        }
+    }
+    bus.last_g = g;
+    bus.busy = 0;
+}
+
+static void port_hook(struct avr_irq_t * irq, uint32_t value, void * param) {
+    (void)irq; (void)value; (void)param;
+    bus_eval();
+}
+
+/* --- Running -------------------------------------------------------*/
+
+/* one instruction (or sleep) of the core, feeding UART1 */
+static int step(void) {
+    int state;
+    if (tx_head < tx_len && xon) {
+        avr_raise_irq(uart_in, txq[tx_head++]);
+        tx_total++;
+    }
+    state = avr_run(avr);
+    if (state == cpu_Done || state == cpu_Crashed) {
+        fprintf(stderr, "simbench: core stopped (%d) at cycle %llu\n",
+            state, (unsigned long long)avr->cycle);
+        return -1;
+    }
+    return 0;
+}
+
+static uint64_t ms_cycles(uint32_t ms) {
+    return (uint64_t)ms * freq / 1000;
+}
+
+/* count matches of text in the new output, consuming them */
+static int match(const char * text, size_t tlen, int want) {
+    int found = 0;
+    while (found < want) {
+        char * p = memmem(rxbuf + rx_seen, rx_len - rx_seen, text, tlen);
+        if (!p)
+            break;
+        rx_seen = (size_t)(p - rxbuf) + tlen;
+        found++;
+    }
+    return found;
+}
+
+static int expect(const char * text, size_t tlen, int count) {
+    uint64_t deadline = avr->cycle + ms_cycles(tmout_ms);
+    count -= match(text, tlen, count);
+    while (count > 0) {
+        if (step() < 0)
+            return -1;
+        count -= match(text, tlen, count);
+        if (count > 0 && avr->cycle > deadline) {
+            fprintf(stderr, "simbench: timeout waiting for \"%.*s\"\n", (int)tlen, text);
+            return -1;
+        }
+    }
+    return 0;
+}
+
+static int idle(uint32_t ms) {
+    uint64_t quiet = ms_cycles(ms);
+    uint64_t deadline = avr->cycle + ms_cycles(tmout_ms) + quiet;
+    uint64_t since = avr->cycle;
+    while (tx_head < tx_len || avr->cycle - ((rx_last_cycle > since) ? rx_last_cycle : since) < quiet) {
+        if (step() < 0)
+            return -1;
+        if (avr->cycle > deadline) {
+            fprintf(stderr, "simbench: timeout waiting for idle\n");
+            return -1;
+        }
+    }
+    rx_seen = rx_len;
+    return 0;
+}
+
+static int ihex(uint16_t addr, uint32_t len) {
+    char rec[64];
+    uint32_t off;
+    for ( off = 0 ; off < len ; off += 16 ) {
+        uint16_t a = (uint16_t)(addr + off);
+        int n = (len - off < 16) ? (int)(len - off) : 16;
+        uint8_t sum = (uint8_t)(n + (a >> 8) + (a & 0xff));
+        int i, p;
+        p = sprintf(rec, ":%02X%04X00", n, a);
+        for ( i = 0 ; i < n ; ++i ) {
+            uint8_t d = pattern((uint16_t)(a + i));
+            p += sprintf(rec + p, "%02X", d);
+            sum += d;
+        }
+        p += sprintf(rec + p, "%02X\r\n", (uint8_t)(0 - sum));
+        queue(rec, (size_t)p);
+        if (expect(" OK", 3, 1) < 0)
+            return -1;
+    }
+    queue(":00000001FF\r\n", 13);
+    return expect(" END", 4, 1);
+}
+
+static int verify(uint16_t addr, uint32_t len) {
+    uint32_t i;
+    for ( i = 0 ; i < len ; ++i ) {
+        uint16_t a = (uint16_t)(addr + i);
+        if (bus.mem[a] != pattern(a)) {
+            fprintf(stderr, "simbench: verify 0x%04x: 0x%02x, expected 0x%02x\n",
+                a, bus.mem[a], pattern(a));
+            return -1;
+        }
+    }
+    return 0;
+}
+
+static void bench_end(void) {
+    uint64_t in, out, wire, end;
+    if (!b_name[0])
+        return;
+    in  = tx_total - b_tx0;
+    out = rx_total - b_rx0;
+    end = (rx_last_cycle > b_cycle0) ? rx_last_cycle : avr->cycle;
+    wire = ((in > out) ? in : out) * 10ULL * freq / baud;
+    printf("BENCH sim_%s cycles=%llu target_us=%.1f in=%llu out=%llu wire_cycles=%llu rd=%lu wr=%lu\n",
+        b_name, (unsigned long long)(end - b_cycle0),
+        (double)(end - b_cycle0) * 1e6 / freq,
+        (unsigned long long)in, (unsigned long long)out,
+        (unsigned long long)wire, bus.rd - b_rd0, bus.wr - b_wr0);
+    fflush(stdout);
+    b_name[0] = '\0';
+}
+
+/* --- Script --------------------------------------------------------*/
+
+/* resolve escapes in place, returns the length */
+static size_t unescape(char * s) {
+    char * o = s;
+    char * i = s;
+    while (*i) {
+        if (*i == '\\' && i[1]) {
+            i++;
+            switch (*i) {
+            case 'r': *o++ = '\r'; break;
+            case 'n': *o++ = '\n'; break;
+            case 't': *o++ = '\t'; break;
+            case 's': *o++ = ' ';  break;
+            case 'x': {
+                unsigned v = 0;
+                int k;
+                for ( k = 0 ; k < 2 && i[1] && strchr("0123456789abcdefABCDEF", i[1]) ; ++k ) {
+                    char c = *++i;
+                    v = v * 16 + (unsigned)((c <= '9') ? c - '0' : (c | 0x20) - 'a' + 10);
+                }
+                *o++ = (char)v;
+                break;
+            }
+            default:  *o++ = *i; break;
+            }
+            i++;
+        } else {
+            *o++ = *i++;
+        }
+    }
+    *o = '\0';
+    return (size_t)(o - s);
+}
+
+static int run_line(char * line, int lineno) {
+    char * cmd;
+    char * arg;
+    size_t n = strlen(line);
+    while (n && (line[n-1] == '\n' || line[n-1] == '\r' || line[n-1] == ' ' || line[n-1] == '\t'))
+        line[--n] = '\0';
+    cmd = line + strspn(line, " \t");
+    if (*cmd == '\0' || *cmd == '#')
+        return 0;
+    arg = cmd + strcspn(cmd, " \t");
+    if (*arg) {
+        *arg++ = '\0';
+        arg += strspn(arg, " \t");
+    }
+
+    if (strcmp(cmd, "timeout") == 0) {
+        tmout_ms = (uint32_t)strtoul(arg, NULL, 0);
+    } else if (strcmp(cmd, "bench") == 0) {
+        bench_end();
+        snprintf(b_name, sizeof(b_name), "%s", arg);
+        b_cycle0 = avr->cycle;
+        b_rx0 = rx_total;
+        b_tx0 = tx_total;
+        b_rd0 = bus.rd;
+        b_wr0 = bus.wr;
+        rx_seen = rx_len;
+    } else if (strcmp(cmd, "end") == 0) {
+        bench_end();
+    } else if (strcmp(cmd, "send") == 0) {
+        size_t len = unescape(arg);
+        queue(arg, len);
+    } else if (strcmp(cmd, "expect") == 0) {
+        size_t len = unescape(arg);
+        return expect(arg, len, 1);
+    } else if (strcmp(cmd, "expectn") == 0) {
+        char * text;
+        int count = (int)strtol(arg, &text, 0);
+        text += strspn(text, " \t");
+        return expect(text, unescape(text), count);
+    } else if (strcmp(cmd, "idle") == 0) {
+        return idle((uint32_t)strtoul(arg, NULL, 0));
+    } else if (strcmp(cmd, "paste") == 0) {
+        char * p;
+        unsigned long bytes = strtoul(arg, &p, 0);
+        unsigned long width = strtoul(p, NULL, 0);
+        unsigned long i;
+        if (width < 2)
+            width = 64;
+        for ( i = 0 ; i < bytes ; ++i ) {
+            uint8_t c = ((i % width) == width - 1 || i == bytes - 1) ?
+                '\r' : (uint8_t)('a' + (i % width) % 26);
+            queue(&c, 1);
+        }
+    } else if (strcmp(cmd, "ihex") == 0 || strcmp(cmd, "verify") == 0) {
+        char * p;
+        uint16_t addr = (uint16_t)strtoul(arg, &p, 0);
+        uint32_t len = (uint32_t)strtoul(p, NULL, 0);
+        return (cmd[0] == 'i') ? ihex(addr, len) : verify(addr, len);
+    } else {
+        fprintf(stderr, "simbench: line %d: unknown step '%s'\n", lineno, cmd);
+        return -1;
+    }
+    return 0;
+}
+
+/* --- Setup ---------------------------------------------------------*/
+
+static void usage(void) {
+    fprintf(stderr, "usage: simbench [-m mcu] [-f hz] [-b baud] [-v file.vcd] script firmware.elf\n");
+    exit(2);
+}
+
+int main(int argc, char * argv[]) {
+    const char * mcu = "atmega2560";
+    const char * vcdname = NULL;
+    elf_firmware_t fw;
+    avr_vcd_t vcd;
+    uint32_t flags = 0;
+    FILE * scr;
+    char line[512];
+    int lineno = 0;
+    int opt, i;
+    uint32_t freq_opt = 0;
+
+    while ((opt = getopt(argc, argv, "m:f:b:v:")) != -1) {
+        switch (opt) {
+        case 'm': mcu = optarg; break;
+        case 'f': freq_opt = (uint32_t)strtoul(optarg, NULL, 0); break;
+        case 'b': baud = (uint32_t)strtoul(optarg, NULL, 0); break;
+        case 'v': vcdname = optarg; break;
+        default:  usage();
+        }
+    }
+    if (argc - optind != 2)
+        usage();
+
+    if ((scr = fopen(argv[optind], "r")) == NULL) {
+        perror(argv[optind]);
+        return 2;
+    }
+    memset(&fw, 0, sizeof(fw));
+    if (elf_read_firmware(argv[optind+1], &fw) != 0) {
+        fprintf(stderr, "simbench: can not load %s\n", argv[optind+1]);
+        return 2;
+    }
+    if (fw.mmcu[0])
+        mcu = fw.mmcu;
+    if (freq_opt)
+        fw.frequency = freq_opt;
+    else if (!fw.frequency)
+        fw.frequency = freq;
+    freq = fw.frequency;
+    if ((avr = avr_make_mcu_by_name(mcu)) == NULL) {
+        fprintf(stderr, "simbench: unknown mcu %s\n", mcu);
+        return 2;
+    }
+    avr_init(avr);
+    avr_load_firmware(avr, &fw);
+
+    /* UART1 to us, not to simavr's stdout */
+    avr_ioctl(avr, AVR_IOCTL_UART_GET_FLAGS('1'), &flags);
+    flags &= ~AVR_UART_FLAG_STDIO;
+    avr_ioctl(avr, AVR_IOCTL_UART_SET_FLAGS('1'), &flags);
+    uart_in = avr_io_getirq(avr, AVR_IOCTL_UART_GETIRQ('1'), UART_IRQ_INPUT);
+    avr_irq_register_notify(avr_io_getirq(avr, AVR_IOCTL_UART_GETIRQ('1'), UART_IRQ_OUTPUT),
+        uart_out_hook, NULL);
+    avr_irq_register_notify(avr_io_getirq(avr, AVR_IOCTL_UART_GETIRQ('1'), UART_IRQ_OUT_XON),
+        uart_xon_hook, NULL);
+    avr_irq_register_notify(avr_io_getirq(avr, AVR_IOCTL_UART_GETIRQ('1'), UART_IRQ_OUT_XOFF),
+        uart_xoff_hook, NULL);
+
+    /* RCU85 bus */
+    for ( i = 0 ; i < 0x10000 ; ++i ) {
+        bus.mem[i] = (uint8_t)(i ^ (i >> 8));
+    }
+    for ( i = 0 ; i < 8 ; ++i ) {
+        pin_a[i] = avr_io_getirq(avr, AVR_IOCTL_IOPORT_GETIRQ('A'), i);
+    }
+    pin_hlda = avr_io_getirq(avr, AVR_IOCTL_IOPORT_GETIRQ('L'), L_HLDA);
+    avr_irq_register_notify(avr_io_getirq(avr, AVR_IOCTL_IOPORT_GETIRQ('G'), IOPORT_IRQ_PIN_ALL),
+        port_hook, NULL);
+    avr_irq_register_notify(avr_io_getirq(avr, AVR_IOCTL_IOPORT_GETIRQ('L'), IOPORT_IRQ_PIN_ALL),
+        port_hook, NULL);
+    avr_irq_register_notify(avr_io_getirq(avr, AVR_IOCTL_IOPORT_GETIRQ('K'), IOPORT_IRQ_PIN_ALL),
+        port_hook, NULL);
+
+    if (vcdname) {
+        const char ports[] = "ACGKL";
+        avr_vcd_init(avr, vcdname, &vcd, 1000);
+        for ( i = 0 ; ports[i] ; ++i ) {
+            char name[8];
+            snprintf(name, sizeof(name), "PORT%c", ports[i]);
+            avr_vcd_add_signal(&vcd,
+                avr_io_getirq(avr, AVR_IOCTL_IOPORT_GETIRQ(ports[i]), IOPORT_IRQ_PIN_ALL), 8, name);
+        }
+        avr_vcd_start(&vcd);
+    }
+
+    while (!failed && fgets(line, sizeof(line), scr)) {
+        lineno++;
+        if (run_line(line, lineno) < 0) {
+            fprintf(stderr, "simbench: %s:%d failed\n", argv[optind], lineno);
+            failed = 1;
+        }
+    }
+    bench_end();
+    fclose(scr);
+    if (bus.errors) {
+        fprintf(stderr, "simbench: %lu bus strobes outside a hold\n", bus.errors);
+    }
+    if (vcdname) {
+        avr_vcd_stop(&vcd);
+    }
+    avr_terminate(avr);
+    return failed ? 1 : 0;
+}
@@ -0,0 +1,154 @@
+/*********************************************************************
+ * tracedec.c
+ *
+ * Version 1.0
+ * ---
+ * Event trace decoder (Linux). Turns avrlib event trace records
+ * (libtrace.h) into a timeline, one event per line:
+ *
+ *      time_us     +delta_us   event           arg
+ *
+ * USAGE
+ *
+ *  tracedec [-t] [file]
+ *
+ *  (default)   binary records, as written by trace_flush() to a spare
+ *              serial port or by the host build to RCU85_TRACE. The
+ *              decoder re-synchronizes on TRACE_SYNC and the checksum,
+ *              so a capture may start in the middle of a record.
+ *  -t          text, as printed by the monitor's 'trace' command:
+ *              "tttttttt iiii aaaa" hex lines, other lines are skipped.
+ *
+ *  Reads stdin when no file is given, eg.
+ *      stty -F /dev/ttyUSB1 115200 raw; cat /dev/ttyUSB1 | tracedec
+ *
+ **********************************************************************/
+
+#include <avrlib/libtrace.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+/* event names, avrlib and RCU85 Monitor (rcu85mem.h) */
+static const struct {
+    uint16_t     id;
+    const char * name;
+} evnames[] = {
+    { TRACE_CMD_BEGIN,  "cmd-begin"   },
+    { TRACE_CMD_END,    "cmd-end"     },
+    { TRACE_UART_OVF,   "uart-ovf"    },
+    { TRACE_TIMER,      "timer"       },
+    { TRACE_USER+0,     "bus-hold"    },
+    { TRACE_USER+1,     "bus-release" },
+    { 0,                NULL          }
+};
+
+static uint32_t t_first = 0;
+static uint32_t t_last  = 0;
+static unsigned long count = 0;
+
+static void print_event(const trace_evt_t * evt) {
+    int i;
+    char name[16];
+    snprintf(name, sizeof(name), "0x%04x", evt->id);
+    for ( i = 0 ; evnames[i].name ; ++i ) {
+        if (evnames[i].id == evt->id) {
+            snprintf(name, sizeof(name), "%s", evnames[i].name);
+            break;
+        }
+    }
+    if (count == 0) {
+        t_first = t_last = evt->time;
+    }
+    /* times wrap after 71 minutes, the unsigned differences still hold */
+    printf("%12lu %+12ld   %-14s %5u (0x%04x)\n",
+        (unsigned long)(uint32_t)(evt->time - t_first),
+        (long)(int32_t)(evt->time - t_last),
+        name, evt->arg, evt->arg);
+    t_last = evt->time;
+    count++;
+}
+
+static void decode_binary(FILE * in) {
+    uint8_t rec[TRACE_REC_LEN];
+    trace_evt_t evt;
+    size_t have = 0;
+    unsigned long skipped = 0;
+    int c, i;
+    uint8_t x;
+    while ((c = fgetc(in)) != EOF) {
+        rec[have++] = (uint8_t)c;
+        if (rec[0] != TRACE_SYNC) {
+            have = 0;
+            skipped++;
+            continue;
+        }
+        if (have < TRACE_REC_LEN) {
+            continue;
+        }
+        for ( x = 0, i = 1 ; i < TRACE_REC_LEN-1 ; ++i ) {
+            x ^= rec[i];
+        }
+        if (x != rec[TRACE_REC_LEN-1]) {
+            /* not a record, look for the next sync byte */
+            skipped++;
+            memmove(rec, rec+1, --have);
+            while (have && rec[0] != TRACE_SYNC) {
+                memmove(rec, rec+1, --have);
+                skipped++;
+            }
+            continue;
+        }
+        evt.time = (uint32_t)rec[1] | ((uint32_t)rec[2] << 8) | ((uint32_t)rec[3] << 16) | ((uint32_t)rec[4] << 24);
+        evt.id   = (uint16_t)(rec[5] | (rec[6] << 8));
+        evt.arg  = (uint16_t)(rec[7] | (rec[8] << 8));
+        print_event(&evt);
+        have = 0;
+    }
+    if (skipped) {
+        fprintf(stderr, "tracedec: %lu bytes skipped\n", skipped);
+    }
+}
+
+static void decode_text(FILE * in) {
+    char line[128];
+    unsigned long t;
+    unsigned int id, arg;
+    trace_evt_t evt;
+    while (fgets(line, sizeof(line), in)) {
+        if (sscanf(line, "%8lx %4x %4x", &t, &id, &arg) == 3) {
+            evt.time = (uint32_t)t;
+            evt.id   = (uint16_t)id;
+            evt.arg  = (uint16_t)arg;
+            print_event(&evt);
+        }
+    }
+}
+
+int main(int argc, char * argv[]) {
+    int text = 0;
+    int argi = 1;
+    FILE * in = stdin;
+    if (argi < argc && strcmp(argv[argi], "-t") == 0) {
+        text = 1;
+        argi++;
+    }
+    if (argi < argc) {
+        in = fopen(argv[argi], text ? "r" : "rb");
+        if (!in) {
+            perror(argv[argi]);
+            return 1;
+        }
+    }
+    printf("%12s %12s   %-14s %5s\n", "time_us", "delta_us", "event", "arg");
+    if (text) {
+        decode_text(in);
+    } else {
+        decode_binary(in);
+    }
+    fprintf(stderr, "tracedec: %lu events\n", count);
+    if (in != stdin) {
+        fclose(in);
+    }
+    return 0;
+}